@@ -0,0 +1,55 @@
+#ifndef ARRAYFETCH_H
+#define ARRAYFETCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mysqlite.h"
+
+namespace jlu {
+	class ArrayFetch {
+	   public:
+		ArrayFetch (MySQLite& database, const std::string& query);
+		~ArrayFetch ();
+		ArrayFetch (const ArrayFetch&) = delete;
+		ArrayFetch& operator= (const ArrayFetch&) = delete;
+		void bindInt64 (int col, int64_t* values, uint8_t* nulls = nullptr);
+		void bindDouble (int col, double* values, uint8_t* nulls = nullptr);
+		void bindFixedText (int col, char* buffer, size_t width, uint32_t* lengths = nullptr, uint8_t* nulls = nullptr);
+		void bindVarText (int col, char* data, size_t capacity, uint32_t* offsets, uint8_t* nulls = nullptr);
+		void unbind (int col);
+		size_t fetch (size_t maxRows);
+		void rewind ();
+		bool isDone () const;
+		int columnCount () const;
+		uint64_t rowsFetched () const;
+		sqlite3_stmt* getStatement ();
+
+	   private:
+		enum class Kind { None, Int64, Double, FixedText, VarText };
+		struct Binding {
+			Kind kind = Kind::None;
+			void* values = nullptr;
+			uint8_t* nulls = nullptr;
+			size_t width = 0;
+			uint32_t* lengths = nullptr;
+			uint32_t* offsets = nullptr;
+		};
+		Binding& binding (int col);
+		void refreshBound ();
+		bool fits () const;
+		void copyRow (size_t row);
+		MySQLite& database;
+		sqlite3_stmt* stmt;
+		std::vector<Binding> bindings;
+		std::vector<int> bound;
+		std::vector<size_t> used;
+		bool pending;
+		bool done;
+		uint64_t fetched;
+	};
+}	// namespace jlu
+
+#endif	 // ARRAYFETCH_H
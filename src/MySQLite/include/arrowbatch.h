@@ -0,0 +1,88 @@
+#ifndef ARROWBATCH_H
+#define ARROWBATCH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sqlite3.h"
+
+// Arrow C Data Interface, as published by the Apache Arrow project. The guard lets it live
+// together with arrow/c/abi.h or any other copy of the same definitions.
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+extern "C" {
+struct ArrowSchema {
+	const char* format;
+	const char* name;
+	const char* metadata;
+	int64_t flags;
+	int64_t n_children;
+	struct ArrowSchema** children;
+	struct ArrowSchema* dictionary;
+	void (*release) (struct ArrowSchema*);
+	void* private_data;
+};
+
+struct ArrowArray {
+	int64_t length;
+	int64_t null_count;
+	int64_t offset;
+	int64_t n_buffers;
+	int64_t n_children;
+	const void** buffers;
+	struct ArrowArray** children;
+	struct ArrowArray* dictionary;
+	void (*release) (struct ArrowArray*);
+	void* private_data;
+};
+}
+
+#endif	 // ARROW_C_DATA_INTERFACE
+
+namespace jlu {
+	class ArrowBatch {
+	   public:
+		ArrowBatch ();
+		~ArrowBatch ();
+		ArrowBatch (ArrowBatch&& other) noexcept;
+		ArrowBatch& operator= (ArrowBatch&& other) noexcept;
+		ArrowBatch (const ArrowBatch&) = delete;
+		ArrowBatch& operator= (const ArrowBatch&) = delete;
+		int64_t numRows () const;
+		void release ();
+		ArrowSchema schema;
+		ArrowArray array;
+	};
+
+	class ArrowBatchBuilder {
+	   public:
+		ArrowBatchBuilder (sqlite3_stmt* stmt);
+		void append (sqlite3_stmt* stmt);
+		size_t size () const;
+		void finish (ArrowBatch& batch);
+
+	   private:
+		struct Column {
+			std::string name;
+			char format;
+			int64_t nullCount = 0;
+			std::vector<uint8_t> validity;
+			std::vector<int64_t> integers;
+			std::vector<double> reals;
+			std::vector<int32_t> offsets;
+			std::vector<uint8_t> data;
+		};
+		void chooseFormats (sqlite3_stmt* stmt);
+		std::vector<Column> columns;
+		size_t rows;
+		bool typed;
+	};
+}	// namespace jlu
+
+#endif	 // ARROWBATCH_H
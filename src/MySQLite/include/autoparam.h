@@ -0,0 +1,41 @@
+#ifndef AUTOPARAM_H
+#define AUTOPARAM_H
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mysqlite.h"
+
+namespace jlu {
+	class AutoParameterizer {
+	   public:
+		AutoParameterizer (size_t maxStatements = 64);
+		~AutoParameterizer ();
+		AutoParameterizer (const AutoParameterizer&) = delete;
+		AutoParameterizer& operator= (const AutoParameterizer&) = delete;
+		static bool normalize (const std::string& sql, std::string& normalized, std::vector<sqlValue>& values);
+		static uint64_t fingerprint (const std::string& normalized);
+		sqlite3_stmt* acquire (sqlite3* db, const std::string& sql, bool keepsColumnNames);
+		void release (sqlite3_stmt* stmt);
+		void clear ();
+		AutoParamStats getStats () const;
+
+	   private:
+		struct Entry {
+			std::string normalized;
+			sqlite3_stmt* stmt;
+			bool renamesColumns;
+			std::list<uint64_t>::iterator lru;
+		};
+		void evict ();
+		size_t maxStatements;
+		std::unordered_map<uint64_t, Entry> entries;
+		std::list<uint64_t> lruList;
+		AutoParamStats stats;
+	};
+}	// namespace jlu
+
+#endif	 // AUTOPARAM_H
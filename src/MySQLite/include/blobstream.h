@@ -0,0 +1,43 @@
+#ifndef BLOBSTREAM_H
+#define BLOBSTREAM_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include "mysqlite.h"
+
+namespace jlu {
+	class BlobStream {
+	   public:
+		BlobStream (MySQLite& database,
+					const std::string& table,
+					const std::string& column,
+					int64_t rowid,
+					bool writable = false,
+					const std::string& schema = "main");
+		~BlobStream ();
+		BlobStream (const BlobStream&) = delete;
+		BlobStream& operator= (const BlobStream&) = delete;
+		static bool reserve (MySQLite& database,
+							 const std::string& table,
+							 const std::string& column,
+							 int64_t rowid,
+							 int bytes,
+							 const std::string& schema = "main");
+		int size ();
+		int tell ();
+		bool seek (int offset);
+		int read (void* buffer, int bytes);
+		int write (const void* data, int bytes);
+		bool reopen (int64_t rowid);
+		bool close ();
+
+	   private:
+		sqlite3* db;
+		sqlite3_blob* blob;
+		int offset;
+	};
+}	// namespace jlu
+
+#endif	 // BLOBSTREAM_H
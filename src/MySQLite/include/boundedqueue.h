@@ -0,0 +1,72 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+namespace jlu {
+	/**
+	 * @brief Blocking FIFO with a fixed capacity, used to hand batches between the stages of
+	 * a pipeline. A full queue stops the producers until the consumer catches up.
+	 */
+	template <typename T>
+	class BoundedQueue {
+	   public:
+		explicit BoundedQueue (size_t capacity) : capacity (capacity > 0 ? capacity : 1), closed (false) {}
+
+		/**
+		 * @brief Add an item, waiting while the queue is full.
+		 *
+		 * @return bool False if the queue was closed; the item is not added.
+		 */
+		bool push (T&& item) {
+			std::unique_lock<std::mutex> lock (mtx);
+			notFull.wait (lock, [this] { return closed || items.size () < capacity; });
+			if (closed) {
+				return false;
+			}
+			items.push_back (std::move (item));
+			notEmpty.notify_one ();
+			return true;
+		}
+
+		/**
+		 * @brief Take the oldest item, waiting while the queue is empty.
+		 *
+		 * @return bool False if the queue is closed and there are no more items.
+		 */
+		bool pop (T& item) {
+			std::unique_lock<std::mutex> lock (mtx);
+			notEmpty.wait (lock, [this] { return closed || !items.empty (); });
+			if (items.empty ()) {
+				return false;
+			}
+			item = std::move (items.front ());
+			items.pop_front ();
+			notFull.notify_one ();
+			return true;
+		}
+
+		/**
+		 * @brief Wake up every waiting thread. Items already queued can still be popped.
+		 */
+		void close () {
+			std::lock_guard<std::mutex> lock (mtx);
+			closed = true;
+			notFull.notify_all ();
+			notEmpty.notify_all ();
+		}
+
+	   private:
+		size_t capacity;
+		bool closed;
+		std::deque<T> items;
+		std::mutex mtx;
+		std::condition_variable notFull;
+		std::condition_variable notEmpty;
+	};
+}	// namespace jlu
+
+#endif	 // BOUNDEDQUEUE_H
@@ -0,0 +1,22 @@
+#ifndef CARRAY_H
+#define CARRAY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sqlite3.h"
+
+namespace jlu {
+	namespace carray {
+		extern const char* const name;
+		extern const char* const pointerType;
+
+		int registerModule (sqlite3* db);
+		int bind (sqlite3_stmt* stmt, int param, const std::vector<int64_t>& values);
+		int bind (sqlite3_stmt* stmt, int param, const std::vector<double>& values);
+		int bind (sqlite3_stmt* stmt, int param, const std::vector<std::string>& values);
+	}	// namespace carray
+}	// namespace jlu
+
+#endif	 // CARRAY_H
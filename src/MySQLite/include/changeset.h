@@ -0,0 +1,126 @@
+#ifndef CHANGESET_H
+#define CHANGESET_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mysqlite.h"
+
+namespace jlu {
+	enum class ConflictPolicy { Abort, Replace, Omit };
+
+	struct ChangesetPublisherOptions {
+		uint64_t firstSequence = 0;
+		bool syncEachRecord = false;
+	};
+
+	struct ChangesetPublisherStats {
+		uint64_t changesets = 0;
+		uint64_t bytes = 0;
+		uint64_t emptyCommits = 0;
+		uint64_t writeErrors = 0;
+		uint64_t lastSequence = 0;
+	};
+
+	struct ChangesetApplierOptions {
+		ConflictPolicy policy = ConflictPolicy::Abort;
+		size_t batchRecords = 256;
+		std::chrono::milliseconds pollInterval{10};
+	};
+
+	struct ChangesetApplierStats {
+		uint64_t records = 0;
+		uint64_t batches = 0;
+		uint64_t bytes = 0;
+		uint64_t conflicts = 0;
+		uint64_t skipped = 0;
+		uint64_t lastSequence = 0;
+		uint64_t pendingBytes = 0;
+		std::chrono::microseconds lastLag{0};
+		std::chrono::microseconds maxLag{0};
+		std::string lastError;
+	};
+
+	class ChangesetPublisher {
+	   public:
+		ChangesetPublisher (MySQLite& primary,
+							const std::string& path,
+							const ChangesetPublisherOptions& options = ChangesetPublisherOptions ());
+		~ChangesetPublisher ();
+		ChangesetPublisher (const ChangesetPublisher&) = delete;
+		ChangesetPublisher& operator= (const ChangesetPublisher&) = delete;
+		bool publish ();
+		ChangesetPublisherStats getStats ();
+
+	   private:
+		static int tableFilter (void* self, const char* table);
+		void openSession ();
+		void resumeSequence ();
+		void writeRecord (const void* data, int size);
+		MySQLite& database;
+		std::string path;
+		ChangesetPublisherOptions options;
+		sqlite3_session* session;
+		int fd;
+		bool isFile;
+		uint64_t fileSize;
+		int listenerId;
+		std::mutex mtx;
+		ChangesetPublisherStats stats;
+	};
+
+	class ChangesetApplier {
+	   public:
+		ChangesetApplier (MySQLite& replica,
+						  const std::string& path,
+						  const ChangesetApplierOptions& options = ChangesetApplierOptions ());
+		~ChangesetApplier ();
+		ChangesetApplier (const ChangesetApplier&) = delete;
+		ChangesetApplier& operator= (const ChangesetApplier&) = delete;
+		size_t applyAvailable ();
+		bool start ();
+		bool stop ();
+		bool isRunning ();
+		ChangesetApplierStats getStats ();
+
+	   private:
+		struct Record {
+			uint64_t sequence;
+			int64_t timestampNs;
+			size_t offset;
+			uint32_t size;
+		};
+		static int onConflict (void* self, int conflict, sqlite3_changeset_iter* iter);
+		void loadState ();
+		bool readAvailable ();
+		size_t nextRecords (std::vector<Record>& records);
+		void applyBatch (const std::vector<Record>& records);
+		void execOrThrow (const char* sql);
+		void run ();
+		MySQLite& database;
+		std::string path;
+		ChangesetApplierOptions options;
+		int fd;
+		bool isFile;
+		uint64_t fileOffset;
+		std::vector<char> buffer;
+		size_t bufferStart;
+		size_t pendingRecordBytes;
+		sqlite3_stmt* saveStmt;
+		uint64_t batchConflicts;
+		std::thread worker;
+		std::mutex mtx;
+		std::mutex applyMtx;
+		std::condition_variable wakeUp;
+		bool stopping;
+		bool running;
+		ChangesetApplierStats stats;
+	};
+}	// namespace jlu
+
+#endif	 // CHANGESET_H
@@ -0,0 +1,90 @@
+#ifndef CHANGESTREAM_H
+#define CHANGESTREAM_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "mysqlite.h"
+#include "spmcring.h"
+
+namespace jlu {
+	enum class ChangeOp : uint32_t { Insert, Update, Delete };
+
+	struct ChangeEvent {
+		uint64_t txn;
+		int64_t rowid;
+		uint32_t table;
+		ChangeOp op;
+	};
+
+	struct ChangeStreamStats {
+		uint64_t transactions = 0;
+		uint64_t events = 0;
+		uint64_t rolledBackEvents = 0;
+	};
+
+	// Only jlu::Savepoint reports a ROLLBACK TO: one run with exec("ROLLBACK TO x") is not
+	// seen, and the events of the rows it undid are still published with the commit.
+	class ChangeStream {
+	   public:
+		ChangeStream (MySQLite& database, size_t capacity = 65536);
+		~ChangeStream ();
+		ChangeStream (const ChangeStream&) = delete;
+		ChangeStream& operator= (const ChangeStream&) = delete;
+		std::string tableName (uint32_t table) const;
+		ChangeStreamStats getStats () const;
+
+	   private:
+		friend class ChangeSubscriber;
+		void onUpdate (int op, const char* schema, const char* table, sqlite3_int64 rowid);
+		void onCommitted ();
+		void onRollback ();
+		void onStatementRollback ();
+		void onSavepoint (const std::string& savepoint);
+		void onRollbackTo (const std::string& savepoint);
+		uint32_t tableId (const char* schema, const char* table);
+		MySQLite& database;
+		int listenerId;
+		SpmcRing<ChangeEvent> ring;
+		std::vector<ChangeEvent> pending;
+		std::vector<std::pair<std::string, size_t>> savepoints;
+		size_t statementMark;
+		std::unordered_map<std::string, uint32_t> tableIds;
+		std::vector<std::string> tableNames;
+		mutable std::mutex namesMtx;
+		std::string lastSchema;
+		std::string lastTable;
+		uint32_t lastId;
+		uint64_t nextTxn;
+		std::atomic<uint64_t> transactions;
+		std::atomic<uint64_t> events;
+		std::atomic<uint64_t> rolledBackEvents;
+		std::mutex waitMtx;
+		std::condition_variable published;
+		std::atomic<int> waiters;
+	};
+
+	class ChangeSubscriber {
+	   public:
+		ChangeSubscriber (ChangeStream& stream);
+		size_t poll (std::vector<ChangeEvent>& batch, size_t maxEvents = 1024);
+		size_t wait (std::vector<ChangeEvent>& batch,
+					 std::chrono::milliseconds timeout,
+					 size_t maxEvents = 1024);
+		uint64_t lost () const;
+
+	   private:
+		ChangeStream& stream;
+		uint64_t cursor;
+		uint64_t lostEvents;
+	};
+}	// namespace jlu
+
+#endif	 // CHANGESTREAM_H
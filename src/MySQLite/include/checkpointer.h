@@ -0,0 +1,70 @@
+#ifndef CHECKPOINTER_H
+#define CHECKPOINTER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "mysqlite.h"
+
+namespace jlu {
+	struct CheckpointerOptions {
+		std::chrono::milliseconds interval{1000};
+		int frameThreshold = 1000;
+		bool allowRestart = true;
+		bool allowTruncate = false;
+		int escalateFrames = 10000;
+		int busyTimeoutMs = 100;
+	};
+
+	struct CheckpointStats {
+		uint64_t passiveRuns = 0;
+		uint64_t restartRuns = 0;
+		uint64_t truncateRuns = 0;
+		uint64_t busyRuns = 0;
+		uint64_t framesCheckpointed = 0;
+		int lastLogFrames = 0;
+		int lastCheckpointedFrames = 0;
+		int pendingFrames = 0;
+		std::chrono::microseconds lastDuration{0};
+		std::chrono::microseconds maxDuration{0};
+		std::chrono::microseconds totalDuration{0};
+	};
+
+	class Checkpointer {
+	   public:
+		Checkpointer (MySQLite& database, const CheckpointerOptions& options = CheckpointerOptions ());
+		~Checkpointer ();
+		Checkpointer (const Checkpointer&) = delete;
+		Checkpointer& operator= (const Checkpointer&) = delete;
+		bool start ();
+		bool stop ();
+		bool isRunning ();
+		bool checkpoint (int mode = SQLITE_CHECKPOINT_PASSIVE);
+		CheckpointStats getStats ();
+
+	   private:
+		void onWalCommit (int frames);
+		void run ();
+		bool runCheckpoint (int mode, int& logFrames, int& checkpointedFrames);
+		MySQLite& database;
+		CheckpointerOptions options;
+		sqlite3* conn;
+		int listenerId;
+		int previousAutoCheckpoint;
+		std::thread worker;
+		std::mutex mtx;
+		std::mutex ckptMtx;
+		std::condition_variable wakeUp;
+		bool stopping;
+		bool running;
+		std::atomic<int> pendingFrames;
+		CheckpointStats stats;
+	};
+}	// namespace jlu
+
+#endif	 // CHECKPOINTER_H
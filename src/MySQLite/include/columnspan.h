@@ -0,0 +1,37 @@
+#ifndef COLUMNSPAN_H
+#define COLUMNSPAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace jlu {
+	struct ColumnSpan {
+		enum class Type { Int64, Double, Text, Blob };
+		static ColumnSpan int64s (const std::string& name,
+								  const int64_t* values,
+								  size_t size,
+								  const uint8_t* validity = nullptr);
+		static ColumnSpan doubles (const std::string& name,
+								   const double* values,
+								   size_t size,
+								   const uint8_t* validity = nullptr);
+		static ColumnSpan texts (const std::string& name,
+								 const std::string_view* values,
+								 size_t size,
+								 const uint8_t* validity = nullptr);
+		static ColumnSpan blobs (const std::string& name,
+								 const std::string_view* values,
+								 size_t size,
+								 const uint8_t* validity = nullptr);
+		bool isNull (size_t row) const;
+		std::string name;
+		Type type = Type::Int64;
+		const void* values = nullptr;
+		size_t size = 0;
+		const uint8_t* validity = nullptr;
+	};
+}	// namespace jlu
+
+#endif	 // COLUMNSPAN_H
@@ -0,0 +1,37 @@
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "value.h"
+
+namespace jlu {
+	class StringDictionary {
+	   public:
+		StringDictionary (size_t maxEntries = 65536);
+		StringDictionary (const StringDictionary&) = delete;
+		StringDictionary& operator= (const StringDictionary&) = delete;
+		uint32_t intern (std::string_view text);
+		uint32_t find (std::string_view text) const;
+		std::string_view view (uint32_t code) const;
+		size_t size () const;
+		size_t bytes () const;
+
+	   private:
+		static constexpr size_t firstChunk = 64;
+		static constexpr size_t maxChunks = 27;
+		static size_t chunkOf (uint32_t code);
+		size_t maxEntries;
+		std::unique_ptr<std::string[]> chunks[maxChunks];
+		std::unordered_map<std::string_view, uint32_t> codes;
+		std::atomic<size_t> count;
+		std::atomic<size_t> textBytes;
+	};
+}	// namespace jlu
+
+#endif	 // DICTIONARY_H
@@ -0,0 +1,43 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "mysqlite.h"
+
+namespace jlu {
+	enum class ExportFormat { Csv, JsonLines, Columnar };
+
+	struct ExportOptions {
+		ExportFormat format = ExportFormat::Csv;
+		char delimiter = ',';
+		bool header = true;
+		size_t bufferSize = 1 << 20;
+		bool pipelined = true;
+		bool directIo = false;
+		size_t columnarBatchRows = 65536;
+		size_t columnarBatchBytes = UINT32_MAX;
+	};
+
+	struct ExportStats {
+		uint64_t rows = 0;
+		uint64_t bytes = 0;
+		uint64_t writes = 0;
+		double seconds = 0.0;
+		double writeSeconds = 0.0;
+	};
+
+	class Exporter {
+	   public:
+		Exporter (MySQLite& database, const ExportOptions& options = ExportOptions ());
+		ExportStats exportQuery (const std::string& query, const std::string& fileName);
+
+	   private:
+		MySQLite& database;
+		ExportOptions options;
+	};
+}	// namespace jlu
+
+#endif	 // EXPORTER_H
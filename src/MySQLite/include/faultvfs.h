@@ -0,0 +1,56 @@
+#ifndef FAULTVFS_H
+#define FAULTVFS_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace jlu {
+	namespace faultvfs {
+		extern const char* const name;
+
+		enum class Distribution { Constant, Uniform, Exponential };
+
+		struct LatencyModel {
+			Distribution distribution = Distribution::Constant;
+			std::chrono::microseconds mean{0};
+			double stallProbability = 0.0;
+			std::chrono::microseconds stall{0};
+		};
+
+		struct Options {
+			LatencyModel read;
+			LatencyModel write;
+			LatencyModel sync;
+			uint64_t bytesPerSecond = 0;
+			double readErrorProbability = 0.0;
+			double writeErrorProbability = 0.0;
+			double shortWriteProbability = 0.0;
+			double diskFullProbability = 0.0;
+			double syncErrorProbability = 0.0;
+			std::string fileFilter;
+			uint64_t seed = 1;
+		};
+
+		struct Stats {
+			uint64_t reads = 0;
+			uint64_t writes = 0;
+			uint64_t syncs = 0;
+			uint64_t stalls = 0;
+			uint64_t readErrors = 0;
+			uint64_t writeErrors = 0;
+			uint64_t shortWrites = 0;
+			uint64_t diskFull = 0;
+			uint64_t syncErrors = 0;
+			std::chrono::microseconds injectedDelay{0};
+		};
+
+		bool registerVfs (const char* baseName = nullptr, bool makeDefault = false);
+		void configure (const Options& options);
+		Options getOptions ();
+		Stats getStats ();
+		void resetStats ();
+	}	// namespace faultvfs
+}	// namespace jlu
+
+#endif	 // FAULTVFS_H
@@ -0,0 +1,51 @@
+#ifndef IMPORTER_H
+#define IMPORTER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mysqlite.h"
+
+namespace jlu {
+	enum class ImportFormat { Csv, JsonLines };
+
+	struct ImportOptions {
+		ImportFormat format = ImportFormat::Csv;
+		char delimiter = ',';
+		bool header = true;
+		std::vector<std::string> columns;
+		bool createTable = true;
+		unsigned int threads = 0;
+		size_t batchRows = 4096;
+		size_t queueBatches = 16;
+		size_t rowsPerTransaction = 200000;
+	};
+
+	struct ImportStats {
+		uint64_t rows = 0;
+		uint64_t bytes = 0;
+		uint64_t transactions = 0;
+		double parseSeconds = 0.0;
+		double insertSeconds = 0.0;
+		double totalSeconds = 0.0;
+		double parseRowsPerSecond () const;
+		double parseBytesPerSecond () const;
+		double insertRowsPerSecond () const;
+		double insertBytesPerSecond () const;
+	};
+
+	class Importer {
+	   public:
+		Importer (MySQLite& database, const ImportOptions& options = ImportOptions ());
+		ImportStats importFile (const std::string& fileName, const std::string& table);
+		ImportStats importBuffer (const char* data, size_t size, const std::string& table);
+
+	   private:
+		MySQLite& database;
+		ImportOptions options;
+	};
+}	// namespace jlu
+
+#endif	 // IMPORTER_H
@@ -0,0 +1,47 @@
+#ifndef IOSTATSVFS_H
+#define IOSTATSVFS_H
+
+#include <cstdint>
+
+namespace jlu {
+	struct LatencyHistogram {
+		static const int bucketCount = 24;
+		uint64_t buckets[bucketCount] = {};
+		uint64_t count = 0;
+		uint64_t totalNs = 0;
+		uint64_t maxNs = 0;
+		void add (uint64_t ns);
+		void merge (const LatencyHistogram& other);
+		double meanMicros () const;
+		double percentileMicros (double p) const;
+	};
+
+	struct IoFileStats {
+		uint64_t reads = 0;
+		uint64_t writes = 0;
+		uint64_t syncs = 0;
+		uint64_t bytesRead = 0;
+		uint64_t bytesWritten = 0;
+		LatencyHistogram readLatency;
+		LatencyHistogram writeLatency;
+		LatencyHistogram syncLatency;
+		void merge (const IoFileStats& other);
+	};
+
+	struct IoStats {
+		IoFileStats database;
+		IoFileStats journal;
+		IoFileStats wal;
+		IoFileStats total () const;
+	};
+
+	namespace iostatsvfs {
+		extern const char* const name;
+		extern const int fileControlGet;
+		extern const int fileControlReset;
+
+		bool registerVfs (const char* baseName = nullptr, bool makeDefault = false);
+	}	// namespace iostatsvfs
+}	// namespace jlu
+
+#endif	 // IOSTATSVFS_H
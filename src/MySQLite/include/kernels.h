@@ -0,0 +1,60 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace jlu {
+	namespace kernels {
+		enum class Isa { Scalar, Sse42, Avx2 };
+
+		enum class CompareOp { Eq, Ne, Lt, Le, Gt, Ge };
+
+		template <typename T>
+		struct MinMax {
+			T min;
+			T max;
+			size_t count;
+		};
+
+		struct Moments {
+			size_t count;
+			double mean;
+			double variance;
+			double sampleVariance;
+		};
+
+		// The aggregates over doubles (sum, minMax and moments) skip NaN values and leave them
+		// out of their count, as they skip NULL values: sqlite3 itself stores NaN as NULL.
+		// compare follows IEEE 754: NaN only matches CompareOp::Ne.
+		Isa detectedIsa ();
+		Isa activeIsa ();
+		Isa forceIsa (Isa isa);
+		const char* isaName (Isa isa);
+
+		size_t countValid (const uint8_t* validity, size_t n);
+		void bitmapAnd (const uint8_t* a, const uint8_t* b, uint8_t* out, size_t n);
+
+		int64_t sum (const int64_t* values, const uint8_t* validity, size_t n);
+		double sum (const double* values, const uint8_t* validity, size_t n);
+		MinMax<int64_t> minMax (const int64_t* values, const uint8_t* validity, size_t n);
+		MinMax<double> minMax (const double* values, const uint8_t* validity, size_t n);
+		Moments moments (const int64_t* values, const uint8_t* validity, size_t n);
+		Moments moments (const double* values, const uint8_t* validity, size_t n);
+
+		size_t compare (const int64_t* values,
+						const uint8_t* validity,
+						size_t n,
+						CompareOp op,
+						int64_t rhs,
+						uint8_t* out);
+		size_t compare (const double* values,
+						const uint8_t* validity,
+						size_t n,
+						CompareOp op,
+						double rhs,
+						uint8_t* out);
+	}	// namespace kernels
+}	// namespace jlu
+
+#endif	 // KERNELS_H
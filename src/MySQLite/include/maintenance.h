@@ -0,0 +1,72 @@
+#ifndef MAINTENANCE_H
+#define MAINTENANCE_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "mysqlite.h"
+
+namespace jlu {
+	struct MaintenanceOptions {
+		std::chrono::milliseconds sliceInterval{200};
+		std::chrono::milliseconds idleDelay{1000};
+		int pagesPerSlice = 128;
+		int minFreePages = 16;
+		std::chrono::milliseconds optimizeInterval{std::chrono::hours (1)};
+		int analysisLimit = 400;
+		int foregroundBusyTimeoutMs = 1000;
+	};
+
+	struct MaintenanceStats {
+		uint64_t vacuumSlices = 0;
+		uint64_t pagesReclaimed = 0;
+		uint64_t optimizeRuns = 0;
+		uint64_t busySkips = 0;
+		uint64_t activeSkips = 0;
+		int freePages = 0;
+		std::chrono::microseconds lastSliceDuration{0};
+		std::chrono::microseconds maxSliceDuration{0};
+		std::chrono::microseconds lastOptimizeDuration{0};
+	};
+
+	class Maintenance {
+	   public:
+		Maintenance (MySQLite& database, const MaintenanceOptions& options = MaintenanceOptions ());
+		~Maintenance ();
+		Maintenance (const Maintenance&) = delete;
+		Maintenance& operator= (const Maintenance&) = delete;
+		static bool enableIncrementalVacuum (MySQLite& database);
+		bool start ();
+		bool stop ();
+		bool isRunning ();
+		bool vacuumSlice ();
+		bool optimize ();
+		MaintenanceStats getStats ();
+
+	   private:
+		void run ();
+		bool isIdle ();
+		bool pragmaInt (const std::string& query, int& value);
+		void countBusySkip ();
+		MySQLite& database;
+		MaintenanceOptions options;
+		sqlite3* conn;
+		std::thread worker;
+		std::mutex mtx;
+		std::mutex connMtx;
+		std::condition_variable wakeUp;
+		bool stopping;
+		bool running;
+		int dataVersion;
+		int previousBusyTimeout;
+		std::chrono::steady_clock::time_point lastChange;
+		std::chrono::steady_clock::time_point lastOptimize;
+		MaintenanceStats stats;
+	};
+}	// namespace jlu
+
+#endif	 // MAINTENANCE_H
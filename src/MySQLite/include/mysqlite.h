@@ -1,17 +1,55 @@
 #ifndef MYSQLITE_H
 #define MYSQLITE_H
 
+#include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <string>
 #include <variant>
 #include <vector>
 // #include "../../../external/sqlite3/sqlite3.h"
+#include "arrowbatch.h"
+#include "columnspan.h"
+#include "iostatsvfs.h"
+#include "rows.h"
 #include "sqlite3.h"
+#include "value.h"
 
 namespace jlu {
-	typedef std::map<std::string, std::variant<int, double, std::string, std::vector<uint8_t>>>
-		sqlRow;
+	typedef std::variant<int, double, std::string, std::vector<uint8_t>> sqlValue;
+	typedef std::map<std::string, sqlValue> sqlRow;
+	typedef std::vector<Value> valueRow;
+
+	struct ChangeListener {
+		std::function<void (int op, const char* schema, const char* table, sqlite3_int64 rowid)> onUpdate;
+		std::function<void ()> onCommit;
+		std::function<void ()> onCommitted;
+		std::function<void ()> onRollback;
+		std::function<void ()> onStatement;
+		std::function<void ()> onStatementRollback;
+		std::function<void (const std::string& savepoint)> onSavepoint;
+		std::function<void (const std::string& savepoint)> onRollbackTo;
+		std::function<void (const char* schema, int frames)> onWalCommit;
+	};
+
+	struct AutoParamStats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t unparameterized = 0;
+		uint64_t evictions = 0;
+		size_t statements = 0;
+	};
+
+	struct TransactionStats {
+		uint64_t commits = 0;
+		uint64_t rollbacks = 0;
+		double writeLockSeconds = 0.0;
+		double maxWriteLockSeconds = 0.0;
+	};
+
+	class AutoParameterizer;
+
 	class MySQLite {
 	   public:
 		MySQLite ();
@@ -19,14 +57,64 @@ namespace jlu {
 		~MySQLite ();
 		bool exec (const std::string& query);
 		bool exec (const std::string& query, std::vector<sqlRow>& result);
-		bool open (const std::string& dbName);
+		bool query (const std::string& query,
+					std::vector<valueRow>& rows,
+					std::vector<std::string>* columnNames = nullptr);
+		bool query (const std::string& query, Rows& rows);
+		bool queryBatches (const std::string& query,
+						   size_t batchRows,
+						   std::vector<ArrowBatch>& batches);
+		uint64_t insertColumns (const std::string& table,
+								const std::vector<ColumnSpan>& columns,
+								size_t rowsPerTransaction = 100000);
+		bool open (const std::string& dbName, const std::string& vfs = "");
 		bool close ();
 		bool isOpen ();
+		sqlite3* getHandle ();
+		static sqlValue columnValue (sqlite3_stmt* stmt, int col);
+		static std::string quoteIdentifier (const std::string& name);
+		int addChangeListener (const ChangeListener& listener);
+		void removeChangeListener (int id);
+		void setWalAutoCheckpoint (int frames);
+		int getWalAutoCheckpoint () const;
+		bool getIoStats (IoStats& stats);
+		bool resetIoStats ();
+		void setAutoParameterize (bool enable, size_t maxStatements = 64);
+		AutoParamStats getAutoParamStats () const;
+		TransactionStats getTransactionStats () const;
 
 	   private:
+		friend class Transaction;
+		friend class Savepoint;
+		static void updateHook (void* self,
+								int op,
+								const char* schema,
+								const char* table,
+								sqlite3_int64 rowid);
+		static int commitHook (void* self);
+		static void rollbackHook (void* self);
+		static int walHook (void* self, sqlite3* handle, const char* schema, int frames);
+		static int traceHook (unsigned type, void* self, void* stmt, void* elapsed);
+		void installHooks ();
+		void statementFailed ();
+		void savepointHook (const std::string& savepoint);
+		void rollbackToHook (const std::string& savepoint);
+		sqlite3_stmt* insertStatement (const std::string& table, const std::vector<ColumnSpan>& columns);
+		sqlite3_stmt* cachedStatement (const std::string& sql);
+		void stepCached (const std::string& sql);
+		void finalizeCachedStatements ();
 		bool returnData (std::vector<sqlRow>& result, sqlite3_stmt* stmt, const int& numCols);
 		sqlite3* db;
 		std::string dbName;
+		std::map<int, ChangeListener> listeners;
+		int nextListenerId;
+		int walAutoCheckpoint;
+		bool committing;
+		sqlite3_stmt* runningStatement;
+		std::unique_ptr<AutoParameterizer> autoParams;
+		std::map<std::string, sqlite3_stmt*> cachedStatements;
+		int savepointDepth;
+		TransactionStats transactionStats;
 	};
 }	// namespace jlu
 
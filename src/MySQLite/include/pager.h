@@ -0,0 +1,42 @@
+#ifndef PAGER_H
+#define PAGER_H
+
+#include <string>
+#include <vector>
+
+#include "mysqlite.h"
+
+namespace jlu {
+	struct Page {
+		std::vector<std::string> columns;
+		std::vector<std::vector<sqlValue>> rows;
+		std::string nextToken;
+	};
+
+	class Pager {
+	   public:
+		Pager (MySQLite& database,
+			   const std::string& baseQuery,
+			   const std::vector<std::string>& keyColumns,
+			   int pageSize,
+			   bool descending = false);
+		~Pager ();
+		Pager (const Pager&) = delete;
+		Pager& operator= (const Pager&) = delete;
+		bool fetch (const std::string& token, Page& page);
+		std::string getSeekQuery ();
+
+	   private:
+		sqlite3_stmt* prepare (const std::string& query);
+		std::string encodeToken (sqlite3_stmt* stmt);
+		void bindToken (const std::string& token);
+		MySQLite& database;
+		int pageSize;
+		std::string seekQuery;
+		std::vector<int> keyIndexes;
+		sqlite3_stmt* firstStmt;
+		sqlite3_stmt* seekStmt;
+	};
+}	// namespace jlu
+
+#endif	 // PAGER_H
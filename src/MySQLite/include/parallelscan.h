@@ -0,0 +1,81 @@
+#ifndef PARALLELSCAN_H
+#define PARALLELSCAN_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "arrowbatch.h"
+#include "mysqlite.h"
+#include "snapshot.h"
+
+namespace jlu {
+	struct ScanOptions {
+		std::string keyColumn = "rowid";
+		std::string columns = "*";
+		std::string predicate;
+		size_t threads = 0;
+		size_t chunksPerThread = 4;
+		size_t batchRows = 4096;
+		bool consistent = true;
+		int busyTimeoutMs = 5000;
+	};
+
+	struct ScanStats {
+		uint64_t rows = 0;
+		size_t chunks = 0;
+		size_t threads = 0;
+		double seconds = 0.0;
+		double rowsPerSecond () const;
+	};
+
+	class ParallelScan {
+	   public:
+		typedef std::function<void (size_t worker, sqlite3_stmt* stmt)> RowFn;
+		typedef std::function<void (size_t worker, ArrowBatch& batch)> BatchFn;
+		ParallelScan (MySQLite& database,
+					  const std::string& table,
+					  const ScanOptions& options = ScanOptions ());
+		~ParallelScan ();
+		ParallelScan (const ParallelScan&) = delete;
+		ParallelScan& operator= (const ParallelScan&) = delete;
+		size_t workers () const;
+		ScanStats run (const RowFn& perRow);
+		ScanStats runBatches (const BatchFn& perBatch);
+		ScanStats getStats () const;
+
+		template <typename Partial, typename PerRow, typename Merge>
+		Partial aggregate (const Partial& init, PerRow perRow, Merge merge) {
+			std::vector<Partial> partials (workers (), init);
+			run ([&] (size_t worker, sqlite3_stmt* stmt) { perRow (partials[worker], stmt); });
+			Partial result (init);
+			for (const Partial& partial : partials) {
+				merge (result, partial);
+			}
+			return result;
+		}
+
+	   private:
+		static size_t resolveThreads (size_t threads);
+		ScanStats scan (const RowFn* perRow, const BatchFn* perBatch);
+		void beginRead ();
+		void endRead ();
+		uint64_t scanChunks (size_t worker, const RowFn* perRow, const BatchFn* perBatch);
+		void finalizeStatements ();
+		std::string table;
+		ScanOptions options;
+		ReaderPool pool;
+		std::vector<sqlite3_stmt*> chunkStmts;
+		sqlite3_stmt* rangeStmt;
+		int64_t rangeFirst;
+		uint64_t rangeSpan;
+		uint64_t chunkWidth;
+		size_t numChunks;
+		std::atomic<size_t> nextChunk;
+		ScanStats stats;
+	};
+}	// namespace jlu
+
+#endif	 // PARALLELSCAN_H
@@ -0,0 +1,44 @@
+#ifndef PIPELINEDFETCH_H
+#define PIPELINEDFETCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "mysqlite.h"
+#include "rows.h"
+
+namespace jlu {
+	struct FetchOptions {
+		size_t batchRows = 1024;
+		size_t buffers = 2;
+		Interning interning = Interning::Off;
+	};
+
+	struct FetchStats {
+		uint64_t rows = 0;
+		uint64_t batches = 0;
+		double stepSeconds = 0.0;
+		double consumeSeconds = 0.0;
+		double producerWaitSeconds = 0.0;
+		double consumerWaitSeconds = 0.0;
+		double totalSeconds = 0.0;
+		double rowsPerSecond () const;
+	};
+
+	class PipelinedFetch {
+	   public:
+		typedef std::function<void (const Rows& batch)> BatchFn;
+		PipelinedFetch (MySQLite& database, const FetchOptions& options = FetchOptions ());
+		FetchStats run (const std::string& query, const BatchFn& consume);
+		FetchStats getStats () const;
+
+	   private:
+		MySQLite& database;
+		FetchOptions options;
+		FetchStats stats;
+	};
+}	// namespace jlu
+
+#endif	 // PIPELINEDFETCH_H
@@ -0,0 +1,88 @@
+#ifndef QUERYCACHE_H
+#define QUERYCACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mysqlite.h"
+
+namespace jlu {
+	typedef std::shared_ptr<const std::vector<sqlRow>> CachedResult;
+
+	struct QueryCacheOptions {
+		size_t maxBytes = 64 * 1024 * 1024;
+		size_t maxEntryBytes = 8 * 1024 * 1024;
+	};
+
+	struct QueryCacheStats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t uncacheable = 0;
+		uint64_t invalidations = 0;
+		uint64_t evictions = 0;
+		size_t entries = 0;
+		size_t bytes = 0;
+		double hitRatio () const;
+	};
+
+	class QueryCache {
+	   public:
+		QueryCache (MySQLite& database, const QueryCacheOptions& options = QueryCacheOptions ());
+		~QueryCache ();
+		QueryCache (const QueryCache&) = delete;
+		QueryCache& operator= (const QueryCache&) = delete;
+		CachedResult query (const std::string& sql, const std::vector<sqlValue>& params = {});
+		bool exec (const std::string& sql, std::vector<sqlRow>& result);
+		void invalidate (const std::string& table);
+		void clear ();
+		QueryCacheStats getStats () const;
+
+	   private:
+		struct Entry {
+			CachedResult result;
+			std::vector<std::string> tables;
+			size_t bytes;
+			std::list<std::string>::iterator lru;
+		};
+		struct ReadSet {
+			std::set<std::string> tables;
+			bool select = false;
+			bool cacheable = true;
+		};
+		static int authorize (void* self,
+							  int action,
+							  const char* arg1,
+							  const char* arg2,
+							  const char* arg3,
+							  const char* arg4);
+		static std::string tableKey (const char* schema, const char* table);
+		static std::string makeKey (const std::string& sql, const std::vector<sqlValue>& params);
+		static size_t resultBytes (const std::vector<sqlRow>& rows);
+		void checkDataVersion ();
+		void erase (const std::string& key);
+		void onUpdate (const char* schema, const char* table);
+		void onRollback ();
+		void onRollbackTo ();
+		MySQLite& database;
+		QueryCacheOptions options;
+		int listenerId;
+		ReadSet* recording;
+		sqlite3_stmt* versionStmt;
+		sqlite3_stmt* schemaStmt;
+		int64_t dataVersion;
+		int64_t schemaVersion;
+		int64_t totalChanges;
+		uint64_t hookChanges;
+		std::unordered_map<std::string, Entry> entries;
+		std::unordered_map<std::string, std::set<std::string>> byTable;
+		std::list<std::string> lruList;
+		QueryCacheStats stats;
+	};
+}	// namespace jlu
+
+#endif	 // QUERYCACHE_H
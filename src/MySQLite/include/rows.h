@@ -0,0 +1,90 @@
+#ifndef ROWS_H
+#define ROWS_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "dictionary.h"
+#include "sqlite3.h"
+#include "value.h"
+
+namespace jlu {
+	class ColumnIndex {
+	   public:
+		ColumnIndex (const std::vector<std::string>& names = {});
+		static std::shared_ptr<const ColumnIndex> fromStatement (sqlite3_stmt* stmt);
+		int find (std::string_view name) const;
+		size_t size () const;
+		const std::string& name (size_t col) const;
+		const std::vector<std::string>& names () const;
+
+	   private:
+		static uint64_t hash (std::string_view name, uint64_t seed);
+		std::vector<std::string> columnNames;
+		std::vector<int> slots;
+		uint64_t seed;
+		uint64_t mask;
+	};
+
+	enum class Interning { Off, PerResult, PerColumn };
+
+	class Rows {
+	   public:
+		class Row {
+		   public:
+			const Value& operator[] (size_t col) const;
+			const Value& operator[] (std::string_view name) const;
+			size_t size () const;
+			const Value* begin () const;
+			const Value* end () const;
+
+		   private:
+			friend class Rows;
+			Row (const Value* cells, const ColumnIndex* index);
+			const Value* cells;
+			const ColumnIndex* index;
+		};
+
+		class Iterator {
+		   public:
+			Row operator* () const;
+			Iterator& operator++ ();
+			bool operator!= (const Iterator& other) const;
+
+		   private:
+			friend class Rows;
+			Iterator (const Rows* rows, size_t row);
+			const Rows* rows;
+			size_t row;
+		};
+
+		Rows ();
+		void setInterning (Interning mode, size_t maxEntries = 65536);
+		void reset (std::shared_ptr<const ColumnIndex> index);
+		void reset (const Rows& other);
+		void append (sqlite3_stmt* stmt);
+		void clear ();
+		size_t size () const;
+		bool empty () const;
+		size_t columnCount () const;
+		Row operator[] (size_t row) const;
+		Iterator begin () const;
+		Iterator end () const;
+		const ColumnIndex& columns () const;
+		std::shared_ptr<const ColumnIndex> sharedColumns () const;
+		const StringDictionary* dictionary (size_t col) const;
+
+	   private:
+		std::shared_ptr<const ColumnIndex> index;
+		Interning interning;
+		size_t maxEntries;
+		std::vector<std::shared_ptr<StringDictionary>> dictionaries;
+		std::vector<Value> cells;
+		size_t rowCount;
+	};
+}	// namespace jlu
+
+#endif	 // ROWS_H
@@ -0,0 +1,54 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mysqlite.h"
+
+namespace jlu {
+	class Snapshot {
+	   public:
+		Snapshot ();
+		static Snapshot capture (sqlite3* conn, const std::string& schema = "main");
+		void open (sqlite3* conn) const;
+		bool isValid () const;
+		int compare (const Snapshot& other) const;
+
+	   private:
+		std::shared_ptr<sqlite3_snapshot> snapshot;
+		std::string schema;
+	};
+
+	class ReaderPool {
+	   public:
+		ReaderPool (MySQLite& database, size_t size, int busyTimeoutMs = 5000);
+		~ReaderPool ();
+		ReaderPool (const ReaderPool&) = delete;
+		ReaderPool& operator= (const ReaderPool&) = delete;
+		size_t size () const;
+		sqlite3* reader (size_t index);
+		void begin (bool consistent = true);
+		void begin (const Snapshot& at);
+		void end ();
+		bool inRead () const;
+		const Snapshot& getSnapshot () const;
+
+	   private:
+		void startRead (sqlite3* conn);
+		bool captureSnapshot ();
+		void holdWriters ();
+		void releaseWriters ();
+		void rollback (size_t count);
+		void close ();
+		std::string fileName;
+		int busyTimeoutMs;
+		std::vector<sqlite3*> readers;
+		sqlite3* gate;
+		Snapshot snapshot;
+		bool reading;
+	};
+}	// namespace jlu
+
+#endif	 // SNAPSHOT_H
@@ -0,0 +1,118 @@
+#ifndef SPMCRING_H
+#define SPMCRING_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+namespace jlu {
+	/**
+	 * @brief Bounded lock-free broadcast ring: one producer and any number of consumers, each
+	 * one with its own cursor, so every consumer sees every value.
+	 *
+	 * The producer never waits: a consumer that falls more than capacity values behind loses
+	 * the oldest ones and is told how many. Every slot is a seqlock whose words are atomics.
+	 */
+	template <typename T>
+	class SpmcRing {
+		static_assert (std::is_trivially_copyable<T>::value, "SpmcRing values must be trivially copyable");
+
+	   public:
+		explicit SpmcRing (size_t capacity) : mask (roundUp (capacity) - 1), slots (new Slot[mask + 1]), head (0) {
+			for (size_t i = 0; i <= mask; i++) {
+				slots[i].version.store (0, std::memory_order_relaxed);
+			}
+		}
+
+		SpmcRing (const SpmcRing&) = delete;
+		SpmcRing& operator= (const SpmcRing&) = delete;
+
+		size_t capacity () const { return mask + 1; }
+
+		/**
+		 * @brief Sequence number of the next value to publish. A consumer that starts its
+		 * cursor here only gets new values.
+		 */
+		uint64_t published () const { return head.load (std::memory_order_acquire); }
+
+		/**
+		 * @brief Publish a value. Only one thread may call it.
+		 */
+		void publish (const T& value) {
+			uint64_t seq = head.load (std::memory_order_relaxed);
+			Slot& slot = slots[seq & mask];
+			uint64_t words[numWords] = {};
+			memcpy (words, &value, sizeof (T));
+
+			slot.version.store (2 * seq + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence (std::memory_order_release);
+			for (size_t w = 0; w < numWords; w++) {
+				slot.words[w].store (words[w], std::memory_order_relaxed);
+			}
+			slot.version.store (2 * seq + 2, std::memory_order_release);
+			head.store (seq + 1, std::memory_order_release);
+		}
+
+		/**
+		 * @brief Copy up to max values from cursor on and move cursor past them. Values that
+		 * were overwritten before they could be read are skipped and added to lost.
+		 *
+		 * @return size_t Number of values copied to out.
+		 */
+		size_t read (uint64_t& cursor, T* out, size_t max, uint64_t& lost) const {
+			size_t count = 0;
+			while (count < max) {
+				uint64_t available = head.load (std::memory_order_acquire);
+				if (cursor >= available) {
+					break;
+				}
+				if (available - cursor > capacity ()) {
+					lost += available - capacity () - cursor;
+					cursor = available - capacity ();
+				}
+
+				const Slot& slot = slots[cursor & mask];
+				uint64_t expected = 2 * cursor + 2;
+				uint64_t before = slot.version.load (std::memory_order_acquire);
+				uint64_t words[numWords];
+				for (size_t w = 0; w < numWords; w++) {
+					words[w] = slot.words[w].load (std::memory_order_relaxed);
+				}
+				std::atomic_thread_fence (std::memory_order_acquire);
+				uint64_t after = slot.version.load (std::memory_order_relaxed);
+				if (before != expected || after != expected) {
+					// The producer wrapped around while we were reading: catch up.
+					continue;
+				}
+				memcpy (&out[count], words, sizeof (T));
+				count++;
+				cursor++;
+			}
+			return count;
+		}
+
+	   private:
+		static const size_t numWords = (sizeof (T) + sizeof (uint64_t) - 1) / sizeof (uint64_t);
+
+		struct Slot {
+			std::atomic<uint64_t> version;
+			std::atomic<uint64_t> words[numWords];
+		};
+
+		static size_t roundUp (size_t capacity) {
+			size_t size = 2;
+			while (size < capacity) {
+				size *= 2;
+			}
+			return size;
+		}
+
+		const size_t mask;
+		std::unique_ptr<Slot[]> slots;
+		alignas (64) std::atomic<uint64_t> head;
+	};
+}	// namespace jlu
+
+#endif	 // SPMCRING_H
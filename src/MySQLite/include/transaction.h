@@ -0,0 +1,50 @@
+#ifndef TRANSACTION_H
+#define TRANSACTION_H
+
+#include <chrono>
+#include <string>
+
+#include "mysqlite.h"
+
+namespace jlu {
+	enum class TransactionMode { Deferred, Immediate, Exclusive };
+
+	class Transaction {
+	   public:
+		Transaction (MySQLite& database, TransactionMode mode = TransactionMode::Deferred);
+		~Transaction ();
+		Transaction (const Transaction&) = delete;
+		Transaction& operator= (const Transaction&) = delete;
+		void commit ();
+		void rollback ();
+		bool isActive () const;
+		double writeLockSeconds () const;
+
+	   private:
+		void finish (bool committed, bool wrote);
+		MySQLite& database;
+		TransactionMode mode;
+		bool active;
+		std::chrono::steady_clock::time_point begin;
+		double lockSeconds;
+	};
+
+	class Savepoint {
+	   public:
+		Savepoint (MySQLite& database);
+		~Savepoint ();
+		Savepoint (const Savepoint&) = delete;
+		Savepoint& operator= (const Savepoint&) = delete;
+		void release ();
+		void rollback ();
+		bool isActive () const;
+		const std::string& getName () const;
+
+	   private:
+		MySQLite& database;
+		std::string name;
+		bool active;
+	};
+}	// namespace jlu
+
+#endif	 // TRANSACTION_H
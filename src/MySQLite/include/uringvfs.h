@@ -0,0 +1,32 @@
+#ifndef URINGVFS_H
+#define URINGVFS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace jlu {
+	namespace uringvfs {
+		extern const char* const name;
+
+		struct Options {
+			unsigned bufferSlots = 32;
+			size_t slotBytes = 64 * 1024;
+		};
+
+		struct Stats {
+			uint64_t files = 0;
+			uint64_t fallbackFiles = 0;
+			uint64_t submissions = 0;
+			uint64_t writes = 0;
+			uint64_t coalescedWrites = 0;
+			uint64_t bytes = 0;
+			uint64_t syncs = 0;
+		};
+
+		bool registerVfs (const Options& options = Options (), bool makeDefault = false);
+		bool isAvailable ();
+		Stats getStats ();
+	}	// namespace uringvfs
+}	// namespace jlu
+
+#endif	 // URINGVFS_H
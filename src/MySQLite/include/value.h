@@ -0,0 +1,63 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "sqlite3.h"
+
+namespace jlu {
+	class StringDictionary;
+
+	class Value {
+	   public:
+		enum class Type : uint8_t { Null, Integer, Real, Text, Blob };
+		static constexpr size_t inlineBytes = 14;
+		static constexpr uint32_t noCode = 0xffffffff;
+
+		Value ();
+		Value (int value);
+		Value (int64_t value);
+		Value (double value);
+		Value (const Value& other);
+		Value (Value&& other) noexcept;
+		~Value ();
+		Value& operator= (const Value& other);
+		Value& operator= (Value&& other) noexcept;
+		bool operator== (const Value& other) const;
+		bool operator!= (const Value& other) const;
+		static Value text (std::string_view text);
+		static Value blob (const void* data, size_t size);
+		static Value interned (const StringDictionary* dictionary, uint32_t code);
+		static Value fromColumn (sqlite3_stmt* stmt, int col);
+		Type type () const;
+		bool isNull () const;
+		bool isInline () const;
+		bool isInterned () const;
+		uint32_t code () const;
+		const StringDictionary* dictionary () const;
+		int64_t asInt64 () const;
+		double asDouble () const;
+		std::string_view asText () const;
+		const uint8_t* data () const;
+		size_t size () const;
+		std::string toString () const;
+
+	   private:
+		static const uint8_t typeMask = 0x07;
+		static const uint8_t heapFlag = 0x08;
+		static const uint8_t dictionaryFlag = 0x10;
+		Value (Type type, const void* data, size_t size);
+		void assign (Type type, const void* data, size_t size);
+		void release ();
+		alignas (8) char storage[inlineBytes];
+		uint8_t smallSize;
+		uint8_t tag;
+	};
+
+	static_assert (sizeof (Value) == 16, "jlu::Value must stay 16 bytes");
+}	// namespace jlu
+
+#endif	 // VALUE_H
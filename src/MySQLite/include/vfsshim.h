@@ -0,0 +1,42 @@
+#ifndef VFSSHIM_H
+#define VFSSHIM_H
+
+#include "sqlite3.h"
+
+namespace jlu {
+	namespace vfsshim {
+		typedef int (*OpenFn) (sqlite3_vfs* vfs, const char* path, sqlite3_file* file, int flags, int* outFlags);
+
+		struct ShimFile {
+			sqlite3_file base;
+			sqlite3_file* real;
+		};
+
+		bool build (sqlite3_vfs& vfs, const char* name, const char* baseName, int fileBytes, OpenFn open);
+		sqlite3_vfs* base (sqlite3_vfs* vfs);
+		sqlite3_file* realFile (sqlite3_file* file, int fileBytes);
+		int openReal (sqlite3_vfs* vfs, const char* path, sqlite3_file* file, int fileBytes, int flags, int* outFlags);
+		const sqlite3_io_methods* methodsFor (const sqlite3_io_methods* tables, const sqlite3_file* real);
+
+		int fileClose (sqlite3_file* file);
+		int fileRead (sqlite3_file* file, void* data, int amount, sqlite3_int64 offset);
+		int fileWrite (sqlite3_file* file, const void* data, int amount, sqlite3_int64 offset);
+		int fileTruncate (sqlite3_file* file, sqlite3_int64 size);
+		int fileSync (sqlite3_file* file, int flags);
+		int fileSize (sqlite3_file* file, sqlite3_int64* size);
+		int fileLock (sqlite3_file* file, int lock);
+		int fileUnlock (sqlite3_file* file, int lock);
+		int fileCheckReservedLock (sqlite3_file* file, int* result);
+		int fileControl (sqlite3_file* file, int op, void* arg);
+		int fileSectorSize (sqlite3_file* file);
+		int fileDeviceCharacteristics (sqlite3_file* file);
+		int fileShmMap (sqlite3_file* file, int page, int pageSize, int extend, void volatile** address);
+		int fileShmLock (sqlite3_file* file, int offset, int n, int flags);
+		void fileShmBarrier (sqlite3_file* file);
+		int fileShmUnmap (sqlite3_file* file, int deleteFlag);
+		int fileFetch (sqlite3_file* file, sqlite3_int64 offset, int amount, void** page);
+		int fileUnfetch (sqlite3_file* file, sqlite3_int64 offset, void* page);
+	}	// namespace vfsshim
+}	// namespace jlu
+
+#endif	 // VFSSHIM_H
@@ -0,0 +1,269 @@
+#include "../include/arrayfetch.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace jlu {
+	// The caller binds an array to each column it wants, like SQLBindCol with a row array
+	// size in ODBC, and fetch() writes the rows straight into them: no row objects, no
+	// allocation, only the sqlite3_column_* calls of the bound columns.
+
+	/**
+	 * @brief Prepare a query for array fetches.
+	 *
+	 * @param database An open database. It must outlive the fetcher.
+	 * @param query The string to execute by sqlite3. Parameters can be bound on
+	 * getStatement () before the first fetch.
+	 * @throw std::runtime_error if the SQL statement is wrong.
+	 */
+	ArrayFetch::ArrayFetch (MySQLite& database, const std::string& query)
+		: database (database), stmt (nullptr), pending (false), done (false), fetched (0) {
+		int rc = sqlite3_prepare_v2 (database.getHandle (), query.c_str (), -1, &stmt, nullptr);
+		if (rc != SQLITE_OK) {
+			throw std::runtime_error ("Unable compile the SQL statement. Error code:" + std::to_string (rc) + "\n");
+		}
+		bindings.resize (sqlite3_column_count (stmt));
+	}
+
+	ArrayFetch::~ArrayFetch () { sqlite3_finalize (stmt); }
+
+	/**
+	 * @brief Fetch a column into an array of integers. Reals are truncated, texts converted
+	 * as sqlite3_column_int64 does.
+	 *
+	 * @param col Column, starting at 0.
+	 * @param values Room for the maxRows of every fetch ().
+	 * @param nulls If not nullptr, set to 1 for NULL values (written as 0) and 0 otherwise.
+	 * @throw std::runtime_error if the query has no such column.
+	 */
+	void ArrayFetch::bindInt64 (int col, int64_t* values, uint8_t* nulls) {
+		Binding& b = binding (col);
+		b.kind = Kind::Int64;
+		b.values = values;
+		b.nulls = nulls;
+		refreshBound ();
+	}
+
+	/**
+	 * @brief Fetch a column into an array of doubles. Same parameters as bindInt64.
+	 */
+	void ArrayFetch::bindDouble (int col, double* values, uint8_t* nulls) {
+		Binding& b = binding (col);
+		b.kind = Kind::Double;
+		b.values = values;
+		b.nulls = nulls;
+		refreshBound ();
+	}
+
+	/**
+	 * @brief Fetch a column into fixed width slots: row i is at buffer + i * width.
+	 *
+	 * Longer values are truncated to width bytes; shorter ones are followed by zeros.
+	 * Numbers are written as text and blobs as their bytes.
+	 *
+	 * @param col Column, starting at 0.
+	 * @param buffer Room for maxRows * width bytes.
+	 * @param width Bytes of every slot.
+	 * @param lengths If not nullptr, the whole length of every value, more than width if it
+	 * was truncated.
+	 * @param nulls If not nullptr, set to 1 for NULL values and 0 otherwise.
+	 * @throw std::runtime_error if the query has no such column.
+	 */
+	void ArrayFetch::bindFixedText (int col, char* buffer, size_t width, uint32_t* lengths, uint8_t* nulls) {
+		Binding& b = binding (col);
+		b.kind = Kind::FixedText;
+		b.values = buffer;
+		b.width = width;
+		b.lengths = lengths;
+		b.nulls = nulls;
+		refreshBound ();
+	}
+
+	/**
+	 * @brief Fetch a column into one buffer of variable length values, as an Arrow string
+	 * column: row i is data[offsets[i]] to data[offsets[i + 1]].
+	 *
+	 * A fetch ends early, before the row that does not fit in capacity; that row is the
+	 * first one of the next fetch.
+	 *
+	 * @param col Column, starting at 0.
+	 * @param data The bytes of the values of a fetch.
+	 * @param capacity Size of data. It must hold at least the longest value.
+	 * @param offsets Room for maxRows + 1 offsets. offsets[0] is always 0.
+	 * @param nulls If not nullptr, set to 1 for NULL values (empty) and 0 otherwise.
+	 * @throw std::runtime_error if the query has no such column.
+	 */
+	void ArrayFetch::bindVarText (int col, char* data, size_t capacity, uint32_t* offsets, uint8_t* nulls) {
+		Binding& b = binding (col);
+		b.kind = Kind::VarText;
+		b.values = data;
+		b.width = capacity;
+		b.offsets = offsets;
+		b.nulls = nulls;
+		refreshBound ();
+	}
+
+	/**
+	 * @brief Stop fetching a column. Unbound columns are never read.
+	 */
+	void ArrayFetch::unbind (int col) {
+		binding (col) = Binding ();
+		refreshBound ();
+	}
+
+	/**
+	 * @brief Fetch the next rows into the bound arrays.
+	 *
+	 * @param maxRows Rows the arrays have room for.
+	 * @return size_t Rows written, from index 0; less than maxRows at the end of the result
+	 * or when a variable length buffer is full, 0 once the result is done.
+	 * @throw std::runtime_error if sqlite3 fails, or if a single value does not fit in its
+	 * variable length buffer.
+	 */
+	size_t ArrayFetch::fetch (size_t maxRows) {
+		if (done || maxRows == 0) {
+			return 0;
+		}
+		for (size_t k = 0; k < bound.size (); k++) {
+			used[k] = 0;
+			if (bindings[bound[k]].kind == Kind::VarText) {
+				bindings[bound[k]].offsets[0] = 0;
+			}
+		}
+
+		size_t rows = 0;
+		while (rows < maxRows) {
+			if (!pending) {
+				int rc = sqlite3_step (stmt);
+				if (rc == SQLITE_DONE) {
+					done = true;
+					break;
+				}
+				if (rc != SQLITE_ROW) {
+					done = true;
+					std::string errorMsg ("Error in sql statement. Desc: ");
+					errorMsg += sqlite3_errmsg (database.getHandle ());
+					throw std::runtime_error (errorMsg);
+				}
+				pending = true;
+			}
+			if (!fits ()) {
+				if (rows == 0) {
+					throw std::runtime_error ("ArrayFetch: a value does not fit in its variable length buffer");
+				}
+				break;
+			}
+			copyRow (rows);
+			pending = false;
+			rows++;
+		}
+		fetched += rows;
+		return rows;
+	}
+
+	/**
+	 * @brief Start the result again, e.g. after binding other parameters. The bound arrays
+	 * are kept.
+	 */
+	void ArrayFetch::rewind () {
+		sqlite3_reset (stmt);
+		pending = false;
+		done = false;
+		fetched = 0;
+	}
+
+	/**
+	 * @brief True once fetch () has reached the end of the result.
+	 */
+	bool ArrayFetch::isDone () const { return done; }
+
+	int ArrayFetch::columnCount () const { return static_cast<int> (bindings.size ()); }
+
+	/**
+	 * @brief Rows fetched since the start of the result.
+	 */
+	uint64_t ArrayFetch::rowsFetched () const { return fetched; }
+
+	/**
+	 * @brief The statement, to bind its parameters or read the names of its columns.
+	 */
+	sqlite3_stmt* ArrayFetch::getStatement () { return stmt; }
+
+	// Private methods >>
+
+	ArrayFetch::Binding& ArrayFetch::binding (int col) {
+		if (col < 0 || col >= columnCount ()) {
+			throw std::runtime_error ("ArrayFetch: the query has no column " + std::to_string (col));
+		}
+		return bindings[col];
+	}
+
+	// The columns to copy, rebuilt on every bind, so fetch () only visits those.
+	void ArrayFetch::refreshBound () {
+		bound.clear ();
+		for (int col = 0; col < columnCount (); col++) {
+			if (bindings[col].kind != Kind::None) {
+				bound.push_back (col);
+			}
+		}
+		used.assign (bound.size (), 0);
+	}
+
+	bool ArrayFetch::fits () const {
+		for (size_t k = 0; k < bound.size (); k++) {
+			const Binding& b = bindings[bound[k]];
+			if (b.kind == Kind::VarText) {
+				size_t length = static_cast<size_t> (sqlite3_column_bytes (stmt, bound[k]));
+				if (used[k] + length > b.width) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	void ArrayFetch::copyRow (size_t row) {
+		for (size_t k = 0; k < bound.size (); k++) {
+			int col = bound[k];
+			Binding& b = bindings[col];
+			bool isNull = (sqlite3_column_type (stmt, col) == SQLITE_NULL);
+			if (b.nulls != nullptr) {
+				b.nulls[row] = isNull ? 1 : 0;
+			}
+			switch (b.kind) {
+				case Kind::Int64:
+					static_cast<int64_t*> (b.values)[row] = sqlite3_column_int64 (stmt, col);
+					break;
+				case Kind::Double:
+					static_cast<double*> (b.values)[row] = sqlite3_column_double (stmt, col);
+					break;
+				case Kind::FixedText: {
+					const void* bytes = sqlite3_column_blob (stmt, col);
+					size_t length = static_cast<size_t> (sqlite3_column_bytes (stmt, col));
+					size_t copied = std::min (length, b.width);
+					char* slot = static_cast<char*> (b.values) + row * b.width;
+					if (copied > 0) {
+						memcpy (slot, bytes, copied);
+					}
+					memset (slot + copied, 0, b.width - copied);
+					if (b.lengths != nullptr) {
+						b.lengths[row] = static_cast<uint32_t> (length);
+					}
+					break;
+				}
+				case Kind::VarText: {
+					const void* bytes = sqlite3_column_blob (stmt, col);
+					size_t length = static_cast<size_t> (sqlite3_column_bytes (stmt, col));
+					if (length > 0) {
+						memcpy (static_cast<char*> (b.values) + used[k], bytes, length);
+					}
+					used[k] += length;
+					b.offsets[row + 1] = static_cast<uint32_t> (used[k]);
+					break;
+				}
+				default:
+					break;
+			}
+		}
+	}
+}	// namespace jlu
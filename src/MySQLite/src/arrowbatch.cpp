@@ -0,0 +1,299 @@
+#include "../include/arrowbatch.h"
+
+#include <cctype>
+#include <cstring>
+
+namespace jlu {
+	namespace {
+		struct ArrayData {
+			const void* buffers[3];
+			std::vector<uint8_t> validity;
+			std::vector<int64_t> integers;
+			std::vector<double> reals;
+			std::vector<int32_t> offsets;
+			std::vector<uint8_t> data;
+		};
+
+		struct StructData {
+			const void* buffers[1];
+			std::vector<ArrowArray*> children;
+		};
+
+		struct SchemaData {
+			std::string format;
+			std::string name;
+			std::vector<ArrowSchema*> children;
+		};
+	}	// namespace
+
+	static void releaseColumn (ArrowArray* array) {
+		delete static_cast<ArrayData*> (array->private_data);
+		array->release = nullptr;
+	}
+
+	static void releaseStruct (ArrowArray* array) {
+		StructData* data = static_cast<StructData*> (array->private_data);
+		for (ArrowArray* child : data->children) {
+			if (child->release != nullptr) {
+				child->release (child);
+			}
+			delete child;
+		}
+		delete data;
+		array->release = nullptr;
+	}
+
+	static void releaseSchema (ArrowSchema* schema) {
+		SchemaData* data = static_cast<SchemaData*> (schema->private_data);
+		for (ArrowSchema* child : data->children) {
+			if (child->release != nullptr) {
+				child->release (child);
+			}
+			delete child;
+		}
+		delete data;
+		schema->release = nullptr;
+	}
+
+	static void initSchema (ArrowSchema* schema, SchemaData* data, int64_t flags) {
+		schema->format = data->format.c_str ();
+		schema->name = data->name.c_str ();
+		schema->metadata = nullptr;
+		schema->flags = flags;
+		schema->n_children = static_cast<int64_t> (data->children.size ());
+		schema->children = data->children.empty () ? nullptr : data->children.data ();
+		schema->dictionary = nullptr;
+		schema->release = &releaseSchema;
+		schema->private_data = data;
+	}
+
+	/**
+	 * @brief Creates an empty batch. Both structs are released (release == nullptr).
+	 */
+	ArrowBatch::ArrowBatch () {
+		memset (&schema, 0, sizeof (schema));
+		memset (&array, 0, sizeof (array));
+	}
+
+	/**
+	 * @brief Release the schema and the array, unless they were moved to a consumer.
+	 */
+	ArrowBatch::~ArrowBatch () { release (); }
+
+	ArrowBatch::ArrowBatch (ArrowBatch&& other) noexcept : schema (other.schema), array (other.array) {
+		other.schema.release = nullptr;
+		other.array.release = nullptr;
+	}
+
+	ArrowBatch& ArrowBatch::operator= (ArrowBatch&& other) noexcept {
+		if (this != &other) {
+			release ();
+			schema = other.schema;
+			array = other.array;
+			other.schema.release = nullptr;
+			other.array.release = nullptr;
+		}
+		return *this;
+	}
+
+	/**
+	 * @brief Number of rows of the batch.
+	 */
+	int64_t ArrowBatch::numRows () const { return (array.release != nullptr) ? array.length : 0; }
+
+	/**
+	 * @brief Call the release callbacks of the schema and the array.
+	 *
+	 * A consumer that takes the structs by copy, as the C Data Interface describes, must set
+	 * their release member to nullptr here so they are not released twice.
+	 */
+	void ArrowBatch::release () {
+		if (schema.release != nullptr) {
+			schema.release (&schema);
+		}
+		if (array.release != nullptr) {
+			array.release (&array);
+		}
+	}
+
+	/**
+	 * @brief Creates a builder for the result columns of a prepared statement.
+	 *
+	 * @param stmt The statement. Its column names become the field names.
+	 */
+	ArrowBatchBuilder::ArrowBatchBuilder (sqlite3_stmt* stmt) : rows (0), typed (false) {
+		int numCols = sqlite3_column_count (stmt);
+		columns.resize (numCols);
+		for (int i = 0; i < numCols; i++) {
+			columns[i].name = sqlite3_column_name (stmt, i);
+			columns[i].offsets.push_back (0);
+		}
+	}
+
+	/**
+	 * @brief Append the current row of the statement.
+	 *
+	 * The Arrow type of every column is fixed on the first row: the declared type of the
+	 * column gives int64, float64, utf8 or binary following the sqlite3 affinity rules, and
+	 * columns without one (expressions, NUMERIC affinity) take the type of their first value.
+	 * Later values are converted with the sqlite3_column_* functions.
+	 *
+	 * @param stmt A statement whose last sqlite3_step returned SQLITE_ROW.
+	 */
+	void ArrowBatchBuilder::append (sqlite3_stmt* stmt) {
+		if (!typed) {
+			chooseFormats (stmt);
+		}
+
+		const size_t byte = rows / 8;
+		const uint8_t bit = static_cast<uint8_t> (1u << (rows % 8));
+		for (size_t i = 0; i < columns.size (); i++) {
+			Column& column = columns[i];
+			int col = static_cast<int> (i);
+			if (rows % 8 == 0) {
+				column.validity.push_back (0);
+			}
+
+			bool isNull = (SQLITE_NULL == sqlite3_column_type (stmt, col));
+			if (isNull) {
+				column.nullCount++;
+			} else {
+				column.validity[byte] |= bit;
+			}
+
+			if (column.format == 'l') {
+				column.integers.push_back (isNull ? 0 : sqlite3_column_int64 (stmt, col));
+			} else if (column.format == 'g') {
+				column.reals.push_back (isNull ? 0.0 : sqlite3_column_double (stmt, col));
+			} else {
+				if (!isNull) {
+					const uint8_t* value =
+						(column.format == 'u')
+							? sqlite3_column_text (stmt, col)
+							: static_cast<const uint8_t*> (sqlite3_column_blob (stmt, col));
+					int len = sqlite3_column_bytes (stmt, col);
+					if (len > 0) {
+						column.data.insert (column.data.end (), value, value + len);
+					}
+				}
+				column.offsets.push_back (static_cast<int32_t> (column.data.size ()));
+			}
+		}
+		rows++;
+	}
+
+	/**
+	 * @brief Number of rows appended since the last finish().
+	 */
+	size_t ArrowBatchBuilder::size () const { return rows; }
+
+	/**
+	 * @brief Move the appended rows into a record batch: a struct array ("+s") with one child
+	 * per column and its schema. The builder is left empty, keeping the column types.
+	 *
+	 * @param batch Destination. Its previous content is released.
+	 */
+	void ArrowBatchBuilder::finish (ArrowBatch& batch) {
+		batch.release ();
+
+		SchemaData* schemaData = new SchemaData ();
+		schemaData->format = "+s";
+		StructData* structData = new StructData ();
+		structData->buffers[0] = nullptr;
+
+		for (Column& column : columns) {
+			SchemaData* fieldData = new SchemaData ();
+			fieldData->format = std::string (1, column.format);
+			fieldData->name = column.name;
+			ArrowSchema* field = new ArrowSchema ();
+			initSchema (field, fieldData, ARROW_FLAG_NULLABLE);
+			schemaData->children.push_back (field);
+
+			ArrayData* data = new ArrayData ();
+			data->validity = std::move (column.validity);
+			data->integers = std::move (column.integers);
+			data->reals = std::move (column.reals);
+			data->offsets = std::move (column.offsets);
+			data->data = std::move (column.data);
+
+			ArrowArray* child = new ArrowArray ();
+			child->length = static_cast<int64_t> (rows);
+			child->null_count = column.nullCount;
+			child->offset = 0;
+			child->n_children = 0;
+			child->children = nullptr;
+			child->dictionary = nullptr;
+			child->release = &releaseColumn;
+			child->private_data = data;
+			data->buffers[0] = (column.nullCount > 0) ? data->validity.data () : nullptr;
+			if (column.format == 'l' || column.format == 'g') {
+				child->n_buffers = 2;
+				data->buffers[1] = (column.format == 'l')
+									   ? static_cast<const void*> (data->integers.data ())
+									   : static_cast<const void*> (data->reals.data ());
+			} else {
+				child->n_buffers = 3;
+				data->buffers[1] = data->offsets.data ();
+				data->buffers[2] = data->data.data ();
+			}
+			child->buffers = data->buffers;
+			structData->children.push_back (child);
+
+			column.validity.clear ();
+			column.integers.clear ();
+			column.reals.clear ();
+			column.offsets.assign (1, 0);
+			column.data.clear ();
+			column.nullCount = 0;
+		}
+
+		initSchema (&batch.schema, schemaData, 0);
+		batch.array.length = static_cast<int64_t> (rows);
+		batch.array.null_count = 0;
+		batch.array.offset = 0;
+		batch.array.n_buffers = 1;
+		batch.array.n_children = static_cast<int64_t> (structData->children.size ());
+		batch.array.buffers = structData->buffers;
+		batch.array.children = structData->children.empty () ? nullptr : structData->children.data ();
+		batch.array.dictionary = nullptr;
+		batch.array.release = &releaseStruct;
+		batch.array.private_data = structData;
+		rows = 0;
+	}
+
+	// Private methods >>
+
+	void ArrowBatchBuilder::chooseFormats (sqlite3_stmt* stmt) {
+		for (size_t i = 0; i < columns.size (); i++) {
+			int col = static_cast<int> (i);
+			std::string declared;
+			const char* decl = sqlite3_column_decltype (stmt, col);
+			for (const char* p = decl; p != nullptr && *p != '\0'; p++) {
+				declared += static_cast<char> (toupper (static_cast<unsigned char> (*p)));
+			}
+
+			char format = '\0';
+			if (declared.find ("INT") != std::string::npos) {
+				format = 'l';
+			} else if (declared.find ("CHAR") != std::string::npos ||
+					   declared.find ("CLOB") != std::string::npos ||
+					   declared.find ("TEXT") != std::string::npos) {
+				format = 'u';
+			} else if (declared.find ("BLOB") != std::string::npos) {
+				format = 'z';
+			} else if (declared.find ("REAL") != std::string::npos ||
+					   declared.find ("FLOA") != std::string::npos ||
+					   declared.find ("DOUB") != std::string::npos) {
+				format = 'g';
+			} else {
+				int columnType = sqlite3_column_type (stmt, col);
+				format = (SQLITE_INTEGER == columnType)	 ? 'l'
+						 : (SQLITE_FLOAT == columnType) ? 'g'
+						 : (SQLITE_BLOB == columnType)	 ? 'z'
+														 : 'u';
+			}
+			columns[i].format = format;
+		}
+		typed = true;
+	}
+}	// namespace jlu
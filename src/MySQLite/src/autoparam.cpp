@@ -0,0 +1,413 @@
+#include "../include/autoparam.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+namespace jlu {
+	// Statements whose literals can become parameters. DDL and PRAGMA do not accept
+	// parameters, and transaction control has no literals.
+	static const char* const parameterizable[] = {"select", "insert", "update", "delete",
+												  "replace", "with",	"values"};
+
+	static bool isWordStart (unsigned char c) { return isalpha (c) || c == '_' || c >= 0x80; }
+
+	static bool isWordChar (unsigned char c) { return isalnum (c) || c == '_' || c == '$' || c >= 0x80; }
+
+	static std::string toLower (const std::string& text) {
+		std::string output (text);
+		for (char& c : output) {
+			c = static_cast<char> (tolower (static_cast<unsigned char> (c)));
+		}
+		return output;
+	}
+
+	static int hexDigit (unsigned char c) {
+		if (isdigit (c)) {
+			return c - '0';
+		}
+		c = static_cast<unsigned char> (tolower (c));
+		return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+	}
+
+	/**
+	 * @brief Statement cache for MySQLite::exec with literal SQL. See
+	 * MySQLite::setAutoParameterize.
+	 *
+	 * @param maxStatements Prepared statements kept, the least recently used are finalized.
+	 */
+	AutoParameterizer::AutoParameterizer (size_t maxStatements) : maxStatements (std::max<size_t> (maxStatements, 1)) {}
+
+	/**
+	 * @brief Finalize the cached statements. Call clear() first if the connection may be
+	 * closed before.
+	 */
+	AutoParameterizer::~AutoParameterizer () { clear (); }
+
+	/**
+	 * @brief Replace the literals of a statement by parameters.
+	 *
+	 * Strings, blobs (X'..') and decimal numbers become "?" and their values are appended
+	 * to values, in order, so the same statement with other values gives the same text. The
+	 * rest of the text, white space and comments included, is kept byte for byte: sqlite3
+	 * names an unaliased result column after its exact text ("a  +  b").
+	 * Integers that do not fit in an int, hexadecimal integers and the integers of an
+	 * ORDER BY or GROUP BY (column numbers) are kept.
+	 *
+	 * @param sql One statement.
+	 * @param normalized Destination of the text with parameters.
+	 * @param values Destination of the values of the literals.
+	 * @return bool False if the text is not a single SELECT, INSERT, UPDATE, DELETE,
+	 * REPLACE, WITH or VALUES statement, already has parameters, or cannot be tokenized.
+	 */
+	bool AutoParameterizer::normalize (const std::string& sql,
+									   std::string& normalized,
+									   std::vector<sqlValue>& values) {
+		normalized.clear ();
+		values.clear ();
+		normalized.reserve (sql.size ());
+		const size_t n = sql.size ();
+		size_t i = 0;
+		size_t copied = 0;
+		bool ended = false;
+		bool byClause = false;
+		int depth = 0;
+		int byDepth = 0;
+		std::string firstWord;
+		std::string previousWord;
+
+		auto replace = [&normalized, &sql, &copied] (size_t begin, size_t end) {
+			normalized.append (sql, copied, begin - copied);
+			normalized += '?';
+			copied = end;
+		};
+
+		while (i < n) {
+			unsigned char c = static_cast<unsigned char> (sql[i]);
+			if (isspace (c)) {
+				i++;
+				continue;
+			}
+			if (c == '-' && i + 1 < n && sql[i + 1] == '-') {
+				size_t end = sql.find ('\n', i);
+				i = (end == std::string::npos) ? n : end + 1;
+				continue;
+			}
+			if (c == '/' && i + 1 < n && sql[i + 1] == '*') {
+				size_t end = sql.find ("*/", i + 2);
+				if (end == std::string::npos) {
+					return false;
+				}
+				i = end + 2;
+				continue;
+			}
+			if (ended) {
+				return false;	// A second statement.
+			}
+
+			if (c == ';') {
+				ended = true;
+				i++;
+			} else if (c == '\'') {
+				std::string text;
+				size_t j = i + 1;
+				while (true) {
+					if (j >= n) {
+						return false;
+					}
+					if (sql[j] == '\'') {
+						if (j + 1 < n && sql[j + 1] == '\'') {
+							text += '\'';
+							j += 2;
+							continue;
+						}
+						break;
+					}
+					text += sql[j++];
+				}
+				replace (i, j + 1);
+				values.push_back (std::move (text));
+				i = j + 1;
+				previousWord.clear ();
+			} else if ((c == 'x' || c == 'X') && i + 1 < n && sql[i + 1] == '\'') {
+				size_t end = sql.find ('\'', i + 2);
+				if (end == std::string::npos || (end - i - 2) % 2 != 0) {
+					return false;
+				}
+				std::vector<uint8_t> blob;
+				for (size_t j = i + 2; j < end; j += 2) {
+					int high = hexDigit (sql[j]);
+					int low = hexDigit (sql[j + 1]);
+					if (high < 0 || low < 0) {
+						return false;
+					}
+					blob.push_back (static_cast<uint8_t> (high * 16 + low));
+				}
+				replace (i, end + 1);
+				values.push_back (std::move (blob));
+				i = end + 1;
+				previousWord.clear ();
+			} else if (isdigit (c) || (c == '.' && i + 1 < n && isdigit (static_cast<unsigned char> (sql[i + 1])))) {
+				size_t j = i;
+				bool integer = true;
+				bool hex = (c == '0' && i + 1 < n && (sql[i + 1] == 'x' || sql[i + 1] == 'X'));
+				if (hex) {
+					j += 2;
+					while (j < n && hexDigit (sql[j]) >= 0) {
+						j++;
+					}
+				} else {
+					while (j < n && isdigit (static_cast<unsigned char> (sql[j]))) {
+						j++;
+					}
+					if (j < n && sql[j] == '.') {
+						integer = false;
+						j++;
+						while (j < n && isdigit (static_cast<unsigned char> (sql[j]))) {
+							j++;
+						}
+					}
+					if (j < n && (sql[j] == 'e' || sql[j] == 'E')) {
+						integer = false;
+						j++;
+						if (j < n && (sql[j] == '+' || sql[j] == '-')) {
+							j++;
+						}
+						if (j >= n || !isdigit (static_cast<unsigned char> (sql[j]))) {
+							return false;
+						}
+						while (j < n && isdigit (static_cast<unsigned char> (sql[j]))) {
+							j++;
+						}
+					}
+				}
+				if (j < n && isWordChar (static_cast<unsigned char> (sql[j]))) {
+					return false;
+				}
+				std::string literal (sql, i, j - i);
+				bool keep = hex || (integer && byClause);
+				if (!keep && integer) {
+					errno = 0;
+					long long value = std::strtoll (literal.c_str (), nullptr, 10);
+					keep = (errno != 0 || value > INT_MAX);
+					if (!keep) {
+						values.push_back (static_cast<int> (value));
+					}
+				} else if (!keep) {
+					values.push_back (std::strtod (literal.c_str (), nullptr));
+				}
+				if (!keep) {
+					replace (i, j);
+				}
+				i = j;
+				previousWord.clear ();
+			} else if (c == '"' || c == '`' || c == '[') {
+				char close = (c == '[') ? ']' : static_cast<char> (c);
+				size_t j = i + 1;
+				while (true) {
+					j = sql.find (close, j);
+					if (j == std::string::npos) {
+						return false;
+					}
+					if (close != ']' && j + 1 < n && sql[j + 1] == close) {
+						j += 2;
+						continue;
+					}
+					break;
+				}
+				i = j + 1;
+				previousWord.clear ();
+			} else if (isWordStart (c)) {
+				size_t j = i;
+				while (j < n && isWordChar (static_cast<unsigned char> (sql[j]))) {
+					j++;
+				}
+				std::string word = toLower (sql.substr (i, j - i));
+				if (firstWord.empty ()) {
+					firstWord = word;
+					bool allowed = false;
+					for (const char* keyword : parameterizable) {
+						allowed = allowed || firstWord == keyword;
+					}
+					if (!allowed) {
+						return false;
+					}
+				}
+				if (word == "by" && (previousWord == "order" || previousWord == "group")) {
+					byClause = true;
+					byDepth = depth;
+				} else if (byClause && depth == byDepth &&
+						   (word == "limit" || word == "having" || word == "window" || word == "union" ||
+							word == "except" || word == "intersect")) {
+					byClause = false;
+				}
+				previousWord = word;
+				i = j;
+			} else if (c == '?' || c == ':' || c == '@' || c == '$' || c == '#') {
+				return false;	// It already has parameters.
+			} else {
+				if (c == '(') {
+					depth++;
+				} else if (c == ')') {
+					if (byClause && depth == byDepth) {
+						byClause = false;
+					}
+					depth--;
+				}
+				i++;
+				previousWord.clear ();
+			}
+		}
+		normalized.append (sql, copied, std::string::npos);
+		return !firstWord.empty ();
+	}
+
+	/**
+	 * @brief 64 bits FNV-1a hash of a normalized statement, the key of the cache.
+	 */
+	uint64_t AutoParameterizer::fingerprint (const std::string& normalized) {
+		uint64_t hash = 14695981039346656037ull;
+		for (unsigned char c : normalized) {
+			hash ^= c;
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	/**
+	 * @brief The cached statement for a literal SQL statement, with its values bound.
+	 *
+	 * The statement is prepared with its parameters the first time its normalized text is
+	 * seen, and kept. Give it back with release() once its rows are read.
+	 *
+	 * @param db Connection the cache belongs to.
+	 * @param sql The statement, with literals.
+	 * @param keepsColumnNames The caller reads the rows by column name: refuse statements
+	 * whose result columns are named after a literal ("SELECT 1" names its column "1").
+	 * @return sqlite3_stmt* The statement, or nullptr to run sql as it is: it cannot be
+	 * normalized, its normalized text does not compile or the cached statement is running.
+	 */
+	sqlite3_stmt* AutoParameterizer::acquire (sqlite3* db, const std::string& sql, bool keepsColumnNames) {
+		std::string normalized;
+		std::vector<sqlValue> values;
+		if (!normalize (sql, normalized, values)) {
+			stats.unparameterized++;
+			return nullptr;
+		}
+		uint64_t key = fingerprint (normalized);
+		auto found = entries.find (key);
+		if (found != entries.end () && found->second.normalized == normalized) {
+			stats.hits++;
+			lruList.splice (lruList.begin (), lruList, found->second.lru);
+		} else {
+			sqlite3_stmt* stmt = nullptr;
+			const char* tail = nullptr;
+			int rc = sqlite3_prepare_v3 (db, normalized.c_str (), static_cast<int> (normalized.size ()),
+										 SQLITE_PREPARE_PERSISTENT, &stmt, &tail);
+			if (rc != SQLITE_OK || stmt == nullptr ||
+				sqlite3_bind_parameter_count (stmt) != static_cast<int> (values.size ())) {
+				sqlite3_finalize (stmt);
+				stats.unparameterized++;
+				return nullptr;
+			}
+			stats.misses++;
+			if (found != entries.end ()) {
+				// Another text with the same fingerprint.
+				sqlite3_finalize (found->second.stmt);
+				lruList.erase (found->second.lru);
+				entries.erase (found);
+			}
+			Entry entry;
+			entry.normalized = normalized;
+			entry.stmt = stmt;
+			entry.renamesColumns = false;
+			for (int col = 0; col < sqlite3_column_count (stmt); col++) {
+				const char* columnName = sqlite3_column_name (stmt, col);
+				entry.renamesColumns = entry.renamesColumns || (columnName != nullptr && strchr (columnName, '?'));
+			}
+			lruList.push_front (key);
+			entry.lru = lruList.begin ();
+			found = entries.emplace (key, entry).first;
+			evict ();
+		}
+
+		Entry& entry = found->second;
+		if ((keepsColumnNames && entry.renamesColumns) || sqlite3_stmt_busy (entry.stmt)) {
+			stats.unparameterized++;
+			return nullptr;
+		}
+		for (size_t p = 0; p < values.size (); p++) {
+			int col = static_cast<int> (p + 1);
+			int rc = SQLITE_OK;
+			if (std::holds_alternative<int> (values[p])) {
+				rc = sqlite3_bind_int (entry.stmt, col, std::get<int> (values[p]));
+			} else if (std::holds_alternative<double> (values[p])) {
+				rc = sqlite3_bind_double (entry.stmt, col, std::get<double> (values[p]));
+			} else if (std::holds_alternative<std::string> (values[p])) {
+				const std::string& text = std::get<std::string> (values[p]);
+				rc = sqlite3_bind_text (entry.stmt, col, text.data (), static_cast<int> (text.size ()),
+										SQLITE_TRANSIENT);
+			} else {
+				const std::vector<uint8_t>& blob = std::get<std::vector<uint8_t>> (values[p]);
+				rc = sqlite3_bind_blob (entry.stmt, col, blob.data (), static_cast<int> (blob.size ()),
+										SQLITE_TRANSIENT);
+			}
+			if (rc != SQLITE_OK) {
+				sqlite3_clear_bindings (entry.stmt);
+				stats.unparameterized++;
+				return nullptr;
+			}
+		}
+		return entry.stmt;
+	}
+
+	/**
+	 * @brief Give back a statement returned by acquire(). It is reset and its values
+	 * cleared, so it does not keep a read transaction open.
+	 */
+	void AutoParameterizer::release (sqlite3_stmt* stmt) {
+		sqlite3_reset (stmt);
+		sqlite3_clear_bindings (stmt);
+	}
+
+	/**
+	 * @brief Finalize every cached statement, e.g. before the connection is closed.
+	 */
+	void AutoParameterizer::clear () {
+		for (auto& entry : entries) {
+			sqlite3_finalize (entry.second.stmt);
+		}
+		entries.clear ();
+		lruList.clear ();
+	}
+
+	/**
+	 * @brief Lookups answered from the cache, statements prepared and statements run with
+	 * their literals since the cache was created.
+	 */
+	AutoParamStats AutoParameterizer::getStats () const {
+		AutoParamStats output = stats;
+		output.statements = entries.size ();
+		return output;
+	}
+
+	// Private methods >>
+
+	void AutoParameterizer::evict () {
+		auto victim = lruList.end ();
+		while (entries.size () > maxStatements && victim != lruList.begin ()) {
+			--victim;
+			auto found = entries.find (*victim);
+			if (sqlite3_stmt_busy (found->second.stmt)) {
+				continue;	// Running in an outer exec, e.g. from a WAL hook.
+			}
+			sqlite3_finalize (found->second.stmt);
+			entries.erase (found);
+			victim = lruList.erase (victim);
+			stats.evictions++;
+		}
+	}
+}	// namespace jlu
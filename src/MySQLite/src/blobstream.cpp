@@ -0,0 +1,179 @@
+#include "../include/blobstream.h"
+
+namespace jlu {
+	/**
+	 * @brief Opens a blob for incremental I/O, without loading it in memory.
+	 *
+	 * @param database An open database. It must outlive the stream.
+	 * @param table Table of the blob.
+	 * @param column Column of the blob.
+	 * @param rowid Row of the blob.
+	 * @param writable Open the blob for writing too. The size of a blob can not change, use
+	 * reserve() first to make room for the data.
+	 * @param schema Database where the table lives: "main", "temp" or an attached name.
+	 * @throw std::runtime_error if the blob can not be open, e.g. the row does not exist.
+	 */
+	BlobStream::BlobStream (MySQLite& database,
+							const std::string& table,
+							const std::string& column,
+							int64_t rowid,
+							bool writable,
+							const std::string& schema)
+		: db (database.getHandle ()), blob (nullptr), offset (0) {
+		int result = sqlite3_blob_open (db, schema.c_str (), table.c_str (), column.c_str (), rowid,
+										writable ? 1 : 0, &blob);
+		if (SQLITE_OK != result) {
+			std::string errorMsg ("Unable to open blob. Desc: ");
+			errorMsg += sqlite3_errmsg (db);
+			sqlite3_blob_close (blob);
+			blob = nullptr;
+			throw std::runtime_error (errorMsg);
+		}
+	}
+
+	/**
+	 * @brief Close the blob if it is open and destroy the object.
+	 */
+	BlobStream::~BlobStream () { close (); }
+
+	/**
+	 * @brief Replace the value of a cell with a zeroblob of the given size, so it can be
+	 * filled later with a writable BlobStream.
+	 *
+	 * @param schema Database where the table lives, as for the BlobStream that fills it.
+	 * @return bool True if the row exists and has been updated.
+	 * @throw std::runtime_error if the SQL statement is wrong.
+	 */
+	bool BlobStream::reserve (MySQLite& database,
+							  const std::string& table,
+							  const std::string& column,
+							  int64_t rowid,
+							  int bytes,
+							  const std::string& schema) {
+		sqlite3* handle = database.getHandle ();
+		std::string query ("UPDATE " + MySQLite::quoteIdentifier (schema) + "." +
+						   MySQLite::quoteIdentifier (table) + " SET " +
+						   MySQLite::quoteIdentifier (column) + " = zeroblob(?1) WHERE rowid = ?2;");
+		sqlite3_stmt* stmt = nullptr;
+		int stmtResult = sqlite3_prepare_v2 (handle, query.c_str (), -1, &stmt, nullptr);
+		if (SQLITE_OK != stmtResult) {
+			std::string errorMsg ("Unable compile the SQL statement. Error code:" +
+								  std::to_string (stmtResult) + "\n");
+			throw std::runtime_error (errorMsg);
+		}
+
+		sqlite3_bind_int (stmt, 1, bytes);
+		sqlite3_bind_int64 (stmt, 2, rowid);
+		int result = sqlite3_step (stmt);
+		sqlite3_finalize (stmt);
+		if (SQLITE_DONE != result) {
+			std::string errorMsg ("Error in sql statement. Desc: ");
+			errorMsg += sqlite3_errmsg (handle);
+			throw std::runtime_error (errorMsg);
+		}
+		return (sqlite3_changes (handle) > 0);
+	}
+
+	/**
+	 * @brief Size of the blob in bytes.
+	 */
+	int BlobStream::size () { return (blob != nullptr) ? sqlite3_blob_bytes (blob) : 0; }
+
+	/**
+	 * @brief Current position of the stream, in bytes from the start of the blob.
+	 */
+	int BlobStream::tell () { return offset; }
+
+	/**
+	 * @brief Move the position of the stream.
+	 *
+	 * @param offset New position, between 0 and size().
+	 * @return bool False if the offset is out of the blob.
+	 */
+	bool BlobStream::seek (int offset) {
+		if (offset < 0 || offset > size ()) {
+			return false;
+		}
+		this->offset = offset;
+		return true;
+	}
+
+	/**
+	 * @brief Read the next chunk of the blob into a buffer of the caller.
+	 *
+	 * @param buffer Destination, at least bytes long.
+	 * @param bytes Maximum number of bytes to read.
+	 * @return int Bytes read. 0 at the end of the blob.
+	 * @throw std::runtime_error if the read fails, e.g. the row was changed or deleted
+	 * (SQLITE_ABORT).
+	 */
+	int BlobStream::read (void* buffer, int bytes) {
+		int count = std::min (bytes, size () - offset);
+		if (count <= 0) {
+			return 0;
+		}
+
+		int result = sqlite3_blob_read (blob, buffer, count, offset);
+		if (SQLITE_OK != result) {
+			std::string errorMsg ("Unable to read blob. Desc: ");
+			errorMsg += sqlite3_errmsg (db);
+			throw std::runtime_error (errorMsg);
+		}
+		offset += count;
+		return count;
+	}
+
+	/**
+	 * @brief Write the next chunk of the blob from a buffer of the caller.
+	 *
+	 * @param data Source, at least bytes long.
+	 * @param bytes Number of bytes to write. Writes past the end of the blob are cut.
+	 * @return int Bytes written.
+	 * @throw std::runtime_error if the stream is read only or the write fails.
+	 */
+	int BlobStream::write (const void* data, int bytes) {
+		int count = std::min (bytes, size () - offset);
+		if (count <= 0) {
+			return 0;
+		}
+
+		int result = sqlite3_blob_write (blob, data, count, offset);
+		if (SQLITE_OK != result) {
+			std::string errorMsg ("Unable to write blob. Desc: ");
+			errorMsg += sqlite3_errmsg (db);
+			throw std::runtime_error (errorMsg);
+		}
+		offset += count;
+		return count;
+	}
+
+	/**
+	 * @brief Move the stream to the same column of another row, which is much faster than
+	 * opening a new stream. The position goes back to 0.
+	 *
+	 * @param rowid The new row.
+	 * @return bool True on success. False if the row does not exist or its cell is not a text
+	 * or a blob; the stream can not be used until the next successful reopen.
+	 */
+	bool BlobStream::reopen (int64_t rowid) {
+		if (blob == nullptr) {
+			return false;
+		}
+		offset = 0;
+		return (SQLITE_OK == sqlite3_blob_reopen (blob, rowid));
+	}
+
+	/**
+	 * @brief Close the blob. Pending writes are committed if there is no open transaction.
+	 *
+	 * @return bool True if the blob was open and has been closed without errors.
+	 */
+	bool BlobStream::close () {
+		if (blob == nullptr) {
+			return false;
+		}
+		int result = sqlite3_blob_close (blob);
+		blob = nullptr;
+		return (SQLITE_OK == result);
+	}
+}	// namespace jlu
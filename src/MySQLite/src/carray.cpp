@@ -0,0 +1,211 @@
+#include "../include/carray.h"
+
+namespace jlu {
+	namespace carray {
+		// An eponymous table-valued function, like the carray extension of sqlite3: carray(?)
+		// is a table with one column, value, holding the elements of a C++ vector bound to
+		// the parameter with sqlite3_bind_pointer. "WHERE id IN carray(?)" is then one
+		// prepared statement for any number of keys, with no literal to parse.
+		//
+		// The bound pointer is a small Array descriptor owned by sqlite3 (freed when the
+		// parameter is rebound or the statement finalized); it points to the caller's vector,
+		// which is not copied and must live until the statement is reset.
+
+		const char* const name = "carray";
+		const char* const pointerType = "jlu-carray";
+
+		enum class Type { Int64, Double, Text };
+
+		struct Array {
+			Type type;
+			const void* values;
+			size_t size;
+		};
+
+		struct Cursor {
+			sqlite3_vtab_cursor base;
+			const Array* array;
+			size_t row;
+		};
+
+		// Columns of the table: the values, and the hidden argument of carray(?).
+		static const int valueColumn = 0;
+		static const int pointerColumn = 1;
+
+		static int xConnect (sqlite3* db, void*, int, const char* const*, sqlite3_vtab** table, char**) {
+			int rc = sqlite3_declare_vtab (db, "CREATE TABLE x(value, pointer HIDDEN)");
+			if (rc != SQLITE_OK) {
+				return rc;
+			}
+			*table = static_cast<sqlite3_vtab*> (sqlite3_malloc (sizeof (sqlite3_vtab)));
+			if (*table == nullptr) {
+				return SQLITE_NOMEM;
+			}
+			**table = sqlite3_vtab ();
+			sqlite3_vtab_config (db, SQLITE_VTAB_INNOCUOUS);
+			return SQLITE_OK;
+		}
+
+		static int xDisconnect (sqlite3_vtab* table) {
+			sqlite3_free (table);
+			return SQLITE_OK;
+		}
+
+		// Only a plan with the pointer is useful. If the pointer is there but not usable in
+		// this order of the join, SQLITE_CONSTRAINT makes the planner try another one.
+		static int xBestIndex (sqlite3_vtab*, sqlite3_index_info* info) {
+			int pointerConstraint = -1;
+			bool unusable = false;
+			for (int i = 0; i < info->nConstraint; i++) {
+				const auto& constraint = info->aConstraint[i];
+				if (constraint.iColumn == pointerColumn && constraint.op == SQLITE_INDEX_CONSTRAINT_EQ) {
+					if (constraint.usable) {
+						pointerConstraint = i;
+					} else {
+						unusable = true;
+					}
+				}
+			}
+			if (pointerConstraint >= 0) {
+				info->aConstraintUsage[pointerConstraint].argvIndex = 1;
+				info->aConstraintUsage[pointerConstraint].omit = 1;
+				info->idxNum = 1;
+				info->estimatedCost = 1;
+				info->estimatedRows = 100;
+				return SQLITE_OK;
+			}
+			if (unusable) {
+				return SQLITE_CONSTRAINT;
+			}
+			info->idxNum = 0;
+			info->estimatedCost = 2147483647;
+			info->estimatedRows = 2147483647;
+			return SQLITE_OK;
+		}
+
+		static int xOpen (sqlite3_vtab*, sqlite3_vtab_cursor** cursor) {
+			Cursor* output = static_cast<Cursor*> (sqlite3_malloc (sizeof (Cursor)));
+			if (output == nullptr) {
+				return SQLITE_NOMEM;
+			}
+			*output = Cursor ();
+			*cursor = &output->base;
+			return SQLITE_OK;
+		}
+
+		static int xClose (sqlite3_vtab_cursor* cursor) {
+			sqlite3_free (cursor);
+			return SQLITE_OK;
+		}
+
+		// Without a pointer bound with carray::bind (NULL, or another type), the table is empty.
+		static int xFilter (sqlite3_vtab_cursor* cursor, int idxNum, const char*, int, sqlite3_value** argv) {
+			Cursor* c = reinterpret_cast<Cursor*> (cursor);
+			c->array = (idxNum == 1) ? static_cast<const Array*> (sqlite3_value_pointer (argv[0], pointerType)) : nullptr;
+			c->row = 0;
+			return SQLITE_OK;
+		}
+
+		static int xNext (sqlite3_vtab_cursor* cursor) {
+			reinterpret_cast<Cursor*> (cursor)->row++;
+			return SQLITE_OK;
+		}
+
+		static int xEof (sqlite3_vtab_cursor* cursor) {
+			Cursor* c = reinterpret_cast<Cursor*> (cursor);
+			return (c->array == nullptr || c->row >= c->array->size) ? 1 : 0;
+		}
+
+		static int xColumn (sqlite3_vtab_cursor* cursor, sqlite3_context* context, int col) {
+			Cursor* c = reinterpret_cast<Cursor*> (cursor);
+			if (col != valueColumn) {
+				sqlite3_result_null (context);
+				return SQLITE_OK;
+			}
+			switch (c->array->type) {
+				case Type::Int64:
+					sqlite3_result_int64 (context, static_cast<const int64_t*> (c->array->values)[c->row]);
+					break;
+				case Type::Double:
+					sqlite3_result_double (context, static_cast<const double*> (c->array->values)[c->row]);
+					break;
+				case Type::Text: {
+					const std::string& text = static_cast<const std::string*> (c->array->values)[c->row];
+					sqlite3_result_text64 (context, text.data (), text.size (), SQLITE_STATIC, SQLITE_UTF8);
+					break;
+				}
+			}
+			return SQLITE_OK;
+		}
+
+		static int xRowid (sqlite3_vtab_cursor* cursor, sqlite3_int64* rowid) {
+			*rowid = static_cast<sqlite3_int64> (reinterpret_cast<Cursor*> (cursor)->row) + 1;
+			return SQLITE_OK;
+		}
+
+		static sqlite3_module makeModule () {
+			sqlite3_module output = sqlite3_module ();
+			output.iVersion = 0;
+			// No xCreate: the table is eponymous only, it cannot be created with CREATE VIRTUAL TABLE.
+			output.xConnect = xConnect;
+			output.xBestIndex = xBestIndex;
+			output.xDisconnect = xDisconnect;
+			output.xOpen = xOpen;
+			output.xClose = xClose;
+			output.xFilter = xFilter;
+			output.xNext = xNext;
+			output.xEof = xEof;
+			output.xColumn = xColumn;
+			output.xRowid = xRowid;
+			return output;
+		}
+
+		static const sqlite3_module module = makeModule ();
+
+		static int bindArray (sqlite3_stmt* stmt, int param, Type type, const void* values, size_t size) {
+			Array* array = new Array{type, values, size};
+			// sqlite3 calls the destructor itself if the bind fails.
+			return sqlite3_bind_pointer (stmt, param, array, pointerType,
+										 [] (void* pointer) { delete static_cast<Array*> (pointer); });
+		}
+
+		/**
+		 * @brief Register carray on a connection. MySQLite::open does it for every connection.
+		 *
+		 * @return int The result of sqlite3_create_module.
+		 */
+		int registerModule (sqlite3* db) { return sqlite3_create_module (db, name, &module, nullptr); }
+
+		/**
+		 * @brief Bind a vector to the parameter of carray(?):
+		 * @code .cpp
+		 * std::vector<int64_t> ids = {3, 7, 42};
+		 * sqlite3_prepare_v2 (db.getHandle (), "SELECT * FROM data_1 WHERE id IN carray(?)", -1, &stmt, nullptr);
+		 * jlu::carray::bind (stmt, 1, ids);
+		 * @endcode
+		 *
+		 * @param stmt A prepared statement.
+		 * @param param Index of the parameter, starting at 1.
+		 * @param values The elements. They are not copied: the vector must neither change
+		 * nor be destroyed until the statement is reset or rebound.
+		 * @return int The result of sqlite3_bind_pointer.
+		 */
+		int bind (sqlite3_stmt* stmt, int param, const std::vector<int64_t>& values) {
+			return bindArray (stmt, param, Type::Int64, values.data (), values.size ());
+		}
+
+		/**
+		 * @brief Bind a vector of reals. Same parameters as bind of integers.
+		 */
+		int bind (sqlite3_stmt* stmt, int param, const std::vector<double>& values) {
+			return bindArray (stmt, param, Type::Double, values.data (), values.size ());
+		}
+
+		/**
+		 * @brief Bind a vector of texts. Same parameters as bind of integers.
+		 */
+		int bind (sqlite3_stmt* stmt, int param, const std::vector<std::string>& values) {
+			return bindArray (stmt, param, Type::Text, values.data (), values.size ());
+		}
+	}	// namespace carray
+}	// namespace jlu
@@ -0,0 +1,601 @@
+#include "../include/changeset.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace jlu {
+	// Every record is a header followed by the changeset. Integers use the byte order of
+	// the host: the transport is a local file or pipe.
+	static const uint32_t recordMagic = 0x53434c4a;	  // "JLCS"
+	static const size_t headerSize = 24;
+	static const size_t readAhead = 4 * 1024 * 1024;
+	static const char* const stateTable = "_replication_state";
+
+	static void encodeHeader (char* header, uint32_t size, uint64_t sequence, int64_t timestampNs) {
+		memcpy (header, &recordMagic, 4);
+		memcpy (header + 4, &size, 4);
+		memcpy (header + 8, &sequence, 8);
+		memcpy (header + 16, &timestampNs, 8);
+	}
+
+	static bool decodeHeader (const char* header, uint32_t& size, uint64_t& sequence, int64_t& timestampNs) {
+		uint32_t magic;
+		memcpy (&magic, header, 4);
+		memcpy (&size, header + 4, 4);
+		memcpy (&sequence, header + 8, 8);
+		memcpy (&timestampNs, header + 16, 8);
+		return magic == recordMagic;
+	}
+
+	static int64_t nowNs () {
+		return std::chrono::duration_cast<std::chrono::nanoseconds> (
+				   std::chrono::system_clock::now ().time_since_epoch ())
+			.count ();
+	}
+
+	static bool isFifo (const std::string& path) {
+		struct stat info;
+		return stat (path.c_str (), &info) == 0 && S_ISFIFO (info.st_mode);
+	}
+
+	static std::runtime_error ioError (const std::string& prefix, const std::string& path) {
+		return std::runtime_error (prefix + path + ". Error: " + strerror (errno));
+	}
+
+	/**
+	 * @brief Start recording the changes of a database, one changeset per transaction, into
+	 * a file or a named pipe that a ChangesetApplier reads.
+	 *
+	 * A session object (sqlite3 session extension) tracks every table of the main database
+	 * that has a PRIMARY KEY; tables without one are not replicated. In WAL mode the
+	 * changeset of each commit is appended by the WAL hook, once the write lock is released;
+	 * otherwise call publish() after every commit.
+	 *
+	 * Each record carries a sequence number and the commit time, used by the applier to
+	 * detect gaps and measure the lag. A regular file is appended to: the sequence goes on
+	 * from its last complete record and a record torn by a crash is removed. Opening a pipe
+	 * blocks until the applier opens it.
+	 *
+	 * @param primary An open database. It must stay open and outlive the publisher.
+	 * @param path File or named pipe. A missing file is created.
+	 * @param options First sequence number (0 to go on from the file, or start at 1) and
+	 * fdatasync after each record.
+	 * @throw std::runtime_error if the database is not open, the session can not be created
+	 * or the transport can not be open.
+	 */
+	ChangesetPublisher::ChangesetPublisher (MySQLite& primary,
+											const std::string& path,
+											const ChangesetPublisherOptions& options)
+		: database (primary),
+		  path (path),
+		  options (options),
+		  session (nullptr),
+		  fd (-1),
+		  isFile (true),
+		  fileSize (0),
+		  listenerId (-1) {
+		if (database.getHandle () == nullptr) {
+			throw std::runtime_error ("ChangesetPublisher: the database is not open");
+		}
+
+		isFile = !isFifo (path);
+		fd = isFile ? ::open (path.c_str (), O_RDWR | O_CREAT | O_APPEND, 0644)
+					: ::open (path.c_str (), O_WRONLY);
+		if (fd < 0) {
+			throw ioError ("ChangesetPublisher: unable to open ", path);
+		}
+		try {
+			resumeSequence ();
+			openSession ();
+		} catch (std::exception&) {
+			if (session != nullptr) {
+				sqlite3session_delete (session);
+			}
+			::close (fd);
+			throw;
+		}
+
+		ChangeListener listener;
+		listener.onWalCommit = [this] (const char* schema, int) {
+			if (strcmp (schema, "main") != 0) {
+				return;
+			}
+			try {
+				publish ();
+			} catch (std::exception& e) { std::cerr << e.what () << std::endl; }
+		};
+		listenerId = database.addChangeListener (listener);
+	}
+
+	/**
+	 * @brief Stop recording. Changes not published yet are lost.
+	 */
+	ChangesetPublisher::~ChangesetPublisher () {
+		database.removeChangeListener (listenerId);
+		sqlite3session_delete (session);
+		::close (fd);
+	}
+
+	/**
+	 * @brief Append the changes committed since the last record as a new record.
+	 *
+	 * Call it from the thread that uses the database, after a commit. It does nothing inside
+	 * a transaction, since the changeset would include uncommitted rows. If the write fails
+	 * the changes are kept and go into the next record.
+	 *
+	 * @return bool True if a record was written, false if there were no changes.
+	 * @throw std::runtime_error if the changeset can not be built or written.
+	 */
+	bool ChangesetPublisher::publish () {
+		std::lock_guard<std::mutex> lock (mtx);
+		if (sqlite3_get_autocommit (database.getHandle ()) == 0) {
+			return false;
+		}
+
+		int size = 0;
+		void* data = nullptr;
+		int rc = sqlite3session_changeset (session, &size, &data);
+		if (rc != SQLITE_OK) {
+			throw std::runtime_error ("ChangesetPublisher: unable to build the changeset. Error code: " +
+									  std::to_string (rc));
+		}
+		if (size == 0) {
+			sqlite3_free (data);
+			stats.emptyCommits++;
+			return false;
+		}
+
+		try {
+			writeRecord (data, size);
+		} catch (std::exception&) {
+			sqlite3_free (data);
+			stats.writeErrors++;
+			throw;
+		}
+		sqlite3_free (data);
+
+		// A session can not be reset: start a new one for the next transaction.
+		sqlite3session_delete (session);
+		session = nullptr;
+		openSession ();
+		return true;
+	}
+
+	/**
+	 * @brief Copy of the publisher counters.
+	 *
+	 * @return ChangesetPublisherStats Records and bytes written, commits without changes,
+	 * failed writes and the last sequence number.
+	 */
+	ChangesetPublisherStats ChangesetPublisher::getStats () {
+		std::lock_guard<std::mutex> lock (mtx);
+		return stats;
+	}
+
+	/**
+	 * @brief Creates an applier that replays the records of a ChangesetPublisher on a
+	 * replica. It does nothing until applyAvailable() or start() is called.
+	 *
+	 * The replica must have the same tables as the primary, e.g. a copy of its file. The
+	 * last applied sequence number and the read offset are kept in the _replication_state
+	 * table of the replica, updated in the same transaction as the changes, so a restarted
+	 * applier resumes where it stopped and records already applied are skipped.
+	 *
+	 * @param replica An open database. It must outlive the applier and, while the applier
+	 * runs, no other transaction should be open on it.
+	 * @param path File or named pipe written by the publisher. A missing file is created.
+	 * @param options Conflict policy, records per transaction and poll interval of start().
+	 * @throw std::runtime_error if the database is not open or the transport can not be open.
+	 */
+	ChangesetApplier::ChangesetApplier (MySQLite& replica,
+										const std::string& path,
+										const ChangesetApplierOptions& options)
+		: database (replica),
+		  path (path),
+		  options (options),
+		  fd (-1),
+		  isFile (true),
+		  fileOffset (0),
+		  bufferStart (0),
+		  pendingRecordBytes (0),
+		  saveStmt (nullptr),
+		  batchConflicts (0),
+		  stopping (false),
+		  running (false) {
+		if (database.getHandle () == nullptr) {
+			throw std::runtime_error ("ChangesetApplier: the database is not open");
+		}
+		if (this->options.batchRecords == 0) {
+			this->options.batchRecords = 1;
+		}
+
+		isFile = !isFifo (path);
+		fd = isFile ? ::open (path.c_str (), O_RDONLY | O_CREAT, 0644)
+					: ::open (path.c_str (), O_RDONLY | O_NONBLOCK);
+		if (fd < 0) {
+			throw ioError ("ChangesetApplier: unable to open ", path);
+		}
+		try {
+			loadState ();
+		} catch (std::exception&) {
+			sqlite3_finalize (saveStmt);
+			::close (fd);
+			throw;
+		}
+	}
+
+	/**
+	 * @brief Stop the background thread, if any, and destroy the object.
+	 *
+	 * In case of error show a message in standard output.
+	 */
+	ChangesetApplier::~ChangesetApplier () {
+		try {
+			stop ();
+		} catch (std::exception& e) {
+			std::cerr << "Error at try stop changeset applier in destructor method. Desc.: " << e.what ()
+					  << std::endl;
+		}
+		sqlite3_finalize (saveStmt);
+		::close (fd);
+	}
+
+	/**
+	 * @brief Apply every complete record available, from the calling thread.
+	 *
+	 * Records are applied in transactions of up to options.batchRecords. A conflict is
+	 * solved by options.policy: Replace overwrites the replica row (a missing row is
+	 * omitted), Omit skips the change and Abort rolls the transaction back.
+	 *
+	 * @return size_t Records applied.
+	 * @throw std::runtime_error if a record is corrupted, sequence numbers are missing, a
+	 * conflict aborts the transaction or sqlite3 reports an error. The failed transaction is
+	 * rolled back and the next call retries it.
+	 */
+	size_t ChangesetApplier::applyAvailable () {
+		std::lock_guard<std::mutex> applyLock (applyMtx);
+		size_t applied = 0;
+		std::vector<Record> records;
+		for (;;) {
+			bool more = readAvailable ();
+			if (nextRecords (records) == 0) {
+				if (more) {
+					continue;
+				}
+				break;
+			}
+			applyBatch (records);
+			applied += records.size ();
+		}
+
+		uint64_t pending = buffer.size () - bufferStart;
+		struct stat info;
+		if (isFile && fstat (fd, &info) == 0 && static_cast<uint64_t> (info.st_size) > fileOffset) {
+			pending = info.st_size - fileOffset;
+		}
+		std::lock_guard<std::mutex> lock (mtx);
+		stats.pendingBytes = pending;
+		return applied;
+	}
+
+	/**
+	 * @brief Start a thread that applies the new records every options.pollInterval.
+	 *
+	 * The thread stops applying at the first error, kept in getStats().lastError.
+	 *
+	 * @return bool True if the thread was started, false if it was already running.
+	 */
+	bool ChangesetApplier::start () {
+		if (running) {
+			return false;
+		}
+		stopping = false;
+		running = true;
+		worker = std::thread (&ChangesetApplier::run, this);
+		return true;
+	}
+
+	/**
+	 * @brief Stop the applier thread. Records already read are not lost.
+	 *
+	 * @return bool True if the thread was running and has been stopped.
+	 */
+	bool ChangesetApplier::stop () {
+		if (!running) {
+			return false;
+		}
+		{
+			std::lock_guard<std::mutex> lock (mtx);
+			stopping = true;
+		}
+		wakeUp.notify_all ();
+		worker.join ();
+		running = false;
+		return true;
+	}
+
+	/**
+	 * @brief Check if the applier thread is running
+	 *
+	 * @return true If start() was called and stop() was not.
+	 */
+	bool ChangesetApplier::isRunning () { return running; }
+
+	/**
+	 * @brief Copy of the applier metrics.
+	 *
+	 * @return ChangesetApplierStats Records, transactions, bytes, conflicts and skipped
+	 * records, the last sequence number, bytes waiting to be applied and the lag (time from
+	 * the commit on the primary to the commit on the replica) of the last record.
+	 */
+	ChangesetApplierStats ChangesetApplier::getStats () {
+		std::lock_guard<std::mutex> lock (mtx);
+		return stats;
+	}
+
+	// Private methods >>
+
+	int ChangesetPublisher::tableFilter (void* /*self*/, const char* table) {
+		return strcmp (table, stateTable) != 0;
+	}
+
+	void ChangesetPublisher::openSession () {
+		int rc = sqlite3session_create (database.getHandle (), "main", &session);
+		if (rc != SQLITE_OK) {
+			throw std::runtime_error ("ChangesetPublisher: unable to create the session. Error code: " +
+									  std::to_string (rc));
+		}
+		sqlite3session_table_filter (session, &ChangesetPublisher::tableFilter, this);
+		rc = sqlite3session_attach (session, nullptr);
+		if (rc != SQLITE_OK) {
+			throw std::runtime_error ("ChangesetPublisher: unable to attach the session. Error code: " +
+									  std::to_string (rc));
+		}
+	}
+
+	void ChangesetPublisher::resumeSequence () {
+		uint64_t lastSequence = 0;
+		if (isFile) {
+			char header[headerSize];
+			uint32_t size;
+			uint64_t sequence;
+			int64_t timestampNs;
+			while (pread (fd, header, headerSize, fileSize) == static_cast<ssize_t> (headerSize) &&
+				   decodeHeader (header, size, sequence, timestampNs)) {
+				struct stat info;
+				if (fstat (fd, &info) != 0 || fileSize + headerSize + size > static_cast<uint64_t> (info.st_size)) {
+					break;
+				}
+				lastSequence = sequence;
+				fileSize += headerSize + size;
+			}
+			if (ftruncate (fd, fileSize) != 0) {
+				throw ioError ("ChangesetPublisher: unable to truncate ", path);
+			}
+		}
+		if (options.firstSequence > lastSequence + 1) {
+			lastSequence = options.firstSequence - 1;
+		}
+		stats.lastSequence = lastSequence;
+	}
+
+	void ChangesetPublisher::writeRecord (const void* data, int size) {
+		std::vector<char> record (headerSize + size);
+		encodeHeader (record.data (), static_cast<uint32_t> (size), stats.lastSequence + 1, nowNs ());
+		memcpy (record.data () + headerSize, data, size);
+
+		size_t written = 0;
+		while (written < record.size ()) {
+			ssize_t count = ::write (fd, record.data () + written, record.size () - written);
+			if (count < 0 && errno == EINTR) {
+				continue;
+			}
+			if (count < 0) {
+				std::runtime_error error = ioError ("ChangesetPublisher: unable to write to ", path);
+				// Do not leave a torn record in front of the next one.
+				if (isFile && ftruncate (fd, fileSize) != 0) {
+					std::cerr << "ChangesetPublisher: unable to truncate " << path << std::endl;
+				}
+				throw error;
+			}
+			written += count;
+		}
+		if (isFile && options.syncEachRecord && fdatasync (fd) != 0) {
+			throw ioError ("ChangesetPublisher: unable to sync ", path);
+		}
+
+		fileSize += record.size ();
+		stats.changesets++;
+		stats.bytes += size;
+		stats.lastSequence++;
+	}
+
+	int ChangesetApplier::onConflict (void* self, int conflict, sqlite3_changeset_iter* /*iter*/) {
+		ChangesetApplier* applier = static_cast<ChangesetApplier*> (self);
+		applier->batchConflicts++;
+		switch (applier->options.policy) {
+			case ConflictPolicy::Omit:
+				return SQLITE_CHANGESET_OMIT;
+			case ConflictPolicy::Replace:
+				// REPLACE is only allowed when the row exists.
+				return (SQLITE_CHANGESET_DATA == conflict || SQLITE_CHANGESET_CONFLICT == conflict)
+						   ? SQLITE_CHANGESET_REPLACE
+						   : SQLITE_CHANGESET_OMIT;
+			default:
+				return SQLITE_CHANGESET_ABORT;
+		}
+	}
+
+	void ChangesetApplier::loadState () {
+		std::string create = std::string ("CREATE TABLE IF NOT EXISTS ") + stateTable +
+							 " (id INTEGER PRIMARY KEY CHECK (id = 0), sequence INTEGER NOT NULL, "
+							 "file_offset INTEGER NOT NULL, applied_at INTEGER NOT NULL);";
+		execOrThrow (create.c_str ());
+
+		sqlite3* handle = database.getHandle ();
+		std::string select = std::string ("SELECT sequence, file_offset FROM ") + stateTable + " WHERE id = 0;";
+		sqlite3_stmt* stmt = nullptr;
+		int rc = sqlite3_prepare_v2 (handle, select.c_str (), -1, &stmt, nullptr);
+		if (rc != SQLITE_OK) {
+			throw std::runtime_error ("Unable compile the SQL statement. Error code:" + std::to_string (rc) +
+									  "\n");
+		}
+		uint64_t storedOffset = 0;
+		if (sqlite3_step (stmt) == SQLITE_ROW) {
+			stats.lastSequence = sqlite3_column_int64 (stmt, 0);
+			storedOffset = sqlite3_column_int64 (stmt, 1);
+		}
+		sqlite3_finalize (stmt);
+
+		// A file that was replaced or truncated is read again; its records already applied
+		// are skipped by sequence number.
+		struct stat info;
+		if (isFile && fstat (fd, &info) == 0 && storedOffset <= static_cast<uint64_t> (info.st_size) &&
+			lseek (fd, storedOffset, SEEK_SET) >= 0) {
+			fileOffset = storedOffset;
+		}
+
+		std::string save = std::string ("INSERT OR REPLACE INTO ") + stateTable + " VALUES (0, ?1, ?2, ?3);";
+		rc = sqlite3_prepare_v3 (handle, save.c_str (), -1, SQLITE_PREPARE_PERSISTENT, &saveStmt, nullptr);
+		if (rc != SQLITE_OK) {
+			throw std::runtime_error ("Unable compile the SQL statement. Error code:" + std::to_string (rc) +
+									  "\n");
+		}
+	}
+
+	bool ChangesetApplier::readAvailable () {
+		if (bufferStart > 0 && bufferStart * 2 >= buffer.size ()) {
+			buffer.erase (buffer.begin (), buffer.begin () + bufferStart);
+			bufferStart = 0;
+		}
+		size_t wanted = std::max (readAhead, pendingRecordBytes);
+		while (buffer.size () - bufferStart < wanted) {
+			size_t used = buffer.size ();
+			buffer.resize (used + 65536);
+			ssize_t count = ::read (fd, buffer.data () + used, 65536);
+			buffer.resize (used + std::max<ssize_t> (count, 0));
+			if (count < 0 && errno == EINTR) {
+				continue;
+			}
+			if (count < 0 && errno != EAGAIN) {
+				throw ioError ("ChangesetApplier: unable to read ", path);
+			}
+			if (count <= 0) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	size_t ChangesetApplier::nextRecords (std::vector<Record>& records) {
+		records.clear ();
+		pendingRecordBytes = 0;
+		size_t position = bufferStart;
+		while (records.size () < options.batchRecords && buffer.size () - position >= headerSize) {
+			Record record;
+			if (!decodeHeader (buffer.data () + position, record.size, record.sequence, record.timestampNs)) {
+				throw std::runtime_error ("ChangesetApplier: corrupted record at offset " +
+										  std::to_string (fileOffset + position - bufferStart) + " of " + path);
+			}
+			if (buffer.size () - position < headerSize + record.size) {
+				pendingRecordBytes = headerSize + record.size;
+				break;
+			}
+			record.offset = position + headerSize;
+			records.push_back (record);
+			position += headerSize + record.size;
+		}
+		return records.size ();
+	}
+
+	void ChangesetApplier::applyBatch (const std::vector<Record>& records) {
+		uint64_t lastSequence = stats.lastSequence;
+		for (const Record& record : records) {
+			if (record.sequence > lastSequence + 1) {
+				throw std::runtime_error ("ChangesetApplier: missing changesets " + std::to_string (lastSequence + 1) +
+										  " to " + std::to_string (record.sequence - 1));
+			}
+			lastSequence = std::max (lastSequence, record.sequence);
+		}
+		const Record& last = records.back ();
+		uint64_t nextOffset = fileOffset + (last.offset + last.size - bufferStart);
+
+		sqlite3* handle = database.getHandle ();
+		uint64_t skipped = 0;
+		uint64_t bytes = 0;
+		batchConflicts = 0;
+		execOrThrow ("BEGIN IMMEDIATE;");
+		try {
+			for (const Record& record : records) {
+				if (record.sequence <= stats.lastSequence) {
+					skipped++;
+					continue;
+				}
+				int rc = sqlite3changeset_apply (handle, record.size, buffer.data () + record.offset, nullptr,
+												 &ChangesetApplier::onConflict, this);
+				if (rc != SQLITE_OK) {
+					throw std::runtime_error ("ChangesetApplier: unable to apply changeset " +
+											  std::to_string (record.sequence) + ". Error code: " + std::to_string (rc));
+				}
+				bytes += record.size;
+			}
+			sqlite3_bind_int64 (saveStmt, 1, static_cast<sqlite3_int64> (lastSequence));
+			sqlite3_bind_int64 (saveStmt, 2, static_cast<sqlite3_int64> (nextOffset));
+			sqlite3_bind_int64 (saveStmt, 3, nowNs ());
+			int rc = sqlite3_step (saveStmt);
+			sqlite3_reset (saveStmt);
+			if (rc != SQLITE_DONE) {
+				throw std::runtime_error (std::string ("Error in sql statement. Desc: ") + sqlite3_errmsg (handle));
+			}
+			execOrThrow ("COMMIT;");
+		} catch (std::exception&) {
+			sqlite3_exec (handle, "ROLLBACK;", nullptr, nullptr, nullptr);
+			throw;
+		}
+
+		std::chrono::microseconds lag (std::max<int64_t> ((nowNs () - last.timestampNs) / 1000, 0));
+		bufferStart = last.offset + last.size;
+		fileOffset = nextOffset;
+
+		std::lock_guard<std::mutex> lock (mtx);
+		stats.records += records.size () - skipped;
+		stats.skipped += skipped;
+		stats.batches++;
+		stats.bytes += bytes;
+		stats.conflicts += batchConflicts;
+		stats.lastSequence = lastSequence;
+		stats.lastLag = lag;
+		stats.maxLag = std::max (stats.maxLag, lag);
+	}
+
+	void ChangesetApplier::execOrThrow (const char* sql) {
+		char* errMsg = nullptr;
+		if (sqlite3_exec (database.getHandle (), sql, nullptr, nullptr, &errMsg) != SQLITE_OK) {
+			std::string error ("ChangesetApplier: ");
+			error += (errMsg != nullptr) ? errMsg : "unknown error";
+			sqlite3_free (errMsg);
+			throw std::runtime_error (error);
+		}
+	}
+
+	void ChangesetApplier::run () {
+		std::unique_lock<std::mutex> lock (mtx);
+		while (!stopping) {
+			lock.unlock ();
+			try {
+				applyAvailable ();
+			} catch (std::exception& e) {
+				lock.lock ();
+				stats.lastError = e.what ();
+				break;
+			}
+			lock.lock ();
+			wakeUp.wait_for (lock, options.pollInterval, [this] { return stopping; });
+		}
+	}
+}	// namespace jlu
@@ -0,0 +1,213 @@
+#include "../include/changestream.h"
+
+#include <algorithm>
+
+namespace jlu {
+	/**
+	 * @brief Start capturing the changes committed through a connection.
+	 *
+	 * The update hook buffers one event (op, table, rowid) per changed row of the current
+	 * transaction; once the commit has succeeded (ChangeListener::onCommitted) they are
+	 * published, tagged with a transaction number, into a lock-free ring that
+	 * ChangeSubscriber objects read; the rollback hook drops them. A commit that fails with
+	 * SQLITE_BUSY keeps them buffered until the transaction is committed again or rolled
+	 * back. A jlu::Savepoint rolled back drops the events buffered since it was opened, and
+	 * a statement that fails inside a transaction, the events of the rows sqlite3 undid.
+	 *
+	 * As sqlite3 itself, it does not see changes of WITHOUT ROWID tables nor rows deleted by
+	 * the truncate optimization (DELETE without WHERE). A ROLLBACK TO run with exec() instead
+	 * of a jlu::Savepoint is not seen either: the events of the rows it undid are published.
+	 *
+	 * @param database The connection to capture. It must outlive the stream.
+	 * @param capacity Events kept for the subscribers, rounded up to a power of 2. A
+	 * subscriber that falls further behind loses the oldest events.
+	 */
+	ChangeStream::ChangeStream (MySQLite& database, size_t capacity)
+		: database (database),
+		  listenerId (-1),
+		  ring (capacity),
+		  statementMark (0),
+		  lastId (0),
+		  nextTxn (1),
+		  transactions (0),
+		  events (0),
+		  rolledBackEvents (0),
+		  waiters (0) {
+		ChangeListener listener;
+		listener.onUpdate = [this] (int op, const char* schema, const char* table, sqlite3_int64 rowid) {
+			onUpdate (op, schema, table, rowid);
+		};
+		listener.onCommitted = [this] () { onCommitted (); };
+		listener.onRollback = [this] () { onRollback (); };
+		listener.onStatement = [this] () { statementMark = pending.size (); };
+		listener.onStatementRollback = [this] () { onStatementRollback (); };
+		listener.onSavepoint = [this] (const std::string& savepoint) { onSavepoint (savepoint); };
+		listener.onRollbackTo = [this] (const std::string& savepoint) { onRollbackTo (savepoint); };
+		listenerId = database.addChangeListener (listener);
+	}
+
+	/**
+	 * @brief Stop capturing. Subscribers must be destroyed first.
+	 */
+	ChangeStream::~ChangeStream () { database.removeChangeListener (listenerId); }
+
+	/**
+	 * @brief Name of the table of an event: "table" for the main database, "schema.table"
+	 * for attached ones.
+	 *
+	 * @throw std::out_of_range if the identifier is unknown.
+	 */
+	std::string ChangeStream::tableName (uint32_t table) const {
+		std::lock_guard<std::mutex> lock (namesMtx);
+		return tableNames.at (table);
+	}
+
+	/**
+	 * @brief Published transactions and events, and events dropped by rollbacks.
+	 */
+	ChangeStreamStats ChangeStream::getStats () const {
+		ChangeStreamStats stats;
+		stats.transactions = transactions.load ();
+		stats.events = events.load ();
+		stats.rolledBackEvents = rolledBackEvents.load ();
+		return stats;
+	}
+
+	/**
+	 * @brief Creates a subscriber that gets the events published from now on. Every
+	 * subscriber gets all of them; use each one from a single thread.
+	 *
+	 * @param stream The stream. It must outlive the subscriber.
+	 */
+	ChangeSubscriber::ChangeSubscriber (ChangeStream& stream)
+		: stream (stream), cursor (stream.ring.published ()), lostEvents (0) {}
+
+	/**
+	 * @brief Take the events published since the last call, without waiting.
+	 *
+	 * @param batch Destination. It is replaced by up to maxEvents events, oldest first. The
+	 * events of a transaction are consecutive and share the txn number.
+	 * @return size_t Number of events.
+	 */
+	size_t ChangeSubscriber::poll (std::vector<ChangeEvent>& batch, size_t maxEvents) {
+		batch.resize (maxEvents);
+		size_t count = stream.ring.read (cursor, batch.data (), maxEvents, lostEvents);
+		batch.resize (count);
+		return count;
+	}
+
+	/**
+	 * @brief Take the events published since the last call, waiting up to timeout for the
+	 * next commit if there are none.
+	 *
+	 * @see poll()
+	 */
+	size_t ChangeSubscriber::wait (std::vector<ChangeEvent>& batch,
+								   std::chrono::milliseconds timeout,
+								   size_t maxEvents) {
+		if (poll (batch, maxEvents) > 0) {
+			return batch.size ();
+		}
+		{
+			std::unique_lock<std::mutex> lock (stream.waitMtx);
+			stream.waiters++;
+			std::atomic_thread_fence (std::memory_order_seq_cst);
+			stream.published.wait_for (lock, timeout, [this] { return stream.ring.published () > cursor; });
+			stream.waiters--;
+		}
+		return poll (batch, maxEvents);
+	}
+
+	/**
+	 * @brief Events this subscriber missed because it fell more than the capacity of the
+	 * stream behind.
+	 */
+	uint64_t ChangeSubscriber::lost () const { return lostEvents; }
+
+	// Private methods >>
+
+	void ChangeStream::onUpdate (int op, const char* schema, const char* table, sqlite3_int64 rowid) {
+		ChangeEvent event;
+		event.txn = 0;
+		event.rowid = rowid;
+		event.table = tableId (schema, table);
+		event.op = (SQLITE_INSERT == op)   ? ChangeOp::Insert
+				   : (SQLITE_DELETE == op) ? ChangeOp::Delete
+										   : ChangeOp::Update;
+		pending.push_back (event);
+	}
+
+	void ChangeStream::onCommitted () {
+		if (pending.empty ()) {
+			return;
+		}
+		uint64_t txn = nextTxn++;
+		for (ChangeEvent& event : pending) {
+			event.txn = txn;
+			ring.publish (event);
+		}
+		events += pending.size ();
+		transactions++;
+		pending.clear ();
+		savepoints.clear ();
+
+		std::atomic_thread_fence (std::memory_order_seq_cst);
+		if (waiters.load () > 0) {
+			{ std::lock_guard<std::mutex> lock (waitMtx); }
+			published.notify_all ();
+		}
+	}
+
+	void ChangeStream::onRollback () {
+		rolledBackEvents += pending.size ();
+		pending.clear ();
+		savepoints.clear ();
+	}
+
+	void ChangeStream::onStatementRollback () {
+		size_t mark = std::min (statementMark, pending.size ());
+		rolledBackEvents += pending.size () - mark;
+		pending.resize (mark);
+	}
+
+	void ChangeStream::onSavepoint (const std::string& savepoint) {
+		savepoints.emplace_back (savepoint, pending.size ());
+	}
+
+	// Savepoints opened after this one are gone too: drop their marks with it.
+	void ChangeStream::onRollbackTo (const std::string& savepoint) {
+		for (size_t i = savepoints.size (); i-- > 0;) {
+			if (savepoints[i].first == savepoint) {
+				size_t mark = std::min (savepoints[i].second, pending.size ());
+				rolledBackEvents += pending.size () - mark;
+				pending.resize (mark);
+				savepoints.resize (i);
+				return;
+			}
+		}
+	}
+
+	uint32_t ChangeStream::tableId (const char* schema, const char* table) {
+		// Consecutive events are usually for the same table.
+		if (!tableNames.empty () && lastSchema == schema && lastTable == table) {
+			return lastId;
+		}
+		lastSchema = schema;
+		lastTable = table;
+
+		std::string name (table);
+		if (lastSchema != "main") {
+			name = std::string (schema) + "." + name;
+		}
+		auto found = tableIds.find (name);
+		if (found != tableIds.end ()) {
+			lastId = found->second;
+			return lastId;
+		}
+		std::lock_guard<std::mutex> lock (namesMtx);
+		lastId = static_cast<uint32_t> (tableNames.size ());
+		tableNames.push_back (name);
+		tableIds[name] = lastId;
+		return lastId;
+	}
+}	// namespace jlu
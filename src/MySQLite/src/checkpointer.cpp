@@ -0,0 +1,251 @@
+#include "../include/checkpointer.h"
+
+namespace jlu {
+	/**
+	 * @brief Creates a checkpointer for a database that works in WAL mode. It does nothing
+	 * until start() is called.
+	 *
+	 * @param database The connection whose commits are tracked. It must outlive the checkpointer.
+	 * @param options Schedule, WAL size threshold and escalation policy.
+	 */
+	Checkpointer::Checkpointer (MySQLite& database, const CheckpointerOptions& options)
+		: database (database),
+		  options (options),
+		  conn (nullptr),
+		  listenerId (-1),
+		  previousAutoCheckpoint (0),
+		  stopping (false),
+		  running (false),
+		  pendingFrames (0) {}
+
+	/**
+	 * @brief Stop the background thread, if any, and destroy the object.
+	 *
+	 * In case of error show a message in standard output.
+	 */
+	Checkpointer::~Checkpointer () {
+		try {
+			stop ();
+		} catch (std::exception& e) {
+			std::cerr << "Error at try stop checkpointer in destructor method. Desc.: " << e.what ()
+					  << std::endl;
+		}
+	}
+
+	/**
+	 * @brief Start the checkpointer thread.
+	 *
+	 * Inline auto-checkpoint is disabled on the database connection: a WAL commit listener
+	 * replaces it and only counts the frames of the log. Checkpoints run on a private connection to the
+	 * same file, every options.interval or as soon as the WAL reaches options.frameThreshold
+	 * frames.
+	 *
+	 * @return bool True if the thread was started, false if it was already running.
+	 * @throw std::runtime_error if the database is not open, is not a file or the private
+	 * connection can not be open.
+	 */
+	bool Checkpointer::start () {
+		if (running) {
+			return false;
+		}
+
+		sqlite3* handle = database.getHandle ();
+		if (handle == nullptr) {
+			throw std::runtime_error ("Checkpointer: the database is not open");
+		}
+
+		const char* fileName = sqlite3_db_filename (handle, "main");
+		if (fileName == nullptr || fileName[0] == '\0') {
+			throw std::runtime_error ("Checkpointer: the database must be an on disk file");
+		}
+
+		int status = sqlite3_open_v2 (fileName, &conn, SQLITE_OPEN_READWRITE, nullptr);
+		if (status != SQLITE_OK) {
+			std::string error ("Checkpointer: unable to open DB. Error: ");
+			error += sqlite3_errmsg (conn);
+			sqlite3_close (conn);
+			conn = nullptr;
+			throw std::runtime_error (error);
+		}
+		sqlite3_busy_timeout (conn, options.busyTimeoutMs);
+		sqlite3_wal_autocheckpoint (conn, 0);
+		// A connection only attaches to the WAL file after its first read.
+		sqlite3_exec (conn, "PRAGMA schema_version;", nullptr, nullptr, nullptr);
+
+		ChangeListener listener;
+		listener.onWalCommit = [this] (const char*, int frames) { onWalCommit (frames); };
+		listenerId = database.addChangeListener (listener);
+		previousAutoCheckpoint = database.getWalAutoCheckpoint ();
+		database.setWalAutoCheckpoint (0);
+
+		stopping = false;
+		running = true;
+		worker = std::thread (&Checkpointer::run, this);
+		return true;
+	}
+
+	/**
+	 * @brief Stop the checkpointer thread and restore the inline auto-checkpoint the
+	 * database connection had before start().
+	 *
+	 * @return bool True if the thread was running and has been stopped.
+	 */
+	bool Checkpointer::stop () {
+		if (!running) {
+			return false;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock (mtx);
+			stopping = true;
+		}
+		wakeUp.notify_all ();
+		worker.join ();
+
+		database.removeChangeListener (listenerId);
+		database.setWalAutoCheckpoint (previousAutoCheckpoint);
+		listenerId = -1;
+
+		sqlite3_close (conn);
+		conn = nullptr;
+		running = false;
+		return true;
+	}
+
+	/**
+	 * @brief Check if the checkpointer thread is running
+	 *
+	 * @return true If start() was called and stop() was not.
+	 */
+	bool Checkpointer::isRunning () { return running; }
+
+	/**
+	 * @brief Run a checkpoint right now, from the calling thread.
+	 *
+	 * @param mode SQLITE_CHECKPOINT_PASSIVE, SQLITE_CHECKPOINT_FULL, SQLITE_CHECKPOINT_RESTART
+	 * or SQLITE_CHECKPOINT_TRUNCATE.
+	 * @return bool True if the checkpoint finished, false if it was blocked by readers or
+	 * writers (SQLITE_BUSY) or the checkpointer is not started.
+	 * @throw std::runtime_error if sqlite3 reports any other error.
+	 */
+	bool Checkpointer::checkpoint (int mode) {
+		if (!running) {
+			return false;
+		}
+		int logFrames = 0;
+		int checkpointedFrames = 0;
+		return runCheckpoint (mode, logFrames, checkpointedFrames);
+	}
+
+	/**
+	 * @brief Copy of the checkpoint metrics collected since the checkpointer was created.
+	 *
+	 * @return CheckpointStats Run counters per mode, frames and durations.
+	 */
+	CheckpointStats Checkpointer::getStats () {
+		std::lock_guard<std::mutex> lock (mtx);
+		CheckpointStats output = stats;
+		output.pendingFrames = pendingFrames.load ();
+		return output;
+	}
+
+	// Private methods >>
+
+	void Checkpointer::onWalCommit (int frames) {
+		pendingFrames.store (frames);
+		if (frames >= options.frameThreshold) {
+			// Take the lock so the notification can not fall between the predicate check
+			// and the wait of the worker.
+			{ std::lock_guard<std::mutex> lock (mtx); }
+			wakeUp.notify_one ();
+		}
+	}
+
+	// A checkpoint that a reader or writer stopped short leaves pendingFrames over the
+	// threshold: until new frames are committed, wait the whole interval instead of retrying.
+	void Checkpointer::run () {
+		std::unique_lock<std::mutex> lock (mtx);
+		int attemptedFrames = 0;
+		while (!stopping) {
+			wakeUp.wait_for (lock, options.interval, [this, &attemptedFrames] {
+				int frames = pendingFrames.load ();
+				return stopping || (frames >= options.frameThreshold && frames > attemptedFrames);
+			});
+			if (stopping) {
+				break;
+			}
+			if (pendingFrames.load () <= 0) {
+				continue;
+			}
+			lock.unlock ();
+
+			bool done = false;
+			try {
+				int logFrames = 0;
+				int checkpointedFrames = 0;
+				done = runCheckpoint (SQLITE_CHECKPOINT_PASSIVE, logFrames, checkpointedFrames);
+
+				if (logFrames >= options.escalateFrames) {
+					if (options.allowTruncate) {
+						done = runCheckpoint (SQLITE_CHECKPOINT_TRUNCATE, logFrames, checkpointedFrames);
+					} else if (options.allowRestart) {
+						done = runCheckpoint (SQLITE_CHECKPOINT_RESTART, logFrames, checkpointedFrames);
+					}
+				}
+				done = done && checkpointedFrames >= logFrames;
+			} catch (std::exception& e) { std::cerr << e.what () << std::endl; }
+			attemptedFrames = done ? 0 : pendingFrames.load ();
+
+			lock.lock ();
+		}
+	}
+
+	bool Checkpointer::runCheckpoint (int mode, int& logFrames, int& checkpointedFrames) {
+		std::lock_guard<std::mutex> ckptLock (ckptMtx);
+		logFrames = 0;
+		checkpointedFrames = 0;
+
+		auto begin = std::chrono::steady_clock::now ();
+		int result = sqlite3_wal_checkpoint_v2 (conn, nullptr, mode, &logFrames, &checkpointedFrames);
+		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds> (
+			std::chrono::steady_clock::now () - begin);
+
+		if (SQLITE_OK != result && SQLITE_BUSY != result) {
+			std::string errorMsg ("Checkpoint failed. Error code: " + std::to_string (result) +
+								  ". Desc: " + sqlite3_errmsg (conn));
+			throw std::runtime_error (errorMsg);
+		}
+
+		// -1 means the database is not in WAL mode.
+		logFrames = std::max (logFrames, 0);
+		checkpointedFrames = std::max (checkpointedFrames, 0);
+
+		std::lock_guard<std::mutex> lock (mtx);
+		if (SQLITE_BUSY == result) {
+			stats.busyRuns++;
+		} else if (SQLITE_CHECKPOINT_TRUNCATE == mode) {
+			stats.truncateRuns++;
+		} else if (SQLITE_CHECKPOINT_RESTART == mode) {
+			stats.restartRuns++;
+		} else {
+			stats.passiveRuns++;
+		}
+
+		// Frame counters are cumulative until a writer restarts the log.
+		if (logFrames >= stats.lastLogFrames && checkpointedFrames >= stats.lastCheckpointedFrames) {
+			stats.framesCheckpointed += checkpointedFrames - stats.lastCheckpointedFrames;
+		} else {
+			stats.framesCheckpointed += checkpointedFrames;
+		}
+		stats.lastLogFrames = logFrames;
+		stats.lastCheckpointedFrames = checkpointedFrames;
+		stats.lastDuration = elapsed;
+		stats.maxDuration = std::max (stats.maxDuration, elapsed);
+		stats.totalDuration += elapsed;
+
+		if (SQLITE_OK == result) {
+			pendingFrames.store (logFrames - checkpointedFrames);
+		}
+		return (SQLITE_OK == result);
+	}
+}	// namespace jlu
@@ -0,0 +1,76 @@
+#include "../include/columnspan.h"
+
+namespace jlu {
+	// A ColumnSpan only points to the caller's arrays: MySQLite::insertColumns binds them
+	// with SQLITE_STATIC, so they must live until it returns. The validity bitmap follows
+	// Arrow: bit i (least significant first) set means row i is not NULL.
+
+	static ColumnSpan makeSpan (const std::string& name,
+								ColumnSpan::Type type,
+								const void* values,
+								size_t size,
+								const uint8_t* validity) {
+		ColumnSpan output;
+		output.name = name;
+		output.type = type;
+		output.values = values;
+		output.size = size;
+		output.validity = validity;
+		return output;
+	}
+
+	/**
+	 * @brief An INTEGER column.
+	 *
+	 * @param name Column of the table.
+	 * @param values size values.
+	 * @param size Rows.
+	 * @param validity Arrow validity bitmap of (size + 7) / 8 bytes, nullptr if no value is
+	 * NULL.
+	 */
+	ColumnSpan ColumnSpan::int64s (const std::string& name,
+								   const int64_t* values,
+								   size_t size,
+								   const uint8_t* validity) {
+		return makeSpan (name, Type::Int64, values, size, validity);
+	}
+
+	/**
+	 * @brief A REAL column. Same parameters as int64s.
+	 */
+	ColumnSpan ColumnSpan::doubles (const std::string& name,
+									const double* values,
+									size_t size,
+									const uint8_t* validity) {
+		return makeSpan (name, Type::Double, values, size, validity);
+	}
+
+	/**
+	 * @brief A TEXT column, whose values are views of the caller's bytes. Same parameters as
+	 * int64s.
+	 */
+	ColumnSpan ColumnSpan::texts (const std::string& name,
+								  const std::string_view* values,
+								  size_t size,
+								  const uint8_t* validity) {
+		return makeSpan (name, Type::Text, values, size, validity);
+	}
+
+	/**
+	 * @brief A BLOB column, whose values are views of the caller's bytes. Same parameters as
+	 * int64s.
+	 */
+	ColumnSpan ColumnSpan::blobs (const std::string& name,
+								  const std::string_view* values,
+								  size_t size,
+								  const uint8_t* validity) {
+		return makeSpan (name, Type::Blob, values, size, validity);
+	}
+
+	/**
+	 * @brief True if the validity bitmap clears the bit of a row.
+	 */
+	bool ColumnSpan::isNull (size_t row) const {
+		return validity != nullptr && (validity[row >> 3] & (1u << (row & 7))) == 0;
+	}
+}	// namespace jlu
@@ -0,0 +1,81 @@
+#include "../include/dictionary.h"
+
+namespace jlu {
+	// The strings live in chunks that are never moved nor freed while the dictionary lives,
+	// so the string_view keys of the map and the views returned stay valid. Chunk k holds
+	// firstChunk << k strings, and the table of chunks has a fixed size: view() of a code
+	// already handed over reads nothing that a concurrent intern() writes, so one thread can
+	// intern while others read the values it produced (PipelinedFetch).
+
+	/**
+	 * @brief An empty dictionary.
+	 *
+	 * @param maxEntries Distinct strings it accepts; intern() returns Value::noCode after
+	 * that, so a column with too many distinct values is stored as plain text.
+	 */
+	StringDictionary::StringDictionary (size_t maxEntries) : maxEntries (maxEntries), count (0), textBytes (0) {}
+
+	/**
+	 * @brief The code of a string, added if it is new. Codes are dense: 0, 1, 2... in order
+	 * of first appearance.
+	 *
+	 * @return uint32_t The code, or Value::noCode if the string is new and the dictionary
+	 * is full.
+	 */
+	uint32_t StringDictionary::intern (std::string_view text) {
+		auto found = codes.find (text);
+		if (found != codes.end ()) {
+			return found->second;
+		}
+		size_t size = count.load (std::memory_order_relaxed);
+		if (size >= maxEntries || size >= Value::noCode) {
+			return Value::noCode;
+		}
+		uint32_t code = static_cast<uint32_t> (size);
+		size_t chunk = chunkOf (code);
+		if (!chunks[chunk]) {
+			chunks[chunk].reset (new std::string[firstChunk << chunk]);
+		}
+		std::string& slot = chunks[chunk][code - firstChunk * ((size_t (1) << chunk) - 1)];
+		slot.assign (text);
+		codes.emplace (std::string_view (slot), code);
+		textBytes.fetch_add (text.size (), std::memory_order_relaxed);
+		count.store (size + 1, std::memory_order_release);
+		return code;
+	}
+
+	/**
+	 * @brief The code of a string, or Value::noCode if it is not in the dictionary. Not
+	 * while another thread interns.
+	 */
+	uint32_t StringDictionary::find (std::string_view text) const {
+		auto found = codes.find (text);
+		return (found != codes.end ()) ? found->second : Value::noCode;
+	}
+
+	/**
+	 * @brief The string of a code returned by intern().
+	 */
+	std::string_view StringDictionary::view (uint32_t code) const {
+		size_t chunk = chunkOf (code);
+		return chunks[chunk][code - firstChunk * ((size_t (1) << chunk) - 1)];
+	}
+
+	/**
+	 * @brief Distinct strings.
+	 */
+	size_t StringDictionary::size () const { return count.load (std::memory_order_acquire); }
+
+	/**
+	 * @brief Bytes of the distinct strings, without the overhead of the containers.
+	 */
+	size_t StringDictionary::bytes () const { return textBytes.load (std::memory_order_relaxed); }
+
+	// Private methods >>
+
+	// Chunk k starts at code firstChunk * (2^k - 1).
+	size_t StringDictionary::chunkOf (uint32_t code) {
+		unsigned long long first = code / firstChunk + 1;
+		return static_cast<size_t> (63 - __builtin_clzll (first));
+	}
+}	// namespace jlu
@@ -0,0 +1,534 @@
+#include "../include/exporter.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../include/boundedqueue.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace jlu {
+	namespace {
+		const size_t ioAlignment = 4096;
+		const char columnarMagic[8] = {'J', 'L', 'U', 'C', 'O', 'L', '0', '1'};
+
+		struct Buffer {
+			char* data = nullptr;
+			size_t size = 0;
+			bool last = false;
+		};
+
+		// Output file fed from reusable aligned buffers. Full buffers are written with one
+		// write() each, from a second thread when the sink is pipelined, so formatting the
+		// next buffer overlaps the I/O of the previous one.
+		class Sink {
+		   public:
+			Sink (const std::string& fileName, size_t bufferSize, bool pipelined, bool directIo)
+				: capacity ((std::max (bufferSize, ioAlignment) + ioAlignment - 1) / ioAlignment *
+							ioAlignment),
+				  pipelined (pipelined),
+				  direct (false),
+				  freeBuffers (3),
+				  fullBuffers (3),
+				  failed (false) {
+				int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+				if (directIo) {
+					fd = ::open (fileName.c_str (), flags | O_DIRECT, 0644);
+					direct = (fd >= 0);
+				}
+#else
+				(void)directIo;
+#endif
+				if (!direct) {
+					fd = ::open (fileName.c_str (), flags, 0644);
+				}
+				if (fd < 0) {
+					throw std::runtime_error ("Unable to open export file " + fileName);
+				}
+
+				for (int i = 0; i < (pipelined ? 3 : 1); i++) {
+					void* memory = std::aligned_alloc (ioAlignment, capacity);
+					if (memory == nullptr) {
+						::close (fd);
+						throw std::bad_alloc ();
+					}
+					pool.emplace_back (static_cast<char*> (memory), &std::free);
+					Buffer buffer;
+					buffer.data = pool.back ().get ();
+					freeBuffers.push (std::move (buffer));
+				}
+				freeBuffers.pop (current);
+
+				if (pipelined) {
+					writer = std::thread ([this] {
+						Buffer buffer;
+						while (fullBuffers.pop (buffer)) {
+							try {
+								if (!failed) {
+									writeBuffer (buffer);
+								}
+							} catch (...) {
+								error = std::current_exception ();
+								failed = true;
+							}
+							buffer.size = 0;
+							buffer.last = false;
+							freeBuffers.push (std::move (buffer));
+						}
+					});
+				}
+			}
+
+			~Sink () {
+				if (writer.joinable ()) {
+					fullBuffers.close ();
+					writer.join ();
+				}
+				if (fd >= 0) {
+					::close (fd);
+				}
+			}
+
+			void append (const char* data, size_t len) {
+				while (len > 0) {
+					if (current.size == capacity) {
+						flush (false);
+					}
+					size_t count = std::min (len, capacity - current.size);
+					memcpy (current.data + current.size, data, count);
+					current.size += count;
+					data += count;
+					len -= count;
+				}
+			}
+
+			void append (char c) {
+				if (current.size == capacity) {
+					flush (false);
+				}
+				current.data[current.size++] = c;
+			}
+
+			// Room for n contiguous bytes, n must be small. Call commit afterwards.
+			char* reserve (size_t n) {
+				if (capacity - current.size < n) {
+					flush (false);
+				}
+				return current.data + current.size;
+			}
+
+			void commit (size_t n) { current.size += n; }
+
+			void finish (ExportStats& stats) {
+				flush (true);
+				if (pipelined) {
+					fullBuffers.close ();
+					writer.join ();
+				}
+				if (failed) {
+					std::rethrow_exception (error);
+				}
+				stats.bytes = bytes;
+				stats.writes = writes;
+				stats.writeSeconds = writeTime.count ();
+			}
+
+		   private:
+			void flush (bool last) {
+				if (failed) {
+					std::rethrow_exception (error);
+				}
+
+				// O_DIRECT writes whole blocks: the unaligned tail moves to the next buffer.
+				size_t tail = (direct && !last) ? current.size % ioAlignment : 0;
+				Buffer next;
+				if (pipelined) {
+					Buffer full = current;
+					full.size -= tail;
+					full.last = last;
+					freeBuffers.pop (next);
+					if (tail > 0) {
+						memcpy (next.data, full.data + full.size, tail);
+					}
+					fullBuffers.push (std::move (full));
+				} else {
+					current.size -= tail;
+					current.last = last;
+					writeBuffer (current);
+					next = current;
+					if (tail > 0) {
+						memmove (next.data, current.data + current.size, tail);
+					}
+				}
+				next.size = tail;
+				next.last = false;
+				current = next;
+			}
+
+			void writeBuffer (const Buffer& buffer) {
+				auto begin = std::chrono::steady_clock::now ();
+#ifdef O_DIRECT
+				if (direct && buffer.last && buffer.size % ioAlignment != 0) {
+					fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) & ~O_DIRECT);
+				}
+#endif
+				const char* p = buffer.data;
+				size_t remaining = buffer.size;
+				while (remaining > 0) {
+					ssize_t n = ::write (fd, p, remaining);
+					if (n < 0 && errno == EINTR) {
+						continue;
+					}
+					if (n <= 0) {
+						throw std::runtime_error ("Error writing export file. Errno: " +
+												  std::to_string (errno));
+					}
+					p += n;
+					remaining -= static_cast<size_t> (n);
+					writes++;
+				}
+				bytes += buffer.size;
+				writeTime += std::chrono::steady_clock::now () - begin;
+			}
+
+			size_t capacity;
+			bool pipelined;
+			bool direct;
+			int fd = -1;
+			std::vector<std::unique_ptr<char, decltype (&std::free)>> pool;
+			Buffer current;
+			BoundedQueue<Buffer> freeBuffers;
+			BoundedQueue<Buffer> fullBuffers;
+			std::thread writer;
+			std::exception_ptr error;
+			std::atomic<bool> failed;
+			uint64_t bytes = 0;
+			uint64_t writes = 0;
+			std::chrono::duration<double> writeTime{0};
+		};
+	}	// namespace
+
+	static const char hexDigits[] = "0123456789abcdef";
+
+	static void appendInt (Sink& sink, sqlite3_int64 value) {
+		char* p = sink.reserve (24);
+		sink.commit (std::to_chars (p, p + 24, value).ptr - p);
+	}
+
+	// Shortest text that reads back to the same double, always with a '.' or an exponent so
+	// it is not taken for an integer.
+	static void appendDouble (Sink& sink, double value) {
+		char* p = sink.reserve (40);
+		char* end = std::to_chars (p, p + 38, value).ptr;
+		if (std::isfinite (value) && std::find_if (p, end, [] (char c) {
+										 return c == '.' || c == 'e';
+									 }) == end) {
+			*end++ = '.';
+			*end++ = '0';
+		}
+		sink.commit (end - p);
+	}
+
+	static void appendHex (Sink& sink, const uint8_t* data, size_t len) {
+		for (size_t i = 0; i < len; i++) {
+			char* p = sink.reserve (2);
+			p[0] = hexDigits[data[i] >> 4];
+			p[1] = hexDigits[data[i] & 0x0f];
+			sink.commit (2);
+		}
+	}
+
+	static void appendCsvText (Sink& sink, const char* text, size_t len, char delimiter) {
+		const char* end = text + len;
+		bool quote = std::find_if (text, end, [delimiter] (char c) {
+						 return c == delimiter || c == '"' || c == '\n' || c == '\r';
+					 }) != end;
+		if (!quote) {
+			sink.append (text, len);
+			return;
+		}
+
+		sink.append ('"');
+		const char* p = text;
+		while (p < end) {
+			const char* q = static_cast<const char*> (memchr (p, '"', end - p));
+			if (q == nullptr) {
+				sink.append (p, end - p);
+				break;
+			}
+			sink.append (p, q + 1 - p);
+			sink.append ('"');
+			p = q + 1;
+		}
+		sink.append ('"');
+	}
+
+	static void appendJsonText (Sink& sink, const char* text, size_t len) {
+		sink.append ('"');
+		const char* p = text;
+		const char* end = text + len;
+		const char* run = p;
+		for (; p < end; p++) {
+			unsigned char c = static_cast<unsigned char> (*p);
+			if (c >= 0x20 && c != '"' && c != '\\') {
+				continue;
+			}
+			sink.append (run, p - run);
+			run = p + 1;
+			if (c == '"' || c == '\\') {
+				char escaped[2] = {'\\', static_cast<char> (c)};
+				sink.append (escaped, 2);
+			} else if (c == '\n') {
+				sink.append ("\\n", 2);
+			} else if (c == '\r') {
+				sink.append ("\\r", 2);
+			} else if (c == '\t') {
+				sink.append ("\\t", 2);
+			} else {
+				char escaped[6] = {'\\', 'u', '0', '0', hexDigits[c >> 4], hexDigits[c & 0x0f]};
+				sink.append (escaped, 6);
+			}
+		}
+		sink.append (run, end - run);
+		sink.append ('"');
+	}
+
+	template <typename T>
+	static void appendRaw (std::string& out, T value) {
+		out.append (reinterpret_cast<const char*> (&value), sizeof (value));
+	}
+
+	template <typename T>
+	static void appendRaw (Sink& sink, T value) {
+		sink.append (reinterpret_cast<const char*> (&value), sizeof (value));
+	}
+
+	/**
+	 * @brief Creates an exporter of query results.
+	 *
+	 * @param database The database to read. Only the calling thread of exportQuery uses it.
+	 * @param options Format, buffer size, pipelining and O_DIRECT. columnarBatchRows and
+	 * columnarBatchBytes are clamped to [1, UINT32_MAX], the range of the row count and of
+	 * the column lengths written in each batch.
+	 */
+	Exporter::Exporter (MySQLite& database, const ExportOptions& options)
+		: database (database), options (options) {
+		this->options.columnarBatchRows =
+			std::min<size_t> (std::max<size_t> (options.columnarBatchRows, 1), UINT32_MAX);
+		this->options.columnarBatchBytes =
+			std::min<size_t> (std::max<size_t> (options.columnarBatchBytes, 1), UINT32_MAX);
+	}
+
+	/**
+	 * @brief Run a query and write its rows to a file, without building a result container.
+	 *
+	 * The statement is stepped and every row is formatted straight into a large output
+	 * buffer. When pipelined, full buffers are written by a second thread while the next one
+	 * is being formatted. With directIo the file is opened with O_DIRECT when the file system
+	 * allows it.
+	 *
+	 * Formats:
+	 * - Csv: optional header line, NULL as an empty field, blobs in hex.
+	 * - JsonLines: one object per row, blobs as hex strings.
+	 * - Columnar: "JLUCOL01", u32 column count and the names (u32 length + bytes). Then
+	 * batches: u32 row count and, for every column, u32 byte length, one type byte per row
+	 * (SQLITE_INTEGER, SQLITE_FLOAT, SQLITE_TEXT, SQLITE_BLOB or SQLITE_NULL) and the values:
+	 * 8 bytes for numbers, u32 length + bytes for text and blobs, nothing for NULL. A batch
+	 * of 0 rows ends the file. Numbers are in the byte order of the host. A batch ends after
+	 * columnarBatchRows rows, or before the row that would make a column longer than
+	 * columnarBatchBytes; a row longer than that goes alone in its batch (a value is shorter
+	 * than 2 GiB, so its column always fits in the u32 length).
+	 *
+	 * @param query The SELECT statement.
+	 * @param fileName Output file. It is truncated.
+	 * @return ExportStats Rows, bytes, write calls and time.
+	 * @throw std::runtime_error if the SQL statement is wrong or the file can not be written.
+	 */
+	ExportStats Exporter::exportQuery (const std::string& query, const std::string& fileName) {
+		auto begin = std::chrono::steady_clock::now ();
+		ExportStats stats;
+		sqlite3* db = database.getHandle ();
+		sqlite3_stmt* stmt = nullptr;
+		int stmtResult = sqlite3_prepare_v2 (db, query.c_str (), -1, &stmt, nullptr);
+		if (SQLITE_OK != stmtResult) {
+			std::string errorMsg ("Unable compile the SQL statement. Error code:" +
+								  std::to_string (stmtResult) + "\n");
+			throw std::runtime_error (errorMsg);
+		}
+		std::unique_ptr<sqlite3_stmt, decltype (&sqlite3_finalize)> guard (stmt, &sqlite3_finalize);
+
+		Sink sink (fileName, options.bufferSize, options.pipelined, options.directIo);
+		const int numCols = sqlite3_column_count (stmt);
+		std::vector<std::string> names;
+		for (int i = 0; i < numCols; i++) {
+			names.push_back (sqlite3_column_name (stmt, i));
+		}
+
+		// Header >>
+		std::vector<std::string> jsonKeys;
+		if (options.format == ExportFormat::Csv && options.header) {
+			for (int i = 0; i < numCols; i++) {
+				if (i > 0) {
+					sink.append (options.delimiter);
+				}
+				appendCsvText (sink, names[i].data (), names[i].size (), options.delimiter);
+			}
+			sink.append ('\n');
+		} else if (options.format == ExportFormat::Columnar) {
+			sink.append (columnarMagic, sizeof (columnarMagic));
+			appendRaw (sink, static_cast<uint32_t> (numCols));
+			for (const std::string& name : names) {
+				appendRaw (sink, static_cast<uint32_t> (name.size ()));
+				sink.append (name.data (), name.size ());
+			}
+		}
+
+		// Rows >>
+		std::vector<std::string> types (numCols);
+		std::vector<std::string> values (numCols);
+		uint32_t batchRows = 0;
+		auto flushColumns = [&] () {
+			appendRaw (sink, batchRows);
+			for (int i = 0; i < numCols; i++) {
+				appendRaw (sink, static_cast<uint32_t> (types[i].size () + values[i].size ()));
+				sink.append (types[i].data (), types[i].size ());
+				sink.append (values[i].data (), values[i].size ());
+				types[i].clear ();
+				values[i].clear ();
+			}
+			batchRows = 0;
+		};
+
+		// False if the current row would make a column of the batch longer than
+		// columnarBatchBytes.
+		auto fitsInBatch = [&] () {
+			for (int i = 0; i < numCols; i++) {
+				int columnType = sqlite3_column_type (stmt, i);
+				size_t rowBytes = 1;
+				if (SQLITE_INTEGER == columnType || SQLITE_FLOAT == columnType) {
+					rowBytes += 8;
+				} else if (SQLITE_TEXT == columnType || SQLITE_BLOB == columnType) {
+					rowBytes += 4 + static_cast<size_t> (sqlite3_column_bytes (stmt, i));
+				}
+				if (types[i].size () + values[i].size () + rowBytes > options.columnarBatchBytes) {
+					return false;
+				}
+			}
+			return true;
+		};
+
+		int rc = 0;
+		while ((rc = sqlite3_step (stmt)) == SQLITE_ROW) {
+			if (options.format == ExportFormat::JsonLines) {
+				sink.append ('{');
+			} else if (options.format == ExportFormat::Columnar && batchRows > 0 && !fitsInBatch ()) {
+				flushColumns ();
+			}
+			for (int i = 0; i < numCols; i++) {
+				int columnType = sqlite3_column_type (stmt, i);
+
+				if (options.format == ExportFormat::Columnar) {
+					types[i] += static_cast<char> (columnType);
+					if (SQLITE_INTEGER == columnType) {
+						appendRaw (values[i], static_cast<int64_t> (sqlite3_column_int64 (stmt, i)));
+					} else if (SQLITE_FLOAT == columnType) {
+						appendRaw (values[i], sqlite3_column_double (stmt, i));
+					} else if (SQLITE_TEXT == columnType || SQLITE_BLOB == columnType) {
+						const char* data =
+							(SQLITE_TEXT == columnType)
+								? reinterpret_cast<const char*> (sqlite3_column_text (stmt, i))
+								: static_cast<const char*> (sqlite3_column_blob (stmt, i));
+						uint32_t len = static_cast<uint32_t> (sqlite3_column_bytes (stmt, i));
+						appendRaw (values[i], len);
+						values[i].append (data, len);
+					}
+					continue;
+				}
+
+				if (options.format == ExportFormat::Csv) {
+					if (i > 0) {
+						sink.append (options.delimiter);
+					}
+				} else {
+					if (i > 0) {
+						sink.append (',');
+					}
+					appendJsonText (sink, names[i].data (), names[i].size ());
+					sink.append (':');
+				}
+
+				if (SQLITE_INTEGER == columnType) {
+					appendInt (sink, sqlite3_column_int64 (stmt, i));
+				} else if (SQLITE_FLOAT == columnType) {
+					double value = sqlite3_column_double (stmt, i);
+					if (options.format == ExportFormat::JsonLines && !std::isfinite (value)) {
+						sink.append ("null", 4);
+					} else {
+						appendDouble (sink, value);
+					}
+				} else if (SQLITE_TEXT == columnType) {
+					const char* text = reinterpret_cast<const char*> (sqlite3_column_text (stmt, i));
+					size_t len = static_cast<size_t> (sqlite3_column_bytes (stmt, i));
+					if (options.format == ExportFormat::Csv) {
+						appendCsvText (sink, text, len, options.delimiter);
+					} else {
+						appendJsonText (sink, text, len);
+					}
+				} else if (SQLITE_BLOB == columnType) {
+					const uint8_t* blob = static_cast<const uint8_t*> (sqlite3_column_blob (stmt, i));
+					size_t len = static_cast<size_t> (sqlite3_column_bytes (stmt, i));
+					if (options.format == ExportFormat::JsonLines) {
+						sink.append ('"');
+					}
+					appendHex (sink, blob, len);
+					if (options.format == ExportFormat::JsonLines) {
+						sink.append ('"');
+					}
+				} else if (options.format == ExportFormat::JsonLines) {
+					sink.append ("null", 4);
+				}
+			}
+
+			if (options.format == ExportFormat::Columnar) {
+				if (++batchRows >= options.columnarBatchRows) {
+					flushColumns ();
+				}
+			} else {
+				if (options.format == ExportFormat::JsonLines) {
+					sink.append ('}');
+				}
+				sink.append ('\n');
+			}
+			stats.rows++;
+		}
+
+		if (SQLITE_DONE != rc) {
+			std::string errorMsg ("Error in sql statement. Desc: ");
+			errorMsg += sqlite3_errmsg (db);
+			throw std::runtime_error (errorMsg);
+		}
+		if (options.format == ExportFormat::Columnar) {
+			if (batchRows > 0) {
+				flushColumns ();
+			}
+			appendRaw (sink, static_cast<uint32_t> (0));
+		}
+
+		sink.finish (stats);
+		stats.seconds =
+			std::chrono::duration<double> (std::chrono::steady_clock::now () - begin).count ();
+		return stats;
+	}
+}	// namespace jlu
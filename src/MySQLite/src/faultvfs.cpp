@@ -0,0 +1,274 @@
+#include "../include/faultvfs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "../include/sqlite3.h"
+#include "../include/vfsshim.h"
+
+namespace jlu {
+	namespace faultvfs {
+		// Files opened through the "faulty" VFS sleep before their reads, writes and syncs, as
+		// set by configure(), and fail some of them on purpose. Every file shares one device:
+		// its throughput cap is a queue of bytes that drains at bytesPerSecond. Everything
+		// else is forwarded to the wrapped VFS.
+
+		const char* const name = "faulty";
+
+		enum class Operation { Read, Write, Sync };
+
+		// What to do with one operation, decided under the mutex and done outside of it.
+		struct Plan {
+			std::chrono::microseconds delay{0};
+			bool stall = false;
+			bool fail = false;
+			bool diskFull = false;
+			bool shortWrite = false;
+		};
+
+		struct FaultFile {
+			vfsshim::ShimFile shim;
+			bool matches;
+		};
+
+		static const int fileBytes = sizeof (FaultFile);
+
+		static sqlite3_vfs faultVfs;
+		static std::mutex registerMtx;
+
+		static std::mutex configMtx;
+		static Options config;
+		static std::mt19937_64 generator (1);
+		static std::chrono::steady_clock::time_point deviceFree;
+
+		static std::atomic<uint64_t> reads (0);
+		static std::atomic<uint64_t> writes (0);
+		static std::atomic<uint64_t> syncs (0);
+		static std::atomic<uint64_t> stalls (0);
+		static std::atomic<uint64_t> readErrors (0);
+		static std::atomic<uint64_t> writeErrors (0);
+		static std::atomic<uint64_t> shortWrites (0);
+		static std::atomic<uint64_t> diskFull (0);
+		static std::atomic<uint64_t> syncErrors (0);
+		static std::atomic<uint64_t> injectedMicros (0);
+
+		static FaultFile* faultFile (sqlite3_file* file) { return reinterpret_cast<FaultFile*> (file); }
+
+		static bool chance (double probability) {
+			return probability > 0.0 && std::uniform_real_distribution<double> (0.0, 1.0) (generator) < probability;
+		}
+
+		static std::chrono::microseconds sample (const LatencyModel& model, bool& stalled) {
+			double mean = static_cast<double> (model.mean.count ());
+			double micros = mean;
+			if (mean > 0.0 && model.distribution == Distribution::Uniform) {
+				micros = std::uniform_real_distribution<double> (0.0, 2.0 * mean) (generator);
+			} else if (mean > 0.0 && model.distribution == Distribution::Exponential) {
+				micros = std::exponential_distribution<double> (1.0 / mean) (generator);
+			}
+			stalled = chance (model.stallProbability);
+			if (stalled) {
+				micros += static_cast<double> (model.stall.count ());
+			}
+			return std::chrono::microseconds (static_cast<int64_t> (micros));
+		}
+
+		static Plan plan (Operation operation, int amount) {
+			std::lock_guard<std::mutex> lock (configMtx);
+			Plan output;
+			const LatencyModel& model = (operation == Operation::Read)	  ? config.read
+										: (operation == Operation::Write) ? config.write
+																		  : config.sync;
+			output.delay = sample (model, output.stall);
+
+			if (config.bytesPerSecond > 0 && operation != Operation::Sync) {
+				auto now = std::chrono::steady_clock::now ();
+				auto start = std::max (now, deviceFree);
+				deviceFree = start + std::chrono::microseconds (amount * 1000000ull / config.bytesPerSecond);
+				output.delay += std::chrono::duration_cast<std::chrono::microseconds> (deviceFree - now);
+			}
+
+			if (operation == Operation::Read) {
+				output.fail = chance (config.readErrorProbability);
+			} else if (operation == Operation::Write) {
+				output.fail = chance (config.writeErrorProbability);
+				output.diskFull = !output.fail && chance (config.diskFullProbability);
+				output.shortWrite = !output.fail && !output.diskFull && amount > 1 && chance (config.shortWriteProbability);
+			} else {
+				output.fail = chance (config.syncErrorProbability);
+			}
+			return output;
+		}
+
+		static void wait (const Plan& plan) {
+			if (plan.stall) {
+				stalls++;
+			}
+			if (plan.delay.count () > 0) {
+				injectedMicros += plan.delay.count ();
+				std::this_thread::sleep_for (plan.delay);
+			}
+		}
+
+		// Methods of the files >>
+
+		static int fileRead (sqlite3_file* file, void* data, int amount, sqlite3_int64 offset) {
+			FaultFile* p = faultFile (file);
+			if (p->matches) {
+				reads++;
+				Plan action = plan (Operation::Read, amount);
+				wait (action);
+				if (action.fail) {
+					readErrors++;
+					return SQLITE_IOERR_READ;
+				}
+			}
+			return p->shim.real->pMethods->xRead (p->shim.real, data, amount, offset);
+		}
+
+		static int fileWrite (sqlite3_file* file, const void* data, int amount, sqlite3_int64 offset) {
+			FaultFile* p = faultFile (file);
+			if (p->matches) {
+				writes++;
+				Plan action = plan (Operation::Write, amount);
+				wait (action);
+				if (action.fail) {
+					writeErrors++;
+					return SQLITE_IOERR_WRITE;
+				}
+				if (action.diskFull) {
+					diskFull++;
+					return SQLITE_FULL;
+				}
+				if (action.shortWrite) {
+					// Torn write: only the first half reaches the file.
+					shortWrites++;
+					p->shim.real->pMethods->xWrite (p->shim.real, data, amount / 2, offset);
+					return SQLITE_IOERR_WRITE;
+				}
+			}
+			return p->shim.real->pMethods->xWrite (p->shim.real, data, amount, offset);
+		}
+
+		static int fileSync (sqlite3_file* file, int flags) {
+			FaultFile* p = faultFile (file);
+			if (p->matches) {
+				syncs++;
+				Plan action = plan (Operation::Sync, 0);
+				wait (action);
+				if (action.fail) {
+					syncErrors++;
+					return SQLITE_IOERR_FSYNC;
+				}
+			}
+			return p->shim.real->pMethods->xSync (p->shim.real, flags);
+		}
+
+		static const sqlite3_io_methods fileMethods[3] = {
+			{1, vfsshim::fileClose, fileRead, fileWrite, vfsshim::fileTruncate, fileSync, vfsshim::fileSize,
+			 vfsshim::fileLock, vfsshim::fileUnlock, vfsshim::fileCheckReservedLock, vfsshim::fileControl,
+			 vfsshim::fileSectorSize, vfsshim::fileDeviceCharacteristics, nullptr, nullptr, nullptr, nullptr, nullptr,
+			 nullptr},
+			{2, vfsshim::fileClose, fileRead, fileWrite, vfsshim::fileTruncate, fileSync, vfsshim::fileSize,
+			 vfsshim::fileLock, vfsshim::fileUnlock, vfsshim::fileCheckReservedLock, vfsshim::fileControl,
+			 vfsshim::fileSectorSize, vfsshim::fileDeviceCharacteristics, vfsshim::fileShmMap, vfsshim::fileShmLock,
+			 vfsshim::fileShmBarrier, vfsshim::fileShmUnmap, nullptr, nullptr},
+			{3, vfsshim::fileClose, fileRead, fileWrite, vfsshim::fileTruncate, fileSync, vfsshim::fileSize,
+			 vfsshim::fileLock, vfsshim::fileUnlock, vfsshim::fileCheckReservedLock, vfsshim::fileControl,
+			 vfsshim::fileSectorSize, vfsshim::fileDeviceCharacteristics, vfsshim::fileShmMap, vfsshim::fileShmLock,
+			 vfsshim::fileShmBarrier, vfsshim::fileShmUnmap, vfsshim::fileFetch, vfsshim::fileUnfetch}};
+
+		// Methods of the VFS >>
+
+		static int vfsOpen (sqlite3_vfs* vfs, const char* path, sqlite3_file* file, int flags, int* outFlags) {
+			FaultFile* p = faultFile (file);
+			p->shim.real = vfsshim::realFile (file, fileBytes);
+			int rc = vfsshim::openReal (vfs, path, file, fileBytes, flags, outFlags);
+			if (rc != SQLITE_OK) {
+				return rc;
+			}
+			p->shim.base.pMethods = vfsshim::methodsFor (fileMethods, p->shim.real);
+			{
+				std::lock_guard<std::mutex> lock (configMtx);
+				p->matches = config.fileFilter.empty () ||
+							 (path != nullptr && strstr (path, config.fileFilter.c_str ()) != nullptr);
+			}
+			return SQLITE_OK;
+		}
+
+		/**
+		 * @brief Register the "faulty" VFS, which delays and fails the I/O of the databases
+		 * opened with it: MySQLite::open (fileName, jlu::faultvfs::name). Nothing is injected
+		 * until configure() is called.
+		 *
+		 * @param baseName VFS to wrap, or nullptr for the default one. Only the first
+		 * registration sets it.
+		 * @param makeDefault Use it for every database open without an explicit VFS.
+		 * @return bool False if the VFS to wrap is not registered.
+		 */
+		bool registerVfs (const char* baseName, bool makeDefault) {
+			std::lock_guard<std::mutex> lock (registerMtx);
+			if (sqlite3_vfs_find (name) == nullptr && !vfsshim::build (faultVfs, name, baseName, fileBytes, vfsOpen)) {
+				return false;
+			}
+			return sqlite3_vfs_register (&faultVfs, makeDefault ? 1 : 0) == SQLITE_OK;
+		}
+
+		/**
+		 * @brief Set the latency and the faults of every file of the VFS. It applies to the
+		 * next operation; the file filter applies to the files opened afterwards.
+		 *
+		 * The random generator restarts from options.seed, so a run can be repeated.
+		 *
+		 * @param options Latency of reads, writes and syncs, throughput cap of the device
+		 * (0 is unlimited), probability of each fault (0 to 1) and substring of the paths of
+		 * the files to affect (empty for all).
+		 */
+		void configure (const Options& options) {
+			std::lock_guard<std::mutex> lock (configMtx);
+			config = options;
+			generator.seed (options.seed);
+			deviceFree = std::chrono::steady_clock::now ();
+		}
+
+		/**
+		 * @brief The options set by the last configure().
+		 */
+		Options getOptions () {
+			std::lock_guard<std::mutex> lock (configMtx);
+			return config;
+		}
+
+		/**
+		 * @brief Operations seen and faults injected since the last resetStats().
+		 */
+		Stats getStats () {
+			Stats output;
+			output.reads = reads;
+			output.writes = writes;
+			output.syncs = syncs;
+			output.stalls = stalls;
+			output.readErrors = readErrors;
+			output.writeErrors = writeErrors;
+			output.shortWrites = shortWrites;
+			output.diskFull = diskFull;
+			output.syncErrors = syncErrors;
+			output.injectedDelay = std::chrono::microseconds (injectedMicros.load ());
+			return output;
+		}
+
+		/**
+		 * @brief Set every counter of getStats() to 0.
+		 */
+		void resetStats () {
+			for (std::atomic<uint64_t>* counter : {&reads, &writes, &syncs, &stalls, &readErrors, &writeErrors,
+												   &shortWrites, &diskFull, &syncErrors, &injectedMicros}) {
+				*counter = 0;
+			}
+		}
+	}	// namespace faultvfs
+}	// namespace jlu
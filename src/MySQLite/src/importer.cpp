@@ -0,0 +1,692 @@
+#include "../include/importer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#include "../include/boundedqueue.h"
+#include "../include/transaction.h"
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define JLU_IMPORTER_SSE2
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define JLU_IMPORTER_MMAP
+#endif
+
+namespace jlu {
+	namespace {
+		struct Cell {
+			int type;
+			int64_t integer;
+			double real;
+			std::string_view text;
+		};
+
+		// Text cells point into the input buffer, or into owned when they had to be unescaped.
+		struct RowBatch {
+			std::vector<Cell> cells;
+			std::deque<std::string> owned;
+			size_t rows = 0;
+		};
+
+		// Input file mapped in memory, or read into a string where mmap is not available.
+		struct InputFile {
+			const char* data = nullptr;
+			size_t size = 0;
+#ifdef JLU_IMPORTER_MMAP
+			void* mapped = nullptr;
+#endif
+			std::string buffer;
+
+			explicit InputFile (const std::string& fileName) {
+#ifdef JLU_IMPORTER_MMAP
+				int fd = ::open (fileName.c_str (), O_RDONLY);
+				if (fd < 0) {
+					throw std::runtime_error ("Unable to open import file " + fileName);
+				}
+				struct stat st;
+				if (fstat (fd, &st) == 0 && st.st_size > 0) {
+					size = static_cast<size_t> (st.st_size);
+					mapped = mmap (nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+					if (mapped == MAP_FAILED) {
+						mapped = nullptr;
+						::close (fd);
+						throw std::runtime_error ("Unable to map import file " + fileName);
+					}
+					madvise (mapped, size, MADV_SEQUENTIAL);
+					data = static_cast<const char*> (mapped);
+				}
+				::close (fd);
+#else
+				std::ifstream in (fileName, std::ios::binary);
+				if (!in) {
+					throw std::runtime_error ("Unable to open import file " + fileName);
+				}
+				buffer.assign (std::istreambuf_iterator<char> (in), std::istreambuf_iterator<char> ());
+				data = buffer.data ();
+				size = buffer.size ();
+#endif
+			}
+
+			~InputFile () {
+#ifdef JLU_IMPORTER_MMAP
+				if (mapped != nullptr) {
+					munmap (mapped, size);
+				}
+#endif
+			}
+		};
+	}	// namespace
+
+	// First position of a or b in [p, end), or end. Compares 16 bytes per step with SSE2.
+	static const char* findEither (const char* p, const char* end, char a, char b) {
+#ifdef JLU_IMPORTER_SSE2
+		const __m128i va = _mm_set1_epi8 (a);
+		const __m128i vb = _mm_set1_epi8 (b);
+		while (end - p >= 16) {
+			__m128i chunk = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (p));
+			int mask = _mm_movemask_epi8 (
+				_mm_or_si128 (_mm_cmpeq_epi8 (chunk, va), _mm_cmpeq_epi8 (chunk, vb)));
+			if (mask != 0) {
+				return p + __builtin_ctz (static_cast<unsigned int> (mask));
+			}
+			p += 16;
+		}
+#endif
+		while (p < end && *p != a && *p != b) {
+			p++;
+		}
+		return p;
+	}
+
+	static Cell nullCell () { return Cell{SQLITE_NULL, 0, 0.0, std::string_view ()}; }
+
+	static Cell textCell (std::string_view text) { return Cell{SQLITE_TEXT, 0, 0.0, text}; }
+
+	// Unquoted values: empty is NULL, then integer, then real, otherwise text.
+	static Cell inferCell (std::string_view field) {
+		Cell cell = nullCell ();
+		if (field.empty ()) {
+			return cell;
+		}
+		const char* begin = field.data ();
+		const char* end = begin + field.size ();
+		char first = *begin;
+		if ((first >= '0' && first <= '9') || first == '-' || first == '.') {
+			auto intResult = std::from_chars (begin, end, cell.integer);
+			if (intResult.ec == std::errc () && intResult.ptr == end) {
+				cell.type = SQLITE_INTEGER;
+				return cell;
+			}
+			auto realResult = std::from_chars (begin, end, cell.real);
+			if (realResult.ec == std::errc () && realResult.ptr == end) {
+				cell.type = SQLITE_FLOAT;
+				return cell;
+			}
+		}
+		return textCell (field);
+	}
+
+	static std::runtime_error parseError (const std::string& what, const char* at, const char* base) {
+		return std::runtime_error ("Import error: " + what + " at byte " +
+								   std::to_string (static_cast<long long> (at - base)));
+	}
+
+	// One CSV record without its line break. Quoted fields may contain the delimiter and
+	// doubled quotes, but not line breaks: records are split on '\n' before parsing.
+	static size_t parseCsvLine (const char* p,
+								const char* end,
+								char delimiter,
+								bool infer,
+								RowBatch& batch,
+								const char* base) {
+		size_t count = 0;
+		while (true) {
+			if (p < end && *p == '"') {
+				const char* start = ++p;
+				bool escaped = false;
+				const char* quote = nullptr;
+				while (true) {
+					quote = static_cast<const char*> (memchr (p, '"', end - p));
+					if (quote == nullptr) {
+						throw parseError ("unterminated quoted field", start, base);
+					}
+					if (quote + 1 < end && quote[1] == '"') {
+						escaped = true;
+						p = quote + 2;
+						continue;
+					}
+					break;
+				}
+
+				std::string_view raw (start, quote - start);
+				if (escaped) {
+					std::string& text = batch.owned.emplace_back ();
+					text.reserve (raw.size ());
+					for (size_t i = 0; i < raw.size (); i++) {
+						text += raw[i];
+						if (raw[i] == '"') {
+							i++;
+						}
+					}
+					raw = text;
+				}
+				batch.cells.push_back (textCell (raw));
+				p = quote + 1;
+				if (p < end && *p != delimiter) {
+					throw parseError ("unexpected character after quoted field", p, base);
+				}
+			} else {
+				const char* start = p;
+				p = findEither (p, end, delimiter, '"');
+				while (p < end && *p == '"') {
+					p = findEither (p + 1, end, delimiter, delimiter);
+				}
+				std::string_view field (start, p - start);
+				batch.cells.push_back (infer ? inferCell (field) : textCell (field));
+			}
+			count++;
+
+			if (p >= end) {
+				break;
+			}
+			p++;	// delimiter
+			if (p == end) {
+				batch.cells.push_back (nullCell ());
+				count++;
+				break;
+			}
+		}
+		return count;
+	}
+
+	static const char* skipSpaces (const char* p, const char* end) {
+		while (p < end && (*p == ' ' || *p == '\t')) {
+			p++;
+		}
+		return p;
+	}
+
+	static void appendUtf8 (std::string& out, uint32_t cp) {
+		if (cp < 0x80) {
+			out += static_cast<char> (cp);
+		} else if (cp < 0x800) {
+			out += static_cast<char> (0xC0 | (cp >> 6));
+			out += static_cast<char> (0x80 | (cp & 0x3F));
+		} else if (cp < 0x10000) {
+			out += static_cast<char> (0xE0 | (cp >> 12));
+			out += static_cast<char> (0x80 | ((cp >> 6) & 0x3F));
+			out += static_cast<char> (0x80 | (cp & 0x3F));
+		} else {
+			out += static_cast<char> (0xF0 | (cp >> 18));
+			out += static_cast<char> (0x80 | ((cp >> 12) & 0x3F));
+			out += static_cast<char> (0x80 | ((cp >> 6) & 0x3F));
+			out += static_cast<char> (0x80 | (cp & 0x3F));
+		}
+	}
+
+	static uint32_t parseHex4 (const char* p, const char* end, const char* base) {
+		uint32_t cp = 0;
+		if (end - p < 4 || std::from_chars (p, p + 4, cp, 16).ptr != p + 4) {
+			throw parseError ("bad \\u escape", p, base);
+		}
+		return cp;
+	}
+
+	// p points after the opening quote. Returns the position after the closing quote.
+	static const char* parseJsonString (const char* p,
+										const char* end,
+										std::string_view& value,
+										RowBatch& batch,
+										const char* base) {
+		const char* start = p;
+		p = findEither (p, end, '"', '\\');
+		if (p < end && *p == '"') {
+			value = std::string_view (start, p - start);
+			return p + 1;
+		}
+
+		std::string& text = batch.owned.emplace_back (start, p - start);
+		while (p < end && *p != '"') {
+			if (*p != '\\') {
+				const char* next = findEither (p, end, '"', '\\');
+				text.append (p, next - p);
+				p = next;
+				continue;
+			}
+			if (++p >= end) {
+				break;
+			}
+			switch (*p) {
+				case 'b': text += '\b'; break;
+				case 'f': text += '\f'; break;
+				case 'n': text += '\n'; break;
+				case 'r': text += '\r'; break;
+				case 't': text += '\t'; break;
+				case 'u': {
+					uint32_t cp = parseHex4 (p + 1, end, base);
+					p += 4;
+					if (cp >= 0xD800 && cp < 0xDC00 && end - p > 6 && p[1] == '\\' && p[2] == 'u') {
+						uint32_t low = parseHex4 (p + 3, end, base);
+						cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+						p += 6;
+					}
+					appendUtf8 (text, cp);
+					break;
+				}
+				default: text += *p; break;
+			}
+			p++;
+		}
+		if (p >= end) {
+			throw parseError ("unterminated string", start, base);
+		}
+		value = text;
+		return p + 1;
+	}
+
+	// Nested objects and arrays are stored as their JSON text.
+	static const char* skipJsonNested (const char* p, const char* end, const char* base) {
+		const char* start = p;
+		int depth = 0;
+		while (p < end) {
+			char c = *p;
+			if (c == '"') {
+				p++;
+				while (p < end && *p != '"') {
+					p += (*p == '\\') ? 2 : 1;
+				}
+			} else if (c == '{' || c == '[') {
+				depth++;
+			} else if (c == '}' || c == ']') {
+				if (--depth == 0) {
+					return p + 1;
+				}
+			}
+			p++;
+		}
+		throw parseError ("unterminated object or array", start, base);
+	}
+
+	// Flat JSON object on one line. onField (key, cell) is called for every member.
+	template <typename OnField>
+	static void parseJsonLine (const char* p,
+							   const char* end,
+							   RowBatch& batch,
+							   const char* base,
+							   OnField onField) {
+		p = skipSpaces (p, end);
+		if (p >= end || *p != '{') {
+			throw parseError ("expected '{'", p, base);
+		}
+		p = skipSpaces (p + 1, end);
+		if (p < end && *p == '}') {
+			return;
+		}
+
+		while (true) {
+			if (p >= end || *p != '"') {
+				throw parseError ("expected a key", p, base);
+			}
+			std::string_view key;
+			p = skipSpaces (parseJsonString (p + 1, end, key, batch, base), end);
+			if (p >= end || *p != ':') {
+				throw parseError ("expected ':'", p, base);
+			}
+			p = skipSpaces (p + 1, end);
+			if (p >= end) {
+				throw parseError ("expected a value", p, base);
+			}
+
+			Cell cell = nullCell ();
+			if (*p == '"') {
+				std::string_view text;
+				p = parseJsonString (p + 1, end, text, batch, base);
+				cell = textCell (text);
+			} else if (*p == '{' || *p == '[') {
+				const char* start = p;
+				p = skipJsonNested (p, end, base);
+				cell = textCell (std::string_view (start, p - start));
+			} else {
+				const char* start = p;
+				while (p < end && *p != ',' && *p != '}' && *p != ' ' && *p != '\t') {
+					p++;
+				}
+				std::string_view token (start, p - start);
+				if (token == "true" || token == "false") {
+					cell = Cell{SQLITE_INTEGER, token == "true" ? 1 : 0, 0.0, std::string_view ()};
+				} else if (token != "null") {
+					cell = inferCell (token);
+					if (cell.type == SQLITE_TEXT) {
+						throw parseError ("bad value", start, base);
+					}
+				}
+			}
+			onField (key, cell);
+
+			p = skipSpaces (p, end);
+			if (p < end && *p == ',') {
+				p = skipSpaces (p + 1, end);
+			} else if (p < end && *p == '}') {
+				return;
+			} else {
+				throw parseError ("expected ',' or '}'", p, base);
+			}
+		}
+	}
+
+	static const char* lineEnd (const char* p, const char* end) {
+		const char* newLine = static_cast<const char*> (memchr (p, '\n', end - p));
+		return (newLine != nullptr) ? newLine : end;
+	}
+
+	static const char* trimReturn (const char* line, const char* stop) {
+		return (stop > line && stop[-1] == '\r') ? stop - 1 : stop;
+	}
+
+	static double perSecond (double amount, double seconds) {
+		return (seconds > 0.0) ? amount / seconds : 0.0;
+	}
+
+	double ImportStats::parseRowsPerSecond () const { return perSecond (rows, parseSeconds); }
+
+	double ImportStats::parseBytesPerSecond () const { return perSecond (bytes, parseSeconds); }
+
+	double ImportStats::insertRowsPerSecond () const { return perSecond (rows, insertSeconds); }
+
+	double ImportStats::insertBytesPerSecond () const { return perSecond (bytes, insertSeconds); }
+
+	/**
+	 * @brief Creates an importer that loads files into a table of a database.
+	 *
+	 * @param database The writer. Only the calling thread of importFile uses it.
+	 * @param options Format, columns, number of parser threads and batch sizes.
+	 */
+	Importer::Importer (MySQLite& database, const ImportOptions& options)
+		: database (database), options (options) {}
+
+	/**
+	 * @brief Import a CSV or JSON Lines file. The file is mapped in memory.
+	 *
+	 * @see importBuffer
+	 */
+	ImportStats Importer::importFile (const std::string& fileName, const std::string& table) {
+		InputFile input (fileName);
+		return importBuffer (input.data, input.size, table);
+	}
+
+	/**
+	 * @brief Import CSV or JSON Lines data that is already in memory.
+	 *
+	 * The data is split on line boundaries into one range per thread. Every thread parses its
+	 * range into typed batches (integer, real, text or NULL) and pushes them into a bounded
+	 * queue. The calling thread pops the batches and inserts them with one prepared INSERT,
+	 * committing every options.rowsPerTransaction rows in IMMEDIATE transactions. Inside a
+	 * transaction of the caller, the rows are part of it instead. The order of the rows in the table is
+	 * not the order of the file when more than one thread is used.
+	 *
+	 * Column names come from options.columns, otherwise from the CSV header or from the keys
+	 * of the first JSON object. If the table does not exist and options.createTable is set,
+	 * it is created with those columns.
+	 *
+	 * @param data The CSV or JSON Lines text. It must stay valid until the call returns.
+	 * @param size Size of data in bytes.
+	 * @param table Destination table.
+	 * @return ImportStats Rows, bytes and the time of the parse and insert stages.
+	 * @throw std::runtime_error on parse errors or SQL errors. Rows of the current
+	 * transaction are rolled back; previous transactions stay committed. In a transaction
+	 * of the caller, the caller decides.
+	 */
+	ImportStats Importer::importBuffer (const char* data, size_t size, const std::string& table) {
+		auto begin = std::chrono::steady_clock::now ();
+		ImportStats stats;
+		stats.bytes = size;
+		const char* end = data + size;
+		const char* body = data;
+
+		// Columns >>
+		std::vector<std::string> columns (options.columns);
+		bool namedColumns = !columns.empty ();
+		if (size > 0 && options.format == ImportFormat::Csv && (options.header || columns.empty ())) {
+			const char* stop = lineEnd (data, end);
+			RowBatch first;
+			size_t count = parseCsvLine (data, trimReturn (data, stop), options.delimiter, false,
+										 first, data);
+			if (options.header) {
+				if (columns.empty ()) {
+					for (const Cell& cell : first.cells) {
+						columns.emplace_back (cell.text);
+					}
+					namedColumns = true;
+				}
+				body = (stop < end) ? stop + 1 : end;
+			} else {
+				for (size_t i = 1; i <= count; i++) {
+					columns.push_back ("c" + std::to_string (i));
+				}
+			}
+		} else if (size > 0 && options.format == ImportFormat::JsonLines && columns.empty ()) {
+			const char* stop = lineEnd (data, end);
+			RowBatch first;
+			parseJsonLine (data, trimReturn (data, stop), first, data,
+						   [&columns] (std::string_view key, const Cell&) { columns.emplace_back (key); });
+			namedColumns = true;
+		}
+		if (columns.empty ()) {
+			stats.totalSeconds =
+				std::chrono::duration<double> (std::chrono::steady_clock::now () - begin).count ();
+			return stats;
+		}
+
+		std::unordered_map<std::string_view, size_t> columnIndex;
+		for (size_t i = 0; i < columns.size (); i++) {
+			columnIndex.emplace (columns[i], i);
+		}
+
+		// Statements >>
+		std::string names;
+		std::string params;
+		std::string coma ("");
+		for (const std::string& column : columns) {
+			names += coma + MySQLite::quoteIdentifier (column);
+			params += coma + "?";
+			coma = ", ";
+		}
+		std::string quotedTable (MySQLite::quoteIdentifier (table));
+		if (options.createTable) {
+			database.exec ("CREATE TABLE IF NOT EXISTS " + quotedTable + " (" + names + ");");
+		}
+		std::string insert ("INSERT INTO " + quotedTable + (namedColumns ? " (" + names + ")" : "") +
+							" VALUES (" + params + ");");
+
+		sqlite3* db = database.getHandle ();
+		sqlite3_stmt* stmt = nullptr;
+		int stmtResult = sqlite3_prepare_v2 (db, insert.c_str (), -1, &stmt, nullptr);
+		if (SQLITE_OK != stmtResult) {
+			std::string errorMsg ("Unable compile the SQL statement. Error code:" +
+								  std::to_string (stmtResult) + "\n");
+			throw std::runtime_error (errorMsg);
+		}
+
+		// Parser threads >>
+		unsigned int threads = options.threads;
+		if (threads == 0) {
+			threads = std::max (1u, std::thread::hardware_concurrency ());
+		}
+		const size_t minRange = 1 << 20;
+		threads = static_cast<unsigned int> (
+			std::max<size_t> (1, std::min<size_t> (threads, static_cast<size_t> (end - body) / minRange + 1)));
+
+		BoundedQueue<RowBatch> queue (options.queueBatches);
+		std::atomic<unsigned int> remaining (threads);
+		std::atomic<bool> failed (false);
+		std::exception_ptr error;
+		std::mutex errorMtx;
+		std::vector<std::chrono::steady_clock::time_point> parseEnd (threads);
+		const size_t numCols = columns.size ();
+		const size_t batchRows = std::max<size_t> (1, options.batchRows);
+
+		auto parseRange = [&] (unsigned int id, const char* from, const char* to) {
+			try {
+				RowBatch batch;
+				batch.cells.reserve (batchRows * numCols);
+				const char* line = from;
+				while (line < to && !failed) {
+					const char* stop = lineEnd (line, to);
+					const char* last = trimReturn (line, stop);
+					if (last > line) {
+						if (options.format == ImportFormat::Csv) {
+							size_t count =
+								parseCsvLine (line, last, options.delimiter, true, batch, data);
+							if (count != numCols) {
+								throw parseError ("wrong number of fields", line, data);
+							}
+						} else {
+							size_t first = batch.cells.size ();
+							batch.cells.resize (first + numCols, nullCell ());
+							parseJsonLine (line, last, batch, data,
+										   [&] (std::string_view key, const Cell& cell) {
+											   auto it = columnIndex.find (key);
+											   if (it != columnIndex.end ()) {
+												   batch.cells[first + it->second] = cell;
+											   }
+										   });
+						}
+						batch.rows++;
+					}
+					line = (stop < to) ? stop + 1 : to;
+
+					if (batch.rows == batchRows) {
+						if (!queue.push (std::move (batch))) {
+							break;
+						}
+						batch = RowBatch ();
+						batch.cells.reserve (batchRows * numCols);
+					}
+				}
+				if (batch.rows > 0) {
+					queue.push (std::move (batch));
+				}
+			} catch (...) {
+				std::lock_guard<std::mutex> lock (errorMtx);
+				if (!error) {
+					error = std::current_exception ();
+				}
+				failed = true;
+				queue.close ();
+			}
+			parseEnd[id] = std::chrono::steady_clock::now ();
+			if (--remaining == 0) {
+				queue.close ();
+			}
+		};
+
+		std::vector<std::thread> workers;
+		const char* from = body;
+		for (unsigned int t = 0; t < threads; t++) {
+			const char* to = end;
+			if (t + 1 < threads) {
+				to = std::max (from, body + (end - body) * (t + 1) / threads);
+				to = (to < end) ? lineEnd (to, end) : end;
+				to = (to < end) ? to + 1 : end;
+			}
+			workers.emplace_back (parseRange, t, from, to);
+			from = to;
+		}
+
+		// Insert loop >>
+		bool ownTransaction = (sqlite3_get_autocommit (db) != 0);
+		std::unique_ptr<Transaction> transaction;
+		std::chrono::duration<double> insertTime (0);
+		try {
+			if (ownTransaction) {
+				transaction.reset (new Transaction (database, TransactionMode::Immediate));
+			}
+			size_t rowsInTransaction = 0;
+			RowBatch batch;
+			while (!failed && queue.pop (batch)) {
+				auto start = std::chrono::steady_clock::now ();
+				const Cell* cell = batch.cells.data ();
+				for (size_t r = 0; r < batch.rows; r++) {
+					for (size_t c = 1; c <= numCols; c++, cell++) {
+						int param = static_cast<int> (c);
+						if (SQLITE_INTEGER == cell->type) {
+							sqlite3_bind_int64 (stmt, param, cell->integer);
+						} else if (SQLITE_FLOAT == cell->type) {
+							sqlite3_bind_double (stmt, param, cell->real);
+						} else if (SQLITE_TEXT == cell->type) {
+							sqlite3_bind_text (stmt, param, cell->text.data (),
+											   static_cast<int> (cell->text.size ()), SQLITE_STATIC);
+						} else {
+							sqlite3_bind_null (stmt, param);
+						}
+					}
+					int result = sqlite3_step (stmt);
+					sqlite3_reset (stmt);
+					if (SQLITE_DONE != result) {
+						std::string errorMsg ("Error in sql statement. Desc: ");
+						errorMsg += sqlite3_errmsg (db);
+						throw std::runtime_error (errorMsg);
+					}
+
+					if (ownTransaction && ++rowsInTransaction >= options.rowsPerTransaction) {
+						transaction->commit ();
+						transaction.reset (new Transaction (database, TransactionMode::Immediate));
+						stats.transactions++;
+						rowsInTransaction = 0;
+					}
+				}
+				stats.rows += batch.rows;
+				insertTime += std::chrono::steady_clock::now () - start;
+			}
+
+			if (!failed && ownTransaction) {
+				auto start = std::chrono::steady_clock::now ();
+				transaction->commit ();
+				stats.transactions++;
+				insertTime += std::chrono::steady_clock::now () - start;
+			}
+		} catch (...) {
+			std::lock_guard<std::mutex> lock (errorMtx);
+			if (!error) {
+				error = std::current_exception ();
+			}
+			failed = true;
+		}
+
+		queue.close ();
+		for (std::thread& worker : workers) {
+			worker.join ();
+		}
+		sqlite3_finalize (stmt);
+
+		if (failed) {
+			transaction.reset ();	// Rolls back the rows not committed yet.
+			std::rethrow_exception (error);
+		}
+
+		auto parseDone = *std::max_element (parseEnd.begin (), parseEnd.end ());
+		stats.parseSeconds = std::chrono::duration<double> (parseDone - begin).count ();
+		stats.insertSeconds = insertTime.count ();
+		stats.totalSeconds =
+			std::chrono::duration<double> (std::chrono::steady_clock::now () - begin).count ();
+		return stats;
+	}
+}	// namespace jlu
@@ -0,0 +1,249 @@
+#include "../include/iostatsvfs.h"
+
+#include <chrono>
+#include <cstring>
+#include <mutex>
+
+#include "../include/sqlite3.h"
+#include "../include/vfsshim.h"
+
+namespace jlu {
+	/**
+	 * @brief Count one operation. Bucket 0 is below 1 microsecond, bucket b is from 2^(b-1)
+	 * to 2^b microseconds; the last one is open ended.
+	 */
+	void LatencyHistogram::add (uint64_t ns) {
+		uint64_t micros = ns / 1000;
+		int bucket = 0;
+		while (micros > 0 && bucket < bucketCount - 1) {
+			micros >>= 1;
+			bucket++;
+		}
+		buckets[bucket]++;
+		count++;
+		totalNs += ns;
+		maxNs = (ns > maxNs) ? ns : maxNs;
+	}
+
+	/**
+	 * @brief Add the operations of another histogram.
+	 */
+	void LatencyHistogram::merge (const LatencyHistogram& other) {
+		for (int b = 0; b < bucketCount; b++) {
+			buckets[b] += other.buckets[b];
+		}
+		count += other.count;
+		totalNs += other.totalNs;
+		maxNs = (other.maxNs > maxNs) ? other.maxNs : maxNs;
+	}
+
+	/**
+	 * @brief Mean latency in microseconds, 0 without operations.
+	 */
+	double LatencyHistogram::meanMicros () const {
+		return (count > 0) ? static_cast<double> (totalNs) / count / 1000.0 : 0.0;
+	}
+
+	/**
+	 * @brief Upper bound of the bucket that holds the percentile p (0 to 1), in
+	 * microseconds, never above the maximum seen.
+	 */
+	double LatencyHistogram::percentileMicros (double p) const {
+		if (count == 0) {
+			return 0.0;
+		}
+		double maxMicros = maxNs / 1000.0;
+		uint64_t rank = static_cast<uint64_t> (p * count);
+		uint64_t seen = 0;
+		for (int b = 0; b < bucketCount; b++) {
+			seen += buckets[b];
+			if (seen > rank) {
+				double upper = static_cast<double> (uint64_t (1) << b);
+				return (upper < maxMicros) ? upper : maxMicros;
+			}
+		}
+		return maxMicros;
+	}
+
+	/**
+	 * @brief Add the counters of another file.
+	 */
+	void IoFileStats::merge (const IoFileStats& other) {
+		reads += other.reads;
+		writes += other.writes;
+		syncs += other.syncs;
+		bytesRead += other.bytesRead;
+		bytesWritten += other.bytesWritten;
+		readLatency.merge (other.readLatency);
+		writeLatency.merge (other.writeLatency);
+		syncLatency.merge (other.syncLatency);
+	}
+
+	/**
+	 * @brief Counters of the database, journal and WAL together.
+	 */
+	IoFileStats IoStats::total () const {
+		IoFileStats output = database;
+		output.merge (journal);
+		output.merge (wal);
+		return output;
+	}
+
+	namespace iostatsvfs {
+		// Files opened through the "iostats" VFS count their reads, writes and syncs, with
+		// their latency, and forward everything to the wrapped VFS. The counters are kept in
+		// the main database file of each connection; its journal and WAL add to them.
+		// They are read with sqlite3_file_control, so under the mutex of the connection.
+
+		const char* const name = "iostats";
+		const int fileControlGet = 0x4a4c5310;
+		const int fileControlReset = 0x4a4c5311;
+
+		// Private file control that returns the IoStats of a database file.
+		static const int fileControlOwner = 0x4a4c5312;
+
+		static sqlite3_vfs statsVfs;
+		static std::mutex registerMtx;
+
+		struct StatsFile {
+			vfsshim::ShimFile shim;
+			IoFileStats* counters;
+			IoStats* stats;
+		};
+
+		static const int fileBytes = sizeof (StatsFile);
+
+		static StatsFile* statsFile (sqlite3_file* file) { return reinterpret_cast<StatsFile*> (file); }
+
+		static uint64_t elapsedNs (std::chrono::steady_clock::time_point begin) {
+			return std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now () - begin)
+				.count ();
+		}
+
+		// Methods of the files >>
+
+		static int fileClose (sqlite3_file* file) {
+			StatsFile* p = statsFile (file);
+			delete p->stats;
+			p->stats = nullptr;
+			return p->shim.real->pMethods->xClose (p->shim.real);
+		}
+
+		static int fileRead (sqlite3_file* file, void* data, int amount, sqlite3_int64 offset) {
+			StatsFile* p = statsFile (file);
+			auto begin = std::chrono::steady_clock::now ();
+			int rc = p->shim.real->pMethods->xRead (p->shim.real, data, amount, offset);
+			if (p->counters != nullptr) {
+				p->counters->readLatency.add (elapsedNs (begin));
+				p->counters->reads++;
+				p->counters->bytesRead += amount;
+			}
+			return rc;
+		}
+
+		static int fileWrite (sqlite3_file* file, const void* data, int amount, sqlite3_int64 offset) {
+			StatsFile* p = statsFile (file);
+			auto begin = std::chrono::steady_clock::now ();
+			int rc = p->shim.real->pMethods->xWrite (p->shim.real, data, amount, offset);
+			if (p->counters != nullptr) {
+				p->counters->writeLatency.add (elapsedNs (begin));
+				p->counters->writes++;
+				p->counters->bytesWritten += amount;
+			}
+			return rc;
+		}
+
+		static int fileSync (sqlite3_file* file, int flags) {
+			StatsFile* p = statsFile (file);
+			auto begin = std::chrono::steady_clock::now ();
+			int rc = p->shim.real->pMethods->xSync (p->shim.real, flags);
+			if (p->counters != nullptr) {
+				p->counters->syncLatency.add (elapsedNs (begin));
+				p->counters->syncs++;
+			}
+			return rc;
+		}
+
+		static int fileControl (sqlite3_file* file, int op, void* arg) {
+			StatsFile* p = statsFile (file);
+			if (p->stats != nullptr) {
+				if (op == fileControlGet) {
+					*static_cast<IoStats*> (arg) = *p->stats;
+					return SQLITE_OK;
+				}
+				if (op == fileControlReset) {
+					*p->stats = IoStats ();
+					return SQLITE_OK;
+				}
+				if (op == fileControlOwner) {
+					*static_cast<IoStats**> (arg) = p->stats;
+					return SQLITE_OK;
+				}
+			}
+			return p->shim.real->pMethods->xFileControl (p->shim.real, op, arg);
+		}
+
+		static const sqlite3_io_methods fileMethods[3] = {
+			{1, fileClose, fileRead, fileWrite, vfsshim::fileTruncate, fileSync, vfsshim::fileSize, vfsshim::fileLock,
+			 vfsshim::fileUnlock, vfsshim::fileCheckReservedLock, fileControl, vfsshim::fileSectorSize,
+			 vfsshim::fileDeviceCharacteristics, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr},
+			{2, fileClose, fileRead, fileWrite, vfsshim::fileTruncate, fileSync, vfsshim::fileSize, vfsshim::fileLock,
+			 vfsshim::fileUnlock, vfsshim::fileCheckReservedLock, fileControl, vfsshim::fileSectorSize,
+			 vfsshim::fileDeviceCharacteristics, vfsshim::fileShmMap, vfsshim::fileShmLock, vfsshim::fileShmBarrier,
+			 vfsshim::fileShmUnmap, nullptr, nullptr},
+			{3, fileClose, fileRead, fileWrite, vfsshim::fileTruncate, fileSync, vfsshim::fileSize, vfsshim::fileLock,
+			 vfsshim::fileUnlock, vfsshim::fileCheckReservedLock, fileControl, vfsshim::fileSectorSize,
+			 vfsshim::fileDeviceCharacteristics, vfsshim::fileShmMap, vfsshim::fileShmLock, vfsshim::fileShmBarrier,
+			 vfsshim::fileShmUnmap, vfsshim::fileFetch, vfsshim::fileUnfetch}};
+
+		// Methods of the VFS >>
+
+		static int vfsOpen (sqlite3_vfs* vfs, const char* path, sqlite3_file* file, int flags, int* outFlags) {
+			StatsFile* p = statsFile (file);
+			p->shim.real = vfsshim::realFile (file, fileBytes);
+			p->counters = nullptr;
+			p->stats = nullptr;
+			int rc = vfsshim::openReal (vfs, path, file, fileBytes, flags, outFlags);
+			if (rc != SQLITE_OK) {
+				return rc;
+			}
+			p->shim.base.pMethods = vfsshim::methodsFor (fileMethods, p->shim.real);
+
+			if ((flags & SQLITE_OPEN_MAIN_DB) != 0) {
+				p->stats = new IoStats ();
+				p->counters = &p->stats->database;
+			} else if (path != nullptr && (flags & (SQLITE_OPEN_MAIN_JOURNAL | SQLITE_OPEN_WAL)) != 0) {
+				sqlite3_file* database = sqlite3_database_file_object (path);
+				IoStats* owner = nullptr;
+				if (database != nullptr && database->pMethods != nullptr &&
+					database->pMethods->xFileControl (database, fileControlOwner, &owner) == SQLITE_OK &&
+					owner != nullptr) {
+					p->counters = ((flags & SQLITE_OPEN_WAL) != 0) ? &owner->wal : &owner->journal;
+				}
+			}
+			return SQLITE_OK;
+		}
+
+		/**
+		 * @brief Register the "iostats" VFS, which counts the I/O of every connection that
+		 * opens a database with it: MySQLite::open (fileName, jlu::iostatsvfs::name). Read
+		 * the counters with MySQLite::getIoStats.
+		 *
+		 * Reads, writes and syncs of the database, its rollback journal and its WAL are
+		 * counted apart, with their bytes and a latency histogram. Temporary files are not
+		 * counted.
+		 *
+		 * @param baseName VFS to wrap, e.g. jlu::uringvfs::name, or nullptr for the default
+		 * one. Only the first registration sets it.
+		 * @param makeDefault Use it for every database open without an explicit VFS.
+		 * @return bool False if the VFS to wrap is not registered.
+		 */
+		bool registerVfs (const char* baseName, bool makeDefault) {
+			std::lock_guard<std::mutex> lock (registerMtx);
+			if (sqlite3_vfs_find (name) == nullptr && !vfsshim::build (statsVfs, name, baseName, fileBytes, vfsOpen)) {
+				return false;
+			}
+			return sqlite3_vfs_register (&statsVfs, makeDefault ? 1 : 0) == SQLITE_OK;
+		}
+	}	// namespace iostatsvfs
+}	// namespace jlu
@@ -0,0 +1,951 @@
+#include "../include/kernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define JLU_KERNELS_X86
+#define JLU_TARGET_SSE42 __attribute__ ((target ("sse4.2,popcnt")))
+#define JLU_TARGET_AVX2 __attribute__ ((target ("avx2,popcnt")))
+#endif
+
+namespace jlu {
+	namespace kernels {
+		// Bitmaps use the Arrow layout: bit i of the buffer is (byte i / 8, bit i % 8), 1 means
+		// valid. A null bitmap pointer means every value is valid.
+
+		static std::atomic<int> selectedIsa (-1);
+
+		static inline bool isValid (const uint8_t* validity, size_t i) {
+			return validity == nullptr || ((validity[i >> 3] >> (i & 7)) & 1);
+		}
+
+		static inline int popcount64 (uint64_t x) {
+#if defined(__GNUC__)
+			return __builtin_popcountll (x);
+#else
+			int count = 0;
+			for (; x != 0; x &= x - 1) {
+				count++;
+			}
+			return count;
+#endif
+		}
+
+		template <typename T>
+		static inline T highest () {
+			return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity ()
+														: std::numeric_limits<T>::max ();
+		}
+
+		template <typename T>
+		static inline T lowest () {
+			return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity ()
+														: std::numeric_limits<T>::lowest ();
+		}
+
+		template <CompareOp Op, typename T>
+		static inline bool test (T a, T b) {
+			if constexpr (Op == CompareOp::Eq) {
+				return a == b;
+			} else if constexpr (Op == CompareOp::Ne) {
+				return a != b;
+			} else if constexpr (Op == CompareOp::Lt) {
+				return a < b;
+			} else if constexpr (Op == CompareOp::Le) {
+				return a <= b;
+			} else if constexpr (Op == CompareOp::Gt) {
+				return a > b;
+			} else {
+				return a >= b;
+			}
+		}
+
+		template <typename F>
+		static size_t withOp (CompareOp op, F kernel) {
+			switch (op) {
+				case CompareOp::Eq: return kernel (std::integral_constant<CompareOp, CompareOp::Eq> ());
+				case CompareOp::Ne: return kernel (std::integral_constant<CompareOp, CompareOp::Ne> ());
+				case CompareOp::Lt: return kernel (std::integral_constant<CompareOp, CompareOp::Lt> ());
+				case CompareOp::Le: return kernel (std::integral_constant<CompareOp, CompareOp::Le> ());
+				case CompareOp::Gt: return kernel (std::integral_constant<CompareOp, CompareOp::Gt> ());
+				default: return kernel (std::integral_constant<CompareOp, CompareOp::Ge> ());
+			}
+		}
+
+		// Scalar kernels >>
+		// They start at i, so the SIMD kernels use them for the tail.
+
+		// count, if given, is increased by the values added.
+		template <typename T>
+		static T sumScalar (const T* x, const uint8_t* validity, size_t i, size_t n, size_t* count = nullptr) {
+			// Integers wrap around on overflow, like the SIMD lanes.
+			typedef typename std::conditional<std::is_integral<T>::value, uint64_t, T>::type Acc;
+			Acc acc = 0;
+			size_t added = 0;
+			for (; i < n; i++) {
+				// x[i] == x[i] is false only for NaN, which is skipped.
+				if (isValid (validity, i) && x[i] == x[i]) {
+					acc += static_cast<Acc> (x[i]);
+					added++;
+				}
+			}
+			if (count != nullptr) {
+				*count += added;
+			}
+			return static_cast<T> (acc);
+		}
+
+		template <typename T>
+		static MinMax<T> minMaxScalar (const T* x, const uint8_t* validity, size_t i, size_t n) {
+			MinMax<T> result{highest<T> (), lowest<T> (), 0};
+			for (; i < n; i++) {
+				// x[i] == x[i] is false only for NaN, which is neither counted nor compared.
+				if (isValid (validity, i) && x[i] == x[i]) {
+					result.min = (x[i] < result.min) ? x[i] : result.min;
+					result.max = (x[i] > result.max) ? x[i] : result.max;
+					result.count++;
+				}
+			}
+			return result;
+		}
+
+		static double sumSqDiffScalar (const double* x,
+									   const uint8_t* validity,
+									   size_t i,
+									   size_t n,
+									   double mean) {
+			double acc = 0.0;
+			for (; i < n; i++) {
+				if (isValid (validity, i) && x[i] == x[i]) {
+					acc += (x[i] - mean) * (x[i] - mean);
+				}
+			}
+			return acc;
+		}
+
+		// i must be a multiple of 8.
+		template <CompareOp Op, typename T>
+		static size_t compareScalar (const T* x,
+									 const uint8_t* validity,
+									 size_t i,
+									 size_t n,
+									 T rhs,
+									 uint8_t* out) {
+			size_t matches = 0;
+			for (; i < n; i += 8) {
+				uint8_t bits = 0;
+				size_t end = std::min (n, i + 8);
+				for (size_t j = i; j < end; j++) {
+					bits |= static_cast<uint8_t> (test<Op> (x[j], rhs) ? 1u << (j - i) : 0u);
+				}
+				if (validity != nullptr) {
+					bits &= validity[i >> 3];
+				}
+				out[i >> 3] = bits;
+				matches += popcount64 (bits);
+			}
+			return matches;
+		}
+
+		static size_t countValidScalar (const uint8_t* validity, size_t n) {
+			size_t count = 0;
+			size_t bytes = n / 8;
+			size_t i = 0;
+			for (; i + 8 <= bytes; i += 8) {
+				uint64_t word;
+				memcpy (&word, validity + i, sizeof (word));
+				count += popcount64 (word);
+			}
+			for (; i < bytes; i++) {
+				count += popcount64 (validity[i]);
+			}
+			if (n % 8 != 0) {
+				count += popcount64 (validity[bytes] & ((1u << (n % 8)) - 1));
+			}
+			return count;
+		}
+
+#ifdef JLU_KERNELS_X86
+		// SSE4.2 kernels >>
+		// 2 lanes of 64 bits. One validity byte covers 4 vectors.
+
+		JLU_TARGET_SSE42 static size_t countValidSse42 (const uint8_t* validity, size_t n) {
+			return countValidScalar (validity, n);
+		}
+
+		JLU_TARGET_SSE42 static inline void masksSse42 (uint8_t byte, __m128i m[4]) {
+			const __m128i b = _mm_set1_epi64x (byte);
+			for (int k = 0; k < 4; k++) {
+				const __m128i bits = _mm_set_epi64x (2LL << (2 * k), 1LL << (2 * k));
+				m[k] = _mm_cmpeq_epi64 (_mm_and_si128 (b, bits), bits);
+			}
+		}
+
+		JLU_TARGET_SSE42 static int64_t sumI64Sse42 (const int64_t* x, const uint8_t* validity, size_t n) {
+			__m128i acc = _mm_setzero_si128 ();
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m128i m[4] = {_mm_set1_epi64x (-1), _mm_set1_epi64x (-1), _mm_set1_epi64x (-1),
+								_mm_set1_epi64x (-1)};
+				if (validity != nullptr) {
+					masksSse42 (validity[i >> 3], m);
+				}
+				for (int k = 0; k < 4; k++) {
+					__m128i v = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (x + i + 2 * k));
+					acc = _mm_add_epi64 (acc, _mm_and_si128 (v, m[k]));
+				}
+			}
+			int64_t lanes[2];
+			_mm_storeu_si128 (reinterpret_cast<__m128i*> (lanes), acc);
+			uint64_t total = static_cast<uint64_t> (lanes[0]) + static_cast<uint64_t> (lanes[1]);
+			return static_cast<int64_t> (total + static_cast<uint64_t> (sumScalar (x, validity, i, n)));
+		}
+
+		// NaN lanes are masked out (_mm_cmpord_pd) and not counted.
+		JLU_TARGET_SSE42 static double sumF64Sse42 (const double* x,
+													const uint8_t* validity,
+													size_t n,
+													size_t& count) {
+			__m128d acc[2] = {_mm_setzero_pd (), _mm_setzero_pd ()};
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m128i m[4] = {_mm_set1_epi64x (-1), _mm_set1_epi64x (-1), _mm_set1_epi64x (-1),
+								_mm_set1_epi64x (-1)};
+				if (validity != nullptr) {
+					masksSse42 (validity[i >> 3], m);
+				}
+				for (int k = 0; k < 4; k++) {
+					__m128d v = _mm_loadu_pd (x + i + 2 * k);
+					__m128d mask = _mm_and_pd (_mm_cmpord_pd (v, v), _mm_castsi128_pd (m[k]));
+					acc[k & 1] = _mm_add_pd (acc[k & 1], _mm_and_pd (v, mask));
+					count += popcount64 (_mm_movemask_pd (mask));
+				}
+			}
+			double lanes[2];
+			_mm_storeu_pd (lanes, _mm_add_pd (acc[0], acc[1]));
+			return lanes[0] + lanes[1] + sumScalar (x, validity, i, n, &count);
+		}
+
+		JLU_TARGET_SSE42 static MinMax<int64_t> minMaxI64Sse42 (const int64_t* x,
+																 const uint8_t* validity,
+																 size_t n) {
+			const __m128i high = _mm_set1_epi64x (highest<int64_t> ());
+			const __m128i low = _mm_set1_epi64x (lowest<int64_t> ());
+			__m128i vmin = high;
+			__m128i vmax = low;
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m128i m[4] = {_mm_set1_epi64x (-1), _mm_set1_epi64x (-1), _mm_set1_epi64x (-1),
+								_mm_set1_epi64x (-1)};
+				if (validity != nullptr) {
+					masksSse42 (validity[i >> 3], m);
+				}
+				for (int k = 0; k < 4; k++) {
+					__m128i v = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (x + i + 2 * k));
+					__m128i forMin = _mm_blendv_epi8 (high, v, m[k]);
+					__m128i forMax = _mm_blendv_epi8 (low, v, m[k]);
+					vmin = _mm_blendv_epi8 (vmin, forMin, _mm_cmpgt_epi64 (vmin, forMin));
+					vmax = _mm_blendv_epi8 (vmax, forMax, _mm_cmpgt_epi64 (forMax, vmax));
+				}
+			}
+			int64_t mins[2];
+			int64_t maxs[2];
+			_mm_storeu_si128 (reinterpret_cast<__m128i*> (mins), vmin);
+			_mm_storeu_si128 (reinterpret_cast<__m128i*> (maxs), vmax);
+			MinMax<int64_t> result = minMaxScalar (x, validity, i, n);
+			result.min = std::min ({result.min, mins[0], mins[1]});
+			result.max = std::max ({result.max, maxs[0], maxs[1]});
+			return result;
+		}
+
+		JLU_TARGET_SSE42 static MinMax<double> minMaxF64Sse42 (const double* x,
+																const uint8_t* validity,
+																size_t n) {
+			const __m128d high = _mm_set1_pd (highest<double> ());
+			const __m128d low = _mm_set1_pd (lowest<double> ());
+			__m128d vmin = high;
+			__m128d vmax = low;
+			size_t count = 0;
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m128i m[4] = {_mm_set1_epi64x (-1), _mm_set1_epi64x (-1), _mm_set1_epi64x (-1),
+								_mm_set1_epi64x (-1)};
+				if (validity != nullptr) {
+					masksSse42 (validity[i >> 3], m);
+				}
+				for (int k = 0; k < 4; k++) {
+					__m128d v = _mm_loadu_pd (x + i + 2 * k);
+					__m128d mask = _mm_castsi128_pd (m[k]);
+					// NaN lanes are ignored: min/max return the second operand for them.
+					vmin = _mm_min_pd (_mm_blendv_pd (high, v, mask), vmin);
+					vmax = _mm_max_pd (_mm_blendv_pd (low, v, mask), vmax);
+					count += popcount64 (_mm_movemask_pd (_mm_and_pd (_mm_cmpord_pd (v, v), mask)));
+				}
+			}
+			double mins[2];
+			double maxs[2];
+			_mm_storeu_pd (mins, vmin);
+			_mm_storeu_pd (maxs, vmax);
+			MinMax<double> result = minMaxScalar (x, validity, i, n);
+			result.min = std::min ({result.min, mins[0], mins[1]});
+			result.max = std::max ({result.max, maxs[0], maxs[1]});
+			result.count += count;
+			return result;
+		}
+
+		JLU_TARGET_SSE42 static double sumSqDiffSse42 (const double* x,
+													   const uint8_t* validity,
+													   size_t n,
+													   double mean) {
+			const __m128d vmean = _mm_set1_pd (mean);
+			__m128d acc = _mm_setzero_pd ();
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m128i m[4] = {_mm_set1_epi64x (-1), _mm_set1_epi64x (-1), _mm_set1_epi64x (-1),
+								_mm_set1_epi64x (-1)};
+				if (validity != nullptr) {
+					masksSse42 (validity[i >> 3], m);
+				}
+				for (int k = 0; k < 4; k++) {
+					__m128d v = _mm_loadu_pd (x + i + 2 * k);
+					__m128d mask = _mm_and_pd (_mm_cmpord_pd (v, v), _mm_castsi128_pd (m[k]));
+					__m128d d = _mm_sub_pd (v, vmean);
+					acc = _mm_add_pd (acc, _mm_and_pd (_mm_mul_pd (d, d), mask));
+				}
+			}
+			double lanes[2];
+			_mm_storeu_pd (lanes, acc);
+			return lanes[0] + lanes[1] + sumSqDiffScalar (x, validity, i, n, mean);
+		}
+
+		template <CompareOp Op>
+		JLU_TARGET_SSE42 static inline __m128i testSse42 (__m128i a, __m128i b) {
+			const __m128i ones = _mm_set1_epi64x (-1);
+			if constexpr (Op == CompareOp::Eq) {
+				return _mm_cmpeq_epi64 (a, b);
+			} else if constexpr (Op == CompareOp::Ne) {
+				return _mm_xor_si128 (_mm_cmpeq_epi64 (a, b), ones);
+			} else if constexpr (Op == CompareOp::Lt) {
+				return _mm_cmpgt_epi64 (b, a);
+			} else if constexpr (Op == CompareOp::Le) {
+				return _mm_xor_si128 (_mm_cmpgt_epi64 (a, b), ones);
+			} else if constexpr (Op == CompareOp::Gt) {
+				return _mm_cmpgt_epi64 (a, b);
+			} else {
+				return _mm_xor_si128 (_mm_cmpgt_epi64 (b, a), ones);
+			}
+		}
+
+		template <CompareOp Op>
+		JLU_TARGET_SSE42 static inline __m128d testSse42 (__m128d a, __m128d b) {
+			if constexpr (Op == CompareOp::Eq) {
+				return _mm_cmpeq_pd (a, b);
+			} else if constexpr (Op == CompareOp::Ne) {
+				return _mm_cmpneq_pd (a, b);
+			} else if constexpr (Op == CompareOp::Lt) {
+				return _mm_cmplt_pd (a, b);
+			} else if constexpr (Op == CompareOp::Le) {
+				return _mm_cmple_pd (a, b);
+			} else if constexpr (Op == CompareOp::Gt) {
+				return _mm_cmpgt_pd (a, b);
+			} else {
+				return _mm_cmpge_pd (a, b);
+			}
+		}
+
+		template <CompareOp Op>
+		JLU_TARGET_SSE42 static size_t compareI64Sse42 (const int64_t* x,
+														const uint8_t* validity,
+														size_t n,
+														int64_t rhs,
+														uint8_t* out) {
+			const __m128i r = _mm_set1_epi64x (rhs);
+			size_t matches = 0;
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				int bits = 0;
+				for (int k = 0; k < 4; k++) {
+					__m128i v = _mm_loadu_si128 (reinterpret_cast<const __m128i*> (x + i + 2 * k));
+					bits |= _mm_movemask_pd (_mm_castsi128_pd (testSse42<Op> (v, r))) << (2 * k);
+				}
+				uint8_t byte = static_cast<uint8_t> (bits);
+				if (validity != nullptr) {
+					byte &= validity[i >> 3];
+				}
+				out[i >> 3] = byte;
+				matches += popcount64 (byte);
+			}
+			return matches + compareScalar<Op> (x, validity, i, n, rhs, out);
+		}
+
+		template <CompareOp Op>
+		JLU_TARGET_SSE42 static size_t compareF64Sse42 (const double* x,
+														const uint8_t* validity,
+														size_t n,
+														double rhs,
+														uint8_t* out) {
+			const __m128d r = _mm_set1_pd (rhs);
+			size_t matches = 0;
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				int bits = 0;
+				for (int k = 0; k < 4; k++) {
+					bits |= _mm_movemask_pd (testSse42<Op> (_mm_loadu_pd (x + i + 2 * k), r)) << (2 * k);
+				}
+				uint8_t byte = static_cast<uint8_t> (bits);
+				if (validity != nullptr) {
+					byte &= validity[i >> 3];
+				}
+				out[i >> 3] = byte;
+				matches += popcount64 (byte);
+			}
+			return matches + compareScalar<Op> (x, validity, i, n, rhs, out);
+		}
+
+		// AVX2 kernels >>
+		// 4 lanes of 64 bits. One validity byte covers 2 vectors.
+
+		JLU_TARGET_AVX2 static size_t countValidAvx2 (const uint8_t* validity, size_t n) {
+			return countValidScalar (validity, n);
+		}
+
+		JLU_TARGET_AVX2 static inline void masksAvx2 (uint8_t byte, __m256i& m0, __m256i& m1) {
+			const __m256i b = _mm256_set1_epi64x (byte);
+			const __m256i lo = _mm256_setr_epi64x (1, 2, 4, 8);
+			const __m256i hi = _mm256_setr_epi64x (16, 32, 64, 128);
+			m0 = _mm256_cmpeq_epi64 (_mm256_and_si256 (b, lo), lo);
+			m1 = _mm256_cmpeq_epi64 (_mm256_and_si256 (b, hi), hi);
+		}
+
+		JLU_TARGET_AVX2 static int64_t sumI64Avx2 (const int64_t* x, const uint8_t* validity, size_t n) {
+			__m256i acc0 = _mm256_setzero_si256 ();
+			__m256i acc1 = _mm256_setzero_si256 ();
+			size_t i = 0;
+			if (validity == nullptr) {
+				for (; i + 8 <= n; i += 8) {
+					acc0 = _mm256_add_epi64 (acc0, _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (x + i)));
+					acc1 = _mm256_add_epi64 (acc1,
+											 _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (x + i + 4)));
+				}
+			} else {
+				for (; i + 8 <= n; i += 8) {
+					__m256i m0;
+					__m256i m1;
+					masksAvx2 (validity[i >> 3], m0, m1);
+					__m256i v0 = _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (x + i));
+					__m256i v1 = _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (x + i + 4));
+					acc0 = _mm256_add_epi64 (acc0, _mm256_and_si256 (v0, m0));
+					acc1 = _mm256_add_epi64 (acc1, _mm256_and_si256 (v1, m1));
+				}
+			}
+			int64_t lanes[4];
+			_mm256_storeu_si256 (reinterpret_cast<__m256i*> (lanes), _mm256_add_epi64 (acc0, acc1));
+			uint64_t total = 0;
+			for (int64_t lane : lanes) {
+				total += static_cast<uint64_t> (lane);
+			}
+			return static_cast<int64_t> (total + static_cast<uint64_t> (sumScalar (x, validity, i, n)));
+		}
+
+		// NaN lanes are masked out (_CMP_ORD_Q) and not counted.
+		JLU_TARGET_AVX2 static double sumF64Avx2 (const double* x,
+												  const uint8_t* validity,
+												  size_t n,
+												  size_t& count) {
+			__m256d acc0 = _mm256_setzero_pd ();
+			__m256d acc1 = _mm256_setzero_pd ();
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m256d v0 = _mm256_loadu_pd (x + i);
+				__m256d v1 = _mm256_loadu_pd (x + i + 4);
+				__m256d mask0 = _mm256_cmp_pd (v0, v0, _CMP_ORD_Q);
+				__m256d mask1 = _mm256_cmp_pd (v1, v1, _CMP_ORD_Q);
+				if (validity != nullptr) {
+					__m256i m0;
+					__m256i m1;
+					masksAvx2 (validity[i >> 3], m0, m1);
+					mask0 = _mm256_and_pd (mask0, _mm256_castsi256_pd (m0));
+					mask1 = _mm256_and_pd (mask1, _mm256_castsi256_pd (m1));
+				}
+				acc0 = _mm256_add_pd (acc0, _mm256_and_pd (v0, mask0));
+				acc1 = _mm256_add_pd (acc1, _mm256_and_pd (v1, mask1));
+				count += popcount64 (_mm256_movemask_pd (mask0) | (_mm256_movemask_pd (mask1) << 4));
+			}
+			double lanes[4];
+			_mm256_storeu_pd (lanes, _mm256_add_pd (acc0, acc1));
+			return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + sumScalar (x, validity, i, n, &count);
+		}
+
+		JLU_TARGET_AVX2 static MinMax<int64_t> minMaxI64Avx2 (const int64_t* x,
+															   const uint8_t* validity,
+															   size_t n) {
+			const __m256i high = _mm256_set1_epi64x (highest<int64_t> ());
+			const __m256i low = _mm256_set1_epi64x (lowest<int64_t> ());
+			__m256i vmin = high;
+			__m256i vmax = low;
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m256i m[2] = {_mm256_set1_epi64x (-1), _mm256_set1_epi64x (-1)};
+				if (validity != nullptr) {
+					masksAvx2 (validity[i >> 3], m[0], m[1]);
+				}
+				for (int k = 0; k < 2; k++) {
+					__m256i v = _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (x + i + 4 * k));
+					__m256i forMin = _mm256_blendv_epi8 (high, v, m[k]);
+					__m256i forMax = _mm256_blendv_epi8 (low, v, m[k]);
+					vmin = _mm256_blendv_epi8 (vmin, forMin, _mm256_cmpgt_epi64 (vmin, forMin));
+					vmax = _mm256_blendv_epi8 (vmax, forMax, _mm256_cmpgt_epi64 (forMax, vmax));
+				}
+			}
+			int64_t mins[4];
+			int64_t maxs[4];
+			_mm256_storeu_si256 (reinterpret_cast<__m256i*> (mins), vmin);
+			_mm256_storeu_si256 (reinterpret_cast<__m256i*> (maxs), vmax);
+			MinMax<int64_t> result = minMaxScalar (x, validity, i, n);
+			result.min = std::min ({result.min, mins[0], mins[1], mins[2], mins[3]});
+			result.max = std::max ({result.max, maxs[0], maxs[1], maxs[2], maxs[3]});
+			return result;
+		}
+
+		JLU_TARGET_AVX2 static MinMax<double> minMaxF64Avx2 (const double* x,
+															  const uint8_t* validity,
+															  size_t n) {
+			const __m256d high = _mm256_set1_pd (highest<double> ());
+			const __m256d low = _mm256_set1_pd (lowest<double> ());
+			__m256d vmin = high;
+			__m256d vmax = low;
+			size_t count = 0;
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m256i m[2] = {_mm256_set1_epi64x (-1), _mm256_set1_epi64x (-1)};
+				if (validity != nullptr) {
+					masksAvx2 (validity[i >> 3], m[0], m[1]);
+				}
+				for (int k = 0; k < 2; k++) {
+					__m256d v = _mm256_loadu_pd (x + i + 4 * k);
+					__m256d mask = _mm256_castsi256_pd (m[k]);
+					vmin = _mm256_min_pd (_mm256_blendv_pd (high, v, mask), vmin);
+					vmax = _mm256_max_pd (_mm256_blendv_pd (low, v, mask), vmax);
+					count += popcount64 (_mm256_movemask_pd (_mm256_and_pd (_mm256_cmp_pd (v, v, _CMP_ORD_Q), mask)));
+				}
+			}
+			double mins[4];
+			double maxs[4];
+			_mm256_storeu_pd (mins, vmin);
+			_mm256_storeu_pd (maxs, vmax);
+			MinMax<double> result = minMaxScalar (x, validity, i, n);
+			result.min = std::min ({result.min, mins[0], mins[1], mins[2], mins[3]});
+			result.max = std::max ({result.max, maxs[0], maxs[1], maxs[2], maxs[3]});
+			result.count += count;
+			return result;
+		}
+
+		JLU_TARGET_AVX2 static double sumSqDiffAvx2 (const double* x,
+													 const uint8_t* validity,
+													 size_t n,
+													 double mean) {
+			const __m256d vmean = _mm256_set1_pd (mean);
+			__m256d acc0 = _mm256_setzero_pd ();
+			__m256d acc1 = _mm256_setzero_pd ();
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m256i m0 = _mm256_set1_epi64x (-1);
+				__m256i m1 = m0;
+				if (validity != nullptr) {
+					masksAvx2 (validity[i >> 3], m0, m1);
+				}
+				__m256d v0 = _mm256_loadu_pd (x + i);
+				__m256d v1 = _mm256_loadu_pd (x + i + 4);
+				__m256d mask0 = _mm256_and_pd (_mm256_cmp_pd (v0, v0, _CMP_ORD_Q), _mm256_castsi256_pd (m0));
+				__m256d mask1 = _mm256_and_pd (_mm256_cmp_pd (v1, v1, _CMP_ORD_Q), _mm256_castsi256_pd (m1));
+				__m256d d0 = _mm256_sub_pd (v0, vmean);
+				__m256d d1 = _mm256_sub_pd (v1, vmean);
+				acc0 = _mm256_add_pd (acc0, _mm256_and_pd (_mm256_mul_pd (d0, d0), mask0));
+				acc1 = _mm256_add_pd (acc1, _mm256_and_pd (_mm256_mul_pd (d1, d1), mask1));
+			}
+			double lanes[4];
+			_mm256_storeu_pd (lanes, _mm256_add_pd (acc0, acc1));
+			return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) +
+				   sumSqDiffScalar (x, validity, i, n, mean);
+		}
+
+		template <CompareOp Op>
+		JLU_TARGET_AVX2 static inline __m256i testAvx2 (__m256i a, __m256i b) {
+			const __m256i ones = _mm256_set1_epi64x (-1);
+			if constexpr (Op == CompareOp::Eq) {
+				return _mm256_cmpeq_epi64 (a, b);
+			} else if constexpr (Op == CompareOp::Ne) {
+				return _mm256_xor_si256 (_mm256_cmpeq_epi64 (a, b), ones);
+			} else if constexpr (Op == CompareOp::Lt) {
+				return _mm256_cmpgt_epi64 (b, a);
+			} else if constexpr (Op == CompareOp::Le) {
+				return _mm256_xor_si256 (_mm256_cmpgt_epi64 (a, b), ones);
+			} else if constexpr (Op == CompareOp::Gt) {
+				return _mm256_cmpgt_epi64 (a, b);
+			} else {
+				return _mm256_xor_si256 (_mm256_cmpgt_epi64 (b, a), ones);
+			}
+		}
+
+		template <CompareOp Op>
+		JLU_TARGET_AVX2 static inline __m256d testAvx2 (__m256d a, __m256d b) {
+			if constexpr (Op == CompareOp::Eq) {
+				return _mm256_cmp_pd (a, b, _CMP_EQ_OQ);
+			} else if constexpr (Op == CompareOp::Ne) {
+				return _mm256_cmp_pd (a, b, _CMP_NEQ_UQ);
+			} else if constexpr (Op == CompareOp::Lt) {
+				return _mm256_cmp_pd (a, b, _CMP_LT_OQ);
+			} else if constexpr (Op == CompareOp::Le) {
+				return _mm256_cmp_pd (a, b, _CMP_LE_OQ);
+			} else if constexpr (Op == CompareOp::Gt) {
+				return _mm256_cmp_pd (a, b, _CMP_GT_OQ);
+			} else {
+				return _mm256_cmp_pd (a, b, _CMP_GE_OQ);
+			}
+		}
+
+		template <CompareOp Op>
+		JLU_TARGET_AVX2 static size_t compareI64Avx2 (const int64_t* x,
+													  const uint8_t* validity,
+													  size_t n,
+													  int64_t rhs,
+													  uint8_t* out) {
+			const __m256i r = _mm256_set1_epi64x (rhs);
+			size_t matches = 0;
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				__m256i v0 = _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (x + i));
+				__m256i v1 = _mm256_loadu_si256 (reinterpret_cast<const __m256i*> (x + i + 4));
+				int lo = _mm256_movemask_pd (_mm256_castsi256_pd (testAvx2<Op> (v0, r)));
+				int hi = _mm256_movemask_pd (_mm256_castsi256_pd (testAvx2<Op> (v1, r)));
+				uint8_t byte = static_cast<uint8_t> (lo | (hi << 4));
+				if (validity != nullptr) {
+					byte &= validity[i >> 3];
+				}
+				out[i >> 3] = byte;
+				matches += popcount64 (byte);
+			}
+			return matches + compareScalar<Op> (x, validity, i, n, rhs, out);
+		}
+
+		template <CompareOp Op>
+		JLU_TARGET_AVX2 static size_t compareF64Avx2 (const double* x,
+													  const uint8_t* validity,
+													  size_t n,
+													  double rhs,
+													  uint8_t* out) {
+			const __m256d r = _mm256_set1_pd (rhs);
+			size_t matches = 0;
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8) {
+				int lo = _mm256_movemask_pd (testAvx2<Op> (_mm256_loadu_pd (x + i), r));
+				int hi = _mm256_movemask_pd (testAvx2<Op> (_mm256_loadu_pd (x + i + 4), r));
+				uint8_t byte = static_cast<uint8_t> (lo | (hi << 4));
+				if (validity != nullptr) {
+					byte &= validity[i >> 3];
+				}
+				out[i >> 3] = byte;
+				matches += popcount64 (byte);
+			}
+			return matches + compareScalar<Op> (x, validity, i, n, rhs, out);
+		}
+#endif	 // JLU_KERNELS_X86
+
+		static double sumSqDiff (const double* x, const uint8_t* validity, size_t n, double mean) {
+#ifdef JLU_KERNELS_X86
+			switch (activeIsa ()) {
+				case Isa::Avx2: return sumSqDiffAvx2 (x, validity, n, mean);
+				case Isa::Sse42: return sumSqDiffSse42 (x, validity, n, mean);
+				default: break;
+			}
+#endif
+			return sumSqDiffScalar (x, validity, 0, n, mean);
+		}
+
+		// Sum of the valid values other than NaN, and their number.
+		static double sumNumbers (const double* x, const uint8_t* validity, size_t n, size_t& count) {
+			count = 0;
+#ifdef JLU_KERNELS_X86
+			switch (activeIsa ()) {
+				case Isa::Avx2: return sumF64Avx2 (x, validity, n, count);
+				case Isa::Sse42: return sumF64Sse42 (x, validity, n, count);
+				default: break;
+			}
+#endif
+			return sumScalar (x, validity, 0, n, &count);
+		}
+
+		static Moments makeMoments (size_t count, double mean, double squares) {
+			Moments result{count, mean, 0.0, 0.0};
+			if (count > 0) {
+				result.variance = squares / count;
+			}
+			if (count > 1) {
+				result.sampleVariance = squares / (count - 1);
+			}
+			return result;
+		}
+
+		// Public functions >>
+
+		/**
+		 * @brief Best instruction set of the CPU among the ones the kernels have.
+		 */
+		Isa detectedIsa () {
+#ifdef JLU_KERNELS_X86
+			static const Isa detected = [] {
+				__builtin_cpu_init ();
+				if (__builtin_cpu_supports ("avx2")) {
+					return Isa::Avx2;
+				}
+				if (__builtin_cpu_supports ("sse4.2") && __builtin_cpu_supports ("popcnt")) {
+					return Isa::Sse42;
+				}
+				return Isa::Scalar;
+			}();
+			return detected;
+#else
+			return Isa::Scalar;
+#endif
+		}
+
+		/**
+		 * @brief Instruction set the kernels are using: the detected one unless forceIsa()
+		 * chose a lower one.
+		 */
+		Isa activeIsa () {
+			int isa = selectedIsa.load (std::memory_order_relaxed);
+			return (isa < 0) ? detectedIsa () : static_cast<Isa> (isa);
+		}
+
+		/**
+		 * @brief Choose the instruction set of the kernels, e.g. to compare them in benchmarks.
+		 *
+		 * @param isa Wanted instruction set. It is lowered to detectedIsa() if the CPU does
+		 * not support it.
+		 * @return Isa The instruction set that will be used.
+		 */
+		Isa forceIsa (Isa isa) {
+			Isa effective = std::min (isa, detectedIsa ());
+			selectedIsa.store (static_cast<int> (effective));
+			return effective;
+		}
+
+		/**
+		 * @brief Printable name of an instruction set.
+		 */
+		const char* isaName (Isa isa) {
+			switch (isa) {
+				case Isa::Avx2: return "avx2";
+				case Isa::Sse42: return "sse4.2";
+				default: return "scalar";
+			}
+		}
+
+		/**
+		 * @brief Number of valid (not NULL) values.
+		 *
+		 * @param validity Validity bitmap, or nullptr if all values are valid.
+		 * @param n Number of values.
+		 */
+		size_t countValid (const uint8_t* validity, size_t n) {
+			if (validity == nullptr) {
+				return n;
+			}
+#ifdef JLU_KERNELS_X86
+			switch (activeIsa ()) {
+				case Isa::Avx2: return countValidAvx2 (validity, n);
+				case Isa::Sse42: return countValidSse42 (validity, n);
+				default: break;
+			}
+#endif
+			return countValidScalar (validity, n);
+		}
+
+		/**
+		 * @brief Intersection of two bitmaps, e.g. a validity bitmap and a predicate result.
+		 * Either input can be nullptr, meaning all ones.
+		 *
+		 * @param out Destination bitmap of (n + 7) / 8 bytes. It can be one of the inputs.
+		 */
+		void bitmapAnd (const uint8_t* a, const uint8_t* b, uint8_t* out, size_t n) {
+			size_t bytes = (n + 7) / 8;
+			for (size_t i = 0; i < bytes; i++) {
+				out[i] = (a != nullptr ? a[i] : 0xFF) & (b != nullptr ? b[i] : 0xFF);
+			}
+		}
+
+		/**
+		 * @brief Sum of the valid values. Overflow wraps around.
+		 *
+		 * @param values Column values, e.g. the buffers[1] of an Arrow int64 array.
+		 * @param validity Validity bitmap, or nullptr. A predicate bitmap from compare()
+		 * gives a filtered sum.
+		 * @param n Number of values.
+		 */
+		int64_t sum (const int64_t* values, const uint8_t* validity, size_t n) {
+#ifdef JLU_KERNELS_X86
+			switch (activeIsa ()) {
+				case Isa::Avx2: return sumI64Avx2 (values, validity, n);
+				case Isa::Sse42: return sumI64Sse42 (values, validity, n);
+				default: break;
+			}
+#endif
+			return sumScalar (values, validity, 0, n);
+		}
+
+		/**
+		 * @brief Sum of the valid values. NaN values are skipped. The SIMD paths add in a
+		 * different order than the scalar one, so the last bits of the result may differ.
+		 *
+		 * @see sum (const int64_t*, const uint8_t*, size_t)
+		 */
+		double sum (const double* values, const uint8_t* validity, size_t n) {
+			size_t count = 0;
+			return sumNumbers (values, validity, n, count);
+		}
+
+		/**
+		 * @brief Minimum, maximum and number of the valid values. min and max are 0 when
+		 * there are no valid values.
+		 */
+		MinMax<int64_t> minMax (const int64_t* values, const uint8_t* validity, size_t n) {
+			MinMax<int64_t> result;
+#ifdef JLU_KERNELS_X86
+			switch (activeIsa ()) {
+				case Isa::Avx2: result = minMaxI64Avx2 (values, validity, n); break;
+				case Isa::Sse42: result = minMaxI64Sse42 (values, validity, n); break;
+				default: result = minMaxScalar (values, validity, 0, n); break;
+			}
+#else
+			result = minMaxScalar (values, validity, 0, n);
+#endif
+			result.count = countValid (validity, n);
+			if (result.count == 0) {
+				result.min = result.max = 0;
+			}
+			return result;
+		}
+
+		/**
+		 * @brief Minimum, maximum and number of the valid values. NaN values are skipped and
+		 * not counted. min and max are 0 when no valid value other than NaN remains.
+		 */
+		MinMax<double> minMax (const double* values, const uint8_t* validity, size_t n) {
+			MinMax<double> result;
+#ifdef JLU_KERNELS_X86
+			switch (activeIsa ()) {
+				case Isa::Avx2: result = minMaxF64Avx2 (values, validity, n); break;
+				case Isa::Sse42: result = minMaxF64Sse42 (values, validity, n); break;
+				default: result = minMaxScalar (values, validity, 0, n); break;
+			}
+#else
+			result = minMaxScalar (values, validity, 0, n);
+#endif
+			if (result.count == 0) {
+				result.min = result.max = 0.0;
+			}
+			return result;
+		}
+
+		/**
+		 * @brief Count, mean and variance of the valid values, in two passes for accuracy.
+		 * Integers are converted to double in blocks.
+		 */
+		Moments moments (const int64_t* values, const uint8_t* validity, size_t n) {
+			size_t count = countValid (validity, n);
+			if (count == 0) {
+				return makeMoments (0, 0.0, 0.0);
+			}
+			double mean = static_cast<double> (sum (values, validity, n)) / count;
+
+			const size_t blockSize = 1024;	 // multiple of 8, so the bitmap stays byte aligned
+			double block[blockSize];
+			double squares = 0.0;
+			for (size_t start = 0; start < n; start += blockSize) {
+				size_t len = std::min (blockSize, n - start);
+				for (size_t i = 0; i < len; i++) {
+					block[i] = static_cast<double> (values[start + i]);
+				}
+				squares += sumSqDiff (block, validity != nullptr ? validity + start / 8 : nullptr, len, mean);
+			}
+			return makeMoments (count, mean, squares);
+		}
+
+		/**
+		 * @brief Count, mean and variance of the valid values, in two passes for accuracy.
+		 * NaN values are skipped and not counted.
+		 */
+		Moments moments (const double* values, const uint8_t* validity, size_t n) {
+			size_t count = 0;
+			double total = sumNumbers (values, validity, n, count);
+			if (count == 0) {
+				return makeMoments (0, 0.0, 0.0);
+			}
+			double mean = total / count;
+			return makeMoments (count, mean, sumSqDiff (values, validity, n, mean));
+		}
+
+		/**
+		 * @brief Compare every value with a constant and write the result as a bitmap.
+		 *
+		 * NULL values (validity bit 0) never match. The bitmap can be used as the validity of
+		 * the other kernels to compute filtered aggregates.
+		 *
+		 * @param out Destination bitmap of (n + 7) / 8 bytes.
+		 * @return size_t Number of matches.
+		 */
+		size_t compare (const int64_t* values,
+						const uint8_t* validity,
+						size_t n,
+						CompareOp op,
+						int64_t rhs,
+						uint8_t* out) {
+			Isa isa = activeIsa ();
+			return withOp (op, [&] (auto c) -> size_t {
+				constexpr CompareOp Op = decltype (c)::value;
+#ifdef JLU_KERNELS_X86
+				if (isa == Isa::Avx2) {
+					return compareI64Avx2<Op> (values, validity, n, rhs, out);
+				} else if (isa == Isa::Sse42) {
+					return compareI64Sse42<Op> (values, validity, n, rhs, out);
+				}
+#endif
+				(void)isa;
+				return compareScalar<Op> (values, validity, 0, n, rhs, out);
+			});
+		}
+
+		/**
+		 * @brief Compare every value with a constant and write the result as a bitmap. NaN
+		 * values only match CompareOp::Ne.
+		 *
+		 * @see compare (const int64_t*, const uint8_t*, size_t, CompareOp, int64_t, uint8_t*)
+		 */
+		size_t compare (const double* values,
+						const uint8_t* validity,
+						size_t n,
+						CompareOp op,
+						double rhs,
+						uint8_t* out) {
+			Isa isa = activeIsa ();
+			return withOp (op, [&] (auto c) -> size_t {
+				constexpr CompareOp Op = decltype (c)::value;
+#ifdef JLU_KERNELS_X86
+				if (isa == Isa::Avx2) {
+					return compareF64Avx2<Op> (values, validity, n, rhs, out);
+				} else if (isa == Isa::Sse42) {
+					return compareF64Sse42<Op> (values, validity, n, rhs, out);
+				}
+#endif
+				(void)isa;
+				return compareScalar<Op> (values, validity, 0, n, rhs, out);
+			});
+		}
+	}	// namespace kernels
+}	// namespace jlu
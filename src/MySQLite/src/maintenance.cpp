@@ -0,0 +1,323 @@
+#include "../include/maintenance.h"
+
+namespace jlu {
+	/**
+	 * @brief Creates the maintenance component of a database. It does nothing until start()
+	 * is called.
+	 *
+	 * @param database The connection to maintain. It must outlive the maintenance object.
+	 * @param options Slice size, idle detection and optimize schedule.
+	 */
+	Maintenance::Maintenance (MySQLite& database, const MaintenanceOptions& options)
+		: database (database),
+		  options (options),
+		  conn (nullptr),
+		  stopping (false),
+		  running (false),
+		  dataVersion (-1),
+		  previousBusyTimeout (-1) {}
+
+	/**
+	 * @brief Stop the background thread, if any, and destroy the object.
+	 *
+	 * In case of error show a message in standard output.
+	 */
+	Maintenance::~Maintenance () {
+		try {
+			stop ();
+		} catch (std::exception& e) {
+			std::cerr << "Error at try stop maintenance in destructor method. Desc.: " << e.what ()
+					  << std::endl;
+		}
+	}
+
+	/**
+	 * @brief Turn on auto_vacuum=INCREMENTAL if the database file is still empty.
+	 *
+	 * The auto_vacuum mode can only be chosen before the first table is created, changing it
+	 * later needs a full VACUUM. So call it right after open a new file.
+	 *
+	 * @param database An open database.
+	 * @return bool True if the database is in incremental auto_vacuum mode.
+	 * @throw std::runtime_error if the SQL statements fail.
+	 */
+	bool Maintenance::enableIncrementalVacuum (MySQLite& database) {
+		std::vector<sqlRow> result;
+		database.exec ("PRAGMA page_count;", result);
+		if (!result.empty () && std::get<int> (result[0]["page_count"]) == 0) {
+			database.exec ("PRAGMA auto_vacuum=INCREMENTAL;");
+		}
+		database.exec ("PRAGMA auto_vacuum;", result);
+		return (!result.empty () && std::get<int> (result[0]["auto_vacuum"]) == 2);
+	}
+
+	/**
+	 * @brief Start the maintenance thread.
+	 *
+	 * Every options.sliceInterval the thread checks PRAGMA data_version. When nobody has
+	 * committed for options.idleDelay it runs one slice: PRAGMA optimize if
+	 * options.optimizeInterval has elapsed, otherwise PRAGMA incremental_vacuum of at most
+	 * options.pagesPerSlice pages. The private connection never waits for locks, so a slice
+	 * that meets a writer is skipped instead of delaying it.
+	 *
+	 * A write of the watched connection that arrives during a slice has to wait for it, so
+	 * its busy timeout is raised to options.foregroundBusyTimeoutMs if it is lower (a busy
+	 * handler set with sqlite3_busy_handler is replaced), and restored by stop().
+	 *
+	 * @return bool True if the thread was started, false if it was already running.
+	 * @throw std::runtime_error if the database is not open, is not a file or the private
+	 * connection can not be open.
+	 */
+	bool Maintenance::start () {
+		if (running) {
+			return false;
+		}
+
+		sqlite3* handle = database.getHandle ();
+		if (handle == nullptr) {
+			throw std::runtime_error ("Maintenance: the database is not open");
+		}
+
+		const char* fileName = sqlite3_db_filename (handle, "main");
+		if (fileName == nullptr || fileName[0] == '\0') {
+			throw std::runtime_error ("Maintenance: the database must be an on disk file");
+		}
+
+		int status = sqlite3_open_v2 (fileName, &conn, SQLITE_OPEN_READWRITE, nullptr);
+		if (status != SQLITE_OK) {
+			std::string error ("Maintenance: unable to open DB. Error: ");
+			error += sqlite3_errmsg (conn);
+			sqlite3_close (conn);
+			conn = nullptr;
+			throw std::runtime_error (error);
+		}
+		sqlite3_busy_timeout (conn, 0);
+
+		std::vector<sqlRow> result;
+		database.exec ("PRAGMA busy_timeout;", result);
+		int busyTimeout = result.empty () ? 0 : std::get<int> (result[0]["timeout"]);
+		previousBusyTimeout = -1;
+		if (busyTimeout < options.foregroundBusyTimeoutMs) {
+			previousBusyTimeout = busyTimeout;
+			sqlite3_busy_timeout (handle, options.foregroundBusyTimeoutMs);
+		}
+
+		dataVersion = -1;
+		lastChange = std::chrono::steady_clock::now ();
+		lastOptimize = lastChange;
+		stopping = false;
+		running = true;
+		worker = std::thread (&Maintenance::run, this);
+		return true;
+	}
+
+	/**
+	 * @brief Stop the maintenance thread. A slice in progress is finished first.
+	 *
+	 * @return bool True if the thread was running and has been stopped.
+	 */
+	bool Maintenance::stop () {
+		if (!running) {
+			return false;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock (mtx);
+			stopping = true;
+		}
+		wakeUp.notify_all ();
+		worker.join ();
+
+		sqlite3_close (conn);
+		conn = nullptr;
+		if (previousBusyTimeout >= 0 && database.getHandle () != nullptr) {
+			sqlite3_busy_timeout (database.getHandle (), previousBusyTimeout);
+		}
+		previousBusyTimeout = -1;
+		running = false;
+		return true;
+	}
+
+	/**
+	 * @brief Check if the maintenance thread is running
+	 *
+	 * @return true If start() was called and stop() was not.
+	 */
+	bool Maintenance::isRunning () { return running; }
+
+	/**
+	 * @brief Run one PRAGMA incremental_vacuum slice right now, from the calling thread.
+	 *
+	 * @return bool True if pages were given back to the file system. False if the database
+	 * is not in incremental mode, has less than options.minFreePages free pages or is busy.
+	 * @throw std::runtime_error if sqlite3 reports any other error.
+	 */
+	bool Maintenance::vacuumSlice () {
+		if (!running) {
+			return false;
+		}
+
+		std::lock_guard<std::mutex> connLock (connMtx);
+		int freeBefore = -1;
+		int autoVacuum = -1;
+		if (!pragmaInt ("PRAGMA freelist_count;", freeBefore) ||
+			!pragmaInt ("PRAGMA auto_vacuum;", autoVacuum)) {
+			countBusySkip ();
+			return false;
+		}
+		if (autoVacuum != 2 || freeBefore < options.minFreePages) {
+			std::lock_guard<std::mutex> lock (mtx);
+			stats.freePages = std::max (freeBefore, 0);
+			return false;
+		}
+
+		std::string query ("PRAGMA incremental_vacuum(" + std::to_string (options.pagesPerSlice) + ");");
+		auto begin = std::chrono::steady_clock::now ();
+		int result = sqlite3_exec (conn, query.c_str (), nullptr, nullptr, nullptr);
+		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds> (
+			std::chrono::steady_clock::now () - begin);
+
+		if (SQLITE_BUSY == result || SQLITE_LOCKED == result) {
+			countBusySkip ();
+			return false;
+		} else if (SQLITE_OK != result) {
+			std::string errorMsg ("Incremental vacuum failed. Desc: ");
+			errorMsg += sqlite3_errmsg (conn);
+			throw std::runtime_error (errorMsg);
+		}
+
+		int freeAfter = -1;
+		pragmaInt ("PRAGMA freelist_count;", freeAfter);
+		std::lock_guard<std::mutex> lock (mtx);
+		stats.vacuumSlices++;
+		if (freeAfter >= 0 && freeAfter < freeBefore) {
+			stats.pagesReclaimed += freeBefore - freeAfter;
+		}
+		stats.freePages = std::max (freeAfter, 0);
+		stats.lastSliceDuration = elapsed;
+		stats.maxSliceDuration = std::max (stats.maxSliceDuration, elapsed);
+		return true;
+	}
+
+	/**
+	 * @brief Run PRAGMA optimize right now, from the calling thread.
+	 *
+	 * PRAGMA analysis_limit is set to options.analysisLimit first, so the ANALYZE that
+	 * optimize may launch only reads a bounded number of rows of each index.
+	 *
+	 * @return bool True if optimize finished, false if the database was busy.
+	 * @throw std::runtime_error if sqlite3 reports any other error.
+	 */
+	bool Maintenance::optimize () {
+		if (!running) {
+			return false;
+		}
+
+		std::lock_guard<std::mutex> connLock (connMtx);
+		std::string query ("PRAGMA analysis_limit=" + std::to_string (options.analysisLimit) +
+						   "; PRAGMA optimize;");
+		auto begin = std::chrono::steady_clock::now ();
+		int result = sqlite3_exec (conn, query.c_str (), nullptr, nullptr, nullptr);
+		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds> (
+			std::chrono::steady_clock::now () - begin);
+
+		if (SQLITE_BUSY == result || SQLITE_LOCKED == result) {
+			countBusySkip ();
+			return false;
+		} else if (SQLITE_OK != result) {
+			std::string errorMsg ("PRAGMA optimize failed. Desc: ");
+			errorMsg += sqlite3_errmsg (conn);
+			throw std::runtime_error (errorMsg);
+		}
+
+		std::lock_guard<std::mutex> lock (mtx);
+		stats.optimizeRuns++;
+		stats.lastOptimizeDuration = elapsed;
+		return true;
+	}
+
+	/**
+	 * @brief Copy of the maintenance metrics collected since the object was created.
+	 *
+	 * @return MaintenanceStats Slices, reclaimed pages, optimize runs and skips.
+	 */
+	MaintenanceStats Maintenance::getStats () {
+		std::lock_guard<std::mutex> lock (mtx);
+		return stats;
+	}
+
+	// Private methods >>
+
+	void Maintenance::run () {
+		std::unique_lock<std::mutex> lock (mtx);
+		while (!stopping) {
+			wakeUp.wait_for (lock, options.sliceInterval, [this] { return stopping; });
+			if (stopping) {
+				break;
+			}
+			lock.unlock ();
+
+			try {
+				if (isIdle ()) {
+					if (std::chrono::steady_clock::now () - lastOptimize >= options.optimizeInterval) {
+						optimize ();
+						lastOptimize = std::chrono::steady_clock::now ();
+					} else {
+						vacuumSlice ();
+					}
+				}
+			} catch (std::exception& e) { std::cerr << e.what () << std::endl; }
+
+			lock.lock ();
+		}
+	}
+
+	// Counts the skip when it is not idle: a busy skip if a writer holds the lock.
+	bool Maintenance::isIdle () {
+		std::lock_guard<std::mutex> connLock (connMtx);
+		int version = -1;
+		if (!pragmaInt ("PRAGMA data_version;", version)) {
+			countBusySkip ();
+			return false;
+		}
+		auto now = std::chrono::steady_clock::now ();
+		if (version != dataVersion || now - lastChange < options.idleDelay) {
+			// Only commits of other connections change data_version.
+			if (version != dataVersion) {
+				dataVersion = version;
+				lastChange = now;
+			}
+			std::lock_guard<std::mutex> lock (mtx);
+			stats.activeSkips++;
+			return false;
+		}
+		return true;
+	}
+
+	// False if the database is busy or locked, which the private connection does not wait
+	// for: reading the schema to compile the pragma can meet a writer too.
+	bool Maintenance::pragmaInt (const std::string& query, int& value) {
+		sqlite3_stmt* stmt = nullptr;
+		int stmtResult = sqlite3_prepare_v2 (conn, query.c_str (), -1, &stmt, nullptr);
+		if (SQLITE_BUSY == stmtResult || SQLITE_LOCKED == stmtResult) {
+			return false;
+		} else if (SQLITE_OK != stmtResult) {
+			std::string errorMsg ("Unable compile the SQL statement. Error code:" +
+								  std::to_string (stmtResult) + "\n");
+			throw std::runtime_error (errorMsg);
+		}
+
+		value = -1;
+		int rc = sqlite3_step (stmt);
+		if (SQLITE_ROW == rc) {
+			value = sqlite3_column_int (stmt, 0);
+		}
+		sqlite3_finalize (stmt);
+		return (SQLITE_BUSY != rc && SQLITE_LOCKED != rc);
+	}
+
+	void Maintenance::countBusySkip () {
+		std::lock_guard<std::mutex> lock (mtx);
+		stats.busySkips++;
+	}
+}	// namespace jlu
@@ -1,9 +1,23 @@
 #include "../include/mysqlite.h"
 
+#include <algorithm>
+
+#include "../include/autoparam.h"
+#include "../include/carray.h"
+#include "../include/transaction.h"
+
 namespace jlu {
+	// Same value sqlite3 uses when it is built without SQLITE_DEFAULT_WAL_AUTOCHECKPOINT.
+	static const int defaultWalAutoCheckpoint = 1000;
+
 	MySQLite::MySQLite () {
 		dbName = "";
 		db = nullptr;
+		nextListenerId = 0;
+		walAutoCheckpoint = defaultWalAutoCheckpoint;
+		committing = false;
+		runningStatement = nullptr;
+		savepointDepth = 0;
 	}
 
 	/**
@@ -14,7 +28,14 @@ namespace jlu {
 	 * on disk database. \n Otherwise dbFileName will be interpreted as a file.
 	 * @throw std::runtime_error if database can not be open
 	 */
-	MySQLite::MySQLite (const std::string& dbFileName) : db (nullptr), dbName ("") {
+	MySQLite::MySQLite (const std::string& dbFileName)
+		: db (nullptr),
+		  dbName (""),
+		  nextListenerId (0),
+		  walAutoCheckpoint (defaultWalAutoCheckpoint),
+		  committing (false),
+		  runningStatement (nullptr),
+		  savepointDepth (0) {
 		try {
 			if (open (dbFileName))
 				dbName = dbFileName;   // It is a valid database name.
@@ -43,19 +64,49 @@ namespace jlu {
 	 * @throw std::runtime_error if the SQL statement is wrong.
 	 */
 	bool MySQLite::exec (const std::string& query) {
-		bool output = false;
-		char* errmsg = 0;
-		int result = sqlite3_exec (db, query.c_str (), 0, 0, &errmsg);
-		if (SQLITE_OK == result || SQLITE_DONE == result) {
-			output = true;
-		} else {
-			std::string errorMsg ("Error in sql statement. Desc: ");
-			errorMsg += std::string (errmsg);
-			sqlite3_free (errmsg);
-			throw std::runtime_error (errorMsg);
+		sqlite3_stmt* stmt = (autoParams != nullptr) ? autoParams->acquire (db, query, false) : nullptr;
+		if (stmt != nullptr) {
+			int rc = 0;
+			while ((rc = sqlite3_step (stmt)) == SQLITE_ROW) {
+			}
+			if (SQLITE_DONE != rc) {
+				std::string errorMsg ("Error in sql statement. Desc: ");
+				errorMsg += sqlite3_errmsg (db);
+				statementFailed ();
+				autoParams->release (stmt);
+				throw std::runtime_error (errorMsg);
+			}
+			autoParams->release (stmt);
+			return true;
 		}
 
-		return output;
+		// What sqlite3_exec does, but it tells a statement that fails to compile from one
+		// that fails to run.
+		const char* sql = query.c_str ();
+		while (*sql != '\0') {
+			const char* tail = nullptr;
+			int rc = sqlite3_prepare_v2 (db, sql, -1, &stmt, &tail);
+			if (SQLITE_OK != rc) {
+				std::string errorMsg ("Error in sql statement. Desc: ");
+				errorMsg += sqlite3_errmsg (db);
+				throw std::runtime_error (errorMsg);
+			}
+			if (stmt == nullptr) {
+				break;
+			}
+			while ((rc = sqlite3_step (stmt)) == SQLITE_ROW) {
+			}
+			if (SQLITE_DONE != rc) {
+				std::string errorMsg ("Error in sql statement. Desc: ");
+				errorMsg += sqlite3_errmsg (db);
+				statementFailed ();
+				sqlite3_finalize (stmt);
+				throw std::runtime_error (errorMsg);
+			}
+			sqlite3_finalize (stmt);
+			sql = tail;
+		}
+		return true;
 	}
 
 	/**
@@ -81,7 +132,19 @@ namespace jlu {
 	 */
 	bool MySQLite::exec (const std::string& query, std::vector<sqlRow>& result) {
 		bool output = false;
-		sqlite3_stmt* stmt = NULL;
+		sqlite3_stmt* stmt = (autoParams != nullptr) ? autoParams->acquire (db, query, true) : nullptr;
+		if (stmt != nullptr) {
+			output = returnData (result, stmt, sqlite3_column_count (stmt));
+			if (!output) {
+				std::string errorMsg ("Error in sql statement. Desc: ");
+				errorMsg += sqlite3_errmsg (db);
+				autoParams->release (stmt);
+				throw std::runtime_error (errorMsg);
+			}
+			autoParams->release (stmt);
+			return output;
+		}
+
 		int stmtResult = sqlite3_prepare_v2 (db, query.c_str (), -1, &stmt, NULL);
 
 		if (SQLITE_OK != stmtResult) {
@@ -97,29 +160,308 @@ namespace jlu {
 		}
 
 		output = returnData (result, stmt, numCols);
+		if (!output) {
+			std::string errorMsg ("Error in sql statement. Desc: ");
+			errorMsg += sqlite3_errmsg (db);
+			sqlite3_finalize (stmt);
+			throw std::runtime_error (errorMsg);
+		}
+		sqlite3_finalize (stmt);
 		return output;
 	}
 
+	/**
+	 * @brief Execute a SQL statement and return its rows as compact values.
+	 *
+	 * Every cell is a 16 bytes jlu::Value: NULL, 64 bits integers, reals, and texts and blobs
+	 * of up to 14 bytes need no allocation. Read them by position, in the order of the
+	 * columns of the statement:
+	 * @code .cpp
+	 * std::vector<jlu::valueRow> rows;
+	 * db.query ("SELECT id, resource FROM data_1", rows);
+	 * for (const jlu::valueRow& row : rows) {
+	 * 		std::cout << row[0].asInt64 () << " - " << row[1].asText () << std::endl;
+	 * }
+	 * @endcode
+	 *
+	 * @param query The string to execute by sqlite3.
+	 * @param rows The container where rows will be stored. It is emptied first.
+	 * @param columnNames If not nullptr, it receives the names of the columns.
+	 * @throw std::runtime_error if the SQL statement is wrong.
+	 * @return bool True if the process was executed successfully.
+	 */
+	bool MySQLite::query (const std::string& query,
+						  std::vector<valueRow>& rows,
+						  std::vector<std::string>* columnNames) {
+		sqlite3_stmt* stmt = NULL;
+		int stmtResult = sqlite3_prepare_v2 (db, query.c_str (), -1, &stmt, NULL);
+
+		if (SQLITE_OK != stmtResult) {
+			std::string errorMsg ("Unable compile the SQL statement. Error code:" +
+								  std::to_string (stmtResult) + "\n");
+			throw std::runtime_error (errorMsg);
+		}
+
+		int numCols = sqlite3_column_count (stmt);
+		rows.clear ();
+		if (columnNames != nullptr) {
+			columnNames->clear ();
+			for (int i = 0; i < numCols; i++) {
+				columnNames->push_back (sqlite3_column_name (stmt, i));
+			}
+		}
+		int rc = 0;
+		while ((rc = sqlite3_step (stmt)) == SQLITE_ROW) {
+			rows.emplace_back ();
+			valueRow& row = rows.back ();
+			row.reserve (numCols);
+			for (int i = 0; i < numCols; i++) {
+				row.push_back (Value::fromColumn (stmt, i));
+			}
+		}
+		sqlite3_finalize (stmt);
+
+		if (SQLITE_DONE != rc) {
+			std::string errorMsg ("Error in sql statement. Desc: ");
+			errorMsg += sqlite3_errmsg (db);
+			statementFailed ();
+			throw std::runtime_error (errorMsg);
+		}
+		return true;
+	}
+
+	/**
+	 * @brief Execute a SQL statement and return its rows in a flat jlu::Rows.
+	 *
+	 * The cells of every row are contiguous in one vector, and the column names are stored
+	 * once, in a perfect hash index shared by all the rows. Read a cell by position in O(1)
+	 * or by name with one hash:
+	 * @code .cpp
+	 * jlu::Rows rows;
+	 * db.query ("SELECT id, resource FROM data_1", rows);
+	 * for (jlu::Rows::Row row : rows) {
+	 * 		std::cout << row[0].asInt64 () << " - " << row["resource"].asText () << std::endl;
+	 * }
+	 * @endcode
+	 *
+	 * @param query The string to execute by sqlite3.
+	 * @param rows The container where rows will be stored. Its rows are replaced; its memory
+	 * is kept for the next query.
+	 * @throw std::runtime_error if the SQL statement is wrong.
+	 * @return bool True if the process was executed successfully.
+	 */
+	bool MySQLite::query (const std::string& query, Rows& rows) {
+		sqlite3_stmt* stmt = NULL;
+		int stmtResult = sqlite3_prepare_v2 (db, query.c_str (), -1, &stmt, NULL);
+
+		if (SQLITE_OK != stmtResult) {
+			std::string errorMsg ("Unable compile the SQL statement. Error code:" +
+								  std::to_string (stmtResult) + "\n");
+			throw std::runtime_error (errorMsg);
+		}
+
+		rows.reset (ColumnIndex::fromStatement (stmt));
+		int rc = 0;
+		while ((rc = sqlite3_step (stmt)) == SQLITE_ROW) {
+			rows.append (stmt);
+		}
+		sqlite3_finalize (stmt);
+
+		if (SQLITE_DONE != rc) {
+			std::string errorMsg ("Error in sql statement. Desc: ");
+			errorMsg += sqlite3_errmsg (db);
+			statementFailed ();
+			throw std::runtime_error (errorMsg);
+		}
+		return true;
+	}
+
+	/**
+	 * @brief Execute a SQL statement and return its rows as Arrow record batches.
+	 *
+	 * Every batch is a struct array with one child per column, laid out as the Arrow C Data
+	 * Interface describes (validity bitmaps, values and offsets buffers), so an Arrow based
+	 * engine can import batches[i].schema and batches[i].array without copying the columns.
+	 * Integers are int64, reals float64, text utf8 and blobs binary; see
+	 * ArrowBatchBuilder::append for how the type of each column is chosen.
+	 *
+	 * @param query The string to execute by sqlite3.
+	 * @param batchRows Maximum number of rows per batch.
+	 * @param batches The container where batches will be stored. It is emptied first, and
+	 * stays empty if the result has no rows.
+	 * @throw std::runtime_error if the SQL statement is wrong.
+	 * @return bool True if the process was executed successfully.
+	 */
+	bool MySQLite::queryBatches (const std::string& query,
+								 size_t batchRows,
+								 std::vector<ArrowBatch>& batches) {
+		sqlite3_stmt* stmt = NULL;
+		int stmtResult = sqlite3_prepare_v2 (db, query.c_str (), -1, &stmt, NULL);
+
+		if (SQLITE_OK != stmtResult) {
+			std::string errorMsg ("Unable compile the SQL statement. Error code:" +
+								  std::to_string (stmtResult) + "\n");
+			throw std::runtime_error (errorMsg);
+		}
+
+		batches.clear ();
+		batchRows = std::max<size_t> (batchRows, 1);
+		ArrowBatchBuilder builder (stmt);
+		int rc = 0;
+		while ((rc = sqlite3_step (stmt)) == SQLITE_ROW) {
+			builder.append (stmt);
+			if (builder.size () == batchRows) {
+				batches.emplace_back ();
+				builder.finish (batches.back ());
+			}
+		}
+		if (builder.size () > 0) {
+			batches.emplace_back ();
+			builder.finish (batches.back ());
+		}
+		sqlite3_finalize (stmt);
+
+		if (SQLITE_DONE != rc) {
+			std::string errorMsg ("Error in sql statement. Desc: ");
+			errorMsg += sqlite3_errmsg (db);
+			statementFailed ();
+			throw std::runtime_error (errorMsg);
+		}
+		return true;
+	}
+
+	/**
+	 * @brief Insert rows given as columns, e.g. the buffers of a columnar engine, without
+	 * writing them as SQL.
+	 *
+	 * One INSERT of the table and columns is prepared for the call and finalized when it
+	 * returns. Every row is bound to it and stepped; texts and blobs are bound with
+	 * SQLITE_STATIC, so no value is copied before sqlite3 writes its record.
+	 * @code .cpp
+	 * std::vector<int64_t> ids = {1, 2, 3};
+	 * std::vector<std::string_view> names = {"AI01", "AI02", "AI03"};
+	 * uint8_t validity = 0x05;   // the second name is NULL
+	 * db.insertColumns ("data_1", {jlu::ColumnSpan::int64s ("id", ids.data (), ids.size ()),
+	 * 							  jlu::ColumnSpan::texts ("resource", names.data (), names.size (), &validity)});
+	 * @endcode
+	 *
+	 * @param table Table, which must exist.
+	 * @param columns Columns of the table and their values. All of them must have the same
+	 * size; their arrays must live until the call returns.
+	 * @param rowsPerTransaction Rows committed together, in IMMEDIATE transactions, if no
+	 * transaction is open. Inside a transaction of the caller, the rows are written in a
+	 * jlu::Savepoint and are part of that transaction once the call returns.
+	 * @return uint64_t Rows inserted.
+	 * @throw std::runtime_error if the spans differ in size, the INSERT does not compile or
+	 * a row fails. Without a transaction of the caller, the rows of the current batch are
+	 * rolled back and the committed batches stay; inside one, every row of the call is
+	 * rolled back and the transaction goes on.
+	 */
+	uint64_t MySQLite::insertColumns (const std::string& table,
+									  const std::vector<ColumnSpan>& columns,
+									  size_t rowsPerTransaction) {
+		if (columns.empty ()) {
+			return 0;
+		}
+		size_t numRows = columns[0].size;
+		for (const ColumnSpan& column : columns) {
+			if (column.size != numRows) {
+				throw std::runtime_error ("insertColumns: the columns have different sizes");
+			}
+		}
+		sqlite3_stmt* stmt = insertStatement (table, columns);
+		std::unique_ptr<sqlite3_stmt, decltype (&sqlite3_finalize)> guard (stmt, &sqlite3_finalize);
+		rowsPerTransaction = std::max<size_t> (rowsPerTransaction, 1);
+		bool ownTransaction = (sqlite3_get_autocommit (db) != 0);
+		int numCols = static_cast<int> (columns.size ());
+
+		size_t row = 0;
+		while (row < numRows) {
+			// Inside a transaction of the caller there is a single batch, in a savepoint, so a
+			// failed row does not leave the rows before it in that transaction.
+			std::unique_ptr<Transaction> transaction;
+			std::unique_ptr<Savepoint> savepoint;
+			if (ownTransaction) {
+				transaction.reset (new Transaction (*this, TransactionMode::Immediate));
+			} else {
+				savepoint.reset (new Savepoint (*this));
+			}
+			size_t batchEnd = ownTransaction ? std::min (numRows, row + rowsPerTransaction) : numRows;
+			for (; row < batchEnd; row++) {
+				for (int col = 0; col < numCols; col++) {
+					const ColumnSpan& column = columns[col];
+					if (column.isNull (row)) {
+						sqlite3_bind_null (stmt, col + 1);
+						continue;
+					}
+					switch (column.type) {
+						case ColumnSpan::Type::Int64:
+							sqlite3_bind_int64 (stmt, col + 1, static_cast<const int64_t*> (column.values)[row]);
+							break;
+						case ColumnSpan::Type::Double:
+							sqlite3_bind_double (stmt, col + 1, static_cast<const double*> (column.values)[row]);
+							break;
+						// A default string_view has no data, which sqlite3 would store as NULL.
+						case ColumnSpan::Type::Text: {
+							const std::string_view& text = static_cast<const std::string_view*> (column.values)[row];
+							sqlite3_bind_text64 (stmt, col + 1, (text.data () != nullptr) ? text.data () : "",
+												 text.size (), SQLITE_STATIC, SQLITE_UTF8);
+							break;
+						}
+						case ColumnSpan::Type::Blob: {
+							const std::string_view& blob = static_cast<const std::string_view*> (column.values)[row];
+							sqlite3_bind_blob64 (stmt, col + 1, (blob.data () != nullptr) ? blob.data () : "",
+												 blob.size (), SQLITE_STATIC);
+							break;
+						}
+					}
+				}
+				int rc = sqlite3_step (stmt);
+				sqlite3_reset (stmt);
+				if (SQLITE_DONE != rc) {
+					std::string errorMsg ("Error in sql statement. Desc: ");
+					errorMsg += sqlite3_errmsg (db);
+					statementFailed ();
+					throw std::runtime_error (errorMsg);
+				}
+			}
+			if (transaction != nullptr) {
+				transaction->commit ();
+			} else {
+				savepoint->release ();
+			}
+		}
+		return numRows;
+	}
+
 	/**
 	 * @brief Opens or creates a sqlite3 database.
 	 *
 	 * @param dbFileName Database name. If dbFileName is ":memory:" than the database will be
 	 * an in memory database. \n If dbFileName has a size of 0 than the database will be private
 	 * on disk database. \n Otherwise dbFileName will be interpreted as a file.
+	 * @param vfs Name of a registered VFS (e.g. jlu::uringvfs::name) or empty for the default
+	 * one.
+	 *
+	 * The connection gets the carray table-valued function (see jlu::carray::bind).
 	 * @throw std::runtime_error if database can not be open
 	 */
-	bool MySQLite::open (const std::string& dbFileName) {
-		int status = sqlite3_open (dbFileName.c_str (), &db);
+	bool MySQLite::open (const std::string& dbFileName, const std::string& vfs) {
+		int status = sqlite3_open_v2 (dbFileName.c_str (), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+									  vfs.empty () ? nullptr : vfs.c_str ());
 		bool output = false;
 
 		if (status != SQLITE_OK) {
 			std::string error ("Unable to open DB. Error: ");
 			error += sqlite3_errmsg (db);
 			sqlite3_close (db);
+			db = nullptr;
 
 			throw std::runtime_error (error.c_str ());
 		} else {
 			output = true;
+			installHooks ();
+			carray::registerModule (db);
 		}
 		return output;
 	}
@@ -133,6 +475,10 @@ namespace jlu {
 		bool output = false;
 		try {
 			if (db != nullptr) {
+				if (autoParams != nullptr) {
+					autoParams->clear ();
+				}
+				finalizeCachedStatements ();
 				int result = sqlite3_close (db);
 				if (SQLITE_BUSY == result) {
 					sqlite3_busy_timeout (db, 2000);
@@ -160,8 +506,373 @@ namespace jlu {
 	 */
 	bool MySQLite::isOpen () { return (db != nullptr); }
 
+	/**
+	 * @brief Raw sqlite3 connection handle, for the helper classes built on top of MySQLite.
+	 *
+	 * @return sqlite3* The connection, or nullptr if the database is not open.
+	 */
+	sqlite3* MySQLite::getHandle () { return db; }
+
+	/**
+	 * @brief Convert the value of a column of the current row of a statement.
+	 *
+	 * @param stmt A statement whose last sqlite3_step returned SQLITE_ROW.
+	 * @param col Index of the column, starting at 0.
+	 * @return sqlValue The value. NULL is returned as the string "null".
+	 */
+	sqlValue MySQLite::columnValue (sqlite3_stmt* stmt, int col) {
+		int columnType = sqlite3_column_type (stmt, col);
+
+		if (SQLITE3_TEXT == columnType) {
+			const unsigned char* value = sqlite3_column_text (stmt, col);
+			int len = sqlite3_column_bytes (stmt, col);
+			return std::string (value, value + len);
+		} else if (SQLITE_INTEGER == columnType) {
+			return sqlite3_column_int (stmt, col);
+		} else if (SQLITE_FLOAT == columnType) {
+			return sqlite3_column_double (stmt, col);
+		} else if (SQLITE_BLOB == columnType) {
+			const uint8_t* value = reinterpret_cast<const uint8_t*> (sqlite3_column_blob (stmt, col));
+			int len = sqlite3_column_bytes (stmt, col);
+			return std::vector<uint8_t> (value, value + len);
+		}
+		return std::string ("null");
+	}
+
+	/**
+	 * @brief Quote a table or column name for SQL text: "name", with every " doubled, so
+	 * any name is a single identifier.
+	 */
+	std::string MySQLite::quoteIdentifier (const std::string& name) {
+		std::string output ("\"");
+		for (char c : name) {
+			if (c == '"') {
+				output += '"';
+			}
+			output += c;
+		}
+		return output + "\"";
+	}
+
+	/**
+	 * @brief Register callbacks for the changes made through this connection.
+	 *
+	 * They are called from sqlite3_update_hook (every row inserted, updated or deleted in a
+	 * rowid table), sqlite3_commit_hook, sqlite3_rollback_hook and sqlite3_wal_hook, on the
+	 * thread that runs the statement. onCommit is called when a commit starts, and the
+	 * commit can still fail with SQLITE_BUSY and be rolled back later; onCommitted is called
+	 * once it has succeeded, when the statement that committed ends (SQLITE_TRACE_PROFILE).
+	 * sqlite3 keeps one hook of each kind per connection, so every component that needs
+	 * them registers here instead of calling sqlite3_*_hook itself. sqlite3 has no hook for
+	 * savepoints: onSavepoint and onRollbackTo are called by the jlu::Savepoint guards, after
+	 * their SAVEPOINT and ROLLBACK TO, since the update hook is not called for the rows a
+	 * ROLLBACK TO undoes. Nor is it for the rows of a statement that fails inside a
+	 * transaction and is undone while the transaction stays open: onStatement is called when
+	 * each statement starts (SQLITE_TRACE_STMT) and onStatementRollback when one run by this
+	 * class fails that way.
+	 *
+	 * Only onWalCommit, called after a commit in WAL mode once the write lock is released,
+	 * may use the connection; the other callbacks must not. Register and remove listeners
+	 * while no statement is running. They are kept if the database is closed and open again.
+	 *
+	 * @param listener Callbacks. Any of them can be empty.
+	 * @return int Identifier for removeChangeListener().
+	 */
+	int MySQLite::addChangeListener (const ChangeListener& listener) {
+		int id = nextListenerId++;
+		listeners[id] = listener;
+		installHooks ();
+		return id;
+	}
+
+	/**
+	 * @brief Remove a listener registered with addChangeListener(). The hooks are removed
+	 * from the connection with the last one.
+	 */
+	void MySQLite::removeChangeListener (int id) {
+		listeners.erase (id);
+		installHooks ();
+	}
+
+	/**
+	 * @brief Size of the WAL, in frames, that makes a commit run a checkpoint, as
+	 * sqlite3_wal_autocheckpoint. It keeps working while a listener uses the WAL hook.
+	 *
+	 * @param frames Frames, or 0 to disable the automatic checkpoints.
+	 */
+	void MySQLite::setWalAutoCheckpoint (int frames) {
+		walAutoCheckpoint = frames;
+		installHooks ();
+	}
+
+	/**
+	 * @brief Size of the WAL set with setWalAutoCheckpoint, 1000 frames by default.
+	 */
+	int MySQLite::getWalAutoCheckpoint () const { return walAutoCheckpoint; }
+
+	/**
+	 * @brief I/O counters of this connection: reads, writes and syncs of the database, its
+	 * journal and its WAL, with bytes and latency histograms. The database must be open
+	 * with the "iostats" VFS (see jlu::iostatsvfs::registerVfs).
+	 *
+	 * Take them before and after a kind of transaction (or reset them) to measure its cost,
+	 * e.g. the write amplification: stats.total ().bytesWritten against the bytes changed.
+	 *
+	 * @param stats Destination.
+	 * @return bool False if the database is not open or does not use the "iostats" VFS.
+	 */
+	bool MySQLite::getIoStats (IoStats& stats) {
+		if (db == nullptr) {
+			return false;
+		}
+		return sqlite3_file_control (db, "main", iostatsvfs::fileControlGet, &stats) == SQLITE_OK;
+	}
+
+	/**
+	 * @brief Set the I/O counters of this connection to zero.
+	 *
+	 * @return bool False if the database is not open or does not use the "iostats" VFS.
+	 */
+	bool MySQLite::resetIoStats () {
+		if (db == nullptr) {
+			return false;
+		}
+		return sqlite3_file_control (db, "main", iostatsvfs::fileControlReset, nullptr) == SQLITE_OK;
+	}
+
+	/**
+	 * @brief Run the SQL given to exec() with literals through a cache of prepared
+	 * statements.
+	 *
+	 * Each statement is rewritten with its numbers, strings and blobs as parameters (see
+	 * AutoParameterizer::normalize), so "UPDATE t SET v = 1.5 WHERE id = 7" and
+	 * "UPDATE t SET v = 2 WHERE id = 9" share one statement, prepared once and bound with
+	 * the values of each call. Statements that cannot be rewritten (DDL, PRAGMA, several
+	 * statements, existing parameters) or whose rewritten text does not compile run as
+	 * before. exec() with rows also runs as before if a result column is named after a
+	 * literal.
+	 *
+	 * A parameter is not a constant for the query planner: partial indexes and indexes on
+	 * expressions with literals are not used by the rewritten statements.
+	 *
+	 * @param enable Turn the cache on or off. Either way the cached statements are
+	 * finalized and the counters start again.
+	 * @param maxStatements Prepared statements kept, the least recently used are finalized.
+	 */
+	void MySQLite::setAutoParameterize (bool enable, size_t maxStatements) {
+		autoParams.reset (enable ? new AutoParameterizer (maxStatements) : nullptr);
+	}
+
+	/**
+	 * @brief Counters of the cache of setAutoParameterize, all 0 if it is off.
+	 */
+	AutoParamStats MySQLite::getAutoParamStats () const {
+		return (autoParams != nullptr) ? autoParams->getStats () : AutoParamStats ();
+	}
+
+	/**
+	 * @brief Counters of the Transaction guards of this connection: commits, rollbacks and
+	 * the time their transactions held the write lock.
+	 */
+	TransactionStats MySQLite::getTransactionStats () const { return transactionStats; }
+
 	// Private methods >>
 
+	void MySQLite::updateHook (void* self,
+							   int op,
+							   const char* schema,
+							   const char* table,
+							   sqlite3_int64 rowid) {
+		for (auto& listener : static_cast<MySQLite*> (self)->listeners) {
+			if (listener.second.onUpdate) {
+				listener.second.onUpdate (op, schema, table, rowid);
+			}
+		}
+	}
+
+	int MySQLite::commitHook (void* self) {
+		static_cast<MySQLite*> (self)->committing = true;
+		for (auto& listener : static_cast<MySQLite*> (self)->listeners) {
+			if (listener.second.onCommit) {
+				listener.second.onCommit ();
+			}
+		}
+		return 0;
+	}
+
+	void MySQLite::rollbackHook (void* self) {
+		static_cast<MySQLite*> (self)->committing = false;
+		for (auto& listener : static_cast<MySQLite*> (self)->listeners) {
+			if (listener.second.onRollback) {
+				listener.second.onRollback ();
+			}
+		}
+	}
+
+	int MySQLite::walHook (void* self, sqlite3* handle, const char* schema, int frames) {
+		MySQLite* database = static_cast<MySQLite*> (self);
+		for (auto& listener : database->listeners) {
+			if (listener.second.onWalCommit) {
+				listener.second.onWalCommit (schema, frames);
+			}
+		}
+		// What the default hook of sqlite3_wal_autocheckpoint does.
+		if (database->walAutoCheckpoint > 0 && frames >= database->walAutoCheckpoint) {
+			sqlite3_wal_checkpoint (handle, schema);
+		}
+		return SQLITE_OK;
+	}
+
+	// The commit hook runs before the commit, which fails with SQLITE_BUSY if the lock can
+	// not be taken and leaves the write transaction open. Once the statement ends without
+	// it, the commit is done.
+	int MySQLite::traceHook (unsigned type, void* self, void* stmt, void* sql) {
+		MySQLite* database = static_cast<MySQLite*> (self);
+		if (SQLITE_TRACE_STMT == type) {
+			// The triggers of a statement are traced with it, as "-- TRIGGER name".
+			const char* text = static_cast<const char*> (sql);
+			if (stmt == database->runningStatement && text[0] == '-' && text[1] == '-') {
+				return 0;
+			}
+			database->runningStatement = static_cast<sqlite3_stmt*> (stmt);
+			for (auto& listener : database->listeners) {
+				if (listener.second.onStatement) {
+					listener.second.onStatement ();
+				}
+			}
+			return 0;
+		}
+		database->runningStatement = nullptr;
+		if (!database->committing || sqlite3_txn_state (database->db, nullptr) == SQLITE_TXN_WRITE) {
+			return 0;
+		}
+		database->committing = false;
+		for (auto& listener : database->listeners) {
+			if (listener.second.onCommitted) {
+				listener.second.onCommitted ();
+			}
+		}
+		return 0;
+	}
+
+	// A statement that fails inside a transaction is undone by sqlite3 without calling the
+	// rollback hook, and the trace hook can not tell it from one that succeeded: it is seen
+	// here, from the error returned to the code that stepped it. With the FAIL conflict
+	// resolution the rows changed before the error are kept, and sqlite3_changes counts
+	// them; after any other error it is 0.
+	void MySQLite::statementFailed () {
+		if (db == nullptr || sqlite3_get_autocommit (db) != 0 || sqlite3_changes (db) != 0) {
+			return;
+		}
+		for (auto& listener : listeners) {
+			if (listener.second.onStatementRollback) {
+				listener.second.onStatementRollback ();
+			}
+		}
+	}
+
+	void MySQLite::savepointHook (const std::string& savepoint) {
+		for (auto& listener : listeners) {
+			if (listener.second.onSavepoint) {
+				listener.second.onSavepoint (savepoint);
+			}
+		}
+	}
+
+	void MySQLite::rollbackToHook (const std::string& savepoint) {
+		for (auto& listener : listeners) {
+			if (listener.second.onRollbackTo) {
+				listener.second.onRollbackTo (savepoint);
+			}
+		}
+	}
+
+	void MySQLite::installHooks () {
+		if (db == nullptr) {
+			return;
+		}
+		bool active = !listeners.empty ();
+		sqlite3_update_hook (db, active ? &MySQLite::updateHook : nullptr, active ? this : nullptr);
+		sqlite3_commit_hook (db, active ? &MySQLite::commitHook : nullptr, active ? this : nullptr);
+		sqlite3_rollback_hook (db, active ? &MySQLite::rollbackHook : nullptr, active ? this : nullptr);
+
+		bool walListeners = false;
+		unsigned traceMask = 0;
+		for (auto& listener : listeners) {
+			walListeners = walListeners || static_cast<bool> (listener.second.onWalCommit);
+			if (listener.second.onCommitted) {
+				traceMask |= SQLITE_TRACE_PROFILE;
+			}
+			if (listener.second.onStatement) {
+				traceMask |= SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE;
+			}
+		}
+		runningStatement = nullptr;
+		sqlite3_trace_v2 (db, traceMask, (traceMask != 0) ? &MySQLite::traceHook : nullptr,
+						  (traceMask != 0) ? this : nullptr);
+		if (walListeners) {
+			sqlite3_wal_hook (db, &MySQLite::walHook, this);
+		} else {
+			sqlite3_wal_autocheckpoint (db, walAutoCheckpoint);
+		}
+	}
+
+	sqlite3_stmt* MySQLite::insertStatement (const std::string& table, const std::vector<ColumnSpan>& columns) {
+		std::string sql ("INSERT INTO " + quoteIdentifier (table) + " (");
+		std::string values (") VALUES (");
+		for (size_t col = 0; col < columns.size (); col++) {
+			sql += ((col > 0) ? ", " : "") + quoteIdentifier (columns[col].name);
+			values += (col > 0) ? ", ?" : "?";
+		}
+		sql += values + ")";
+
+		// Not cached: every table and list of columns would keep a statement until close().
+		sqlite3_stmt* stmt = nullptr;
+		int stmtResult = sqlite3_prepare_v2 (db, sql.c_str (), -1, &stmt, nullptr);
+		if (SQLITE_OK != stmtResult) {
+			std::string errorMsg ("Unable compile the SQL statement. Error code:" +
+								  std::to_string (stmtResult) + "\n");
+			throw std::runtime_error (errorMsg);
+		}
+		return stmt;
+	}
+
+	// Statements run often by the library itself (BEGIN, COMMIT, SAVEPOINT...), prepared
+	// once and finalized by close().
+	sqlite3_stmt* MySQLite::cachedStatement (const std::string& sql) {
+		auto cached = cachedStatements.find (sql);
+		if (cached != cachedStatements.end ()) {
+			return cached->second;
+		}
+		sqlite3_stmt* stmt = nullptr;
+		int stmtResult = sqlite3_prepare_v3 (db, sql.c_str (), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr);
+		if (SQLITE_OK != stmtResult) {
+			std::string errorMsg ("Unable compile the SQL statement. Error code:" +
+								  std::to_string (stmtResult) + "\n");
+			throw std::runtime_error (errorMsg);
+		}
+		cachedStatements[sql] = stmt;
+		return stmt;
+	}
+
+	void MySQLite::stepCached (const std::string& sql) {
+		sqlite3_stmt* stmt = cachedStatement (sql);
+		int rc = sqlite3_step (stmt);
+		sqlite3_reset (stmt);
+		if (SQLITE_DONE != rc) {
+			std::string errorMsg ("Error in sql statement. Desc: ");
+			errorMsg += sqlite3_errmsg (db);
+			throw std::runtime_error (errorMsg);
+		}
+	}
+
+	void MySQLite::finalizeCachedStatements () {
+		for (auto& cached : cachedStatements) {
+			sqlite3_finalize (cached.second);
+		}
+		cachedStatements.clear ();
+	}
+
 	bool MySQLite::returnData (std::vector<sqlRow>& result,
 							   sqlite3_stmt* stmt,
 							   const int& numCols) {
@@ -177,33 +888,18 @@ namespace jlu {
 		}
 
 		// prepare data to send
-		while ((rc = sqlite3_step (stmt)) != SQLITE_DONE) {
-			std::map<std::string, std::variant<int, double, std::string, std::vector<uint8_t>>> row;
+		while ((rc = sqlite3_step (stmt)) == SQLITE_ROW) {
+			sqlRow row;
 
 			for (int i = 0; i < numCols; i++) {
-				int columnType = sqlite3_column_type (stmt, i);
-
-				if (SQLITE3_TEXT == columnType) {
-					const unsigned char* value = sqlite3_column_text (stmt, i);
-					int len = sqlite3_column_bytes (stmt, i);
-					row[column_names[i]] = std::string (value, value + len);
-				} else if (SQLITE_INTEGER == columnType) {
-					row[column_names[i]] = sqlite3_column_int (stmt, i);
-				} else if (SQLITE_FLOAT == columnType) {
-					row[column_names[i]] = sqlite3_column_double (stmt, i);
-				} else if (SQLITE_BLOB == columnType) {
-					const uint8_t* value =
-						reinterpret_cast<const uint8_t*> (sqlite3_column_blob (stmt, i));
-					int len = sqlite3_column_bytes (stmt, i);
-					row[column_names[i]] = std::vector<uint8_t> (value, value + len);
-				} else if (SQLITE_NULL == columnType) {
-					row[column_names[i]] = "null";
-				}
+				row[column_names[i]] = columnValue (stmt, i);
 			}
 			result.push_back (row);
 		}
-		sqlite3_finalize (stmt);
-		output = true;
+		output = (SQLITE_DONE == rc);
+		if (!output) {
+			statementFailed ();
+		}
 		return output;
 	}
 }	// namespace jlu
\ No newline at end of file
@@ -0,0 +1,269 @@
+#include "../include/pager.h"
+
+#include <cctype>
+#include <cstring>
+
+namespace jlu {
+	static const char hexDigits[] = "0123456789abcdef";
+
+	/**
+	 * @brief Creates a keyset pager over a query.
+	 *
+	 * Two statements are prepared once and reused for every page: the first page and the
+	 * seek query, which starts right after the keys of the last row of the previous page.
+	 * So the cost of a page does not depend on how deep it is.
+	 *
+	 * @param database An open database. It must outlive the pager.
+	 * @param baseQuery A SELECT statement. Its result must include the key columns.
+	 * @param keyColumns Ordering columns. Together they must be unique and NOT NULL, e.g.
+	 * {"resource", "id"}.
+	 * @param pageSize Maximum number of rows per page.
+	 * @param descending Walk the keys from the highest to the lowest.
+	 * @throw std::runtime_error if the query can not be compiled or does not return the keys.
+	 */
+	Pager::Pager (MySQLite& database,
+				  const std::string& baseQuery,
+				  const std::vector<std::string>& keyColumns,
+				  int pageSize,
+				  bool descending)
+		: database (database), pageSize (pageSize), firstStmt (nullptr), seekStmt (nullptr) {
+		if (keyColumns.empty () || pageSize <= 0) {
+			throw std::runtime_error ("Pager needs at least one key column and a positive page size");
+		}
+
+		std::string base (baseQuery);
+		while (!base.empty () &&
+			   (base.back () == ';' || isspace (static_cast<unsigned char> (base.back ())))) {
+			base.pop_back ();
+		}
+
+		std::string keys;
+		std::string params;
+		std::string orderBy;
+		std::string coma ("");
+		for (const std::string& key : keyColumns) {
+			keys += coma + MySQLite::quoteIdentifier (key);
+			params += coma + "?";
+			orderBy += coma + MySQLite::quoteIdentifier (key) + (descending ? " DESC" : "");
+			coma = ", ";
+		}
+
+		std::string from ("SELECT * FROM (" + base + ")");
+		std::string limit (" LIMIT ?" + std::to_string (keyColumns.size () + 1));
+		seekQuery = from + " WHERE (" + keys + ") " + (descending ? "<" : ">") + " (" + params +
+					") ORDER BY " + orderBy + limit;
+
+		firstStmt = prepare (from + " ORDER BY " + orderBy + limit);
+		seekStmt = prepare (seekQuery);
+
+		int numCols = sqlite3_column_count (firstStmt);
+		for (const std::string& key : keyColumns) {
+			int index = -1;
+			for (int i = 0; i < numCols && index < 0; i++) {
+				if (key == sqlite3_column_name (firstStmt, i)) {
+					index = i;
+				}
+			}
+			if (index < 0) {
+				sqlite3_finalize (firstStmt);
+				sqlite3_finalize (seekStmt);
+				throw std::runtime_error ("Key column " + key + " is not in the result of the query");
+			}
+			keyIndexes.push_back (index);
+		}
+	}
+
+	/**
+	 * @brief Finalize the cached statements. Destroy the pager before closing the database.
+	 */
+	Pager::~Pager () {
+		sqlite3_finalize (firstStmt);
+		sqlite3_finalize (seekStmt);
+	}
+
+	/**
+	 * @brief Fetch one page.
+	 *
+	 * @param token Empty for the first page, otherwise the nextToken of the previous page.
+	 * @param page Column names, rows and the token of the next page. nextToken is empty when
+	 * this is the last page.
+	 * @return bool True if the page has rows.
+	 * @throw std::runtime_error if the token is not valid or sqlite3 reports an error.
+	 */
+	bool Pager::fetch (const std::string& token, Page& page) {
+		sqlite3_stmt* stmt = token.empty () ? firstStmt : seekStmt;
+		sqlite3_reset (stmt);
+		sqlite3_clear_bindings (stmt);
+		if (!token.empty ()) {
+			bindToken (token);
+		}
+		// One extra row tells whether there is a next page.
+		sqlite3_bind_int (stmt, static_cast<int> (keyIndexes.size ()) + 1, pageSize + 1);
+
+		int numCols = sqlite3_column_count (stmt);
+		page.columns.clear ();
+		for (int i = 0; i < numCols; i++) {
+			page.columns.push_back (sqlite3_column_name (stmt, i));
+		}
+		page.rows.clear ();
+		page.nextToken.clear ();
+
+		std::string lastKeys;
+		int rc = 0;
+		while ((rc = sqlite3_step (stmt)) == SQLITE_ROW) {
+			if (static_cast<int> (page.rows.size ()) == pageSize) {
+				page.nextToken = lastKeys;
+				break;
+			}
+
+			std::vector<sqlValue> row;
+			row.reserve (numCols);
+			for (int i = 0; i < numCols; i++) {
+				row.push_back (MySQLite::columnValue (stmt, i));
+			}
+			page.rows.push_back (std::move (row));
+
+			if (static_cast<int> (page.rows.size ()) == pageSize) {
+				lastKeys = encodeToken (stmt);
+			}
+		}
+
+		if (SQLITE_ROW != rc && SQLITE_DONE != rc) {
+			std::string errorMsg ("Error fetching page. Desc: ");
+			errorMsg += sqlite3_errmsg (database.getHandle ());
+			sqlite3_reset (stmt);
+			throw std::runtime_error (errorMsg);
+		}
+		sqlite3_reset (stmt);
+		return !page.rows.empty ();
+	}
+
+	/**
+	 * @brief The SQL of the seek query, useful to check its plan with EXPLAIN QUERY PLAN.
+	 *
+	 * @return std::string The query. Its last parameter is the LIMIT.
+	 */
+	std::string Pager::getSeekQuery () { return seekQuery; }
+
+	// Private methods >>
+
+	sqlite3_stmt* Pager::prepare (const std::string& query) {
+		sqlite3_stmt* stmt = nullptr;
+		int stmtResult =
+			sqlite3_prepare_v3 (database.getHandle (), query.c_str (), -1, SQLITE_PREPARE_PERSISTENT,
+								&stmt, nullptr);
+		if (SQLITE_OK != stmtResult) {
+			sqlite3_finalize (firstStmt);
+			std::string errorMsg ("Unable compile the SQL statement. Error code:" +
+								  std::to_string (stmtResult) + "\n");
+			throw std::runtime_error (errorMsg);
+		}
+		return stmt;
+	}
+
+	// Token layout, before hex encoding: for each key a type byte ('i', 'f', 's' or 'b') and
+	// 8 bytes for numbers or a 4 bytes length and the bytes for text and blobs.
+	std::string Pager::encodeToken (sqlite3_stmt* stmt) {
+		std::string raw;
+		for (int index : keyIndexes) {
+			int columnType = sqlite3_column_type (stmt, index);
+			if (SQLITE_INTEGER == columnType || SQLITE_FLOAT == columnType) {
+				char buffer[8];
+				if (SQLITE_INTEGER == columnType) {
+					sqlite3_int64 value = sqlite3_column_int64 (stmt, index);
+					memcpy (buffer, &value, sizeof (buffer));
+					raw += 'i';
+				} else {
+					double value = sqlite3_column_double (stmt, index);
+					memcpy (buffer, &value, sizeof (buffer));
+					raw += 'f';
+				}
+				raw.append (buffer, sizeof (buffer));
+			} else if (SQLITE_TEXT == columnType || SQLITE_BLOB == columnType) {
+				const char* value = (SQLITE_TEXT == columnType)
+										? reinterpret_cast<const char*> (sqlite3_column_text (stmt, index))
+										: static_cast<const char*> (sqlite3_column_blob (stmt, index));
+				uint32_t len = static_cast<uint32_t> (sqlite3_column_bytes (stmt, index));
+				raw += (SQLITE_TEXT == columnType) ? 's' : 'b';
+				raw.append (reinterpret_cast<const char*> (&len), sizeof (len));
+				if (len > 0) {
+					raw.append (value, len);
+				}
+			} else {
+				throw std::runtime_error ("Pager key columns can not be NULL");
+			}
+		}
+
+		std::string output;
+		output.reserve (raw.size () * 2);
+		for (unsigned char c : raw) {
+			output += hexDigits[c >> 4];
+			output += hexDigits[c & 0x0f];
+		}
+		return output;
+	}
+
+	void Pager::bindToken (const std::string& token) {
+		const std::string invalid ("Invalid continuation token");
+		if (token.size () % 2 != 0) {
+			throw std::runtime_error (invalid);
+		}
+
+		std::string raw;
+		raw.reserve (token.size () / 2);
+		for (size_t i = 0; i < token.size (); i += 2) {
+			const char* high = strchr (hexDigits, token[i]);
+			const char* low = strchr (hexDigits, token[i + 1]);
+			if (high == nullptr || low == nullptr || *high == '\0' || *low == '\0') {
+				throw std::runtime_error (invalid);
+			}
+			raw += static_cast<char> (((high - hexDigits) << 4) | (low - hexDigits));
+		}
+
+		size_t pos = 0;
+		for (size_t param = 1; param <= keyIndexes.size (); param++) {
+			if (pos >= raw.size ()) {
+				throw std::runtime_error (invalid);
+			}
+			char type = raw[pos++];
+			if (type == 'i' || type == 'f') {
+				if (pos + 8 > raw.size ()) {
+					throw std::runtime_error (invalid);
+				}
+				if (type == 'i') {
+					sqlite3_int64 value;
+					memcpy (&value, raw.data () + pos, sizeof (value));
+					sqlite3_bind_int64 (seekStmt, static_cast<int> (param), value);
+				} else {
+					double value;
+					memcpy (&value, raw.data () + pos, sizeof (value));
+					sqlite3_bind_double (seekStmt, static_cast<int> (param), value);
+				}
+				pos += 8;
+			} else if (type == 's' || type == 'b') {
+				uint32_t len = 0;
+				if (pos + sizeof (len) > raw.size ()) {
+					throw std::runtime_error (invalid);
+				}
+				memcpy (&len, raw.data () + pos, sizeof (len));
+				pos += sizeof (len);
+				if (pos + len > raw.size ()) {
+					throw std::runtime_error (invalid);
+				}
+				if (type == 's') {
+					sqlite3_bind_text (seekStmt, static_cast<int> (param), raw.data () + pos,
+									   static_cast<int> (len), SQLITE_TRANSIENT);
+				} else {
+					sqlite3_bind_blob (seekStmt, static_cast<int> (param), raw.data () + pos,
+									   static_cast<int> (len), SQLITE_TRANSIENT);
+				}
+				pos += len;
+			} else {
+				throw std::runtime_error (invalid);
+			}
+		}
+		if (pos != raw.size ()) {
+			throw std::runtime_error (invalid);
+		}
+	}
+}	// namespace jlu
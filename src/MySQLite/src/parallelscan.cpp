@@ -0,0 +1,251 @@
+#include "../include/parallelscan.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <thread>
+
+namespace jlu {
+	/**
+	 * @brief Rows scanned per second in the last run.
+	 */
+	double ScanStats::rowsPerSecond () const { return (seconds > 0.0) ? rows / seconds : 0.0; }
+
+	/**
+	 * @brief Creates a parallel scanner of a table.
+	 *
+	 * Every worker gets its own read-only connection to the database file (a ReaderPool),
+	 * with the chunk statement prepared once:
+	 *   SELECT <columns> FROM <table> WHERE <key> BETWEEN ?1 AND ?2 [AND (<predicate>)]
+	 * The key range is split in threads * chunksPerThread chunks that the workers take as they
+	 * finish the previous one, so a dense part of the table does not keep a single worker busy.
+	 *
+	 * @param database An open database, stored in a file. WAL mode lets the scan run while
+	 * other connections write.
+	 * @param table Table to scan.
+	 * @param options keyColumn must be the rowid or an indexed integer column, so every chunk is
+	 * a range search. threads == 0 uses all the cores.
+	 * @throw std::runtime_error if the database is not a file, a connection can not be open
+	 * or the statements can not be compiled.
+	 */
+	ParallelScan::ParallelScan (MySQLite& database, const std::string& table, const ScanOptions& options)
+		: table (table),
+		  options (options),
+		  pool (database, resolveThreads (options.threads), options.busyTimeoutMs),
+		  rangeStmt (nullptr),
+		  rangeFirst (0),
+		  rangeSpan (0),
+		  chunkWidth (1),
+		  numChunks (0),
+		  nextChunk (0) {
+		this->options.chunksPerThread = std::max<size_t> (1, options.chunksPerThread);
+		this->options.batchRows = std::max<size_t> (1, options.batchRows);
+
+		std::string key (MySQLite::quoteIdentifier (options.keyColumn));
+		std::string from (" FROM " + MySQLite::quoteIdentifier (table));
+		std::string chunkQuery ("SELECT " + options.columns + from + " WHERE " + key +
+								" BETWEEN ?1 AND ?2");
+		if (!options.predicate.empty ()) {
+			chunkQuery += " AND (" + options.predicate + ")";
+		}
+		std::string rangeQuery ("SELECT min(" + key + "), max(" + key + ")" + from);
+
+		auto prepare = [this] (sqlite3* conn, const std::string& query) {
+			sqlite3_stmt* stmt = nullptr;
+			int rc = sqlite3_prepare_v3 (conn, query.c_str (), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr);
+			if (rc != SQLITE_OK) {
+				std::string error ("ParallelScan: unable compile the SQL statement " + query +
+								   ". Error: " + sqlite3_errmsg (conn));
+				finalizeStatements ();
+				throw std::runtime_error (error);
+			}
+			return stmt;
+		};
+		for (size_t i = 0; i < pool.size (); i++) {
+			chunkStmts.push_back (prepare (pool.reader (i), chunkQuery));
+		}
+		rangeStmt = prepare (pool.reader (0), rangeQuery);
+	}
+
+	/**
+	 * @brief Finalize the statements and close the reader connections.
+	 */
+	ParallelScan::~ParallelScan () { finalizeStatements (); }
+
+	/**
+	 * @brief Number of workers, each one with its own connection and thread.
+	 */
+	size_t ParallelScan::workers () const { return pool.size (); }
+
+	/**
+	 * @brief Scan the table calling perRow for every row that matches the predicate.
+	 *
+	 * perRow runs concurrently on the worker threads (worker 0 is the calling thread) with
+	 * the statement of the worker positioned on the row. Keep one partial result per worker,
+	 * indexed by the worker argument, and merge them at the end; aggregate() does it.
+	 *
+	 * @param perRow Callback. It must not step or reset the statement.
+	 * @return ScanStats Rows, chunks and elapsed time.
+	 * @throw std::runtime_error on SQL errors. Exceptions thrown by perRow stop the scan and
+	 * are rethrown here.
+	 */
+	ScanStats ParallelScan::run (const RowFn& perRow) { return scan (&perRow, nullptr); }
+
+	/**
+	 * @brief Scan the table handing the rows to perBatch as Arrow record batches of up to
+	 * options.batchRows rows. It runs concurrently like run().
+	 *
+	 * @param perBatch Callback. It can move the batch away.
+	 */
+	ScanStats ParallelScan::runBatches (const BatchFn& perBatch) { return scan (nullptr, &perBatch); }
+
+	/**
+	 * @brief Statistics of the last run.
+	 */
+	ScanStats ParallelScan::getStats () const { return stats; }
+
+	// Private methods >>
+
+	size_t ParallelScan::resolveThreads (size_t threads) {
+		return (threads > 0) ? threads : std::max (1u, std::thread::hardware_concurrency ());
+	}
+
+	ScanStats ParallelScan::scan (const RowFn* perRow, const BatchFn* perBatch) {
+		auto start = std::chrono::steady_clock::now ();
+		beginRead ();
+
+		std::vector<uint64_t> rows (pool.size (), 0);
+		std::vector<std::exception_ptr> errors (pool.size ());
+		auto work = [&] (size_t worker) {
+			try {
+				rows[worker] = scanChunks (worker, perRow, perBatch);
+			} catch (...) {
+				errors[worker] = std::current_exception ();
+				nextChunk = numChunks;	 // the other workers stop after their current chunk
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for (size_t worker = 1; worker < pool.size (); worker++) {
+			threads.emplace_back (work, worker);
+		}
+		work (0);
+		for (std::thread& thread : threads) {
+			thread.join ();
+		}
+		endRead ();
+
+		for (std::exception_ptr& error : errors) {
+			if (error) {
+				std::rethrow_exception (error);
+			}
+		}
+
+		stats.rows = 0;
+		for (uint64_t count : rows) {
+			stats.rows += count;
+		}
+		stats.chunks = numChunks;
+		stats.threads = pool.size ();
+		stats.seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+		return stats;
+	}
+
+	/**
+	 * Start a read transaction on every reader and split the key range.
+	 *
+	 * With options.consistent all the workers see the same snapshot (see ReaderPool::begin).
+	 */
+	void ParallelScan::beginRead () {
+		pool.begin (options.consistent);
+
+		numChunks = 0;
+		int rc = sqlite3_step (rangeStmt);
+		if (rc == SQLITE_ROW && sqlite3_column_type (rangeStmt, 0) != SQLITE_NULL) {
+			rangeFirst = sqlite3_column_int64 (rangeStmt, 0);
+			rangeSpan = static_cast<uint64_t> (sqlite3_column_int64 (rangeStmt, 1)) -
+						static_cast<uint64_t> (rangeFirst);
+			numChunks = pool.size () * options.chunksPerThread;
+			if (rangeSpan < numChunks - 1) {
+				numChunks = static_cast<size_t> (rangeSpan) + 1;
+			}
+			// A span of 2^64 - 1 keys in one chunk would need a width of 2^64: it saturates,
+			// as the last chunk always ends at the end of the range.
+			chunkWidth = rangeSpan / numChunks;
+			chunkWidth = (chunkWidth == UINT64_MAX) ? UINT64_MAX : chunkWidth + 1;
+		}
+		sqlite3_reset (rangeStmt);
+		nextChunk = 0;
+
+		if (rc != SQLITE_ROW && rc != SQLITE_DONE) {
+			std::string error ("Error in sql statement. Desc: ");
+			error += sqlite3_errmsg (pool.reader (0));
+			pool.end ();
+			throw std::runtime_error (error);
+		}
+	}
+
+	void ParallelScan::endRead () {
+		for (sqlite3_stmt* stmt : chunkStmts) {
+			sqlite3_reset (stmt);
+		}
+		pool.end ();
+	}
+
+	uint64_t ParallelScan::scanChunks (size_t worker, const RowFn* perRow, const BatchFn* perBatch) {
+		sqlite3_stmt* stmt = chunkStmts[worker];
+		std::unique_ptr<ArrowBatchBuilder> builder;
+		if (perBatch != nullptr) {
+			builder.reset (new ArrowBatchBuilder (stmt));
+		}
+
+		uint64_t count = 0;
+		for (size_t chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++) {
+			if (chunk > rangeSpan / chunkWidth) {
+				continue;
+			}
+			uint64_t low = chunk * chunkWidth;
+			uint64_t high = (chunk + 1 == numChunks || rangeSpan - low < chunkWidth) ? rangeSpan
+																					  : low + chunkWidth - 1;
+			sqlite3_bind_int64 (stmt, 1, static_cast<int64_t> (static_cast<uint64_t> (rangeFirst) + low));
+			sqlite3_bind_int64 (stmt, 2, static_cast<int64_t> (static_cast<uint64_t> (rangeFirst) + high));
+
+			int rc;
+			while ((rc = sqlite3_step (stmt)) == SQLITE_ROW) {
+				count++;
+				if (perRow != nullptr) {
+					(*perRow) (worker, stmt);
+				} else {
+					builder->append (stmt);
+					if (builder->size () >= options.batchRows) {
+						ArrowBatch batch;
+						builder->finish (batch);
+						(*perBatch) (worker, batch);
+					}
+				}
+			}
+			sqlite3_reset (stmt);
+			if (rc != SQLITE_DONE) {
+				throw std::runtime_error (std::string ("Error in sql statement. Desc: ") +
+										  sqlite3_errmsg (pool.reader (worker)));
+			}
+		}
+
+		if (builder && builder->size () > 0) {
+			ArrowBatch batch;
+			builder->finish (batch);
+			(*perBatch) (worker, batch);
+		}
+		return count;
+	}
+
+	void ParallelScan::finalizeStatements () {
+		sqlite3_finalize (rangeStmt);
+		rangeStmt = nullptr;
+		for (sqlite3_stmt* stmt : chunkStmts) {
+			sqlite3_finalize (stmt);
+		}
+		chunkStmts.clear ();
+	}
+}	// namespace jlu
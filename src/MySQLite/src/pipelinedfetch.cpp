@@ -0,0 +1,167 @@
+#include "../include/pipelinedfetch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../include/boundedqueue.h"
+
+namespace jlu {
+	// Two stages: a producer thread steps the statement and copies up to batchRows rows into
+	// a Rows buffer, while the calling thread consumes the previous buffer. The buffers go
+	// round between a queue of free ones and a queue of full ones; a Rows keeps its memory
+	// when it is cleared, so after the first round only texts and blobs longer than
+	// Value::inlineBytes allocate. With interning, the buffers share the dictionaries of the
+	// first one for the whole run: only new distinct texts allocate, and a code means the
+	// same text in every batch. With no free buffer the producer waits, which keeps sqlite3
+	// from running ahead of a slow consumer.
+
+	typedef std::chrono::duration<double> seconds;
+
+	/**
+	 * @brief Rows delivered per second of the whole run.
+	 */
+	double FetchStats::rowsPerSecond () const { return (totalSeconds > 0.0) ? rows / totalSeconds : 0.0; }
+
+	/**
+	 * @brief Creates a pipelined fetcher.
+	 *
+	 * @param database The database to read. During run() the producer thread uses it and
+	 * nothing else may.
+	 * @param options Rows per batch, buffers in flight (2 is double buffering) and interning
+	 * of the texts, with dictionaries shared by the batches of a run.
+	 */
+	PipelinedFetch::PipelinedFetch (MySQLite& database, const FetchOptions& options)
+		: database (database), options (options) {
+		this->options.batchRows = std::max<size_t> (this->options.batchRows, 1);
+		this->options.buffers = std::max<size_t> (this->options.buffers, 2);
+	}
+
+	/**
+	 * @brief Run a query and hand its rows to consume in batches, stepping the next batch
+	 * while consume processes the current one.
+	 *
+	 * consume runs on the calling thread, once per batch and in order. The batch and its
+	 * values are valid only during the call: copy what must outlive it. It must not use
+	 * the database. With interning the codes hold for the whole run, but the producer adds
+	 * texts to the dictionaries meanwhile: consume may read values and their codes, and
+	 * Rows::dictionary ()->view () and size (), but not find ().
+	 *
+	 * @code .cpp
+	 * jlu::PipelinedFetch fetch (db);
+	 * double total = 0.0;
+	 * fetch.run ("SELECT value FROM data_1", [&total] (const jlu::Rows& batch) {
+	 * 		for (jlu::Rows::Row row : batch) {
+	 * 			total += row[0].asDouble ();
+	 * 		}
+	 * });
+	 * @endcode
+	 *
+	 * @param query The string to execute by sqlite3.
+	 * @param consume Called with every batch of up to batchRows rows.
+	 * @throw std::runtime_error if the SQL statement is wrong. An exception of consume
+	 * stops the producer and is rethrown.
+	 * @return FetchStats Rows, batches, and the time of each stage and of their waits: a
+	 * long producer wait means the consumer is the bottleneck, a long consumer wait means
+	 * sqlite3 is.
+	 */
+	FetchStats PipelinedFetch::run (const std::string& query, const BatchFn& consume) {
+		auto start = std::chrono::steady_clock::now ();
+		sqlite3_stmt* stmt = NULL;
+		int stmtResult = sqlite3_prepare_v2 (database.getHandle (), query.c_str (), -1, &stmt, NULL);
+		if (SQLITE_OK != stmtResult) {
+			std::string errorMsg ("Unable compile the SQL statement. Error code:" +
+								  std::to_string (stmtResult) + "\n");
+			throw std::runtime_error (errorMsg);
+		}
+
+		stats = FetchStats ();
+		std::shared_ptr<const ColumnIndex> columns = ColumnIndex::fromStatement (stmt);
+		std::vector<std::unique_ptr<Rows>> buffers;
+		BoundedQueue<Rows*> freeBuffers (options.buffers);
+		BoundedQueue<Rows*> fullBuffers (options.buffers);
+		for (size_t b = 0; b < options.buffers; b++) {
+			buffers.push_back (std::make_unique<Rows> ());
+			if (b == 0) {
+				buffers.back ()->setInterning (options.interning);
+				buffers.back ()->reset (columns);
+			} else {
+				buffers.back ()->reset (*buffers.front ());
+			}
+			freeBuffers.push (buffers.back ().get ());
+		}
+
+		int rc = SQLITE_OK;
+		seconds stepTime{0};
+		seconds producerWait{0};
+		std::thread producer ([&] {
+			Rows* batch = nullptr;
+			bool more = true;
+			while (more) {
+				auto waitBegin = std::chrono::steady_clock::now ();
+				if (!freeBuffers.pop (batch)) {
+					break;	 // The consumer stopped.
+				}
+				auto stepBegin = std::chrono::steady_clock::now ();
+				producerWait += stepBegin - waitBegin;
+				batch->clear ();
+				while (batch->size () < options.batchRows && (rc = sqlite3_step (stmt)) == SQLITE_ROW) {
+					batch->append (stmt);
+				}
+				more = (rc == SQLITE_ROW);
+				stepTime += std::chrono::steady_clock::now () - stepBegin;
+				if (!batch->empty () && !fullBuffers.push (std::move (batch))) {
+					break;
+				}
+			}
+			fullBuffers.close ();
+		});
+
+		std::exception_ptr error;
+		seconds consumeTime{0};
+		seconds consumerWait{0};
+		try {
+			Rows* batch = nullptr;
+			while (true) {
+				auto waitBegin = std::chrono::steady_clock::now ();
+				if (!fullBuffers.pop (batch)) {
+					break;
+				}
+				auto consumeBegin = std::chrono::steady_clock::now ();
+				consumerWait += consumeBegin - waitBegin;
+				consume (*batch);
+				consumeTime += std::chrono::steady_clock::now () - consumeBegin;
+				stats.rows += batch->size ();
+				stats.batches++;
+				freeBuffers.push (std::move (batch));
+			}
+		} catch (...) { error = std::current_exception (); }
+		freeBuffers.close ();
+		producer.join ();
+		sqlite3_finalize (stmt);
+
+		stats.stepSeconds = stepTime.count ();
+		stats.consumeSeconds = consumeTime.count ();
+		stats.producerWaitSeconds = producerWait.count ();
+		stats.consumerWaitSeconds = consumerWait.count ();
+		stats.totalSeconds = seconds (std::chrono::steady_clock::now () - start).count ();
+		if (error) {
+			std::rethrow_exception (error);
+		}
+		if (SQLITE_DONE != rc) {
+			std::string errorMsg ("Error in sql statement. Desc: ");
+			errorMsg += sqlite3_errmsg (database.getHandle ());
+			throw std::runtime_error (errorMsg);
+		}
+		return stats;
+	}
+
+	/**
+	 * @brief Counters of the last run().
+	 */
+	FetchStats PipelinedFetch::getStats () const { return stats; }
+}	// namespace jlu
@@ -0,0 +1,403 @@
+#include "../include/querycache.h"
+
+#include <cctype>
+#include <cstring>
+
+namespace jlu {
+	// Functions whose result changes between two runs of the same statement.
+	static const char* const volatileFunctions[] = {
+		"random",	 "randomblob",	  "changes",		  "total_changes", "last_insert_rowid",
+		"date",		 "time",		  "datetime",		  "julianday",	   "strftime",
+		"unixepoch", "current_date", "current_time", "current_timestamp"};
+
+	static std::string toLower (const std::string& text) {
+		std::string output (text);
+		for (char& c : output) {
+			c = static_cast<char> (tolower (static_cast<unsigned char> (c)));
+		}
+		return output;
+	}
+
+	/**
+	 * @brief Fraction of the lookups answered from the cache.
+	 */
+	double QueryCacheStats::hitRatio () const {
+		uint64_t lookups = hits + misses;
+		return (lookups > 0) ? static_cast<double> (hits) / lookups : 0.0;
+	}
+
+	/**
+	 * @brief Creates an empty result cache for a connection.
+	 *
+	 * Every cached result records the tables its statement reads, collected by an
+	 * authorizer while it is compiled. The authorizer is set once, here: setting one expires
+	 * every prepared statement of the connection, so doing it per lookup would make the
+	 * cached statements of the connection, of its AutoParameterizer or of a Pager be
+	 * compiled again. It does nothing outside of the compilation of query(). The entries of a table are dropped as soon as this
+	 * connection changes it (update hook). Results are not stored while this connection has
+	 * a write transaction open: they could see rows that a ROLLBACK or a ROLLBACK TO undoes
+	 * later, and sqlite3 reports no update for the undone rows. A rollback, or the rollback
+	 * of a jlu::Savepoint, also drops the whole cache. Writes of other connections are
+	 * caught with PRAGMA data_version before every lookup; they drop the whole cache, since
+	 * their tables are not known.
+	 *
+	 * Changes that the update hook does not report are detected with sqlite3_total_changes and
+	 * also drop the whole cache, as do schema changes, caught with PRAGMA schema_version
+	 * before every lookup even when the same transaction also changed rows.
+	 *
+	 * @param database An open database. It must outlive the cache, and no other authorizer
+	 * can be set on it.
+	 * @param options Memory budget of the cache and of a single result.
+	 * @throw std::runtime_error if the database is not open.
+	 */
+	QueryCache::QueryCache (MySQLite& database, const QueryCacheOptions& options)
+		: database (database),
+		  options (options),
+		  listenerId (-1),
+		  recording (nullptr),
+		  versionStmt (nullptr),
+		  schemaStmt (nullptr),
+		  dataVersion (-1),
+		  schemaVersion (-1),
+		  totalChanges (0),
+		  hookChanges (0) {
+		sqlite3* handle = database.getHandle ();
+		if (handle == nullptr) {
+			throw std::runtime_error ("QueryCache: the database is not open");
+		}
+		sqlite3_set_authorizer (handle, &QueryCache::authorize, this);
+		int rc = sqlite3_prepare_v3 (handle, "PRAGMA data_version;", -1, SQLITE_PREPARE_PERSISTENT,
+									 &versionStmt, nullptr);
+		if (rc == SQLITE_OK) {
+			rc = sqlite3_prepare_v3 (handle, "PRAGMA schema_version;", -1, SQLITE_PREPARE_PERSISTENT,
+									 &schemaStmt, nullptr);
+		}
+		if (rc != SQLITE_OK) {
+			sqlite3_set_authorizer (handle, nullptr, nullptr);
+			sqlite3_finalize (versionStmt);
+			throw std::runtime_error ("Unable compile the SQL statement. Error code:" + std::to_string (rc) +
+									  "\n");
+		}
+		totalChanges = sqlite3_total_changes (handle);
+
+		ChangeListener listener;
+		listener.onUpdate = [this] (int, const char* schema, const char* table, sqlite3_int64) {
+			onUpdate (schema, table);
+		};
+		listener.onRollback = [this] () { onRollback (); };
+		listener.onRollbackTo = [this] (const std::string&) { onRollbackTo (); };
+		listenerId = database.addChangeListener (listener);
+	}
+
+	/**
+	 * @brief Stop tracking the connection and free the results that are not in use.
+	 */
+	QueryCache::~QueryCache () {
+		database.removeChangeListener (listenerId);
+		if (database.getHandle () != nullptr) {
+			sqlite3_set_authorizer (database.getHandle (), nullptr, nullptr);
+		}
+		sqlite3_finalize (versionStmt);
+		sqlite3_finalize (schemaStmt);
+	}
+
+	/**
+	 * @brief Run a statement, or return its cached result.
+	 *
+	 * Only SELECTs that return columns and do not call time or random functions are
+	 * cached, and only outside of write transactions. Other statements run every time:
+	 * BEGIN, COMMIT, SAVEPOINT... have effects, and a PRAGMA can read a value, such as
+	 * user_version, whose change the cache would not see.
+	 * Results are immutable and shared: they stay valid after they are invalidated or
+	 * evicted, for as long as the caller keeps them.
+	 *
+	 * @param sql One statement. The key is its exact text plus the parameters.
+	 * @param params Values bound to ?1, ?2...
+	 * @return CachedResult The rows, as MySQLite::exec returns them.
+	 * @throw std::runtime_error if the statement is wrong or sql has more than one.
+	 */
+	CachedResult QueryCache::query (const std::string& sql, const std::vector<sqlValue>& params) {
+		checkDataVersion ();
+		std::string key (makeKey (sql, params));
+		auto found = entries.find (key);
+		if (found != entries.end ()) {
+			stats.hits++;
+			lruList.splice (lruList.begin (), lruList, found->second.lru);
+			return found->second.result;
+		}
+		stats.misses++;
+
+		sqlite3* handle = database.getHandle ();
+		ReadSet readSet;
+		sqlite3_stmt* stmt = nullptr;
+		const char* tail = nullptr;
+		recording = &readSet;
+		int rc = sqlite3_prepare_v2 (handle, sql.c_str (), -1, &stmt, &tail);
+		recording = nullptr;
+		if (rc != SQLITE_OK) {
+			throw std::runtime_error ("Unable compile the SQL statement. Error code:" + std::to_string (rc) +
+									  "\n");
+		}
+		// What follows the statement must compile to nothing: spaces, comments or ';'.
+		if (tail != nullptr && *tail != '\0') {
+			sqlite3_stmt* next = nullptr;
+			rc = sqlite3_prepare_v2 (handle, tail, -1, &next, nullptr);
+			sqlite3_finalize (next);
+			if (rc != SQLITE_OK || next != nullptr) {
+				sqlite3_finalize (stmt);
+				throw std::runtime_error ("QueryCache: sql has more than one statement");
+			}
+		}
+
+		for (size_t i = 0; i < params.size (); i++) {
+			int index = static_cast<int> (i + 1);
+			const sqlValue& param = params[i];
+			if (const int* number = std::get_if<int> (&param)) {
+				sqlite3_bind_int (stmt, index, *number);
+			} else if (const double* real = std::get_if<double> (&param)) {
+				sqlite3_bind_double (stmt, index, *real);
+			} else if (const std::string* text = std::get_if<std::string> (&param)) {
+				sqlite3_bind_text (stmt, index, text->data (), static_cast<int> (text->size ()),
+								   SQLITE_TRANSIENT);
+			} else {
+				const std::vector<uint8_t>& blob = std::get<std::vector<uint8_t>> (param);
+				sqlite3_bind_blob (stmt, index, blob.data (), static_cast<int> (blob.size ()), SQLITE_TRANSIENT);
+			}
+		}
+
+		std::vector<std::string> columnNames;
+		int numCols = sqlite3_column_count (stmt);
+		for (int i = 0; i < numCols; i++) {
+			columnNames.push_back (sqlite3_column_name (stmt, i));
+		}
+		std::vector<sqlRow> rows;
+		while ((rc = sqlite3_step (stmt)) == SQLITE_ROW) {
+			sqlRow row;
+			for (int i = 0; i < numCols; i++) {
+				row[columnNames[i]] = MySQLite::columnValue (stmt, i);
+			}
+			rows.push_back (std::move (row));
+		}
+		bool readOnly = sqlite3_stmt_readonly (stmt);
+		sqlite3_finalize (stmt);
+		if (rc != SQLITE_DONE) {
+			throw std::runtime_error (std::string ("Error in sql statement. Desc: ") + sqlite3_errmsg (handle));
+		}
+
+		size_t bytes = resultBytes (rows) + key.size ();
+		CachedResult result = std::make_shared<const std::vector<sqlRow>> (std::move (rows));
+		bool writing = (sqlite3_txn_state (handle, nullptr) == SQLITE_TXN_WRITE);
+		if (!readOnly || numCols == 0 || !readSet.select || !readSet.cacheable || writing || bytes > options.maxEntryBytes ||
+			bytes > options.maxBytes) {
+			stats.uncacheable++;
+			return result;
+		}
+
+		lruList.push_front (key);
+		Entry& entry = entries[key];
+		entry.result = result;
+		entry.tables.assign (readSet.tables.begin (), readSet.tables.end ());
+		entry.bytes = bytes;
+		entry.lru = lruList.begin ();
+		for (const std::string& table : entry.tables) {
+			byTable[table].insert (key);
+		}
+		stats.bytes += bytes;
+		while (stats.bytes > options.maxBytes) {
+			std::string oldest (lruList.back ());
+			erase (oldest);
+			stats.evictions++;
+		}
+		stats.entries = entries.size ();
+		return result;
+	}
+
+	/**
+	 * @brief MySQLite::exec (query, result) through the cache, for a single statement. The
+	 * rows are copied into result; query() avoids the copy.
+	 *
+	 * @throw std::runtime_error as query() does.
+	 */
+	bool QueryCache::exec (const std::string& sql, std::vector<sqlRow>& result) {
+		result = *query (sql);
+		return true;
+	}
+
+	/**
+	 * @brief Drop the cached results that read a table, e.g. after it was changed by a
+	 * mechanism the cache does not see.
+	 *
+	 * @param table Table name, optionally with its schema ("temp.data_1").
+	 */
+	void QueryCache::invalidate (const std::string& table) {
+		std::string name (toLower (table));
+		if (name.find ('.') == std::string::npos) {
+			name = "main." + name;
+		}
+		auto found = byTable.find (name);
+		if (found == byTable.end ()) {
+			return;
+		}
+		std::set<std::string> keys (found->second);
+		for (const std::string& key : keys) {
+			erase (key);
+		}
+		stats.invalidations += keys.size ();
+		stats.entries = entries.size ();
+	}
+
+	/**
+	 * @brief Drop every cached result.
+	 */
+	void QueryCache::clear () {
+		stats.invalidations += entries.size ();
+		entries.clear ();
+		byTable.clear ();
+		lruList.clear ();
+		stats.entries = 0;
+		stats.bytes = 0;
+	}
+
+	/**
+	 * @brief Hits, misses, invalidations and memory in use.
+	 */
+	QueryCacheStats QueryCache::getStats () const { return stats; }
+
+	// Private methods >>
+
+	int QueryCache::authorize (void* self,
+							   int action,
+							   const char* arg1,
+							   const char* arg2,
+							   const char* arg3,
+							   const char*) {
+		ReadSet* set = static_cast<QueryCache*> (self)->recording;
+		if (set == nullptr) {
+			return SQLITE_OK;
+		}
+		if (SQLITE_SELECT == action) {
+			set->select = true;
+		} else if (SQLITE_TRANSACTION == action || SQLITE_SAVEPOINT == action || SQLITE_PRAGMA == action) {
+			set->cacheable = false;
+		} else if (SQLITE_READ == action && arg1 != nullptr) {
+			// Also called with an empty column for tables read without columns, e.g. count(*).
+			set->tables.insert (tableKey (arg3, arg1));
+		} else if (SQLITE_FUNCTION == action && arg2 != nullptr) {
+			std::string name (toLower (arg2));
+			for (const char* function : volatileFunctions) {
+				if (name == function) {
+					set->cacheable = false;
+				}
+			}
+		}
+		return SQLITE_OK;
+	}
+
+	std::string QueryCache::tableKey (const char* schema, const char* table) {
+		return toLower (std::string (schema != nullptr ? schema : "main") + "." + table);
+	}
+
+	std::string QueryCache::makeKey (const std::string& sql, const std::vector<sqlValue>& params) {
+		std::string key (sql);
+		for (const sqlValue& param : params) {
+			key += '\0';
+			if (const int* number = std::get_if<int> (&param)) {
+				key += 'i' + std::to_string (*number);
+			} else if (const double* real = std::get_if<double> (&param)) {
+				char bytes[sizeof (double)];
+				memcpy (bytes, real, sizeof (double));
+				key += 'r';
+				key.append (bytes, sizeof (bytes));
+			} else if (const std::string* text = std::get_if<std::string> (&param)) {
+				key += 't' + std::to_string (text->size ()) + ':' + *text;
+			} else {
+				const std::vector<uint8_t>& blob = std::get<std::vector<uint8_t>> (param);
+				key += 'b' + std::to_string (blob.size ()) + ':';
+				key.append (blob.begin (), blob.end ());
+			}
+		}
+		return key;
+	}
+
+	size_t QueryCache::resultBytes (const std::vector<sqlRow>& rows) {
+		// Approximation of the heap used by the rows: map nodes, keys and values.
+		const size_t nodeOverhead = 48;
+		size_t bytes = sizeof (std::vector<sqlRow>) + rows.capacity () * sizeof (sqlRow);
+		for (const sqlRow& row : rows) {
+			for (const auto& column : row) {
+				bytes += nodeOverhead + sizeof (column) + column.first.capacity ();
+				if (const std::string* text = std::get_if<std::string> (&column.second)) {
+					bytes += text->capacity ();
+				} else if (const std::vector<uint8_t>* blob = std::get_if<std::vector<uint8_t>> (&column.second)) {
+					bytes += blob->capacity ();
+				}
+			}
+		}
+		return bytes;
+	}
+
+	void QueryCache::checkDataVersion () {
+		int64_t version = -1;
+		if (sqlite3_step (versionStmt) == SQLITE_ROW) {
+			version = sqlite3_column_int64 (versionStmt, 0);
+		}
+		sqlite3_reset (versionStmt);
+		if (version != dataVersion) {
+			clear ();
+			dataVersion = version;
+		}
+
+		version = -1;
+		if (sqlite3_step (schemaStmt) == SQLITE_ROW) {
+			version = sqlite3_column_int64 (schemaStmt, 0);
+		}
+		sqlite3_reset (schemaStmt);
+		if (version != schemaVersion) {
+			clear ();
+			schemaVersion = version;
+		}
+
+		int64_t changes = sqlite3_total_changes (database.getHandle ());
+		if (static_cast<uint64_t> (changes - totalChanges) > hookChanges) {
+			clear ();
+		}
+		totalChanges = changes;
+		hookChanges = 0;
+	}
+
+	void QueryCache::erase (const std::string& key) {
+		auto found = entries.find (key);
+		if (found == entries.end ()) {
+			return;
+		}
+		for (const std::string& table : found->second.tables) {
+			auto keys = byTable.find (table);
+			if (keys != byTable.end ()) {
+				keys->second.erase (key);
+				if (keys->second.empty ()) {
+					byTable.erase (keys);
+				}
+			}
+		}
+		stats.bytes -= found->second.bytes;
+		lruList.erase (found->second.lru);
+		entries.erase (found);
+	}
+
+	void QueryCache::onUpdate (const char* schema, const char* table) {
+		if (!entries.empty ()) {
+			invalidate (tableKey (schema, table));
+		}
+		hookChanges++;
+	}
+
+	void QueryCache::onRollbackTo () {
+		// The undone rows were not reported: the results of their tables are not known.
+		clear ();
+	}
+
+	void QueryCache::onRollback () {
+		// Results cached during the transaction saw its uncommitted rows.
+		clear ();
+	}
+}	// namespace jlu
@@ -0,0 +1,253 @@
+#include "../include/rows.h"
+
+#include <stdexcept>
+
+namespace jlu {
+	// Rows keeps every cell of a result in one vector, row after row, and the names of the
+	// columns once, in a ColumnIndex shared by every row (and by copies of the result).
+	// ColumnIndex is a perfect hash: a seed is searched until every name gets its own slot,
+	// so a lookup is one hash and one string comparison.
+	//
+	// With interning on, the texts are stored once in a StringDictionary, of the result or
+	// of each column, and their cells only hold its pointer and a code. The dictionaries
+	// are shared by copies of the result, like the index.
+
+	// Seeds tried before the table of slots doubles.
+	static const int seedsPerSize = 32;
+
+	/**
+	 * @brief Build the index of a list of column names.
+	 *
+	 * @param names Names in column order. If a name repeats, find() returns its first
+	 * column.
+	 */
+	ColumnIndex::ColumnIndex (const std::vector<std::string>& names) : columnNames (names), seed (0), mask (0) {
+		std::vector<int> unique;
+		for (size_t col = 0; col < columnNames.size (); col++) {
+			bool repeated = false;
+			for (int previous : unique) {
+				repeated = repeated || columnNames[previous] == columnNames[col];
+			}
+			if (!repeated) {
+				unique.push_back (static_cast<int> (col));
+			}
+		}
+
+		size_t tableSize = 1;
+		while (tableSize < 2 * unique.size ()) {
+			tableSize <<= 1;
+		}
+		for (int attempt = 0;; attempt++) {
+			if (attempt > 0 && attempt % seedsPerSize == 0) {
+				tableSize <<= 1;
+			}
+			seed = static_cast<uint64_t> (attempt);
+			mask = tableSize - 1;
+			slots.assign (tableSize, -1);
+			bool collision = false;
+			for (size_t u = 0; u < unique.size () && !collision; u++) {
+				int& slot = slots[hash (columnNames[unique[u]], seed) & mask];
+				collision = (slot >= 0);
+				slot = unique[u];
+			}
+			if (!collision) {
+				break;
+			}
+		}
+	}
+
+	/**
+	 * @brief Index of the columns of a prepared statement.
+	 */
+	std::shared_ptr<const ColumnIndex> ColumnIndex::fromStatement (sqlite3_stmt* stmt) {
+		std::vector<std::string> names;
+		int numCols = sqlite3_column_count (stmt);
+		for (int col = 0; col < numCols; col++) {
+			const char* columnName = sqlite3_column_name (stmt, col);
+			names.push_back ((columnName != nullptr) ? columnName : "");
+		}
+		return std::make_shared<const ColumnIndex> (names);
+	}
+
+	/**
+	 * @brief Position of a column.
+	 *
+	 * @return int The column, starting at 0, or -1 if no column has this name.
+	 */
+	int ColumnIndex::find (std::string_view name) const {
+		int col = slots[hash (name, seed) & mask];
+		return (col >= 0 && columnNames[col] == name) ? col : -1;
+	}
+
+	size_t ColumnIndex::size () const { return columnNames.size (); }
+
+	const std::string& ColumnIndex::name (size_t col) const { return columnNames[col]; }
+
+	const std::vector<std::string>& ColumnIndex::names () const { return columnNames; }
+
+	/**
+	 * @brief The cell of a column, without checks, like std::vector::operator[].
+	 */
+	const Value& Rows::Row::operator[] (size_t col) const { return cells[col]; }
+
+	/**
+	 * @brief The cell of a column by name.
+	 *
+	 * @throw std::runtime_error if no column has this name.
+	 */
+	const Value& Rows::Row::operator[] (std::string_view name) const {
+		int col = index->find (name);
+		if (col < 0) {
+			throw std::runtime_error ("Rows: no column named " + std::string (name));
+		}
+		return cells[col];
+	}
+
+	size_t Rows::Row::size () const { return index->size (); }
+
+	const Value* Rows::Row::begin () const { return cells; }
+
+	const Value* Rows::Row::end () const { return cells + index->size (); }
+
+	Rows::Row::Row (const Value* cells, const ColumnIndex* index) : cells (cells), index (index) {}
+
+	Rows::Row Rows::Iterator::operator* () const { return (*rows)[row]; }
+
+	Rows::Iterator& Rows::Iterator::operator++ () {
+		row++;
+		return *this;
+	}
+
+	bool Rows::Iterator::operator!= (const Iterator& other) const { return row != other.row || rows != other.rows; }
+
+	Rows::Iterator::Iterator (const Rows* rows, size_t row) : rows (rows), row (row) {}
+
+	/**
+	 * @brief An empty result, without columns.
+	 */
+	Rows::Rows ()
+		: index (std::make_shared<const ColumnIndex> ()), interning (Interning::Off), maxEntries (65536), rowCount (0) {}
+
+	/**
+	 * @brief Store the texts of the next results in dictionaries, for columns that repeat
+	 * a few distinct values (e.g. a resource name on millions of rows): every distinct
+	 * text is stored once, and its cells get Value::interned values whose code() can be
+	 * grouped by.
+	 *
+	 * @param mode Off, one dictionary for the result (codes comparable across columns) or
+	 * one per column (dense codes in each column).
+	 * @param maxEntries Distinct texts of a dictionary. Once it is full, new texts are
+	 * stored as plain values, so a column with many distinct texts costs little more.
+	 */
+	void Rows::setInterning (Interning mode, size_t maxEntries) {
+		interning = mode;
+		this->maxEntries = maxEntries;
+	}
+
+	/**
+	 * @brief Drop the rows and set the columns of the next ones.
+	 */
+	void Rows::reset (std::shared_ptr<const ColumnIndex> index) {
+		this->index = std::move (index);
+		cells.clear ();
+		rowCount = 0;
+		dictionaries.clear ();
+		size_t count = (interning == Interning::PerResult) ? 1
+					   : (interning == Interning::PerColumn) ? this->index->size ()
+															 : 0;
+		for (size_t d = 0; d < count; d++) {
+			dictionaries.push_back (std::make_shared<StringDictionary> (maxEntries));
+		}
+	}
+
+	/**
+	 * @brief Drop the rows and take the columns, the interning mode and the dictionaries of
+	 * another result, so that a code means the same text in both.
+	 */
+	void Rows::reset (const Rows& other) {
+		index = other.index;
+		interning = other.interning;
+		maxEntries = other.maxEntries;
+		cells.clear ();
+		rowCount = 0;
+		dictionaries = other.dictionaries;
+	}
+
+	/**
+	 * @brief Copy the current row of a statement, whose columns must be the ones given to
+	 * reset().
+	 *
+	 * @param stmt A statement whose last sqlite3_step returned SQLITE_ROW.
+	 */
+	void Rows::append (sqlite3_stmt* stmt) {
+		int numCols = static_cast<int> (index->size ());
+		for (int col = 0; col < numCols; col++) {
+			if (!dictionaries.empty () && sqlite3_column_type (stmt, col) == SQLITE_TEXT) {
+				StringDictionary* dictionary = dictionaries[(dictionaries.size () == 1) ? 0 : col].get ();
+				const char* text = reinterpret_cast<const char*> (sqlite3_column_text (stmt, col));
+				uint32_t code = dictionary->intern (std::string_view (text, sqlite3_column_bytes (stmt, col)));
+				if (code != Value::noCode) {
+					cells.push_back (Value::interned (dictionary, code));
+					continue;
+				}
+			}
+			cells.push_back (Value::fromColumn (stmt, col));
+		}
+		rowCount++;
+	}
+
+	/**
+	 * @brief Drop the rows, keeping the columns and the memory.
+	 */
+	void Rows::clear () {
+		cells.clear ();
+		rowCount = 0;
+	}
+
+	size_t Rows::size () const { return rowCount; }
+
+	bool Rows::empty () const { return rowCount == 0; }
+
+	size_t Rows::columnCount () const { return index->size (); }
+
+	/**
+	 * @brief A view of one row. It is valid until the result changes or is destroyed.
+	 */
+	Rows::Row Rows::operator[] (size_t row) const { return Row (cells.data () + row * index->size (), index.get ()); }
+
+	Rows::Iterator Rows::begin () const { return Iterator (this, 0); }
+
+	Rows::Iterator Rows::end () const { return Iterator (this, rowCount); }
+
+	const ColumnIndex& Rows::columns () const { return *index; }
+
+	/**
+	 * @brief The column index, to keep or to share with another result of the same
+	 * statement.
+	 */
+	std::shared_ptr<const ColumnIndex> Rows::sharedColumns () const { return index; }
+
+	/**
+	 * @brief The dictionary of the texts of a column, nullptr if interning is off.
+	 */
+	const StringDictionary* Rows::dictionary (size_t col) const {
+		if (dictionaries.empty ()) {
+			return nullptr;
+		}
+		return dictionaries[(dictionaries.size () == 1) ? 0 : col].get ();
+	}
+
+	// Private methods >>
+
+	uint64_t ColumnIndex::hash (std::string_view name, uint64_t seed) {
+		uint64_t output = 14695981039346656037ull ^ (seed * 0x9e3779b97f4a7c15ull);
+		for (unsigned char c : name) {
+			output ^= c;
+			output *= 1099511628211ull;
+		}
+		output ^= output >> 33;
+		output *= 0xff51afd7ed558ccdull;
+		output ^= output >> 33;
+		return output;
+	}
+}	// namespace jlu
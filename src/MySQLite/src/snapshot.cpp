@@ -0,0 +1,313 @@
+#include "../include/snapshot.h"
+
+#include <algorithm>
+
+namespace jlu {
+	/**
+	 * @brief Creates an empty snapshot. isValid() is false.
+	 */
+	Snapshot::Snapshot () : schema ("main") {}
+
+	/**
+	 * @brief Capture the point in time seen by the read transaction of a connection.
+	 *
+	 * The snapshot can be opened on other connections to the same file while the WAL still
+	 * holds it: keeping a read transaction open on it, as ReaderPool does, guarantees that
+	 * checkpoints do not overwrite it.
+	 *
+	 * @param conn A connection of a WAL database inside a read transaction (BEGIN and a
+	 * first SELECT) with no pending writes.
+	 * @param schema Attached database name.
+	 * @return Snapshot The captured snapshot. Copies share it.
+	 * @throw std::runtime_error if the snapshot can not be taken: the database is not in WAL
+	 * mode, the connection is not in a read transaction or nothing was ever written to the
+	 * WAL file.
+	 */
+	Snapshot Snapshot::capture (sqlite3* conn, const std::string& schema) {
+#ifdef SQLITE_ENABLE_SNAPSHOT
+		sqlite3_snapshot* handle = nullptr;
+		int rc = sqlite3_snapshot_get (conn, schema.c_str (), &handle);
+		if (rc != SQLITE_OK) {
+			throw std::runtime_error (std::string ("Snapshot: unable to get the snapshot. Error: ") +
+									  sqlite3_errstr (rc));
+		}
+		Snapshot result;
+		result.snapshot.reset (handle, &sqlite3_snapshot_free);
+		result.schema = schema;
+		return result;
+#else
+		(void)conn;
+		(void)schema;
+		throw std::runtime_error ("Snapshot: sqlite3 was built without SQLITE_ENABLE_SNAPSHOT");
+#endif
+	}
+
+	/**
+	 * @brief Start a read transaction on the connection that sees the database as it was
+	 * when the snapshot was captured. End it with COMMIT or ROLLBACK.
+	 *
+	 * @param conn A connection to the same database file, in autocommit mode or right
+	 * after BEGIN.
+	 * @throw std::runtime_error if the snapshot is empty or no longer available
+	 * (SQLITE_ERROR_SNAPSHOT: a checkpoint overwrote it).
+	 */
+	void Snapshot::open (sqlite3* conn) const {
+		if (!snapshot) {
+			throw std::runtime_error ("Snapshot: the snapshot is empty");
+		}
+#ifdef SQLITE_ENABLE_SNAPSHOT
+		bool began = false;
+		if (sqlite3_get_autocommit (conn)) {
+			if (sqlite3_exec (conn, "BEGIN;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+				throw std::runtime_error (std::string ("Error in sql statement. Desc: ") + sqlite3_errmsg (conn));
+			}
+			began = true;
+		}
+		int rc = sqlite3_snapshot_open (conn, schema.c_str (), snapshot.get ());
+		if (rc != SQLITE_OK) {
+			if (began) {
+				sqlite3_exec (conn, "ROLLBACK;", nullptr, nullptr, nullptr);
+			}
+			throw std::runtime_error (std::string ("Snapshot: unable to open the snapshot. Error: ") +
+									  sqlite3_errstr (rc));
+		}
+#else
+		(void)conn;
+#endif
+	}
+
+	/**
+	 * @brief True if the object holds a captured snapshot.
+	 */
+	bool Snapshot::isValid () const { return static_cast<bool> (snapshot); }
+
+	/**
+	 * @brief Order of two snapshots of the same database.
+	 *
+	 * @return int Negative if this snapshot is older than other, 0 if they are the same
+	 * point in time and positive if it is newer.
+	 * @throw std::runtime_error if one of them is empty.
+	 */
+	int Snapshot::compare (const Snapshot& other) const {
+		if (!snapshot || !other.snapshot) {
+			throw std::runtime_error ("Snapshot: the snapshot is empty");
+		}
+#ifdef SQLITE_ENABLE_SNAPSHOT
+		return sqlite3_snapshot_cmp (snapshot.get (), other.snapshot.get ());
+#else
+		return 0;
+#endif
+	}
+
+	/**
+	 * @brief Open size read-only connections to the file of the database.
+	 *
+	 * @param database An open database stored in a file, preferably in WAL mode.
+	 * @param size Number of readers, at least 1.
+	 * @param busyTimeoutMs Busy timeout of the readers.
+	 * @throw std::runtime_error if the database is not a file or a reader can not be open.
+	 */
+	ReaderPool::ReaderPool (MySQLite& database, size_t size, int busyTimeoutMs)
+		: busyTimeoutMs (busyTimeoutMs), gate (nullptr), reading (false) {
+		sqlite3* handle = database.getHandle ();
+		if (handle == nullptr) {
+			throw std::runtime_error ("ReaderPool: the database is not open");
+		}
+		const char* name = sqlite3_db_filename (handle, "main");
+		if (name == nullptr || name[0] == '\0') {
+			throw std::runtime_error ("ReaderPool: the database must be an on disk file");
+		}
+		fileName = name;
+
+		readers.resize (std::max<size_t> (1, size), nullptr);
+		for (sqlite3*& conn : readers) {
+			int rc = sqlite3_open_v2 (fileName.c_str (), &conn, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX,
+									  nullptr);
+			if (rc != SQLITE_OK) {
+				std::string error ("ReaderPool: unable to open DB. Error: ");
+				error += sqlite3_errmsg (conn);
+				close ();
+				throw std::runtime_error (error);
+			}
+			sqlite3_busy_timeout (conn, busyTimeoutMs);
+		}
+	}
+
+	/**
+	 * @brief End the read transaction, if any, and close the readers.
+	 */
+	ReaderPool::~ReaderPool () { close (); }
+
+	/**
+	 * @brief Number of readers.
+	 */
+	size_t ReaderPool::size () const { return readers.size (); }
+
+	/**
+	 * @brief Connection of a reader. Use each one from a single thread at a time.
+	 */
+	sqlite3* ReaderPool::reader (size_t index) { return readers.at (index); }
+
+	/**
+	 * @brief Start a read transaction on every reader.
+	 *
+	 * With consistent, all of them see the same point in time: the first reader starts a
+	 * transaction, its snapshot is captured with sqlite3_snapshot_get and opened on the
+	 * others with sqlite3_snapshot_open, so writers are never blocked. When no snapshot can
+	 * be taken (rollback journal, or a WAL file that was never written) the readers start
+	 * while a separate connection holds the write lock instead.
+	 *
+	 * @param consistent False lets every reader start its own transaction independently.
+	 * @throw std::runtime_error if a transaction is already open or can not be started.
+	 */
+	void ReaderPool::begin (bool consistent) {
+		if (reading) {
+			throw std::runtime_error ("ReaderPool: the readers are already in a read transaction");
+		}
+		snapshot = Snapshot ();
+		size_t started = 0;
+		bool holding = false;
+		try {
+			if (consistent) {
+				startRead (readers[0]);
+				started = 1;
+				if (captureSnapshot ()) {
+					for (; started < readers.size (); started++) {
+						snapshot.open (readers[started]);
+					}
+				} else {
+					rollback (started);
+					started = 0;
+					holdWriters ();
+					holding = true;
+				}
+			}
+			for (; started < readers.size (); started++) {
+				startRead (readers[started]);
+			}
+		} catch (...) {
+			rollback (started);
+			if (holding) {
+				releaseWriters ();
+			}
+			throw;
+		}
+		if (holding) {
+			releaseWriters ();
+		}
+		reading = true;
+	}
+
+	/**
+	 * @brief Start a read transaction on every reader at a snapshot captured before, e.g. on
+	 * the main connection, so several fan-out queries report the same point in time.
+	 *
+	 * @throw std::runtime_error if a transaction is already open or the snapshot can not be
+	 * opened.
+	 */
+	void ReaderPool::begin (const Snapshot& at) {
+		if (reading) {
+			throw std::runtime_error ("ReaderPool: the readers are already in a read transaction");
+		}
+		size_t started = 0;
+		try {
+			for (; started < readers.size (); started++) {
+				at.open (readers[started]);
+			}
+		} catch (...) {
+			rollback (started);
+			throw;
+		}
+		snapshot = at;
+		reading = true;
+	}
+
+	/**
+	 * @brief End the read transaction of every reader. Their statements must be reset.
+	 */
+	void ReaderPool::end () {
+		if (!reading) {
+			return;
+		}
+		for (sqlite3* conn : readers) {
+			sqlite3_exec (conn, "COMMIT;", nullptr, nullptr, nullptr);
+		}
+		reading = false;
+	}
+
+	/**
+	 * @brief True between begin() and end().
+	 */
+	bool ReaderPool::inRead () const { return reading; }
+
+	/**
+	 * @brief Snapshot shared by the readers in the current read transaction. It is empty if
+	 * the transaction did not use one.
+	 */
+	const Snapshot& ReaderPool::getSnapshot () const { return snapshot; }
+
+	// Private methods >>
+
+	void ReaderPool::startRead (sqlite3* conn) {
+		// A deferred transaction only takes its snapshot on the first read.
+		if (sqlite3_exec (conn, "BEGIN; SELECT 1 FROM sqlite_master LIMIT 1;", nullptr, nullptr, nullptr) !=
+			SQLITE_OK) {
+			std::string error ("Error in sql statement. Desc: ");
+			error += sqlite3_errmsg (conn);
+			if (!sqlite3_get_autocommit (conn)) {
+				sqlite3_exec (conn, "ROLLBACK;", nullptr, nullptr, nullptr);
+			}
+			throw std::runtime_error (error);
+		}
+	}
+
+	bool ReaderPool::captureSnapshot () {
+#ifdef SQLITE_ENABLE_SNAPSHOT
+		try {
+			snapshot = Snapshot::capture (readers[0]);
+			return true;
+		} catch (std::runtime_error&) {
+			return false;
+		}
+#else
+		return false;
+#endif
+	}
+
+	void ReaderPool::holdWriters () {
+		if (gate == nullptr) {
+			int rc = sqlite3_open_v2 (fileName.c_str (), &gate, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX,
+									  nullptr);
+			if (rc != SQLITE_OK) {
+				std::string error ("ReaderPool: unable to open DB. Error: ");
+				error += sqlite3_errmsg (gate);
+				sqlite3_close (gate);
+				gate = nullptr;
+				throw std::runtime_error (error);
+			}
+			sqlite3_busy_timeout (gate, busyTimeoutMs);
+		}
+		if (sqlite3_exec (gate, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) != SQLITE_OK) {
+			throw std::runtime_error (std::string ("ReaderPool: unable to hold writers. Error: ") +
+									  sqlite3_errmsg (gate));
+		}
+	}
+
+	void ReaderPool::releaseWriters () { sqlite3_exec (gate, "ROLLBACK;", nullptr, nullptr, nullptr); }
+
+	void ReaderPool::rollback (size_t count) {
+		for (size_t i = 0; i < count; i++) {
+			sqlite3_exec (readers[i], "ROLLBACK;", nullptr, nullptr, nullptr);
+		}
+	}
+
+	void ReaderPool::close () {
+		end ();
+		for (sqlite3* conn : readers) {
+			sqlite3_close (conn);
+		}
+		readers.clear ();
+		sqlite3_close (gate);
+		gate = nullptr;
+	}
+}	// namespace jlu
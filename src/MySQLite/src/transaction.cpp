@@ -0,0 +1,186 @@
+#include "../include/transaction.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace jlu {
+	// Transaction and Savepoint run their BEGIN, COMMIT, SAVEPOINT... through the cache of
+	// prepared statements of the connection, so a short transaction does not parse SQL.
+	// A guard that is still active when it is destroyed, e.g. because an exception unwinds
+	// the stack, rolls back; its destructor never throws.
+
+	typedef std::chrono::duration<double> seconds;
+
+	static const char* beginSql (TransactionMode mode) {
+		switch (mode) {
+			case TransactionMode::Immediate:
+				return "BEGIN IMMEDIATE;";
+			case TransactionMode::Exclusive:
+				return "BEGIN EXCLUSIVE;";
+			default:
+				return "BEGIN DEFERRED;";
+		}
+	}
+
+	/**
+	 * @brief Begin a transaction.
+	 *
+	 * @param database An open database, without an open transaction (use a Savepoint to nest).
+	 * @param mode DEFERRED takes the write lock at the first write, which can fail with
+	 * SQLITE_BUSY if another connection wrote since this one read. IMMEDIATE takes it now,
+	 * so a transaction that will write waits (busy timeout) or fails before doing any
+	 * work. EXCLUSIVE also keeps readers out in rollback journal mode; in WAL mode it is
+	 * IMMEDIATE.
+	 * @throw std::runtime_error if a transaction is open or sqlite3 cannot begin (e.g.
+	 * SQLITE_BUSY for IMMEDIATE).
+	 */
+	Transaction::Transaction (MySQLite& database, TransactionMode mode)
+		: database (database), mode (mode), active (false), lockSeconds (0.0) {
+		if (sqlite3_get_autocommit (database.getHandle ()) == 0) {
+			throw std::runtime_error ("Transaction: a transaction is already open, use a Savepoint");
+		}
+		database.stepCached (beginSql (mode));
+		begin = std::chrono::steady_clock::now ();
+		active = true;
+	}
+
+	Transaction::~Transaction () {
+		if (active) {
+			try {
+				rollback ();
+			} catch (std::exception& e) {
+				std::cerr << "Error at rollback of a transaction in destructor method. Desc.: " << e.what ()
+						  << std::endl;
+			}
+		}
+	}
+
+	/**
+	 * @brief Commit. If it fails (e.g. SQLITE_BUSY while readers hold the database in
+	 * rollback journal mode), the transaction stays active: commit () can be called again,
+	 * or the destructor rolls back.
+	 *
+	 * @throw std::runtime_error if the transaction is not active or sqlite3 cannot commit.
+	 */
+	void Transaction::commit () {
+		if (!active) {
+			throw std::runtime_error ("Transaction: commit of a finished transaction");
+		}
+		bool wrote = (sqlite3_txn_state (database.getHandle (), nullptr) == SQLITE_TXN_WRITE);
+		database.stepCached ("COMMIT;");
+		finish (true, wrote);
+	}
+
+	/**
+	 * @brief Roll back. Nothing to do if sqlite3 has already rolled back after an error.
+	 *
+	 * @throw std::runtime_error if the transaction is not active or sqlite3 cannot roll back.
+	 */
+	void Transaction::rollback () {
+		if (!active) {
+			throw std::runtime_error ("Transaction: rollback of a finished transaction");
+		}
+		bool wrote = (sqlite3_txn_state (database.getHandle (), nullptr) == SQLITE_TXN_WRITE);
+		if (sqlite3_get_autocommit (database.getHandle ()) == 0) {
+			database.stepCached ("ROLLBACK;");
+		}
+		finish (false, wrote);
+	}
+
+	bool Transaction::isActive () const { return active; }
+
+	/**
+	 * @brief Time the transaction held the write lock, known once it is finished.
+	 *
+	 * IMMEDIATE and EXCLUSIVE transactions hold it from begin to the end. A DEFERRED one
+	 * counts from begin too if it wrote, since sqlite3 does not tell when the lock was
+	 * taken, and 0 if it only read.
+	 */
+	double Transaction::writeLockSeconds () const { return lockSeconds; }
+
+	// Private methods >>
+
+	void Transaction::finish (bool committed, bool wrote) {
+		active = false;
+		TransactionStats& stats = database.transactionStats;
+		if (committed) {
+			stats.commits++;
+		} else {
+			stats.rollbacks++;
+		}
+		lockSeconds = (mode != TransactionMode::Deferred || wrote)
+						  ? seconds (std::chrono::steady_clock::now () - begin).count ()
+						  : 0.0;
+		stats.writeLockSeconds += lockSeconds;
+		stats.maxWriteLockSeconds = std::max (stats.maxWriteLockSeconds, lockSeconds);
+	}
+
+	/**
+	 * @brief Open a savepoint, inside a transaction or as a DEFERRED transaction of its own.
+	 * Savepoints nest: each one must be finished before the one it was opened in.
+	 *
+	 * @param database An open database.
+	 * @throw std::runtime_error if sqlite3 cannot open the savepoint.
+	 */
+	Savepoint::Savepoint (MySQLite& database)
+		: database (database), name ("jlu_savepoint_" + std::to_string (database.savepointDepth)), active (false) {
+		database.stepCached ("SAVEPOINT " + name + ";");
+		database.savepointDepth++;
+		active = true;
+		database.savepointHook (name);
+	}
+
+	Savepoint::~Savepoint () {
+		if (active) {
+			try {
+				rollback ();
+			} catch (std::exception& e) {
+				std::cerr << "Error at rollback of a savepoint in destructor method. Desc.: " << e.what ()
+						  << std::endl;
+			}
+		}
+	}
+
+	/**
+	 * @brief Keep the changes made since the savepoint: they are part of the enclosing
+	 * transaction, or committed if the savepoint began the transaction.
+	 *
+	 * @throw std::runtime_error if the savepoint is not active or sqlite3 cannot release it.
+	 */
+	void Savepoint::release () {
+		if (!active) {
+			throw std::runtime_error ("Savepoint: release of a finished savepoint");
+		}
+		database.stepCached ("RELEASE " + name + ";");
+		active = false;
+		database.savepointDepth--;
+	}
+
+	/**
+	 * @brief Undo the changes made since the savepoint and close it. The enclosing
+	 * transaction goes on. The onRollbackTo callbacks of the connection's listeners are
+	 * called.
+	 *
+	 * @throw std::runtime_error if the savepoint is not active or sqlite3 cannot roll back.
+	 */
+	void Savepoint::rollback () {
+		if (!active) {
+			throw std::runtime_error ("Savepoint: rollback of a finished savepoint");
+		}
+		active = false;
+		database.savepointDepth--;
+		// Nothing to undo if the enclosing transaction is already gone.
+		if (sqlite3_get_autocommit (database.getHandle ()) == 0) {
+			database.stepCached ("ROLLBACK TO " + name + ";");
+			database.rollbackToHook (name);
+			database.stepCached ("RELEASE " + name + ";");
+		}
+	}
+
+	bool Savepoint::isActive () const { return active; }
+
+	/**
+	 * @brief The SQL name of the savepoint, for statements of its own (ROLLBACK TO...).
+	 */
+	const std::string& Savepoint::getName () const { return name; }
+}	// namespace jlu
@@ -0,0 +1,812 @@
+#include "../include/uringvfs.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "../include/sqlite3.h"
+#include "../include/vfsshim.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define JLU_HAVE_IO_URING
+#endif
+#endif
+
+namespace jlu {
+	namespace uringvfs {
+		// Files opened through the "uring" VFS wrap a file of the default VFS, which keeps
+		// doing the open, locks, shared memory, reads and the first sync (it also syncs the
+		// directory of a new file). Writes are copied into buffers registered with an
+		// io_uring instance and submitted together, with the fdatasync of xSync chained after
+		// them, when the file is synced, read where they are pending, unlocked or, for the
+		// WAL, when the WAL index is published to other connections (xShmBarrier/xShmLock).
+
+		const char* const name = "uring";
+
+		// Private file control that returns the UringFile of a database file.
+		static const int fileControlSelf = 0x4a4c5501;
+
+		static Options vfsOptions;
+		static sqlite3_vfs uringVfs;
+		static std::mutex registerMtx;
+
+		static std::atomic<uint64_t> statFiles (0);
+		static std::atomic<uint64_t> statFallbackFiles (0);
+		static std::atomic<uint64_t> statSubmissions (0);
+		static std::atomic<uint64_t> statWrites (0);
+		static std::atomic<uint64_t> statCoalescedWrites (0);
+		static std::atomic<uint64_t> statBytes (0);
+		static std::atomic<uint64_t> statSyncs (0);
+
+#ifdef JLU_HAVE_IO_URING
+		// Minimal io_uring set up with the raw system calls, so liburing is not needed.
+		class Ring {
+		   public:
+			Ring () = default;
+			Ring (const Ring&) = delete;
+			Ring& operator= (const Ring&) = delete;
+
+			~Ring () {
+				if (sqes != nullptr) {
+					munmap (sqes, sqesBytes);
+				}
+				if (cqRing != nullptr && cqRing != sqRing) {
+					munmap (cqRing, cqBytes);
+				}
+				if (sqRing != nullptr) {
+					munmap (sqRing, sqBytes);
+				}
+				if (fd >= 0) {
+					::close (fd);
+				}
+			}
+
+			bool init (unsigned entries) {
+				io_uring_params params;
+				memset (&params, 0, sizeof (params));
+				fd = static_cast<int> (syscall (__NR_io_uring_setup, entries, &params));
+				if (fd < 0) {
+					return false;
+				}
+				sqBytes = params.sq_off.array + params.sq_entries * sizeof (unsigned);
+				cqBytes = params.cq_off.cqes + params.cq_entries * sizeof (io_uring_cqe);
+				bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+				if (singleMap) {
+					sqBytes = cqBytes = std::max (sqBytes, cqBytes);
+				}
+				sqRing = map (sqBytes, IORING_OFF_SQ_RING);
+				cqRing = singleMap ? sqRing : map (cqBytes, IORING_OFF_CQ_RING);
+				sqesBytes = params.sq_entries * sizeof (io_uring_sqe);
+				sqes = static_cast<io_uring_sqe*> (map (sqesBytes, IORING_OFF_SQES));
+				if (sqRing == nullptr || cqRing == nullptr || sqes == nullptr) {
+					return false;
+				}
+
+				char* sq = static_cast<char*> (sqRing);
+				sqHead = reinterpret_cast<unsigned*> (sq + params.sq_off.head);
+				sqTail = reinterpret_cast<unsigned*> (sq + params.sq_off.tail);
+				sqMask = *reinterpret_cast<unsigned*> (sq + params.sq_off.ring_mask);
+				sqArray = reinterpret_cast<unsigned*> (sq + params.sq_off.array);
+				sqEntries = params.sq_entries;
+				char* cq = static_cast<char*> (cqRing);
+				cqHead = reinterpret_cast<unsigned*> (cq + params.cq_off.head);
+				cqTail = reinterpret_cast<unsigned*> (cq + params.cq_off.tail);
+				cqMask = *reinterpret_cast<unsigned*> (cq + params.cq_off.ring_mask);
+				cqes = reinterpret_cast<io_uring_cqe*> (cq + params.cq_off.cqes);
+				localTail = *sqTail;
+				return true;
+			}
+
+			bool registerBuffers (const iovec* buffers, unsigned count) {
+				return syscall (__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, buffers, count) == 0;
+			}
+
+			// Zeroed entry at the tail of the submission queue, or nullptr if it is full.
+			io_uring_sqe* nextSqe () {
+				unsigned head = __atomic_load_n (sqHead, __ATOMIC_ACQUIRE);
+				if (localTail - head >= sqEntries) {
+					return nullptr;
+				}
+				unsigned index = localTail & sqMask;
+				io_uring_sqe* sqe = &sqes[index];
+				memset (sqe, 0, sizeof (*sqe));
+				sqArray[index] = index;
+				localTail++;
+				return sqe;
+			}
+
+			// Submit up to toSubmit queued entries and wait for waitFor completions.
+			// Returns the entries submitted or -errno.
+			int enter (unsigned toSubmit, unsigned waitFor) {
+				__atomic_store_n (sqTail, localTail, __ATOMIC_RELEASE);
+				long rc = syscall (__NR_io_uring_enter, fd, toSubmit, waitFor,
+								   (waitFor > 0) ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+				return (rc < 0) ? -errno : static_cast<int> (rc);
+			}
+
+			bool reap (io_uring_cqe& cqe) {
+				unsigned head = *cqHead;
+				if (head == __atomic_load_n (cqTail, __ATOMIC_ACQUIRE)) {
+					return false;
+				}
+				cqe = cqes[head & cqMask];
+				__atomic_store_n (cqHead, head + 1, __ATOMIC_RELEASE);
+				return true;
+			}
+
+			unsigned entries () const { return sqEntries; }
+
+		   private:
+			void* map (size_t bytes, off_t offset) {
+				void* address = mmap (nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+				return (address == MAP_FAILED) ? nullptr : address;
+			}
+
+			int fd = -1;
+			void* sqRing = nullptr;
+			void* cqRing = nullptr;
+			io_uring_sqe* sqes = nullptr;
+			size_t sqBytes = 0;
+			size_t cqBytes = 0;
+			size_t sqesBytes = 0;
+			unsigned* sqHead = nullptr;
+			unsigned* sqTail = nullptr;
+			unsigned* sqArray = nullptr;
+			unsigned sqMask = 0;
+			unsigned sqEntries = 0;
+			unsigned localTail = 0;
+			unsigned* cqHead = nullptr;
+			unsigned* cqTail = nullptr;
+			unsigned cqMask = 0;
+			io_uring_cqe* cqes = nullptr;
+		};
+
+		// Pending writes of one file, in registered buffers. A write that follows the last one
+		// is appended to its buffer, one that overwrites pending bytes replaces them.
+		class BatchWriter {
+		   public:
+			BatchWriter () = default;
+			BatchWriter (const BatchWriter&) = delete;
+			BatchWriter& operator= (const BatchWriter&) = delete;
+			~BatchWriter () { free (buffers); }
+
+			// Writers are reused across files, e.g. the journal of every transaction.
+			void attach (int file) {
+				fd = file;
+				used = 0;
+				synced = false;
+			}
+
+			bool matches (const Options& options) const {
+				return slotCount == std::max (options.bufferSlots, 1u) &&
+					   slotBytes == std::max<size_t> (options.slotBytes, 4096);
+			}
+
+			bool init () {
+				slotCount = std::max (vfsOptions.bufferSlots, 1u);
+				slotBytes = std::max<size_t> (vfsOptions.slotBytes, 4096);
+				// One more entry for the fdatasync.
+				unsigned entries = 1;
+				while (entries < slotCount + 1) {
+					entries <<= 1;
+				}
+				if (!ring.init (entries) || ring.entries () < slotCount + 1) {
+					return false;
+				}
+				if (posix_memalign (reinterpret_cast<void**> (&buffers), 4096, slotCount * slotBytes) != 0) {
+					buffers = nullptr;
+					return false;
+				}
+				slots.resize (slotCount);
+				std::vector<iovec> iovecs (slotCount);
+				for (unsigned i = 0; i < slotCount; i++) {
+					iovecs[i].iov_base = buffer (i);
+					iovecs[i].iov_len = slotBytes;
+				}
+				// Without registered buffers (memlock limit) plain writes are used.
+				fixedBuffers = ring.registerBuffers (iovecs.data (), slotCount);
+				return true;
+			}
+
+			// queued is false if the caller has to write the data itself (too big for a
+			// buffer); pending writes are already flushed in that case.
+			int write (const void* data, int amount, sqlite3_int64 offset, bool& queued) {
+				queued = false;
+				if (static_cast<size_t> (amount) > slotBytes) {
+					return flush (false);
+				}
+				sqlite3_int64 end = offset + amount;
+				for (unsigned i = 0; i < used; i++) {
+					Slot& slot = slots[i];
+					sqlite3_int64 slotEnd = slot.offset + static_cast<sqlite3_int64> (slot.length);
+					if (offset < slotEnd && end > slot.offset) {
+						if (offset >= slot.offset && end <= slotEnd) {
+							memcpy (buffer (i) + (offset - slot.offset), data, amount);
+							statCoalescedWrites++;
+							queued = true;
+							return SQLITE_OK;
+						}
+						// Writes run in any order: never queue two that overlap.
+						int rc = flush (false);
+						if (rc != SQLITE_OK) {
+							return rc;
+						}
+						break;
+					}
+				}
+				if (used > 0) {
+					Slot& last = slots[used - 1];
+					if (last.offset + static_cast<sqlite3_int64> (last.length) == offset &&
+						last.length + amount <= slotBytes) {
+						memcpy (buffer (used - 1) + last.length, data, amount);
+						last.length += amount;
+						statCoalescedWrites++;
+						queued = true;
+						return SQLITE_OK;
+					}
+				}
+				if (used == slotCount) {
+					int rc = flush (false);
+					if (rc != SQLITE_OK) {
+						return rc;
+					}
+				}
+				slots[used].offset = offset;
+				slots[used].length = amount;
+				memcpy (buffer (used), data, amount);
+				used++;
+				queued = true;
+				return SQLITE_OK;
+			}
+
+			int flush (bool sync) {
+				if (used == 0 && !sync) {
+					return SQLITE_OK;
+				}
+				uint64_t bytes = 0;
+				for (unsigned i = 0; i < used; i++) {
+					io_uring_sqe* sqe = ring.nextSqe ();
+					sqe->opcode = fixedBuffers ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+					sqe->fd = fd;
+					sqe->addr = reinterpret_cast<uint64_t> (buffer (i));
+					sqe->len = static_cast<uint32_t> (slots[i].length);
+					sqe->off = static_cast<uint64_t> (slots[i].offset);
+					sqe->buf_index = fixedBuffers ? static_cast<uint16_t> (i) : 0;
+					sqe->user_data = i;
+					bytes += slots[i].length;
+				}
+				if (sync) {
+					io_uring_sqe* sqe = ring.nextSqe ();
+					sqe->opcode = IORING_OP_FSYNC;
+					sqe->fd = fd;
+					sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+					// Starts once every write before it has completed.
+					sqe->flags = IOSQE_IO_DRAIN;
+					sqe->user_data = syncTag;
+				}
+
+				unsigned total = used + (sync ? 1 : 0);
+				unsigned toSubmit = total;
+				unsigned remaining = total;
+				int rc = SQLITE_OK;
+				bool shortWrites = false;
+				while (remaining > 0) {
+					int submitted = ring.enter (toSubmit, remaining);
+					if (submitted < 0 && submitted != -EINTR && submitted != -EAGAIN && submitted != -EBUSY) {
+						// The ring is unusable; nothing else will complete.
+						used = 0;
+						return SQLITE_IOERR_WRITE;
+					}
+					if (submitted > 0) {
+						toSubmit -= std::min (toSubmit, static_cast<unsigned> (submitted));
+					}
+					io_uring_cqe cqe;
+					while (ring.reap (cqe)) {
+						remaining--;
+						if (cqe.user_data == syncTag) {
+							if (cqe.res < 0) {
+								rc = SQLITE_IOERR_FSYNC;
+							}
+						} else if (cqe.res < 0) {
+							rc = SQLITE_IOERR_WRITE;
+						} else if (static_cast<size_t> (cqe.res) < slots[cqe.user_data].length) {
+							if (!finishShortWrite (static_cast<unsigned> (cqe.user_data), cqe.res)) {
+								rc = SQLITE_IOERR_WRITE;
+							}
+							shortWrites = true;
+						}
+					}
+				}
+				// The fdatasync may have run before the rest of a short write.
+				if (sync && shortWrites && rc == SQLITE_OK && fdatasync (fd) != 0) {
+					rc = SQLITE_IOERR_FSYNC;
+				}
+
+				statSubmissions++;
+				statWrites += used;
+				statBytes += bytes;
+				if (sync) {
+					statSyncs++;
+				}
+				used = 0;
+				return rc;
+			}
+
+			bool overlaps (sqlite3_int64 offset, int amount) const {
+				for (unsigned i = 0; i < used; i++) {
+					if (offset < slots[i].offset + static_cast<sqlite3_int64> (slots[i].length) &&
+						offset + amount > slots[i].offset) {
+						return true;
+					}
+				}
+				return false;
+			}
+
+			sqlite3_int64 pendingEnd () const {
+				sqlite3_int64 end = 0;
+				for (unsigned i = 0; i < used; i++) {
+					end = std::max (end, slots[i].offset + static_cast<sqlite3_int64> (slots[i].length));
+				}
+				return end;
+			}
+
+			bool synced = false;
+
+		   private:
+			struct Slot {
+				sqlite3_int64 offset;
+				size_t length;
+			};
+			static const uint64_t syncTag = ~static_cast<uint64_t> (0);
+
+			char* buffer (unsigned slot) { return buffers + static_cast<size_t> (slot) * slotBytes; }
+
+			bool finishShortWrite (unsigned slot, int written) {
+				size_t done = written;
+				while (done < slots[slot].length) {
+					ssize_t count = pwrite (fd, buffer (slot) + done, slots[slot].length - done, slots[slot].offset + done);
+					if (count < 0 && errno == EINTR) {
+						continue;
+					}
+					if (count <= 0) {
+						return false;
+					}
+					done += count;
+				}
+				return true;
+			}
+
+			int fd = -1;
+			Ring ring;
+			char* buffers = nullptr;
+			std::vector<Slot> slots;
+			unsigned slotCount = 0;
+			size_t slotBytes = 0;
+			unsigned used = 0;
+			bool fixedBuffers = false;
+		};
+#else
+		class BatchWriter {
+		   public:
+			void attach (int) {}
+			bool matches (const Options&) const { return false; }
+			bool init () { return false; }
+			int write (const void*, int, sqlite3_int64, bool& queued) {
+				queued = false;
+				return SQLITE_OK;
+			}
+			int flush (bool) { return SQLITE_OK; }
+			bool overlaps (sqlite3_int64, int) const { return false; }
+			sqlite3_int64 pendingEnd () const { return 0; }
+			bool synced = false;
+		};
+#endif
+
+		static const size_t maxIdleWriters = 8;
+		static std::mutex poolMtx;
+		static std::vector<std::unique_ptr<BatchWriter>> idleWriters;
+
+		static BatchWriter* acquireWriter () {
+			BatchWriter* writer = nullptr;
+			{
+				std::lock_guard<std::mutex> lock (poolMtx);
+				while (writer == nullptr && !idleWriters.empty ()) {
+					std::unique_ptr<BatchWriter> idle = std::move (idleWriters.back ());
+					idleWriters.pop_back ();
+					if (idle->matches (vfsOptions)) {
+						writer = idle.release ();
+					}
+				}
+			}
+			if (writer == nullptr) {
+				writer = new BatchWriter ();
+				if (!writer->init ()) {
+					delete writer;
+					return nullptr;
+				}
+			}
+			return writer;
+		}
+
+		static void releaseWriter (BatchWriter* writer) {
+			if (writer == nullptr) {
+				return;
+			}
+			writer->attach (-1);
+			std::lock_guard<std::mutex> lock (poolMtx);
+			if (idleWriters.size () < maxIdleWriters) {
+				idleWriters.emplace_back (writer);
+			} else {
+				delete writer;
+			}
+		}
+
+		struct UringFile {
+			sqlite3_file base;
+			sqlite3_file* real;
+			BatchWriter* writer;
+			UringFile* wal;
+			UringFile* database;
+			int fd;
+			std::pair<dev_t, ino_t> inode;
+		};
+
+		// The writes of the ring go through a descriptor of our own. Closing any descriptor
+		// of a file drops every POSIX lock the process holds on it, the ones of sqlite3
+		// included, so the files open through this VFS share one descriptor per inode, closed
+		// with the last of them. The locks of connections of other VFSes can not be seen
+		// here: a file must not be open through this VFS and another one in the same process
+		// (see registerVfs).
+		struct SharedDescriptor {
+			int fd;
+			int users;
+		};
+		static std::mutex descriptorsMtx;
+		static std::map<std::pair<dev_t, ino_t>, SharedDescriptor> descriptors;
+
+		static UringFile* uringFile (sqlite3_file* file) { return reinterpret_cast<UringFile*> (file); }
+
+		static int flushWrites (UringFile* file, bool sync = false) {
+			return (file != nullptr && file->writer != nullptr) ? file->writer->flush (sync) : SQLITE_OK;
+		}
+
+		// A write descriptor on the file that path names, or -1. The inode is checked before
+		// and after the open, so a file renamed in between is not written.
+		static int acquireDescriptor (UringFile* file, const char* path) {
+#ifdef JLU_HAVE_IO_URING
+			struct stat named;
+			if (stat (path, &named) != 0) {
+				return -1;
+			}
+			std::lock_guard<std::mutex> lock (descriptorsMtx);
+			auto found = descriptors.find (std::make_pair (named.st_dev, named.st_ino));
+			if (found == descriptors.end ()) {
+				int fd = open (path, O_WRONLY | O_CLOEXEC);
+				struct stat opened;
+				if (fd < 0) {
+					return -1;
+				}
+				if (fstat (fd, &opened) != 0 || opened.st_dev != named.st_dev || opened.st_ino != named.st_ino) {
+					close (fd);
+					return -1;
+				}
+				found = descriptors.emplace (std::make_pair (named.st_dev, named.st_ino), SharedDescriptor{fd, 0}).first;
+			}
+			found->second.users++;
+			file->inode = found->first;
+			return found->second.fd;
+#else
+			(void)file;
+			(void)path;
+			return -1;
+#endif
+		}
+
+		static void releaseDescriptor (UringFile* file) {
+#ifdef JLU_HAVE_IO_URING
+			if (file->fd < 0) {
+				return;
+			}
+			std::lock_guard<std::mutex> lock (descriptorsMtx);
+			auto found = descriptors.find (file->inode);
+			if (found != descriptors.end () && --found->second.users == 0) {
+				close (found->second.fd);
+				descriptors.erase (found);
+			}
+			file->fd = -1;
+#else
+			(void)file;
+#endif
+		}
+
+		// Methods of the files >>
+
+		static int fileClose (sqlite3_file* file) {
+			UringFile* p = uringFile (file);
+			int rc = flushWrites (p);
+			releaseWriter (p->writer);
+			p->writer = nullptr;
+			releaseDescriptor (p);
+			if (p->database != nullptr) {
+				p->database->wal = nullptr;
+			}
+			if (p->wal != nullptr) {
+				p->wal->database = nullptr;
+			}
+			int closeRc = p->real->pMethods->xClose (p->real);
+			return (rc != SQLITE_OK) ? rc : closeRc;
+		}
+
+		static int fileRead (sqlite3_file* file, void* data, int amount, sqlite3_int64 offset) {
+			UringFile* p = uringFile (file);
+			if (p->writer != nullptr && p->writer->overlaps (offset, amount)) {
+				int rc = p->writer->flush (false);
+				if (rc != SQLITE_OK) {
+					return rc;
+				}
+			}
+			return p->real->pMethods->xRead (p->real, data, amount, offset);
+		}
+
+		static int fileWrite (sqlite3_file* file, const void* data, int amount, sqlite3_int64 offset) {
+			UringFile* p = uringFile (file);
+			if (p->writer != nullptr) {
+				bool queued = false;
+				int rc = p->writer->write (data, amount, offset, queued);
+				if (rc != SQLITE_OK || queued) {
+					return rc;
+				}
+			}
+			return p->real->pMethods->xWrite (p->real, data, amount, offset);
+		}
+
+		static int fileTruncate (sqlite3_file* file, sqlite3_int64 size) {
+			UringFile* p = uringFile (file);
+			int rc = flushWrites (p);
+			return (rc != SQLITE_OK) ? rc : p->real->pMethods->xTruncate (p->real, size);
+		}
+
+		static int fileSync (sqlite3_file* file, int flags) {
+			UringFile* p = uringFile (file);
+			if (p->writer != nullptr && p->writer->synced) {
+				return p->writer->flush (true);
+			}
+			// The first sync of the default VFS also syncs the directory of a new file.
+			int rc = flushWrites (p);
+			if (rc != SQLITE_OK) {
+				return rc;
+			}
+			rc = p->real->pMethods->xSync (p->real, flags);
+			if (rc == SQLITE_OK && p->writer != nullptr) {
+				p->writer->synced = true;
+			}
+			return rc;
+		}
+
+		static int fileSize (sqlite3_file* file, sqlite3_int64* size) {
+			UringFile* p = uringFile (file);
+			int rc = p->real->pMethods->xFileSize (p->real, size);
+			if (rc == SQLITE_OK && p->writer != nullptr) {
+				*size = std::max (*size, p->writer->pendingEnd ());
+			}
+			return rc;
+		}
+
+		static int fileLock (sqlite3_file* file, int lock) {
+			UringFile* p = uringFile (file);
+			return p->real->pMethods->xLock (p->real, lock);
+		}
+
+		static int fileUnlock (sqlite3_file* file, int lock) {
+			UringFile* p = uringFile (file);
+			int rc = flushWrites (p);
+			return (rc != SQLITE_OK) ? rc : p->real->pMethods->xUnlock (p->real, lock);
+		}
+
+		static int fileCheckReservedLock (sqlite3_file* file, int* result) {
+			UringFile* p = uringFile (file);
+			return p->real->pMethods->xCheckReservedLock (p->real, result);
+		}
+
+		static int fileControl (sqlite3_file* file, int op, void* arg) {
+			UringFile* p = uringFile (file);
+			if (op == fileControlSelf) {
+				*static_cast<UringFile**> (arg) = p;
+				return SQLITE_OK;
+			}
+			if (op != SQLITE_FCNTL_SIZE_HINT) {
+				int rc = flushWrites (p);
+				if (rc != SQLITE_OK) {
+					return rc;
+				}
+			}
+			return p->real->pMethods->xFileControl (p->real, op, arg);
+		}
+
+		static int fileSectorSize (sqlite3_file* file) {
+			UringFile* p = uringFile (file);
+			return p->real->pMethods->xSectorSize (p->real);
+		}
+
+		static int fileDeviceCharacteristics (sqlite3_file* file) {
+			UringFile* p = uringFile (file);
+			return p->real->pMethods->xDeviceCharacteristics (p->real);
+		}
+
+		static int fileShmMap (sqlite3_file* file, int page, int pageSize, int extend, void volatile** address) {
+			UringFile* p = uringFile (file);
+			return p->real->pMethods->xShmMap (p->real, page, pageSize, extend, address);
+		}
+
+		// The WAL frames must be in the file before the WAL index makes them visible.
+		static int fileShmLock (sqlite3_file* file, int offset, int n, int flags) {
+			UringFile* p = uringFile (file);
+			int rc = flushWrites (p->wal);
+			return (rc != SQLITE_OK) ? rc : p->real->pMethods->xShmLock (p->real, offset, n, flags);
+		}
+
+		static void fileShmBarrier (sqlite3_file* file) {
+			UringFile* p = uringFile (file);
+			flushWrites (p->wal);
+			p->real->pMethods->xShmBarrier (p->real);
+		}
+
+		static int fileShmUnmap (sqlite3_file* file, int deleteFlag) {
+			UringFile* p = uringFile (file);
+			return p->real->pMethods->xShmUnmap (p->real, deleteFlag);
+		}
+
+		static int fileFetch (sqlite3_file* file, sqlite3_int64 offset, int amount, void** page) {
+			UringFile* p = uringFile (file);
+			int rc = flushWrites (p);
+			return (rc != SQLITE_OK) ? rc : p->real->pMethods->xFetch (p->real, offset, amount, page);
+		}
+
+		static int fileUnfetch (sqlite3_file* file, sqlite3_int64 offset, void* page) {
+			UringFile* p = uringFile (file);
+			return p->real->pMethods->xUnfetch (p->real, offset, page);
+		}
+
+		// One table per version of the wrapped methods: sqlite3 only calls xShm* and xFetch
+		// if the version says they exist.
+		static const sqlite3_io_methods fileMethods[3] = {
+			{1, fileClose, fileRead, fileWrite, fileTruncate, fileSync, fileSize, fileLock, fileUnlock,
+			 fileCheckReservedLock, fileControl, fileSectorSize, fileDeviceCharacteristics, nullptr, nullptr,
+			 nullptr, nullptr, nullptr, nullptr},
+			{2, fileClose, fileRead, fileWrite, fileTruncate, fileSync, fileSize, fileLock, fileUnlock,
+			 fileCheckReservedLock, fileControl, fileSectorSize, fileDeviceCharacteristics, fileShmMap,
+			 fileShmLock, fileShmBarrier, fileShmUnmap, nullptr, nullptr},
+			{3, fileClose, fileRead, fileWrite, fileTruncate, fileSync, fileSize, fileLock, fileUnlock,
+			 fileCheckReservedLock, fileControl, fileSectorSize, fileDeviceCharacteristics, fileShmMap,
+			 fileShmLock, fileShmBarrier, fileShmUnmap, fileFetch, fileUnfetch}};
+
+		// Methods of the VFS >>
+
+		static int vfsOpen (sqlite3_vfs* vfs, const char* path, sqlite3_file* file, int flags, int* outFlags) {
+			UringFile* p = uringFile (file);
+			p->real = vfsshim::realFile (file, sizeof (UringFile));
+			p->writer = nullptr;
+			p->wal = nullptr;
+			p->database = nullptr;
+			p->fd = -1;
+			int rc = vfsshim::openReal (vfs, path, file, sizeof (UringFile), flags, outFlags);
+			if (rc != SQLITE_OK) {
+				return rc;
+			}
+			int version = std::min (std::max (p->real->pMethods->iVersion, 1), 3);
+			p->base.pMethods = &fileMethods[version - 1];
+			statFiles++;
+
+			const int batched = SQLITE_OPEN_MAIN_DB | SQLITE_OPEN_MAIN_JOURNAL | SQLITE_OPEN_WAL;
+			if (path != nullptr && (flags & batched) != 0 && (flags & SQLITE_OPEN_READWRITE) != 0) {
+				p->writer = acquireWriter ();
+				if (p->writer != nullptr) {
+					p->fd = acquireDescriptor (p, path);
+					if (p->fd >= 0) {
+						p->writer->attach (p->fd);
+					} else {
+						releaseWriter (p->writer);
+						p->writer = nullptr;
+					}
+				}
+				if (p->writer == nullptr) {
+					statFallbackFiles++;
+				}
+			}
+			if ((flags & SQLITE_OPEN_WAL) != 0 && path != nullptr) {
+				// Other shims can wrap the database file: ask it for the uring file inside.
+				sqlite3_file* database = sqlite3_database_file_object (path);
+				UringFile* owner = nullptr;
+				if (database != nullptr && database->pMethods != nullptr &&
+					database->pMethods->xFileControl (database, fileControlSelf, &owner) == SQLITE_OK &&
+					owner != nullptr) {
+					p->database = owner;
+					owner->wal = p;
+				}
+			}
+			return SQLITE_OK;
+		}
+
+		/**
+		 * @brief Register the "uring" VFS, a wrapper of the default VFS whose writes go through
+		 * io_uring. Open a database with it with MySQLite::open (fileName, jlu::uringvfs::name).
+		 *
+		 * The page writes of a transaction are batched in registered buffers and submitted
+		 * together when it commits, with the fdatasync chained in the same submission. If
+		 * io_uring is not available (old kernel, seccomp, io_uring_disabled) or a file can not
+		 * use it, the files behave exactly as with the default VFS.
+		 *
+		 * Call it before the databases are open; new options apply to the files open later.
+		 * A database file must not be open through this VFS and through another one in the
+		 * same process: the locks of the other VFS are lost when the last file of this one
+		 * on the same inode is closed.
+		 *
+		 * @param options Buffers per file and their size. A write bigger than a buffer is
+		 * written directly.
+		 * @param makeDefault Use it for every database open without an explicit VFS.
+		 * @return bool True if io_uring is used, false if the VFS falls back to the default
+		 * one.
+		 */
+		bool registerVfs (const Options& options, bool makeDefault) {
+			std::lock_guard<std::mutex> lock (registerMtx);
+			vfsOptions = options;
+			if (sqlite3_vfs_find (name) == nullptr &&
+				!vfsshim::build (uringVfs, name, nullptr, sizeof (UringFile), vfsOpen)) {
+				return false;
+			}
+			if (sqlite3_vfs_register (&uringVfs, makeDefault ? 1 : 0) != SQLITE_OK) {
+				return false;
+			}
+			return isAvailable ();
+		}
+
+		/**
+		 * @brief Check once whether this process can create io_uring instances.
+		 */
+		bool isAvailable () {
+#ifdef JLU_HAVE_IO_URING
+			static const bool available = [] {
+				Ring ring;
+				return ring.init (2);
+			}();
+			return available;
+#else
+			return false;
+#endif
+		}
+
+		/**
+		 * @brief Counters of every file open through the VFS since the program started.
+		 *
+		 * @return Stats Files and files that fell back to the default VFS, ring submissions,
+		 * writes submitted, writes merged into a pending one, bytes and chained syncs.
+		 */
+		Stats getStats () {
+			Stats stats;
+			stats.files = statFiles.load ();
+			stats.fallbackFiles = statFallbackFiles.load ();
+			stats.submissions = statSubmissions.load ();
+			stats.writes = statWrites.load ();
+			stats.coalescedWrites = statCoalescedWrites.load ();
+			stats.bytes = statBytes.load ();
+			stats.syncs = statSyncs.load ();
+			return stats;
+		}
+	}	// namespace uringvfs
+}	// namespace jlu
@@ -0,0 +1,322 @@
+#include "../include/value.h"
+
+#include <cstring>
+
+#include "../include/dictionary.h"
+
+namespace jlu {
+	// A Value is 16 bytes: 14 of storage, the size of an inline text or blob and a tag with
+	// the type and whether the bytes are on the heap. Integers and reals use the first 8
+	// bytes of the storage. Texts and blobs up to 14 bytes are stored inline; longer ones
+	// are copied to the heap, whose pointer and 32 bits size take the first 12 bytes.
+	// Interned texts store the pointer to their StringDictionary and their 32 bits code
+	// there instead; they do not own the dictionary.
+
+	/**
+	 * @brief A NULL value.
+	 */
+	Value::Value () : smallSize (0), tag (static_cast<uint8_t> (Type::Null)) {}
+
+	Value::Value (int value) : Value (static_cast<int64_t> (value)) {}
+
+	/**
+	 * @brief An INTEGER value, with the 64 bits sqlite3 stores.
+	 */
+	Value::Value (int64_t value) : smallSize (0), tag (static_cast<uint8_t> (Type::Integer)) {
+		memcpy (storage, &value, sizeof (value));
+	}
+
+	/**
+	 * @brief A REAL value.
+	 */
+	Value::Value (double value) : smallSize (0), tag (static_cast<uint8_t> (Type::Real)) {
+		memcpy (storage, &value, sizeof (value));
+	}
+
+	Value::Value (const Value& other) : smallSize (0), tag (static_cast<uint8_t> (Type::Null)) {
+		*this = other;
+	}
+
+	Value::Value (Value&& other) noexcept {
+		memcpy (storage, other.storage, sizeof (storage));
+		smallSize = other.smallSize;
+		tag = other.tag;
+		other.tag = static_cast<uint8_t> (Type::Null);
+	}
+
+	Value::~Value () { release (); }
+
+	Value& Value::operator= (const Value& other) {
+		if (this == &other) {
+			return *this;
+		}
+		if ((other.tag & heapFlag) != 0) {
+			assign (other.type (), other.data (), other.size ());
+		} else {
+			release ();
+			memcpy (storage, other.storage, sizeof (storage));
+			smallSize = other.smallSize;
+			tag = other.tag;
+		}
+		return *this;
+	}
+
+	Value& Value::operator= (Value&& other) noexcept {
+		if (this != &other) {
+			release ();
+			memcpy (storage, other.storage, sizeof (storage));
+			smallSize = other.smallSize;
+			tag = other.tag;
+			other.tag = static_cast<uint8_t> (Type::Null);
+		}
+		return *this;
+	}
+
+	/**
+	 * @brief Same type and same content. Unlike SQL, NULL equals NULL and 1 does not equal
+	 * 1.0.
+	 */
+	bool Value::operator== (const Value& other) const {
+		if (type () != other.type ()) {
+			return false;
+		}
+		switch (type ()) {
+			case Type::Null:
+				return true;
+			case Type::Integer:
+				return asInt64 () == other.asInt64 ();
+			case Type::Real:
+				return asDouble () == other.asDouble ();
+			default:
+				if (isInterned () && dictionary () == other.dictionary ()) {
+					return code () == other.code ();
+				}
+				return asText () == other.asText ();
+		}
+	}
+
+	bool Value::operator!= (const Value& other) const { return !(*this == other); }
+
+	/**
+	 * @brief A TEXT value, copied.
+	 */
+	Value Value::text (std::string_view text) { return Value (Type::Text, text.data (), text.size ()); }
+
+	/**
+	 * @brief A BLOB value, copied.
+	 */
+	Value Value::blob (const void* data, size_t size) { return Value (Type::Blob, data, size); }
+
+	/**
+	 * @brief A TEXT value kept in a dictionary: its bytes are the ones of the code. The
+	 * value is valid while the dictionary lives.
+	 *
+	 * @param dictionary The dictionary.
+	 * @param code A code returned by dictionary->intern ().
+	 */
+	Value Value::interned (const StringDictionary* dictionary, uint32_t code) {
+		Value output;
+		memcpy (output.storage, &dictionary, sizeof (dictionary));
+		memcpy (output.storage + sizeof (dictionary), &code, sizeof (code));
+		output.tag = static_cast<uint8_t> (Type::Text) | dictionaryFlag;
+		return output;
+	}
+
+	/**
+	 * @brief Copy the value of a column of the current row of a statement.
+	 *
+	 * @param stmt A statement whose last sqlite3_step returned SQLITE_ROW.
+	 * @param col Index of the column, starting at 0.
+	 * @return Value The value, with its sqlite3 storage class. Integers keep their 64 bits.
+	 */
+	Value Value::fromColumn (sqlite3_stmt* stmt, int col) {
+		switch (sqlite3_column_type (stmt, col)) {
+			case SQLITE_INTEGER:
+				return Value (static_cast<int64_t> (sqlite3_column_int64 (stmt, col)));
+			case SQLITE_FLOAT:
+				return Value (sqlite3_column_double (stmt, col));
+			case SQLITE_TEXT: {
+				const unsigned char* text = sqlite3_column_text (stmt, col);
+				return Value (Type::Text, text, sqlite3_column_bytes (stmt, col));
+			}
+			case SQLITE_BLOB: {
+				const void* blob = sqlite3_column_blob (stmt, col);
+				return Value (Type::Blob, blob, sqlite3_column_bytes (stmt, col));
+			}
+			default:
+				return Value ();
+		}
+	}
+
+	Value::Type Value::type () const { return static_cast<Type> (tag & typeMask); }
+
+	bool Value::isNull () const { return type () == Type::Null; }
+
+	/**
+	 * @brief True if the value needs no allocation: any NULL, number, or text or blob of up
+	 * to inlineBytes bytes.
+	 */
+	bool Value::isInline () const { return (tag & heapFlag) == 0; }
+
+	/**
+	 * @brief True for a text made with interned (): it points to a dictionary.
+	 */
+	bool Value::isInterned () const { return (tag & dictionaryFlag) != 0; }
+
+	/**
+	 * @brief The code of an interned text in its dictionary, noCode for any other value.
+	 * Equal codes of the same dictionary are equal texts, so a group by can hash the code.
+	 */
+	uint32_t Value::code () const {
+		if (!isInterned ()) {
+			return noCode;
+		}
+		uint32_t output;
+		memcpy (&output, storage + sizeof (StringDictionary*), sizeof (output));
+		return output;
+	}
+
+	/**
+	 * @brief The dictionary of an interned text, nullptr for any other value.
+	 */
+	const StringDictionary* Value::dictionary () const {
+		if (!isInterned ()) {
+			return nullptr;
+		}
+		const StringDictionary* output;
+		memcpy (&output, storage, sizeof (output));
+		return output;
+	}
+
+	/**
+	 * @brief The integer, or a real truncated toward zero. 0 for NULL, text and blob.
+	 */
+	int64_t Value::asInt64 () const {
+		if (type () == Type::Integer) {
+			int64_t value;
+			memcpy (&value, storage, sizeof (value));
+			return value;
+		}
+		return (type () == Type::Real) ? static_cast<int64_t> (asDouble ()) : 0;
+	}
+
+	/**
+	 * @brief The real, or the integer converted. 0.0 for NULL, text and blob.
+	 */
+	double Value::asDouble () const {
+		if (type () == Type::Real) {
+			double value;
+			memcpy (&value, storage, sizeof (value));
+			return value;
+		}
+		return (type () == Type::Integer) ? static_cast<double> (asInt64 ()) : 0.0;
+	}
+
+	/**
+	 * @brief The bytes of a text or a blob, empty for other types. It is valid while the
+	 * value is neither changed nor destroyed.
+	 */
+	std::string_view Value::asText () const {
+		return std::string_view (reinterpret_cast<const char*> (data ()), size ());
+	}
+
+	/**
+	 * @brief The bytes of a text or a blob, nullptr for other types.
+	 */
+	const uint8_t* Value::data () const {
+		if (type () != Type::Text && type () != Type::Blob) {
+			return nullptr;
+		}
+		if (isInterned ()) {
+			return reinterpret_cast<const uint8_t*> (dictionary ()->view (code ()).data ());
+		}
+		if ((tag & heapFlag) != 0) {
+			const uint8_t* pointer;
+			memcpy (&pointer, storage, sizeof (pointer));
+			return pointer;
+		}
+		return reinterpret_cast<const uint8_t*> (storage);
+	}
+
+	/**
+	 * @brief Bytes of a text or a blob, 0 for other types.
+	 */
+	size_t Value::size () const {
+		if (type () != Type::Text && type () != Type::Blob) {
+			return 0;
+		}
+		if (isInterned ()) {
+			return dictionary ()->view (code ()).size ();
+		}
+		if ((tag & heapFlag) != 0) {
+			uint32_t heapSize;
+			memcpy (&heapSize, storage + sizeof (uint8_t*), sizeof (heapSize));
+			return heapSize;
+		}
+		return smallSize;
+	}
+
+	/**
+	 * @brief The value as sqlite3 would print it: "null", the number or the bytes. Reals
+	 * are printed as CAST (x AS TEXT) does, with 15 significant digits and ".0" if they
+	 * have no decimals, e.g. "1.5", "2.0" or "1.0e+20".
+	 */
+	std::string Value::toString () const {
+		switch (type ()) {
+			case Type::Null:
+				return "null";
+			case Type::Integer:
+				return std::to_string (asInt64 ());
+			case Type::Real: {
+				char text[32];
+				sqlite3_snprintf (sizeof (text), text, "%!.15g", asDouble ());
+				return text;
+			}
+			default:
+				return std::string (asText ());
+		}
+	}
+
+	// Private methods >>
+
+	Value::Value (Type type, const void* data, size_t size) : smallSize (0), tag (static_cast<uint8_t> (Type::Null)) {
+		assign (type, data, size);
+	}
+
+	void Value::assign (Type type, const void* data, size_t size) {
+		char* heap = nullptr;
+		if (size > inlineBytes) {
+			// Allocated before release (), in case data belongs to this value.
+			heap = new char[size];
+			memcpy (heap, data, size);
+		}
+		char small[inlineBytes];
+		if (heap == nullptr && size > 0) {
+			memcpy (small, data, size);
+		}
+		release ();
+		if (heap != nullptr) {
+			uint32_t heapSize = static_cast<uint32_t> (size);
+			memcpy (storage, &heap, sizeof (heap));
+			memcpy (storage + sizeof (heap), &heapSize, sizeof (heapSize));
+			smallSize = 0;
+			tag = static_cast<uint8_t> (type) | heapFlag;
+		} else {
+			if (size > 0) {
+				memcpy (storage, small, size);
+			}
+			smallSize = static_cast<uint8_t> (size);
+			tag = static_cast<uint8_t> (type);
+		}
+	}
+
+	void Value::release () {
+		if ((tag & heapFlag) != 0) {
+			char* heap;
+			memcpy (&heap, storage, sizeof (heap));
+			delete[] heap;
+		}
+		tag = static_cast<uint8_t> (Type::Null);
+		smallSize = 0;
+	}
+}	// namespace jlu
@@ -0,0 +1,222 @@
+#include "../include/vfsshim.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace jlu {
+	namespace vfsshim {
+		// A shim VFS wraps another one: its files are a struct of the shim, whose first member
+		// is the sqlite3_file, followed by the file of the wrapped VFS. Everything but xOpen is
+		// forwarded to the wrapped VFS, kept in pAppData.
+
+		static int alignedBytes (int fileBytes) { return (fileBytes + 7) & ~7; }
+
+		static int vfsDelete (sqlite3_vfs* vfs, const char* path, int syncDir) {
+			return base (vfs)->xDelete (base (vfs), path, syncDir);
+		}
+
+		static int vfsAccess (sqlite3_vfs* vfs, const char* path, int flags, int* result) {
+			return base (vfs)->xAccess (base (vfs), path, flags, result);
+		}
+
+		static int vfsFullPathname (sqlite3_vfs* vfs, const char* path, int size, char* out) {
+			return base (vfs)->xFullPathname (base (vfs), path, size, out);
+		}
+
+		static void* vfsDlOpen (sqlite3_vfs* vfs, const char* path) { return base (vfs)->xDlOpen (base (vfs), path); }
+
+		static void vfsDlError (sqlite3_vfs* vfs, int size, char* message) {
+			base (vfs)->xDlError (base (vfs), size, message);
+		}
+
+		static void (*vfsDlSym (sqlite3_vfs* vfs, void* handle, const char* symbol)) (void) {
+			return base (vfs)->xDlSym (base (vfs), handle, symbol);
+		}
+
+		static void vfsDlClose (sqlite3_vfs* vfs, void* handle) { base (vfs)->xDlClose (base (vfs), handle); }
+
+		static int vfsRandomness (sqlite3_vfs* vfs, int size, char* out) {
+			return base (vfs)->xRandomness (base (vfs), size, out);
+		}
+
+		static int vfsSleep (sqlite3_vfs* vfs, int microseconds) {
+			return base (vfs)->xSleep (base (vfs), microseconds);
+		}
+
+		static int vfsCurrentTime (sqlite3_vfs* vfs, double* now) {
+			return base (vfs)->xCurrentTime (base (vfs), now);
+		}
+
+		static int vfsGetLastError (sqlite3_vfs* vfs, int size, char* message) {
+			return base (vfs)->xGetLastError (base (vfs), size, message);
+		}
+
+		static int vfsCurrentTimeInt64 (sqlite3_vfs* vfs, sqlite3_int64* now) {
+			return base (vfs)->xCurrentTimeInt64 (base (vfs), now);
+		}
+
+		static int vfsSetSystemCall (sqlite3_vfs* vfs, const char* callName, sqlite3_syscall_ptr call) {
+			return base (vfs)->xSetSystemCall (base (vfs), callName, call);
+		}
+
+		static sqlite3_syscall_ptr vfsGetSystemCall (sqlite3_vfs* vfs, const char* callName) {
+			return base (vfs)->xGetSystemCall (base (vfs), callName);
+		}
+
+		static const char* vfsNextSystemCall (sqlite3_vfs* vfs, const char* callName) {
+			return base (vfs)->xNextSystemCall (base (vfs), callName);
+		}
+
+		/**
+		 * @brief Fill a VFS that wraps another registered one. Register it with
+		 * sqlite3_vfs_register afterwards.
+		 *
+		 * @param vfs Destination. It must live until the end of the program.
+		 * @param name Name of the new VFS.
+		 * @param baseName VFS to wrap, or nullptr for the default one.
+		 * @param fileBytes Size of the file struct of the shim, without the wrapped file.
+		 * @param open xOpen of the shim. It calls openReal() and sets its own methods.
+		 * @return bool False if the wrapped VFS is not registered.
+		 */
+		bool build (sqlite3_vfs& vfs, const char* name, const char* baseName, int fileBytes, OpenFn open) {
+			sqlite3_vfs* wrapped = sqlite3_vfs_find (baseName);
+			if (wrapped == nullptr) {
+				return false;
+			}
+			memset (&vfs, 0, sizeof (vfs));
+			vfs.iVersion = std::min (wrapped->iVersion, 3);
+			vfs.szOsFile = alignedBytes (fileBytes) + wrapped->szOsFile;
+			vfs.mxPathname = wrapped->mxPathname;
+			vfs.zName = name;
+			vfs.pAppData = wrapped;
+			vfs.xOpen = open;
+			vfs.xDelete = vfsDelete;
+			vfs.xAccess = vfsAccess;
+			vfs.xFullPathname = vfsFullPathname;
+			vfs.xDlOpen = vfsDlOpen;
+			vfs.xDlError = vfsDlError;
+			vfs.xDlSym = vfsDlSym;
+			vfs.xDlClose = vfsDlClose;
+			vfs.xRandomness = vfsRandomness;
+			vfs.xSleep = vfsSleep;
+			vfs.xCurrentTime = vfsCurrentTime;
+			vfs.xGetLastError = vfsGetLastError;
+			if (vfs.iVersion >= 2) {
+				vfs.xCurrentTimeInt64 = vfsCurrentTimeInt64;
+			}
+			if (vfs.iVersion >= 3) {
+				vfs.xSetSystemCall = vfsSetSystemCall;
+				vfs.xGetSystemCall = vfsGetSystemCall;
+				vfs.xNextSystemCall = vfsNextSystemCall;
+			}
+			return true;
+		}
+
+		/**
+		 * @brief The VFS wrapped by a shim built with build().
+		 */
+		sqlite3_vfs* base (sqlite3_vfs* vfs) { return static_cast<sqlite3_vfs*> (vfs->pAppData); }
+
+		/**
+		 * @brief The file of the wrapped VFS, stored after the file struct of the shim.
+		 */
+		sqlite3_file* realFile (sqlite3_file* file, int fileBytes) {
+			return reinterpret_cast<sqlite3_file*> (reinterpret_cast<char*> (file) + alignedBytes (fileBytes));
+		}
+
+		/**
+		 * @brief Open the wrapped file, from the xOpen of a shim.
+		 *
+		 * The methods of the shim file are left null, as sqlite3 requires when xOpen fails;
+		 * set them if it returns SQLITE_OK.
+		 *
+		 * @return int Result of the xOpen of the wrapped VFS.
+		 */
+		int openReal (sqlite3_vfs* vfs, const char* path, sqlite3_file* file, int fileBytes, int flags, int* outFlags) {
+			file->pMethods = nullptr;
+			sqlite3_file* real = realFile (file, fileBytes);
+			int rc = base (vfs)->xOpen (base (vfs), path, real, flags, outFlags);
+			if (rc == SQLITE_OK && real->pMethods == nullptr) {
+				rc = SQLITE_CANTOPEN;
+			}
+			return rc;
+		}
+
+		/**
+		 * @brief Methods of a shim file with the version of the wrapped file, since sqlite3
+		 * only calls xShm* and xFetch if the version says they exist.
+		 *
+		 * @param tables Three tables of the shim, for versions 1, 2 and 3.
+		 * @param real The wrapped file, open.
+		 */
+		const sqlite3_io_methods* methodsFor (const sqlite3_io_methods* tables, const sqlite3_file* real) {
+			int version = std::min (std::max (real->pMethods->iVersion, 1), 3);
+			return &tables[version - 1];
+		}
+
+		// Forwarders to the wrapped file, for the methods a shim does not change. The file
+		// struct of the shim must start with a ShimFile.
+
+		static sqlite3_file* real (sqlite3_file* file) { return reinterpret_cast<ShimFile*> (file)->real; }
+
+		int fileClose (sqlite3_file* file) { return real (file)->pMethods->xClose (real (file)); }
+
+		int fileRead (sqlite3_file* file, void* data, int amount, sqlite3_int64 offset) {
+			return real (file)->pMethods->xRead (real (file), data, amount, offset);
+		}
+
+		int fileWrite (sqlite3_file* file, const void* data, int amount, sqlite3_int64 offset) {
+			return real (file)->pMethods->xWrite (real (file), data, amount, offset);
+		}
+
+		int fileTruncate (sqlite3_file* file, sqlite3_int64 size) {
+			return real (file)->pMethods->xTruncate (real (file), size);
+		}
+
+		int fileSync (sqlite3_file* file, int flags) { return real (file)->pMethods->xSync (real (file), flags); }
+
+		int fileSize (sqlite3_file* file, sqlite3_int64* size) {
+			return real (file)->pMethods->xFileSize (real (file), size);
+		}
+
+		int fileLock (sqlite3_file* file, int lock) { return real (file)->pMethods->xLock (real (file), lock); }
+
+		int fileUnlock (sqlite3_file* file, int lock) { return real (file)->pMethods->xUnlock (real (file), lock); }
+
+		int fileCheckReservedLock (sqlite3_file* file, int* result) {
+			return real (file)->pMethods->xCheckReservedLock (real (file), result);
+		}
+
+		int fileControl (sqlite3_file* file, int op, void* arg) {
+			return real (file)->pMethods->xFileControl (real (file), op, arg);
+		}
+
+		int fileSectorSize (sqlite3_file* file) { return real (file)->pMethods->xSectorSize (real (file)); }
+
+		int fileDeviceCharacteristics (sqlite3_file* file) {
+			return real (file)->pMethods->xDeviceCharacteristics (real (file));
+		}
+
+		int fileShmMap (sqlite3_file* file, int page, int pageSize, int extend, void volatile** address) {
+			return real (file)->pMethods->xShmMap (real (file), page, pageSize, extend, address);
+		}
+
+		int fileShmLock (sqlite3_file* file, int offset, int n, int flags) {
+			return real (file)->pMethods->xShmLock (real (file), offset, n, flags);
+		}
+
+		void fileShmBarrier (sqlite3_file* file) { real (file)->pMethods->xShmBarrier (real (file)); }
+
+		int fileShmUnmap (sqlite3_file* file, int deleteFlag) {
+			return real (file)->pMethods->xShmUnmap (real (file), deleteFlag);
+		}
+
+		int fileFetch (sqlite3_file* file, sqlite3_int64 offset, int amount, void** page) {
+			return real (file)->pMethods->xFetch (real (file), offset, amount, page);
+		}
+
+		int fileUnfetch (sqlite3_file* file, sqlite3_int64 offset, void* page) {
+			return real (file)->pMethods->xUnfetch (real (file), offset, page);
+		}
+	}	// namespace vfsshim
+}	// namespace jlu
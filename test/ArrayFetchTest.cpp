@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include "../src/MySQLite/include/arrayfetch.h"
+
+static const std::string arrayFetchFileName ("arrayfetch.db");
+
+class ArrayFetchTest : public ::testing::Test {
+   public:
+	void SetUp () { std::filesystem::remove (arrayFetchFileName); }
+};
+
+TEST_F (ArrayFetchTest, Fetch_into_column_arrays) {
+	jlu::MySQLite db (arrayFetchFileName);
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, resource TEXT, value REAL)");
+	db.exec ("BEGIN;");
+	for (int i = 1; i <= 10; i++) {
+		db.exec ("INSERT INTO data_1 (resource, value) VALUES (" +
+				 ((i == 5) ? std::string ("NULL") : "'AI" + std::to_string (i) + "'") + ", " +
+				 ((i == 3) ? std::string ("NULL") : std::to_string (i) + ".5") + ")");
+	}
+	db.exec ("COMMIT;");
+
+	jlu::ArrayFetch fetch (db, "SELECT id, resource, value FROM data_1 WHERE id > ? ORDER BY id");
+	EXPECT_EQ (fetch.columnCount (), 3);
+	sqlite3_bind_int (fetch.getStatement (), 1, 0);
+	int64_t ids[4];
+	double values[4];
+	uint8_t valueNulls[4];
+	char resources[4 * 3];
+	uint32_t lengths[4];
+	uint8_t resourceNulls[4];
+	fetch.bindInt64 (0, ids);
+	fetch.bindDouble (2, values, valueNulls);
+	fetch.bindFixedText (1, resources, 3, lengths, resourceNulls);
+	EXPECT_THROW (fetch.bindInt64 (3, ids), std::runtime_error);
+
+	ASSERT_EQ (fetch.fetch (4), 4u);
+	EXPECT_EQ (ids[3], 4);
+	EXPECT_DOUBLE_EQ (values[1], 2.5);
+	EXPECT_EQ (valueNulls[2], 1);
+	EXPECT_DOUBLE_EQ (values[2], 0.0);
+	EXPECT_EQ (std::string (resources, 3), "AI1");
+
+	ASSERT_EQ (fetch.fetch (4), 4u);
+	EXPECT_EQ (ids[0], 5);
+	EXPECT_EQ (resourceNulls[0], 1);
+	EXPECT_EQ (resources[0], '\0');
+	EXPECT_EQ (std::string (resources + 3, 3), "AI6");
+
+	ASSERT_EQ (fetch.fetch (4), 2u);
+	EXPECT_EQ (ids[1], 10);
+	// "AI9" fits, "AI10" is cut to the width but keeps its whole length.
+	EXPECT_EQ (lengths[0], 3u);
+	EXPECT_EQ (lengths[1], 4u);
+	EXPECT_EQ (std::string (resources + 3, 3), "AI1");
+	EXPECT_EQ (std::string (resources, 3), "AI9");
+	EXPECT_TRUE (fetch.isDone ());
+	EXPECT_EQ (fetch.fetch (4), 0u);
+	EXPECT_EQ (fetch.rowsFetched (), 10u);
+
+	fetch.rewind ();
+	sqlite3_bind_int (fetch.getStatement (), 1, 8);
+	fetch.unbind (1);
+	fetch.unbind (2);
+	EXPECT_EQ (fetch.fetch (4), 2u);
+	EXPECT_EQ (ids[0], 9);
+}
+
+TEST_F (ArrayFetchTest, Variable_length_texts) {
+	jlu::MySQLite db (arrayFetchFileName);
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, resource TEXT)");
+	db.exec ("INSERT INTO data_1 (resource) VALUES ('a'), ('bb'), (NULL), ('cccc'), ('ddddd'), ('a text too long')");
+
+	jlu::ArrayFetch fetch (db, "SELECT resource, id FROM data_1 ORDER BY id");
+	char data[8];
+	uint32_t offsets[5];
+	uint8_t nulls[4];
+	int64_t ids[4];
+	fetch.bindVarText (0, data, sizeof (data), offsets, nulls);
+	fetch.bindInt64 (1, ids);
+
+	// 'ddddd' does not fit after 'abbcccc': the fetch stops before it.
+	ASSERT_EQ (fetch.fetch (4), 4u);
+	EXPECT_EQ (std::string (data, offsets[4]), "abbcccc");
+	EXPECT_EQ ((std::vector<uint32_t> (offsets, offsets + 5)), (std::vector<uint32_t>{0, 1, 3, 3, 7}));
+	EXPECT_EQ (nulls[2], 1);
+
+	ASSERT_EQ (fetch.fetch (4), 1u);
+	EXPECT_EQ (ids[0], 5);
+	EXPECT_EQ (std::string (data + offsets[0], offsets[1] - offsets[0]), "ddddd");
+
+	// A single value larger than the buffer.
+	EXPECT_THROW (fetch.fetch (4), std::runtime_error);
+
+	EXPECT_THROW (jlu::ArrayFetch (db, "SELECT * FROM data_2"), std::runtime_error);
+}
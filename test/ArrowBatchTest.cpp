@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include "../src/MySQLite/include/mysqlite.h"
+
+class ArrowBatchTest : public ::testing::Test {
+   public:
+	void SetUp () {
+		db.open (":memory:");
+		db.exec (
+			"CREATE TABLE data_1 (id INTEGER PRIMARY KEY ASC NOT NULL, resource TEXT, value REAL, "
+			"raw BLOB)");
+		db.exec (
+			"WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 2500) "
+			"INSERT INTO data_1 (resource, value) SELECT 'AI0' || i, i * 0.5 FROM n;");
+		db.exec ("UPDATE data_1 SET resource = NULL, raw = x'0102' WHERE id = 2;");
+		db.exec ("UPDATE data_1 SET id = 5000000000 WHERE id = 2500;");
+	}
+	jlu::MySQLite db;
+};
+
+TEST_F (ArrowBatchTest, Columns_follow_the_c_data_interface) {
+	std::vector<jlu::ArrowBatch> batches;
+	EXPECT_TRUE (db.queryBatches ("SELECT id, resource, value, raw, id * 2 AS twice FROM data_1",
+								  1000, batches));
+	ASSERT_EQ (batches.size (), 3u);
+	EXPECT_EQ (batches[0].numRows (), 1000);
+	EXPECT_EQ (batches[2].numRows (), 500);
+
+	const ArrowSchema& schema = batches[0].schema;
+	EXPECT_STREQ (schema.format, "+s");
+	ASSERT_EQ (schema.n_children, 5);
+	EXPECT_STREQ (schema.children[0]->format, "l");
+	EXPECT_STREQ (schema.children[1]->format, "u");
+	EXPECT_STREQ (schema.children[1]->name, "resource");
+	EXPECT_STREQ (schema.children[2]->format, "g");
+	EXPECT_STREQ (schema.children[3]->format, "z");
+	EXPECT_STREQ (schema.children[4]->format, "l");
+
+	const ArrowArray& array = batches[0].array;
+	ASSERT_EQ (array.n_children, 5);
+	const ArrowArray* ids = array.children[0];
+	EXPECT_EQ (ids->null_count, 0);
+	EXPECT_EQ (ids->buffers[0], nullptr);
+	EXPECT_EQ (static_cast<const int64_t*> (ids->buffers[1])[999], 1000);
+
+	const ArrowArray* resources = array.children[1];
+	EXPECT_EQ (resources->n_buffers, 3);
+	EXPECT_EQ (resources->null_count, 1);
+	const uint8_t* validity = static_cast<const uint8_t*> (resources->buffers[0]);
+	EXPECT_EQ (validity[0], 0xFD);
+	const int32_t* offsets = static_cast<const int32_t*> (resources->buffers[1]);
+	const char* chars = static_cast<const char*> (resources->buffers[2]);
+	EXPECT_EQ (std::string (chars + offsets[0], offsets[1] - offsets[0]), "AI01");
+	EXPECT_EQ (offsets[2], offsets[1]);
+	EXPECT_EQ (std::string (chars + offsets[2], offsets[3] - offsets[2]), "AI03");
+
+	EXPECT_DOUBLE_EQ (static_cast<const double*> (array.children[2]->buffers[1])[3], 2.0);
+	const ArrowArray* raw = array.children[3];
+	EXPECT_EQ (raw->null_count, 999);
+	EXPECT_EQ (static_cast<const int32_t*> (raw->buffers[1])[2], 2);
+
+	const ArrowArray* last = batches[2].array.children[0];
+	EXPECT_EQ (static_cast<const int64_t*> (last->buffers[1])[499], 5000000000LL);
+}
+
+TEST_F (ArrowBatchTest, Consumer_takes_ownership) {
+	std::vector<jlu::ArrowBatch> batches;
+	db.queryBatches ("SELECT resource FROM data_1 WHERE id < 10", 100, batches);
+	ASSERT_EQ (batches.size (), 1u);
+
+	ArrowArray moved = batches[0].array;
+	ArrowSchema movedSchema = batches[0].schema;
+	batches[0].array.release = nullptr;
+	batches[0].schema.release = nullptr;
+	batches.clear ();
+
+	EXPECT_EQ (moved.length, 9);
+	ASSERT_NE (moved.release, nullptr);
+	moved.release (&moved);
+	movedSchema.release (&movedSchema);
+	EXPECT_EQ (moved.release, nullptr);
+	EXPECT_EQ (movedSchema.release, nullptr);
+}
+
+TEST_F (ArrowBatchTest, Empty_result_and_wrong_query) {
+	std::vector<jlu::ArrowBatch> batches;
+	EXPECT_TRUE (db.queryBatches ("SELECT * FROM data_1 WHERE id < 0", 100, batches));
+	EXPECT_TRUE (batches.empty ());
+	EXPECT_THROW (db.queryBatches ("SELECT * FROM data_3", 100, batches), std::runtime_error);
+}
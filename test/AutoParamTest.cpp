@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include "../src/MySQLite/include/autoparam.h"
+#include "../src/MySQLite/include/mysqlite.h"
+
+static const std::string autoParamFileName ("autoparam.db");
+
+class AutoParamTest : public ::testing::Test {
+   public:
+	void SetUp () { std::filesystem::remove (autoParamFileName); }
+};
+
+TEST_F (AutoParamTest, Normalize_literals) {
+	std::string normalized;
+	std::vector<jlu::sqlValue> values;
+	ASSERT_TRUE (jlu::AutoParameterizer::normalize (
+		"SELECT  name FROM data_1 -- comment\n WHERE value > 2.5 AND resource = 'it''s' AND data = x'0aFF'\n"
+		"ORDER BY 2, value LIMIT 10;",
+		normalized, values));
+	EXPECT_EQ (normalized,
+			   "SELECT  name FROM data_1 -- comment\n WHERE value > ? AND resource = ? AND data = ?\n"
+			   "ORDER BY 2, value LIMIT ?;");
+	ASSERT_EQ (values.size (), 4u);
+	EXPECT_DOUBLE_EQ (std::get<double> (values[0]), 2.5);
+	EXPECT_EQ (std::get<std::string> (values[1]), "it's");
+	EXPECT_EQ (std::get<std::vector<uint8_t>> (values[2]), (std::vector<uint8_t>{0x0a, 0xff}));
+	EXPECT_EQ (std::get<int> (values[3]), 10);
+
+	std::string other;
+	ASSERT_TRUE (jlu::AutoParameterizer::normalize ("INSERT INTO \"data 1\" VALUES (1, 'a', 9999999999, 0x10)", other, values));
+	EXPECT_EQ (other, "INSERT INTO \"data 1\" VALUES (?, ?, 9999999999, 0x10)");
+	ASSERT_TRUE (jlu::AutoParameterizer::normalize ("INSERT INTO \"data 1\" VALUES (22, 'bb', 9999999999, 0x10)", normalized, values));
+	EXPECT_EQ (jlu::AutoParameterizer::fingerprint (normalized), jlu::AutoParameterizer::fingerprint (other));
+
+	EXPECT_FALSE (jlu::AutoParameterizer::normalize ("CREATE TABLE t (a DEFAULT 1)", normalized, values));
+	EXPECT_FALSE (jlu::AutoParameterizer::normalize ("PRAGMA user_version = 3", normalized, values));
+	EXPECT_FALSE (jlu::AutoParameterizer::normalize ("SELECT 1; SELECT 2", normalized, values));
+	EXPECT_FALSE (jlu::AutoParameterizer::normalize ("SELECT * FROM t WHERE a = ?", normalized, values));
+	EXPECT_FALSE (jlu::AutoParameterizer::normalize ("SELECT 'unterminated", normalized, values));
+}
+
+TEST_F (AutoParamTest, Literal_statements_share_a_prepared_statement) {
+	jlu::MySQLite db (autoParamFileName);
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, resource TEXT, value REAL, data BLOB)");
+	db.setAutoParameterize (true);
+	for (int i = 0; i < 100; i++) {
+		db.exec ("INSERT INTO data_1 (resource, value, data) VALUES ('AI" + std::to_string (i) + "', " +
+				 std::to_string (i) + ".5, x'0102');");
+	}
+	jlu::AutoParamStats stats = db.getAutoParamStats ();
+	EXPECT_EQ (stats.misses, 1u);
+	EXPECT_EQ (stats.hits, 99u);
+	EXPECT_EQ (stats.statements, 1u);
+
+	std::vector<jlu::sqlRow> result;
+	EXPECT_TRUE (db.exec ("SELECT resource, value, data FROM data_1 WHERE id = 8", result));
+	ASSERT_EQ (result.size (), 1u);
+	EXPECT_EQ (std::get<std::string> (result[0]["resource"]), "AI7");
+	EXPECT_DOUBLE_EQ (std::get<double> (result[0]["value"]), 7.5);
+	EXPECT_EQ (std::get<std::vector<uint8_t>> (result[0]["data"]), (std::vector<uint8_t>{1, 2}));
+	EXPECT_TRUE (db.exec ("SELECT resource, value, data FROM data_1 WHERE id = 9", result));
+	EXPECT_EQ (std::get<std::string> (result[0]["resource"]), "AI8");
+	EXPECT_EQ (db.getAutoParamStats ().hits, 100u);
+
+	// Column named after a literal: run as it is.
+	EXPECT_TRUE (db.exec ("SELECT count(*) + 1 FROM data_1", result));
+	ASSERT_EQ (result.size (), 1u);
+	EXPECT_EQ (std::get<int> (result[0]["count(*) + 1"]), 101);
+	EXPECT_EQ (db.getAutoParamStats ().unparameterized, 1u);
+
+	db.setAutoParameterize (false);
+	EXPECT_EQ (db.getAutoParamStats ().hits, 0u);
+	EXPECT_TRUE (db.close ());
+}
+
+TEST_F (AutoParamTest, Column_names_keep_the_original_text) {
+	jlu::MySQLite db (autoParamFileName);
+	db.exec ("CREATE TABLE t (a INTEGER, b INTEGER)");
+	db.exec ("INSERT INTO t (a, b) VALUES (1, 2)");
+	std::vector<jlu::sqlRow> plain;
+	EXPECT_TRUE (db.exec ("SELECT a  +  b FROM t WHERE a = 1", plain));
+	db.setAutoParameterize (true);
+	std::vector<jlu::sqlRow> rewritten;
+	EXPECT_TRUE (db.exec ("SELECT a  +  b FROM t WHERE a = 1", rewritten));
+	EXPECT_EQ (db.getAutoParamStats ().misses, 1u);
+	ASSERT_EQ (rewritten.size (), 1u);
+	EXPECT_EQ (rewritten, plain);
+	EXPECT_EQ (std::get<int> (rewritten[0]["a  +  b"]), 3);
+	EXPECT_TRUE (db.close ());
+}
+
+TEST_F (AutoParamTest, Errors_eviction_and_close) {
+	jlu::MySQLite db (autoParamFileName);
+	db.setAutoParameterize (true, 2);
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, resource TEXT NOT NULL UNIQUE)");
+	db.exec ("INSERT INTO data_1 (resource) VALUES ('a')");
+	EXPECT_THROW (db.exec ("INSERT INTO data_1 (resource) VALUES ('a')"), std::runtime_error);
+	EXPECT_THROW (db.exec ("INSERT INTO data_2 (resource) VALUES ('a')"), std::runtime_error);
+	db.exec ("INSERT INTO data_1 (resource) VALUES ('b')");
+
+	std::vector<jlu::sqlRow> result;
+	db.exec ("SELECT id FROM data_1 WHERE resource = 'b'", result);
+	db.exec ("SELECT resource FROM data_1 WHERE id = 1", result);
+	ASSERT_EQ (result.size (), 1u);
+	EXPECT_EQ (std::get<std::string> (result[0]["resource"]), "a");
+	jlu::AutoParamStats stats = db.getAutoParamStats ();
+	EXPECT_EQ (stats.statements, 2u);
+	EXPECT_EQ (stats.evictions, 1u);
+
+	// The cached statements are finalized, or sqlite3_close would fail.
+	EXPECT_TRUE (db.close ());
+	EXPECT_EQ (db.getAutoParamStats ().statements, 0u);
+}
+
+TEST_F (AutoParamTest, Runtime_errors_throw_with_or_without_the_cache) {
+	jlu::MySQLite db (autoParamFileName);
+	std::vector<jlu::sqlRow> result;
+	for (bool enable : {false, true}) {
+		db.setAutoParameterize (enable);
+		// Compiles, then fails while it runs.
+		EXPECT_THROW (db.exec ("SELECT json ('not json') AS j", result), std::runtime_error);
+		EXPECT_TRUE (db.exec ("SELECT json ('[1]') AS j", result));
+	}
+	// Both statements went through the cache, as one statement.
+	EXPECT_EQ (db.getAutoParamStats ().misses, 1u);
+	EXPECT_EQ (db.getAutoParamStats ().hits, 1u);
+}
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include "../src/MySQLite/include/blobstream.h"
+
+class BlobStreamTest : public ::testing::Test {
+   public:
+	void SetUp () {
+		db.open (":memory:");
+		db.exec ("CREATE TABLE files (id INTEGER PRIMARY KEY, name TEXT, content BLOB)");
+		db.exec ("INSERT INTO files VALUES (1, 'a', zeroblob(0)), (2, 'b', x'0102030405')");
+	}
+	jlu::MySQLite db;
+};
+
+TEST_F (BlobStreamTest, Write_reserved_blob_and_read_it_in_chunks) {
+	const int total = 100000;
+	EXPECT_TRUE (jlu::BlobStream::reserve (db, "files", "content", 1, total));
+	EXPECT_FALSE (jlu::BlobStream::reserve (db, "files", "content", 99, total));
+
+	{
+		jlu::BlobStream out (db, "files", "content", 1, true);
+		EXPECT_EQ (out.size (), total);
+		std::vector<uint8_t> chunk (4096);
+		int written = 0;
+		while (written < total) {
+			for (size_t i = 0; i < chunk.size (); i++) {
+				chunk[i] = static_cast<uint8_t> ((written + i) % 251);
+			}
+			int n = out.write (chunk.data (), static_cast<int> (chunk.size ()));
+			ASSERT_GT (n, 0);
+			written += n;
+		}
+		EXPECT_EQ (out.write (chunk.data (), 1), 0);
+	}
+
+	jlu::BlobStream in (db, "files", "content", 1);
+	std::vector<uint8_t> chunk (1000);
+	int offset = 0;
+	int n = 0;
+	while ((n = in.read (chunk.data (), static_cast<int> (chunk.size ()))) > 0) {
+		for (int i = 0; i < n; i++) {
+			ASSERT_EQ (chunk[i], static_cast<uint8_t> ((offset + i) % 251));
+		}
+		offset += n;
+	}
+	EXPECT_EQ (offset, total);
+	EXPECT_TRUE (in.seek (total - 10));
+	EXPECT_EQ (in.read (chunk.data (), 100), 10);
+	EXPECT_FALSE (in.seek (total + 1));
+}
+
+TEST_F (BlobStreamTest, Reopen_moves_to_other_row) {
+	jlu::BlobStream in (db, "files", "content", 1);
+	EXPECT_EQ (in.size (), 0);
+	EXPECT_TRUE (in.reopen (2));
+	EXPECT_EQ (in.size (), 5);
+	uint8_t buffer[5];
+	EXPECT_EQ (in.read (buffer, 5), 5);
+	EXPECT_EQ (buffer[4], 5);
+	EXPECT_FALSE (in.reopen (42));
+	EXPECT_TRUE (in.close ());
+}
+
+TEST_F (BlobStreamTest, Throw_exception_on_missing_row_or_read_only_write) {
+	EXPECT_THROW (jlu::BlobStream (db, "files", "content", 42), std::runtime_error);
+	EXPECT_THROW (jlu::BlobStream (db, "nope", "content", 1), std::runtime_error);
+	jlu::BlobStream in (db, "files", "content", 2);
+	uint8_t buffer[2] = {9, 9};
+	EXPECT_THROW (in.write (buffer, 2), std::runtime_error);
+}
+
+TEST_F (BlobStreamTest, Reserve_quotes_names) {
+	db.exec ("CREATE TABLE \"my \"\"files\"\"\" (id INTEGER PRIMARY KEY, \"con\"\"tent\" BLOB)");
+	db.exec ("INSERT INTO \"my \"\"files\"\"\" VALUES (1, NULL)");
+	EXPECT_TRUE (jlu::BlobStream::reserve (db, "my \"files\"", "con\"tent", 1, 10));
+	EXPECT_EQ (jlu::BlobStream (db, "my \"files\"", "con\"tent", 1).size (), 10);
+	EXPECT_EQ (jlu::MySQLite::quoteIdentifier ("a\"b"), "\"a\"\"b\"");
+}
+
+TEST_F (BlobStreamTest, Reserve_in_an_attached_database) {
+	db.exec ("ATTACH DATABASE ':memory:' AS archive");
+	db.exec ("CREATE TABLE archive.files (id INTEGER PRIMARY KEY, name TEXT, content BLOB)");
+	db.exec ("INSERT INTO archive.files VALUES (1, 'a', NULL)");
+	EXPECT_TRUE (jlu::BlobStream::reserve (db, "files", "content", 1, 8, "archive"));
+	EXPECT_EQ (jlu::BlobStream (db, "files", "content", 1, false, "archive").size (), 8);
+	// The table of the same name in main is not touched.
+	EXPECT_EQ (jlu::BlobStream (db, "files", "content", 1).size (), 0);
+	EXPECT_FALSE (jlu::BlobStream::reserve (db, "files", "content", 2, 8, "archive"));
+}
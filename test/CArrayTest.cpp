@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include "../src/MySQLite/include/carray.h"
+#include "../src/MySQLite/include/mysqlite.h"
+
+static const std::string carrayFileName ("carray.db");
+
+class CArrayTest : public ::testing::Test {
+   public:
+	void SetUp () { std::filesystem::remove (carrayFileName); }
+};
+
+TEST_F (CArrayTest, In_list_of_a_bound_vector) {
+	jlu::MySQLite db (carrayFileName);
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, resource TEXT, value REAL)");
+	db.exec ("BEGIN;");
+	for (int i = 1; i <= 5000; i++) {
+		db.exec ("INSERT INTO data_1 (resource, value) VALUES ('AI" + std::to_string (i) + "', " + std::to_string (i) +
+				 ".5)");
+	}
+	db.exec ("COMMIT;");
+
+	sqlite3_stmt* stmt = nullptr;
+	ASSERT_EQ (sqlite3_prepare_v2 (db.getHandle (), "SELECT count(*), sum(id) FROM data_1 WHERE id IN carray(?)", -1,
+								   &stmt, nullptr),
+			   SQLITE_OK);
+	std::vector<int64_t> ids;
+	for (int64_t id = 2; id <= 4000; id += 2) {
+		ids.push_back (id);
+	}
+	ids.push_back (9999);
+	ASSERT_EQ (jlu::carray::bind (stmt, 1, ids), SQLITE_OK);
+	ASSERT_EQ (sqlite3_step (stmt), SQLITE_ROW);
+	EXPECT_EQ (sqlite3_column_int (stmt, 0), 2000);
+	EXPECT_EQ (sqlite3_column_int64 (stmt, 1), 4002000);
+
+	// Same statement, other keys.
+	sqlite3_reset (stmt);
+	std::vector<int64_t> few = {7, 7, 11};
+	jlu::carray::bind (stmt, 1, few);
+	ASSERT_EQ (sqlite3_step (stmt), SQLITE_ROW);
+	EXPECT_EQ (sqlite3_column_int (stmt, 0), 2);
+
+	// NULL or a pointer of another type: no rows.
+	sqlite3_reset (stmt);
+	sqlite3_bind_null (stmt, 1);
+	ASSERT_EQ (sqlite3_step (stmt), SQLITE_ROW);
+	EXPECT_EQ (sqlite3_column_int (stmt, 0), 0);
+	sqlite3_reset (stmt);
+	sqlite3_bind_pointer (stmt, 1, &few, "other", nullptr);
+	ASSERT_EQ (sqlite3_step (stmt), SQLITE_ROW);
+	EXPECT_EQ (sqlite3_column_int (stmt, 0), 0);
+	sqlite3_finalize (stmt);
+
+	ASSERT_EQ (sqlite3_prepare_v2 (db.getHandle (),
+								   "SELECT d.id FROM carray(?) AS c JOIN data_1 AS d ON d.resource = c.value "
+								   "ORDER BY d.id",
+								   -1, &stmt, nullptr),
+			   SQLITE_OK);
+	std::vector<std::string> resources = {"AI30", "AI10", "missing"};
+	jlu::carray::bind (stmt, 1, resources);
+	std::vector<int64_t> found;
+	while (sqlite3_step (stmt) == SQLITE_ROW) {
+		found.push_back (sqlite3_column_int64 (stmt, 0));
+	}
+	EXPECT_EQ (found, (std::vector<int64_t>{10, 30}));
+	sqlite3_finalize (stmt);
+
+	ASSERT_EQ (sqlite3_prepare_v2 (db.getHandle (), "SELECT count(*) FROM data_1 WHERE value IN carray(?)", -1, &stmt,
+								   nullptr),
+			   SQLITE_OK);
+	std::vector<double> values = {1.5, 2.5, 2.0};
+	jlu::carray::bind (stmt, 1, values);
+	ASSERT_EQ (sqlite3_step (stmt), SQLITE_ROW);
+	EXPECT_EQ (sqlite3_column_int (stmt, 0), 2);
+	sqlite3_finalize (stmt);
+
+	EXPECT_THROW (db.exec ("CREATE VIRTUAL TABLE t USING carray"), std::runtime_error);
+}
@@ -0,0 +1,188 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <thread>
+#include "../src/MySQLite/include/changestream.h"
+#include "../src/MySQLite/include/transaction.h"
+
+class ChangeStreamTest : public ::testing::Test {
+   public:
+	void SetUp () {
+		db.open (":memory:");
+		db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY ASC NOT NULL, resource TEXT, value REAL)");
+		db.exec ("CREATE TABLE data_2 (id INTEGER PRIMARY KEY ASC NOT NULL, name TEXT)");
+	}
+	jlu::MySQLite db;
+};
+
+TEST_F (ChangeStreamTest, Committed_transactions_are_published) {
+	jlu::ChangeStream stream (db);
+	jlu::ChangeSubscriber subscriber (stream);
+	std::vector<jlu::ChangeEvent> batch;
+
+	db.exec ("BEGIN;");
+	db.exec ("INSERT INTO data_1 (id, resource, value) VALUES (1, 'AI01', 1.5), (2, 'AI02', 2.5);");
+	db.exec ("UPDATE data_1 SET value = 3.5 WHERE id = 2;");
+	db.exec ("INSERT INTO data_2 (id, name) VALUES (7, 'pump');");
+	EXPECT_EQ (subscriber.poll (batch), 0u);
+	db.exec ("COMMIT;");
+	db.exec ("DELETE FROM data_1 WHERE id = 1;");
+
+	ASSERT_EQ (subscriber.poll (batch), 5u);
+	EXPECT_EQ (batch[0].op, jlu::ChangeOp::Insert);
+	EXPECT_EQ (batch[0].rowid, 1);
+	EXPECT_EQ (stream.tableName (batch[0].table), "data_1");
+	EXPECT_EQ (batch[2].op, jlu::ChangeOp::Update);
+	EXPECT_EQ (batch[2].rowid, 2);
+	EXPECT_EQ (stream.tableName (batch[3].table), "data_2");
+	EXPECT_EQ (batch[3].txn, batch[0].txn);
+	EXPECT_EQ (batch[4].op, jlu::ChangeOp::Delete);
+	EXPECT_EQ (batch[4].txn, batch[0].txn + 1);
+	EXPECT_EQ (subscriber.poll (batch), 0u);
+
+	jlu::ChangeStreamStats stats = stream.getStats ();
+	EXPECT_EQ (stats.transactions, 2u);
+	EXPECT_EQ (stats.events, 5u);
+}
+
+TEST_F (ChangeStreamTest, Rolled_back_events_are_dropped) {
+	jlu::ChangeStream stream (db);
+	jlu::ChangeSubscriber subscriber (stream);
+	std::vector<jlu::ChangeEvent> batch;
+
+	db.exec ("BEGIN;");
+	db.exec ("INSERT INTO data_1 (id, resource, value) VALUES (1, 'AI01', 1.5);");
+	db.exec ("ROLLBACK;");
+	db.exec ("INSERT INTO data_2 (id, name) VALUES (1, 'valve');");
+
+	ASSERT_EQ (subscriber.poll (batch), 1u);
+	EXPECT_EQ (stream.tableName (batch[0].table), "data_2");
+	EXPECT_EQ (stream.getStats ().rolledBackEvents, 1u);
+}
+
+TEST_F (ChangeStreamTest, Failed_statement_drops_its_events) {
+	db.exec ("CREATE TABLE data_3 (id INTEGER PRIMARY KEY, value INTEGER UNIQUE)");
+	jlu::ChangeStream stream (db);
+	jlu::ChangeSubscriber subscriber (stream);
+	std::vector<jlu::ChangeEvent> batch;
+
+	db.exec ("BEGIN;");
+	db.exec ("INSERT INTO data_3 VALUES (1, 100);");
+	EXPECT_THROW (db.exec ("INSERT INTO data_3 VALUES (10, 1), (11, 2), (12, 100);"), std::runtime_error);
+	// FAIL keeps the rows written before the error.
+	EXPECT_THROW (db.exec ("INSERT OR FAIL INTO data_3 VALUES (20, 3), (21, 100);"), std::runtime_error);
+	db.exec ("COMMIT;");
+
+	std::vector<jlu::sqlRow> rows;
+	db.exec ("SELECT count(*) AS n FROM data_3;", rows);
+	EXPECT_EQ (std::get<int> (rows[0]["n"]), 2);
+	ASSERT_EQ (subscriber.poll (batch), 2u);
+	EXPECT_EQ (batch[0].rowid, 1);
+	EXPECT_EQ (batch[1].rowid, 20);
+	EXPECT_EQ (stream.getStats ().rolledBackEvents, 2u);
+}
+
+TEST_F (ChangeStreamTest, Savepoint_rollback_drops_its_events) {
+	jlu::ChangeStream stream (db);
+	jlu::ChangeSubscriber subscriber (stream);
+	std::vector<jlu::ChangeEvent> batch;
+
+	jlu::Transaction transaction (db);
+	db.exec ("INSERT INTO data_1 (id, resource, value) VALUES (1, 'AI01', 1.5);");
+	{
+		jlu::Savepoint outer (db);
+		db.exec ("INSERT INTO data_1 (id, resource, value) VALUES (2, 'AI02', 2.5);");
+		{
+			jlu::Savepoint inner (db);
+			db.exec ("INSERT INTO data_1 (id, resource, value) VALUES (3, 'AI03', 3.5);");
+			inner.release ();
+		}
+		db.exec ("UPDATE data_1 SET value = 0 WHERE id = 1;");
+	}
+	{
+		jlu::Savepoint kept (db);
+		db.exec ("INSERT INTO data_2 (id, name) VALUES (5, 'pump');");
+		kept.release ();
+	}
+	transaction.commit ();
+
+	ASSERT_EQ (subscriber.poll (batch), 2u);
+	EXPECT_EQ (batch[0].rowid, 1);
+	EXPECT_EQ (batch[0].op, jlu::ChangeOp::Insert);
+	EXPECT_EQ (stream.tableName (batch[1].table), "data_2");
+	EXPECT_EQ (stream.getStats ().rolledBackEvents, 3u);
+}
+
+TEST_F (ChangeStreamTest, Every_subscriber_gets_every_event) {
+	jlu::ChangeStream stream (db, 8);
+	jlu::ChangeSubscriber fast (stream);
+	jlu::ChangeSubscriber slow (stream);
+	std::vector<jlu::ChangeEvent> batch;
+
+	size_t received = 0;
+	for (int i = 1; i <= 20; i++) {
+		db.exec ("INSERT INTO data_1 (id, resource, value) VALUES (" + std::to_string (i) + ", 'AI', 0);");
+		received += fast.poll (batch, 4);
+	}
+	EXPECT_EQ (received, 20u);
+	EXPECT_EQ (fast.lost (), 0u);
+
+	ASSERT_EQ (slow.poll (batch, 100), 8u);
+	EXPECT_EQ (slow.lost (), 12u);
+	EXPECT_EQ (batch.front ().rowid, 13);
+	EXPECT_EQ (batch.back ().rowid, 20);
+}
+
+TEST_F (ChangeStreamTest, Wait_wakes_up_on_commit) {
+	jlu::ChangeStream stream (db);
+	jlu::ChangeSubscriber subscriber (stream);
+	std::vector<jlu::ChangeEvent> batch;
+	EXPECT_EQ (subscriber.wait (batch, std::chrono::milliseconds (10)), 0u);
+
+	size_t received = 0;
+	std::thread consumer ([&] {
+		while (received < 100) {
+			std::vector<jlu::ChangeEvent> events;
+			received += subscriber.wait (events, std::chrono::milliseconds (2000));
+		}
+	});
+	for (int i = 1; i <= 100; i++) {
+		db.exec ("INSERT INTO data_2 (id, name) VALUES (" + std::to_string (i) + ", 'x');");
+	}
+	consumer.join ();
+	EXPECT_EQ (received, 100u);
+}
+
+TEST_F (ChangeStreamTest, Busy_commit_publishes_nothing_until_it_succeeds) {
+	std::remove ("changestream.db");
+	jlu::MySQLite writer ("changestream.db");
+	writer.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY ASC NOT NULL, resource TEXT)");
+	sqlite3_busy_timeout (writer.getHandle (), 0);
+	jlu::ChangeStream stream (writer);
+	jlu::ChangeSubscriber subscriber (stream);
+	std::vector<jlu::ChangeEvent> batch;
+
+	sqlite3* reader = nullptr;
+	ASSERT_EQ (sqlite3_open ("changestream.db", &reader), SQLITE_OK);
+	writer.exec ("BEGIN;");
+	writer.exec ("INSERT INTO data_1 (id, resource) VALUES (1, 'AI01');");
+	ASSERT_EQ (sqlite3_exec (reader, "BEGIN; SELECT count(*) FROM data_1;", nullptr, nullptr, nullptr),
+			   SQLITE_OK);
+	EXPECT_THROW (writer.exec ("COMMIT;"), std::runtime_error);
+	EXPECT_EQ (subscriber.poll (batch), 0u);
+	writer.exec ("ROLLBACK;");
+	EXPECT_EQ (subscriber.poll (batch), 0u);
+	EXPECT_EQ (stream.getStats ().rolledBackEvents, 1u);
+
+	writer.exec ("BEGIN;");
+	writer.exec ("INSERT INTO data_1 (id, resource) VALUES (2, 'AI02');");
+	EXPECT_THROW (writer.exec ("COMMIT;"), std::runtime_error);
+	sqlite3_exec (reader, "COMMIT;", nullptr, nullptr, nullptr);
+	writer.exec ("COMMIT;");
+	ASSERT_EQ (subscriber.poll (batch), 1u);
+	EXPECT_EQ (batch[0].rowid, 2);
+	EXPECT_EQ (stream.getStats ().transactions, 1u);
+
+	sqlite3_close (reader);
+	writer.close ();
+	std::remove ("changestream.db");
+}
@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <filesystem>
+#include <thread>
+#include "../src/MySQLite/include/changeset.h"
+
+static const std::string primaryFileName ("primary.db");
+static const std::string replicaFileName ("replica.db");
+static const std::string logFileName ("changesets.log");
+
+class ChangesetTest : public ::testing::Test {
+   public:
+	void SetUp () {
+		for (const std::string& name : {primaryFileName, replicaFileName}) {
+			for (std::string suffix : {"", "-wal", "-shm"}) {
+				std::filesystem::remove (name + suffix);
+			}
+		}
+		std::filesystem::remove (logFileName);
+	}
+};
+
+static void createTable (jlu::MySQLite& db) {
+	db.exec ("PRAGMA journal_mode=WAL;");
+	db.exec (
+		"CREATE TABLE IF NOT EXISTS data_1 (id INTEGER PRIMARY KEY ASC NOT NULL, "
+		"resource TEXT NOT NULL, value REAL NOT NULL)");
+}
+
+static std::vector<jlu::sqlRow> allRows (jlu::MySQLite& db) {
+	std::vector<jlu::sqlRow> rows;
+	db.exec ("SELECT * FROM data_1 ORDER BY id;", rows);
+	return rows;
+}
+
+TEST_F (ChangesetTest, Replicate_inserts_updates_and_deletes) {
+	jlu::MySQLite primary (primaryFileName);
+	jlu::MySQLite replica (replicaFileName);
+	createTable (primary);
+	createTable (replica);
+
+	jlu::ChangesetPublisher publisher (primary, logFileName);
+	jlu::ChangesetApplier applier (replica, logFileName);
+	primary.exec ("INSERT INTO data_1 VALUES (1, 'a', 1.0), (2, 'b', 2.0), (3, 'c', 3.0);");
+	primary.exec ("BEGIN; UPDATE data_1 SET value = 20.0 WHERE id = 2; DELETE FROM data_1 WHERE id = 3; COMMIT;");
+	primary.exec ("BEGIN; INSERT INTO data_1 VALUES (4, 'd', 4.0); ROLLBACK;");
+
+	EXPECT_EQ (publisher.getStats ().changesets, 2u);
+	EXPECT_EQ (applier.applyAvailable (), 2u);
+	EXPECT_EQ (allRows (replica), allRows (primary));
+
+	jlu::ChangesetApplierStats stats = applier.getStats ();
+	EXPECT_EQ (stats.lastSequence, 2u);
+	EXPECT_EQ (stats.conflicts, 0u);
+	EXPECT_EQ (stats.pendingBytes, 0u);
+	EXPECT_EQ (applier.applyAvailable (), 0u);
+}
+
+TEST_F (ChangesetTest, Resume_after_restart) {
+	jlu::MySQLite primary (primaryFileName);
+	jlu::MySQLite replica (replicaFileName);
+	createTable (primary);
+	createTable (replica);
+	{
+		jlu::ChangesetPublisher publisher (primary, logFileName);
+		jlu::ChangesetApplier applier (replica, logFileName);
+		primary.exec ("INSERT INTO data_1 VALUES (1, 'a', 1.0);");
+		EXPECT_EQ (applier.applyAvailable (), 1u);
+	}
+
+	jlu::ChangesetPublisher publisher (primary, logFileName);
+	primary.exec ("INSERT INTO data_1 VALUES (2, 'b', 2.0);");
+	EXPECT_EQ (publisher.getStats ().lastSequence, 2u);
+
+	jlu::ChangesetApplier applier (replica, logFileName);
+	EXPECT_EQ (applier.applyAvailable (), 1u);
+	EXPECT_EQ (applier.getStats ().lastSequence, 2u);
+	EXPECT_EQ (allRows (replica), allRows (primary));
+}
+
+TEST_F (ChangesetTest, Conflict_policy) {
+	jlu::MySQLite primary (primaryFileName);
+	jlu::MySQLite replica (replicaFileName);
+	createTable (primary);
+	createTable (replica);
+	replica.exec ("INSERT INTO data_1 VALUES (1, 'replica', 0.0);");
+
+	jlu::ChangesetPublisher publisher (primary, logFileName);
+	primary.exec ("INSERT INTO data_1 VALUES (1, 'primary', 1.0);");
+	{
+		jlu::ChangesetApplier applier (replica, logFileName);
+		EXPECT_THROW (applier.applyAvailable (), std::runtime_error);
+		EXPECT_EQ (applier.getStats ().lastSequence, 0u);
+	}
+	{
+		jlu::ChangesetApplierOptions options;
+		options.policy = jlu::ConflictPolicy::Replace;
+		jlu::ChangesetApplier applier (replica, logFileName, options);
+		EXPECT_EQ (applier.applyAvailable (), 1u);
+		EXPECT_EQ (applier.getStats ().conflicts, 1u);
+	}
+	EXPECT_EQ (allRows (replica), allRows (primary));
+}
+
+TEST_F (ChangesetTest, Apply_in_background) {
+	jlu::MySQLite primary (primaryFileName);
+	jlu::MySQLite replica (replicaFileName);
+	createTable (primary);
+	createTable (replica);
+
+	jlu::ChangesetPublisher publisher (primary, logFileName);
+	jlu::ChangesetApplierOptions options;
+	options.batchRecords = 8;
+	options.pollInterval = std::chrono::milliseconds (1);
+	jlu::ChangesetApplier applier (replica, logFileName, options);
+	EXPECT_TRUE (applier.start ());
+	for (int i = 0; i < 100; i++) {
+		primary.exec ("INSERT INTO data_1 VALUES (" + std::to_string (i) + ", 'r', " + std::to_string (i) + ");");
+	}
+	for (int i = 0; i < 5000 && applier.getStats ().lastSequence < 100; i++) {
+		std::this_thread::sleep_for (std::chrono::milliseconds (1));
+	}
+	EXPECT_TRUE (applier.stop ());
+
+	jlu::ChangesetApplierStats stats = applier.getStats ();
+	EXPECT_EQ (stats.lastSequence, 100u);
+	EXPECT_TRUE (stats.lastError.empty ());
+	EXPECT_GT (stats.maxLag.count (), 0);
+	EXPECT_EQ (allRows (replica), allRows (primary));
+}
+
+TEST_F (ChangesetTest, Named_pipe_transport) {
+	ASSERT_EQ (mkfifo (logFileName.c_str (), 0600), 0);
+	jlu::MySQLite primary (primaryFileName);
+	jlu::MySQLite replica (replicaFileName);
+	createTable (primary);
+	createTable (replica);
+
+	// The reader opens first: opening the write end of a pipe waits for it.
+	jlu::ChangesetApplier applier (replica, logFileName);
+	jlu::ChangesetPublisher publisher (primary, logFileName);
+	primary.exec ("INSERT INTO data_1 VALUES (1, 'a', 1.0), (2, 'b', 2.0);");
+	primary.exec ("UPDATE data_1 SET resource = 'z';");
+	EXPECT_EQ (applier.applyAvailable (), 2u);
+	EXPECT_EQ (allRows (replica), allRows (primary));
+}
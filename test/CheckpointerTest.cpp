@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <thread>
+#include "../src/MySQLite/include/checkpointer.h"
+
+static const std::string ckptFileName ("checkpoint.db");
+
+class CheckpointerTest : public ::testing::Test {
+   public:
+	void SetUp () {
+		for (std::string suffix : {"", "-wal", "-shm"}) {
+			std::filesystem::remove (ckptFileName + suffix);
+		}
+	}
+};
+
+static void createWalTable (jlu::MySQLite& db) {
+	db.exec ("PRAGMA journal_mode=WAL;");
+	db.exec (
+		"CREATE TABLE IF NOT EXISTS data_1 (id INTEGER PRIMARY KEY ASC NOT NULL, "
+		"resource TEXT NOT NULL, value REAL NOT NULL)");
+}
+
+TEST_F (CheckpointerTest, Start_and_stop) {
+	jlu::MySQLite db (ckptFileName);
+	createWalTable (db);
+	jlu::Checkpointer ckpt (db);
+	EXPECT_TRUE (ckpt.start ());
+	EXPECT_FALSE (ckpt.start ());
+	EXPECT_TRUE (ckpt.isRunning ());
+	EXPECT_TRUE (ckpt.stop ());
+	EXPECT_FALSE (ckpt.isRunning ());
+	EXPECT_TRUE (db.close ());
+}
+
+TEST_F (CheckpointerTest, Stop_restores_the_previous_auto_checkpoint) {
+	jlu::MySQLite db (ckptFileName);
+	createWalTable (db);
+	EXPECT_EQ (db.getWalAutoCheckpoint (), 1000);
+	db.setWalAutoCheckpoint (250);
+	jlu::Checkpointer ckpt (db);
+	ckpt.start ();
+	EXPECT_EQ (db.getWalAutoCheckpoint (), 0);
+	ckpt.stop ();
+	EXPECT_EQ (db.getWalAutoCheckpoint (), 250);
+
+	db.setWalAutoCheckpoint (0);
+	ckpt.start ();
+	ckpt.stop ();
+	EXPECT_EQ (db.getWalAutoCheckpoint (), 0);
+}
+
+TEST_F (CheckpointerTest, Throw_exception_with_memory_database) {
+	jlu::MySQLite db (":memory:");
+	jlu::Checkpointer ckpt (db);
+	EXPECT_THROW (ckpt.start (), std::runtime_error);
+}
+
+TEST_F (CheckpointerTest, Checkpoint_when_wal_reaches_threshold) {
+	jlu::MySQLite db (ckptFileName);
+	createWalTable (db);
+	jlu::CheckpointerOptions options;
+	options.interval = std::chrono::seconds (60);
+	options.frameThreshold = 10;
+	jlu::Checkpointer ckpt (db, options);
+	EXPECT_TRUE (ckpt.start ());
+
+	for (int i = 1; i <= 50; i++) {
+		db.exec ("INSERT INTO data_1 (resource, value) values ('AI0" + std::to_string (i) +
+				 "', 2.3)");
+	}
+
+	for (int i = 0; i < 200 && ckpt.getStats ().passiveRuns == 0; i++) {
+		std::this_thread::sleep_for (std::chrono::milliseconds (10));
+	}
+	jlu::CheckpointStats stats = ckpt.getStats ();
+	EXPECT_GT (stats.passiveRuns, 0u);
+	EXPECT_GT (stats.framesCheckpointed, 0u);
+	EXPECT_TRUE (ckpt.stop ());
+	EXPECT_TRUE (db.close ());
+}
+
+TEST_F (CheckpointerTest, Truncate_checkpoint_empties_wal_file) {
+	jlu::MySQLite db (ckptFileName);
+	createWalTable (db);
+	jlu::CheckpointerOptions options;
+	options.interval = std::chrono::seconds (60);
+	options.frameThreshold = 1000000;
+	jlu::Checkpointer ckpt (db, options);
+	EXPECT_TRUE (ckpt.start ());
+	db.exec ("INSERT INTO data_1 (resource, value) values ('AI01', 2.3)");
+	EXPECT_GT (std::filesystem::file_size (ckptFileName + "-wal"), 0u);
+
+	EXPECT_TRUE (ckpt.checkpoint (SQLITE_CHECKPOINT_TRUNCATE));
+	EXPECT_EQ (std::filesystem::file_size (ckptFileName + "-wal"), 0u);
+	EXPECT_EQ (ckpt.getStats ().truncateRuns, 1u);
+	EXPECT_TRUE (ckpt.stop ());
+	EXPECT_TRUE (db.close ());
+}
+
+TEST_F (CheckpointerTest, Reader_holding_the_wal_does_not_make_it_spin) {
+	jlu::MySQLite db (ckptFileName);
+	createWalTable (db);
+	sqlite3* reader = nullptr;
+	ASSERT_EQ (sqlite3_open (ckptFileName.c_str (), &reader), SQLITE_OK);
+	ASSERT_EQ (sqlite3_exec (reader, "BEGIN; SELECT count(*) FROM data_1;", nullptr, nullptr, nullptr),
+			   SQLITE_OK);
+
+	jlu::CheckpointerOptions options;
+	options.interval = std::chrono::seconds (60);
+	options.frameThreshold = 10;
+	jlu::Checkpointer ckpt (db, options);
+	EXPECT_TRUE (ckpt.start ());
+	for (int i = 1; i <= 50; i++) {
+		db.exec ("INSERT INTO data_1 (resource, value) values ('AI0" + std::to_string (i) +
+				 "', 2.3)");
+	}
+	std::this_thread::sleep_for (std::chrono::milliseconds (300));
+
+	// At most one attempt per commit, not a retry loop while the reader is open.
+	jlu::CheckpointStats stats = ckpt.getStats ();
+	EXPECT_GT (stats.passiveRuns, 0u);
+	EXPECT_LE (stats.passiveRuns, 50u);
+	EXPECT_GE (stats.pendingFrames, options.frameThreshold);
+
+	sqlite3_exec (reader, "COMMIT;", nullptr, nullptr, nullptr);
+	sqlite3_close (reader);
+	EXPECT_TRUE (ckpt.checkpoint ());
+	EXPECT_EQ (ckpt.getStats ().pendingFrames, 0);
+	EXPECT_TRUE (ckpt.stop ());
+	EXPECT_TRUE (db.close ());
+}
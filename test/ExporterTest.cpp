@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include "../src/MySQLite/include/exporter.h"
+#include "../src/MySQLite/include/importer.h"
+
+static const std::string exportFileName ("export.out");
+
+static std::string readFile (const std::string& name) {
+	std::ifstream in (name, std::ios::binary);
+	return std::string (std::istreambuf_iterator<char> (in), std::istreambuf_iterator<char> ());
+}
+
+class ExporterTest : public ::testing::Test {
+   public:
+	void SetUp () {
+		std::filesystem::remove (exportFileName);
+		db.open (":memory:");
+		db.exec (
+			"CREATE TABLE data_1 (id INTEGER PRIMARY KEY ASC NOT NULL, resource TEXT, value REAL, "
+			"raw BLOB)");
+		db.exec (
+			"WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 20000) "
+			"INSERT INTO data_1 (resource, value) SELECT 'AI0' || i, i * 0.25 FROM n;");
+		db.exec (
+			"UPDATE data_1 SET resource = 'say \"hi\", bye', value = 3, raw = x'00ff' WHERE id = 2;");
+		db.exec ("UPDATE data_1 SET resource = NULL, value = 1e300 * 1e300 WHERE id = 3;");
+	}
+	jlu::MySQLite db;
+};
+
+TEST_F (ExporterTest, Csv_round_trip_with_small_buffers) {
+	for (bool pipelined : {true, false}) {
+		jlu::ExportOptions options;
+		options.bufferSize = 4096;
+		options.pipelined = pipelined;
+		jlu::Exporter exporter (db, options);
+		jlu::ExportStats stats =
+			exporter.exportQuery ("SELECT id, resource, value FROM data_1 ORDER BY id", exportFileName);
+		EXPECT_EQ (stats.rows, 20000u);
+		EXPECT_EQ (stats.bytes, std::filesystem::file_size (exportFileName));
+		EXPECT_GT (stats.writes, 10u);
+
+		std::string csv = readFile (exportFileName);
+		std::string expected ("id,resource,value\n1,AI01,0.25\n2,\"say \"\"hi\"\", bye\",3.0\n3,,inf\n");
+		EXPECT_EQ (csv.substr (0, expected.size ()), expected);
+
+		jlu::MySQLite copy (":memory:");
+		jlu::Importer importer (copy);
+		importer.importFile (exportFileName, "data_1");
+		std::vector<jlu::sqlRow> data;
+		copy.exec ("SELECT count(*) AS n, sum(value) AS s FROM data_1 WHERE id <> 3", data);
+		EXPECT_EQ (std::get<int> (data[0]["n"]), 19999);
+		db.exec ("SELECT sum(value) AS s FROM data_1 WHERE id <> 3", data);
+		double sum = std::get<double> (data[0]["s"]);
+		copy.exec ("SELECT sum(value) AS s FROM data_1 WHERE id <> 3", data);
+		EXPECT_DOUBLE_EQ (std::get<double> (data[0]["s"]), sum);
+	}
+}
+
+TEST_F (ExporterTest, Json_lines_escape_and_null) {
+	jlu::ExportOptions options;
+	options.format = jlu::ExportFormat::JsonLines;
+	options.directIo = true;
+	jlu::Exporter exporter (db, options);
+	jlu::ExportStats stats = exporter.exportQuery ("SELECT * FROM data_1 WHERE id <= 3", exportFileName);
+	EXPECT_EQ (stats.rows, 3u);
+	EXPECT_EQ (readFile (exportFileName),
+			   "{\"id\":1,\"resource\":\"AI01\",\"value\":0.25,\"raw\":null}\n"
+			   "{\"id\":2,\"resource\":\"say \\\"hi\\\", bye\",\"value\":3.0,\"raw\":\"00ff\"}\n"
+			   "{\"id\":3,\"resource\":null,\"value\":null,\"raw\":null}\n");
+}
+
+TEST_F (ExporterTest, Columnar_batches) {
+	jlu::ExportOptions options;
+	options.format = jlu::ExportFormat::Columnar;
+	options.columnarBatchRows = 7000;
+	jlu::Exporter exporter (db, options);
+	exporter.exportQuery ("SELECT id, resource FROM data_1 ORDER BY id", exportFileName);
+
+	std::string data = readFile (exportFileName);
+	const char* p = data.data ();
+	auto u32 = [&p] () {
+		uint32_t v;
+		memcpy (&v, p, 4);
+		p += 4;
+		return v;
+	};
+	ASSERT_EQ (std::string (p, 8), "JLUCOL01");
+	p += 8;
+	ASSERT_EQ (u32 (), 2u);
+	uint32_t len = u32 ();
+	EXPECT_EQ (std::string (p, len), "id");
+	p += len;
+	len = u32 ();
+	p += len;
+
+	uint32_t total = 0;
+	uint32_t rows = 0;
+	std::vector<uint32_t> batches;
+	while ((rows = u32 ()) != 0) {
+		batches.push_back (rows);
+		uint32_t idBytes = u32 ();
+		EXPECT_EQ (idBytes, rows * 9);
+		EXPECT_EQ (p[0], SQLITE_INTEGER);
+		int64_t first;
+		memcpy (&first, p + rows, 8);
+		EXPECT_EQ (first, total + 1);
+		p += idBytes;
+		uint32_t resourceBytes = u32 ();
+		if (total == 0) {
+			EXPECT_EQ (p[2], SQLITE_NULL);
+		}
+		p += resourceBytes;
+		total += rows;
+	}
+	EXPECT_EQ (batches, (std::vector<uint32_t>{7000, 7000, 6000}));
+	EXPECT_EQ (p, data.data () + data.size ());
+}
+
+TEST_F (ExporterTest, Columnar_batch_of_zero_rows_is_one_row) {
+	jlu::ExportOptions options;
+	options.format = jlu::ExportFormat::Columnar;
+	options.columnarBatchRows = 0;
+	jlu::Exporter exporter (db, options);
+	exporter.exportQuery ("SELECT id FROM data_1 WHERE id <= 3 ORDER BY id", exportFileName);
+
+	std::string data = readFile (exportFileName);
+	const char* p = data.data () + 8;
+	auto u32 = [&p] () {
+		uint32_t v;
+		memcpy (&v, p, 4);
+		p += 4;
+		return v;
+	};
+	ASSERT_EQ (u32 (), 1u);
+	p += u32 ();
+
+	uint32_t rows = 0;
+	std::vector<uint32_t> batches;
+	while ((rows = u32 ()) != 0) {
+		batches.push_back (rows);
+		p += u32 ();
+	}
+	EXPECT_EQ (batches, (std::vector<uint32_t>{1, 1, 1}));
+	EXPECT_EQ (p, data.data () + data.size ());
+}
+
+TEST_F (ExporterTest, Columnar_batch_ends_before_a_column_is_too_long) {
+	jlu::ExportOptions options;
+	options.format = jlu::ExportFormat::Columnar;
+	options.columnarBatchBytes = 25;	// Two rows of 'AI0nn' (type + length + 5 bytes)
+	jlu::Exporter exporter (db, options);
+	exporter.exportQuery (
+		"SELECT CASE WHEN id = 12 THEN printf('%040d', id) ELSE resource END FROM data_1 "
+		"WHERE id BETWEEN 10 AND 14 ORDER BY id",
+		exportFileName);
+
+	std::string data = readFile (exportFileName);
+	const char* p = data.data () + 8;
+	auto u32 = [&p] () {
+		uint32_t v;
+		memcpy (&v, p, 4);
+		p += 4;
+		return v;
+	};
+	ASSERT_EQ (u32 (), 1u);
+	p += u32 ();
+
+	uint32_t rows = 0;
+	std::vector<uint32_t> batches;
+	std::vector<uint32_t> bytes;
+	while ((rows = u32 ()) != 0) {
+		batches.push_back (rows);
+		bytes.push_back (u32 ());
+		p += bytes.back ();
+	}
+	// The 40 bytes row is longer than the limit: it goes alone.
+	EXPECT_EQ (batches, (std::vector<uint32_t>{2, 1, 2}));
+	EXPECT_EQ (bytes, (std::vector<uint32_t>{20, 45, 20}));
+	EXPECT_EQ (p, data.data () + data.size ());
+}
+
+TEST_F (ExporterTest, Throw_exception_on_bad_query) {
+	jlu::Exporter exporter (db);
+	EXPECT_THROW (exporter.exportQuery ("SELECT * FROM data_3", exportFileName), std::runtime_error);
+}
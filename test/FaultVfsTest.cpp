@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <filesystem>
+#include "../src/MySQLite/include/faultvfs.h"
+#include "../src/MySQLite/include/mysqlite.h"
+
+static const std::string faultFileName ("faulty.db");
+
+class FaultVfsTest : public ::testing::Test {
+   public:
+	void SetUp () {
+		for (std::string suffix : {"", "-wal", "-shm", "-journal"}) {
+			std::filesystem::remove (faultFileName + suffix);
+		}
+		ASSERT_TRUE (jlu::faultvfs::registerVfs ());
+		jlu::faultvfs::configure (jlu::faultvfs::Options ());
+		jlu::faultvfs::resetStats ();
+	}
+
+	void TearDown () { jlu::faultvfs::configure (jlu::faultvfs::Options ()); }
+};
+
+static void createTable (jlu::MySQLite& db) {
+	db.exec ("PRAGMA journal_mode=WAL;");
+	db.exec ("PRAGMA synchronous=FULL;");
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, payload BLOB)");
+}
+
+TEST_F (FaultVfsTest, Sync_latency_delays_the_commit) {
+	jlu::MySQLite db;
+	db.open (faultFileName, jlu::faultvfs::name);
+	createTable (db);
+
+	jlu::faultvfs::Options options;
+	options.sync.mean = std::chrono::milliseconds (20);
+	jlu::faultvfs::configure (options);
+	jlu::faultvfs::resetStats ();
+
+	auto begin = std::chrono::steady_clock::now ();
+	db.exec ("INSERT INTO data_1 (payload) VALUES (randomblob(100));");
+	auto elapsed = std::chrono::steady_clock::now () - begin;
+
+	jlu::faultvfs::Stats stats = jlu::faultvfs::getStats ();
+	EXPECT_GE (stats.syncs, 1u);
+	EXPECT_EQ (stats.injectedDelay, std::chrono::milliseconds (20) * stats.syncs);
+	EXPECT_GE (elapsed, std::chrono::milliseconds (20));
+}
+
+TEST_F (FaultVfsTest, Stalls_and_throughput_cap) {
+	jlu::MySQLite db;
+	db.open (faultFileName, jlu::faultvfs::name);
+	createTable (db);
+
+	jlu::faultvfs::Options options;
+	options.write.distribution = jlu::faultvfs::Distribution::Exponential;
+	options.write.mean = std::chrono::microseconds (50);
+	options.write.stallProbability = 1.0;
+	options.write.stall = std::chrono::microseconds (100);
+	options.bytesPerSecond = 4 * 1024 * 1024;
+	jlu::faultvfs::configure (options);
+	jlu::faultvfs::resetStats ();
+
+	db.exec ("INSERT INTO data_1 (payload) VALUES (randomblob(200000));");
+	jlu::faultvfs::Stats stats = jlu::faultvfs::getStats ();
+	EXPECT_GT (stats.writes, 0u);
+	EXPECT_EQ (stats.stalls, stats.writes);
+	// 200 kB at 4 MB/s queue for about 48 ms, plus a stall of 100 us per write.
+	EXPECT_GE (stats.injectedDelay, std::chrono::milliseconds (45) + std::chrono::microseconds (100) * stats.writes);
+}
+
+TEST_F (FaultVfsTest, Injected_errors_leave_a_consistent_database) {
+	jlu::MySQLite db;
+	db.open (faultFileName, jlu::faultvfs::name);
+	createTable (db);
+	db.exec ("INSERT INTO data_1 (payload) VALUES (randomblob(100));");
+
+	jlu::faultvfs::Options options;
+	options.writeErrorProbability = 1.0;
+	jlu::faultvfs::configure (options);
+	EXPECT_THROW (db.exec ("INSERT INTO data_1 (payload) VALUES (randomblob(100));"), std::runtime_error);
+
+	options = jlu::faultvfs::Options ();
+	options.shortWriteProbability = 1.0;
+	jlu::faultvfs::configure (options);
+	EXPECT_THROW (db.exec ("INSERT INTO data_1 (payload) VALUES (randomblob(100));"), std::runtime_error);
+
+	options = jlu::faultvfs::Options ();
+	options.syncErrorProbability = 1.0;
+	jlu::faultvfs::configure (options);
+	EXPECT_THROW (db.exec ("INSERT INTO data_1 (payload) VALUES (randomblob(100));"), std::runtime_error);
+
+	jlu::faultvfs::Stats stats = jlu::faultvfs::getStats ();
+	EXPECT_EQ (stats.writeErrors, 1u);
+	EXPECT_EQ (stats.shortWrites, 1u);
+	EXPECT_EQ (stats.syncErrors, 1u);
+
+	jlu::faultvfs::configure (jlu::faultvfs::Options ());
+	db.close ();
+	db.open (faultFileName, jlu::faultvfs::name);
+	sqlite3_stmt* stmt = nullptr;
+	ASSERT_EQ (sqlite3_prepare_v2 (db.getHandle (), "PRAGMA integrity_check;", -1, &stmt, nullptr), SQLITE_OK);
+	ASSERT_EQ (sqlite3_step (stmt), SQLITE_ROW);
+	EXPECT_STREQ (reinterpret_cast<const char*> (sqlite3_column_text (stmt, 0)), "ok");
+	sqlite3_finalize (stmt);
+	ASSERT_EQ (sqlite3_prepare_v2 (db.getHandle (), "SELECT count(*) FROM data_1;", -1, &stmt, nullptr), SQLITE_OK);
+	ASSERT_EQ (sqlite3_step (stmt), SQLITE_ROW);
+	EXPECT_EQ (sqlite3_column_int (stmt, 0), 1);
+	sqlite3_finalize (stmt);
+}
+
+TEST_F (FaultVfsTest, File_filter_spares_other_files) {
+	jlu::faultvfs::Options options;
+	options.readErrorProbability = 1.0;
+	options.writeErrorProbability = 1.0;
+	options.fileFilter = "-wal";
+	jlu::faultvfs::configure (options);
+
+	jlu::MySQLite db;
+	db.open (faultFileName, jlu::faultvfs::name);
+	db.exec ("PRAGMA journal_mode=DELETE;");
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, payload BLOB)");
+	db.exec ("INSERT INTO data_1 (payload) VALUES (randomblob(100));");
+	jlu::faultvfs::Stats stats = jlu::faultvfs::getStats ();
+	EXPECT_EQ (stats.writes, 0u);
+	EXPECT_EQ (stats.writeErrors, 0u);
+	EXPECT_EQ (jlu::faultvfs::getOptions ().fileFilter, "-wal");
+}
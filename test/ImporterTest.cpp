@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include "../src/MySQLite/include/importer.h"
+
+static const std::string importFileName ("import.csv");
+
+class ImporterTest : public ::testing::Test {
+   public:
+	void SetUp () {
+		std::filesystem::remove (importFileName);
+		db.open (":memory:");
+	}
+	jlu::MySQLite db;
+};
+
+TEST_F (ImporterTest, Import_csv_file_with_several_threads) {
+	{
+		std::ofstream out (importFileName);
+		out << "id,resource,value\r\n";
+		for (int i = 1; i <= 50000; i++) {
+			out << i << ",AI0" << i << "," << i * 0.5 << "\n";
+		}
+	}
+
+	jlu::ImportOptions options;
+	options.threads = 4;
+	options.batchRows = 1000;
+	options.rowsPerTransaction = 20000;
+	jlu::Importer importer (db, options);
+	jlu::ImportStats stats = importer.importFile (importFileName, "data_1");
+	EXPECT_EQ (stats.rows, 50000u);
+	EXPECT_EQ (stats.bytes, std::filesystem::file_size (importFileName));
+	EXPECT_EQ (stats.transactions, 3u);
+	EXPECT_GT (stats.insertRowsPerSecond (), 0.0);
+
+	std::vector<jlu::sqlRow> data;
+	db.exec ("SELECT count(*) AS n, sum(id) AS s FROM data_1", data);
+	EXPECT_EQ (std::get<int> (data[0]["n"]), 50000);
+	EXPECT_EQ (std::get<int> (data[0]["s"]), 1250025000);
+	db.exec ("SELECT resource, value FROM data_1 WHERE id = 7", data);
+	EXPECT_EQ (std::get<std::string> (data[0]["resource"]), "AI07");
+	EXPECT_DOUBLE_EQ (std::get<double> (data[0]["value"]), 3.5);
+}
+
+TEST_F (ImporterTest, Csv_quotes_nulls_and_explicit_table) {
+	db.exec ("CREATE TABLE contacts (name TEXT, phone TEXT, age INTEGER)");
+	std::string csv ("\"Lopez, Jonathan\";\"555 \"\"home\"\"\";42\nAna;;\n");
+	jlu::ImportOptions options;
+	options.delimiter = ';';
+	options.header = false;
+	options.columns = {"name", "phone", "age"};
+	jlu::Importer importer (db, options);
+	EXPECT_EQ (importer.importBuffer (csv.data (), csv.size (), "contacts").rows, 2u);
+
+	std::vector<jlu::sqlRow> data;
+	db.exec ("SELECT name, phone, age, typeof(phone) AS t FROM contacts ORDER BY rowid", data);
+	ASSERT_EQ (data.size (), 2u);
+	EXPECT_EQ (std::get<std::string> (data[0]["name"]), "Lopez, Jonathan");
+	EXPECT_EQ (std::get<std::string> (data[0]["phone"]), "555 \"home\"");
+	EXPECT_EQ (std::get<int> (data[0]["age"]), 42);
+	EXPECT_EQ (std::get<std::string> (data[1]["t"]), "null");
+}
+
+TEST_F (ImporterTest, Table_name_with_quotes) {
+	std::string csv ("id,name\n1,pump\n");
+	jlu::Importer importer (db);
+	EXPECT_EQ (importer.importBuffer (csv.data (), csv.size (), "my \"data\"").rows, 1u);
+	std::vector<jlu::sqlRow> data;
+	db.exec ("SELECT name FROM \"my \"\"data\"\"\"", data);
+	ASSERT_EQ (data.size (), 1u);
+	EXPECT_EQ (std::get<std::string> (data[0]["name"]), "pump");
+}
+
+TEST_F (ImporterTest, Import_json_lines) {
+	std::string jsonl (
+		"{\"id\": 1, \"resource\": \"AI01\", \"value\": 2.5, \"tags\": [1, 2]}\n"
+		"{\"value\": -1e3, \"resource\": \"caf\\u00e9 \\\"x\\\"\", \"id\": 2, \"extra\": true}\n"
+		"{\"id\": 3, \"resource\": null}\n");
+	jlu::ImportOptions options;
+	options.format = jlu::ImportFormat::JsonLines;
+	jlu::Importer importer (db, options);
+	EXPECT_EQ (importer.importBuffer (jsonl.data (), jsonl.size (), "data_1").rows, 3u);
+
+	std::vector<jlu::sqlRow> data;
+	db.exec ("SELECT * FROM data_1 ORDER BY id", data);
+	ASSERT_EQ (data.size (), 3u);
+	EXPECT_EQ (std::get<std::string> (data[0]["tags"]), "[1, 2]");
+	EXPECT_EQ (std::get<std::string> (data[1]["resource"]), "caf\xc3\xa9 \"x\"");
+	EXPECT_DOUBLE_EQ (std::get<double> (data[1]["value"]), -1000.0);
+	EXPECT_EQ (std::get<std::string> (data[2]["value"]), "null");
+}
+
+TEST_F (ImporterTest, Throw_exception_and_rollback_on_bad_line) {
+	std::string csv ("id,value\n1,2.0\n2\n");
+	jlu::Importer importer (db);
+	EXPECT_THROW (importer.importBuffer (csv.data (), csv.size (), "data_1"), std::runtime_error);
+	std::vector<jlu::sqlRow> data;
+	db.exec ("SELECT count(*) AS n FROM data_1", data);
+	EXPECT_EQ (std::get<int> (data[0]["n"]), 0);
+}
+
+TEST_F (ImporterTest, Import_joins_the_transaction_of_the_caller) {
+	db.exec ("CREATE TABLE data_1 (id INTEGER, resource TEXT)");
+	std::string csv ("id,resource\n1,AI01\n2,AI02\n3,AI03\n");
+	jlu::ImportOptions options;
+	options.rowsPerTransaction = 2;
+	jlu::Importer importer (db, options);
+
+	db.exec ("BEGIN;");
+	jlu::ImportStats stats = importer.importBuffer (csv.data (), csv.size (), "data_1");
+	EXPECT_EQ (stats.rows, 3u);
+	EXPECT_EQ (stats.transactions, 0u);
+	EXPECT_EQ (sqlite3_get_autocommit (db.getHandle ()), 0);
+	db.exec ("ROLLBACK;");
+	std::vector<jlu::sqlRow> data;
+	db.exec ("SELECT count(*) AS n FROM data_1", data);
+	EXPECT_EQ (std::get<int> (data[0]["n"]), 0);
+
+	EXPECT_EQ (importer.importBuffer (csv.data (), csv.size (), "data_1").transactions, 2u);
+	db.exec ("SELECT count(*) AS n FROM data_1", data);
+	EXPECT_EQ (std::get<int> (data[0]["n"]), 3);
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include "../src/MySQLite/include/mysqlite.h"
+
+static const std::string insertColumnsFileName ("insertcolumns.db");
+
+class InsertColumnsTest : public ::testing::Test {
+   public:
+	void SetUp () { std::filesystem::remove (insertColumnsFileName); }
+};
+
+TEST_F (InsertColumnsTest, Insert_columns_in_batches) {
+	jlu::MySQLite db (insertColumnsFileName);
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, resource TEXT, value REAL, data BLOB)");
+	int commits = 0;
+	jlu::ChangeListener listener;
+	listener.onCommit = [&] () { commits++; };
+	db.addChangeListener (listener);
+
+	const size_t numRows = 10000;
+	std::vector<int64_t> ids (numRows);
+	std::vector<double> values (numRows);
+	std::vector<std::string> names (numRows);
+	std::vector<std::string_view> resources (numRows);
+	std::vector<std::string_view> blobs (numRows, std::string_view ("\x01\x00\x02", 3));
+	std::vector<uint8_t> validity ((numRows + 7) / 8, 0xff);
+	for (size_t i = 0; i < numRows; i++) {
+		ids[i] = static_cast<int64_t> (i) + 1;
+		values[i] = static_cast<double> (i) / 2;
+		names[i] = "AI" + std::to_string (i % 10);
+		resources[i] = names[i];
+	}
+	validity[0] = 0xfe;   // row 0: NULL value
+
+	uint64_t inserted = db.insertColumns ("data_1",
+										  {jlu::ColumnSpan::int64s ("id", ids.data (), numRows),
+										   jlu::ColumnSpan::texts ("resource", resources.data (), numRows),
+										   jlu::ColumnSpan::doubles ("value", values.data (), numRows, validity.data ()),
+										   jlu::ColumnSpan::blobs ("data", blobs.data (), numRows)},
+										  3000);
+	EXPECT_EQ (inserted, numRows);
+	EXPECT_EQ (commits, 4);
+
+	std::vector<jlu::sqlRow> result;
+	db.exec ("SELECT count(*) AS n, count(value) AS v, sum(id) AS s FROM data_1", result);
+	EXPECT_EQ (std::get<int> (result[0]["n"]), 10000);
+	EXPECT_EQ (std::get<int> (result[0]["v"]), 9999);
+	EXPECT_EQ (std::get<int> (result[0]["s"]), 50005000);
+	db.exec ("SELECT resource, value, data FROM data_1 WHERE id = 12", result);
+	EXPECT_EQ (std::get<std::string> (result[0]["resource"]), "AI1");
+	EXPECT_DOUBLE_EQ (std::get<double> (result[0]["value"]), 5.5);
+	EXPECT_EQ (std::get<std::vector<uint8_t>> (result[0]["data"]), (std::vector<uint8_t>{1, 0, 2}));
+
+	// Inside a transaction of the caller: no commit of its own.
+	db.exec ("BEGIN;");
+	std::vector<int64_t> moreIds = {20001, 20002};
+	db.insertColumns ("data_1", {jlu::ColumnSpan::int64s ("id", moreIds.data (), moreIds.size ())});
+	EXPECT_EQ (commits, 4);
+	db.exec ("ROLLBACK;");
+
+	EXPECT_THROW (db.insertColumns ("data_1", {jlu::ColumnSpan::int64s ("id", ids.data (), 2),
+											   jlu::ColumnSpan::doubles ("value", values.data (), 3)}),
+				  std::runtime_error);
+	EXPECT_THROW (db.insertColumns ("data_2", {jlu::ColumnSpan::int64s ("id", ids.data (), 2)}), std::runtime_error);
+}
+
+TEST_F (InsertColumnsTest, Failed_batch_is_rolled_back) {
+	jlu::MySQLite db (insertColumnsFileName);
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY)");
+	std::vector<int64_t> ids = {1, 2, 3, 4, 5, 6, 4, 8};
+	EXPECT_THROW (db.insertColumns ("data_1", {jlu::ColumnSpan::int64s ("id", ids.data (), ids.size ())}, 4),
+				  std::runtime_error);
+	std::vector<jlu::sqlRow> result;
+	db.exec ("SELECT count(*) AS n FROM data_1", result);
+	EXPECT_EQ (std::get<int> (result[0]["n"]), 4);
+	EXPECT_NE (sqlite3_get_autocommit (db.getHandle ()), 0);
+
+	EXPECT_EQ (db.insertColumns ("data_1", {jlu::ColumnSpan::int64s ("id", ids.data () + 4, 2)}), 2u);
+}
+
+TEST_F (InsertColumnsTest, Failed_call_inside_a_transaction_is_rolled_back) {
+	jlu::MySQLite db (insertColumnsFileName);
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY)");
+	db.exec ("BEGIN;");
+	db.exec ("INSERT INTO data_1 VALUES (100)");
+	std::vector<int64_t> ids = {1, 2, 3, 2};
+	EXPECT_THROW (db.insertColumns ("data_1", {jlu::ColumnSpan::int64s ("id", ids.data (), ids.size ())}),
+				  std::runtime_error);
+
+	// The rows before the failed one are gone, the row of the caller and its transaction stay.
+	std::vector<jlu::sqlRow> result;
+	EXPECT_EQ (sqlite3_get_autocommit (db.getHandle ()), 0);
+	db.exec ("SELECT count(*) AS n, sum(id) AS s FROM data_1", result);
+	EXPECT_EQ (std::get<int> (result[0]["n"]), 1);
+	EXPECT_EQ (std::get<int> (result[0]["s"]), 100);
+
+	EXPECT_EQ (db.insertColumns ("data_1", {jlu::ColumnSpan::int64s ("id", ids.data (), 3)}), 3u);
+	db.exec ("COMMIT;");
+	db.exec ("SELECT count(*) AS n FROM data_1", result);
+	EXPECT_EQ (std::get<int> (result[0]["n"]), 4);
+}
+
+TEST_F (InsertColumnsTest, Empty_views_are_empty_values_not_null) {
+	jlu::MySQLite db (insertColumnsFileName);
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, resource TEXT, data BLOB)");
+	std::vector<int64_t> ids = {1, 2};
+	std::vector<std::string_view> empty (2);   // data () is nullptr
+	uint8_t validity = 0x01;				   // row 1: NULL
+	db.insertColumns ("data_1", {jlu::ColumnSpan::int64s ("id", ids.data (), 2),
+								 jlu::ColumnSpan::texts ("resource", empty.data (), 2, &validity),
+								 jlu::ColumnSpan::blobs ("data", empty.data (), 2, &validity)});
+
+	std::vector<jlu::sqlRow> result;
+	db.exec ("SELECT typeof(resource) AS t, typeof(data) AS b FROM data_1 ORDER BY id", result);
+	ASSERT_EQ (result.size (), 2u);
+	EXPECT_EQ (std::get<std::string> (result[0]["t"]), "text");
+	EXPECT_EQ (std::get<std::string> (result[0]["b"]), "blob");
+	EXPECT_EQ (std::get<std::string> (result[1]["t"]), "null");
+	EXPECT_EQ (std::get<std::string> (result[1]["b"]), "null");
+}
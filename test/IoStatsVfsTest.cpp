@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include "../src/MySQLite/include/mysqlite.h"
+
+static const std::string ioStatsFileName ("iostats.db");
+
+class IoStatsVfsTest : public ::testing::Test {
+   public:
+	void SetUp () {
+		for (std::string suffix : {"", "-wal", "-shm", "-journal"}) {
+			std::filesystem::remove (ioStatsFileName + suffix);
+		}
+		ASSERT_TRUE (jlu::iostatsvfs::registerVfs ());
+	}
+};
+
+static void insertRows (jlu::MySQLite& db, int count) {
+	db.exec ("BEGIN;");
+	for (int i = 0; i < count; i++) {
+		db.exec ("INSERT INTO data_1 (payload) VALUES (randomblob(100));");
+	}
+	db.exec ("COMMIT;");
+}
+
+TEST_F (IoStatsVfsTest, Latency_histogram) {
+	jlu::LatencyHistogram histogram;
+	EXPECT_EQ (histogram.percentileMicros (0.5), 0.0);
+	for (int i = 0; i < 90; i++) {
+		histogram.add (500);	// 0.5 us, bucket 0
+	}
+	for (int i = 0; i < 10; i++) {
+		histogram.add (3000000);	// 3 ms, bucket 12 (2048 to 4096 us)
+	}
+	EXPECT_EQ (histogram.count, 100u);
+	EXPECT_EQ (histogram.buckets[0], 90u);
+	EXPECT_EQ (histogram.buckets[12], 10u);
+	EXPECT_DOUBLE_EQ (histogram.percentileMicros (0.5), 1.0);
+	EXPECT_DOUBLE_EQ (histogram.percentileMicros (0.95), 3000.0);
+	EXPECT_DOUBLE_EQ (histogram.meanMicros (), (90 * 500 + 10 * 3000000) / 100.0 / 1000.0);
+}
+
+TEST_F (IoStatsVfsTest, Count_the_io_of_a_wal_connection) {
+	jlu::MySQLite db;
+	db.open (ioStatsFileName, jlu::iostatsvfs::name);
+	db.exec ("PRAGMA journal_mode=WAL;");
+	db.exec ("PRAGMA synchronous=FULL;");
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, payload BLOB)");
+
+	EXPECT_TRUE (db.resetIoStats ());
+	insertRows (db, 100);
+	jlu::IoStats stats;
+	ASSERT_TRUE (db.getIoStats (stats));
+	EXPECT_GT (stats.wal.writes, 0u);
+	EXPECT_GT (stats.wal.bytesWritten, 100u * 100u);
+	EXPECT_EQ (stats.wal.syncs, 1u);
+	EXPECT_EQ (stats.wal.syncLatency.count, 1u);
+	EXPECT_EQ (stats.journal.writes, 0u);
+	EXPECT_EQ (stats.database.writes, 0u);
+
+	db.exec ("PRAGMA wal_checkpoint(TRUNCATE);");
+	ASSERT_TRUE (db.getIoStats (stats));
+	EXPECT_GT (stats.database.writes, 0u);
+	EXPECT_GT (stats.database.syncs, 0u);
+	EXPECT_EQ (stats.total ().writes, stats.database.writes + stats.wal.writes);
+}
+
+TEST_F (IoStatsVfsTest, Count_the_journal_and_separate_connections) {
+	jlu::MySQLite db;
+	db.open (ioStatsFileName, jlu::iostatsvfs::name);
+	db.exec ("PRAGMA journal_mode=DELETE;");
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, payload BLOB)");
+	insertRows (db, 10);
+
+	jlu::MySQLite other;
+	other.open (ioStatsFileName, jlu::iostatsvfs::name);
+	EXPECT_TRUE (db.resetIoStats ());
+	db.exec ("UPDATE data_1 SET payload = randomblob(100);");
+
+	jlu::IoStats stats;
+	ASSERT_TRUE (db.getIoStats (stats));
+	EXPECT_GT (stats.journal.writes, 0u);
+	EXPECT_GT (stats.journal.syncs, 0u);
+	EXPECT_GT (stats.database.writes, 0u);
+	EXPECT_EQ (stats.wal.writes, 0u);
+
+	ASSERT_TRUE (other.getIoStats (stats));
+	EXPECT_EQ (stats.total ().writes, 0u);
+
+	jlu::MySQLite plain (ioStatsFileName);
+	EXPECT_FALSE (plain.getIoStats (stats));
+}
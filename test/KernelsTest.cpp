@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#include "../src/MySQLite/include/kernels.h"
+#include "../src/MySQLite/include/mysqlite.h"
+
+using jlu::kernels::CompareOp;
+using jlu::kernels::Isa;
+
+class KernelsTest : public ::testing::Test {
+   public:
+	void SetUp () {
+		// Odd length, so every kernel has a scalar tail.
+		const size_t n = 1003;
+		validity.assign ((n + 7) / 8, 0);
+		for (size_t i = 0; i < n; i++) {
+			integers.push_back ((i % 2 == 0) ? static_cast<int64_t> (i * 7) : -static_cast<int64_t> (i));
+			reals.push_back (static_cast<double> (i) * 0.25 - 100.0);
+			if (i % 3 != 0) {
+				validity[i / 8] |= static_cast<uint8_t> (1u << (i % 8));
+			}
+		}
+	}
+	void TearDown () { jlu::kernels::forceIsa (jlu::kernels::detectedIsa ()); }
+	std::vector<int64_t> integers;
+	std::vector<double> reals;
+	std::vector<uint8_t> validity;
+};
+
+TEST_F (KernelsTest, Every_isa_gives_the_scalar_result) {
+	const size_t n = integers.size ();
+	jlu::kernels::forceIsa (Isa::Scalar);
+	int64_t sum = jlu::kernels::sum (integers.data (), validity.data (), n);
+	double realSum = jlu::kernels::sum (reals.data (), validity.data (), n);
+	jlu::kernels::MinMax<int64_t> range = jlu::kernels::minMax (integers.data (), validity.data (), n);
+	jlu::kernels::Moments moments = jlu::kernels::moments (reals.data (), validity.data (), n);
+	std::vector<uint8_t> expected ((n + 7) / 8);
+	size_t matches = jlu::kernels::compare (integers.data (), validity.data (), n, CompareOp::Ge, 350,
+											expected.data ());
+
+	for (Isa isa : {Isa::Sse42, Isa::Avx2}) {
+		if (jlu::kernels::forceIsa (isa) != isa) {
+			continue;
+		}
+		EXPECT_EQ (jlu::kernels::sum (integers.data (), validity.data (), n), sum);
+		EXPECT_NEAR (jlu::kernels::sum (reals.data (), validity.data (), n), realSum, 1e-6);
+		jlu::kernels::MinMax<int64_t> other = jlu::kernels::minMax (integers.data (), validity.data (), n);
+		EXPECT_EQ (other.min, range.min);
+		EXPECT_EQ (other.max, range.max);
+		EXPECT_EQ (other.count, range.count);
+		jlu::kernels::Moments m = jlu::kernels::moments (reals.data (), validity.data (), n);
+		EXPECT_NEAR (m.mean, moments.mean, 1e-9);
+		EXPECT_NEAR (m.variance, moments.variance, 1e-6);
+		std::vector<uint8_t> bitmap ((n + 7) / 8);
+		EXPECT_EQ (jlu::kernels::compare (integers.data (), validity.data (), n, CompareOp::Ge, 350,
+										  bitmap.data ()),
+				   matches);
+		EXPECT_EQ (bitmap, expected);
+	}
+}
+
+TEST_F (KernelsTest, Null_values_are_skipped) {
+	const size_t n = integers.size ();
+	int64_t expected = 0;
+	size_t count = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (i % 3 != 0) {
+			expected += integers[i];
+			count++;
+		}
+	}
+	EXPECT_EQ (jlu::kernels::countValid (validity.data (), n), count);
+	EXPECT_EQ (jlu::kernels::countValid (nullptr, n), n);
+	EXPECT_EQ (jlu::kernels::sum (integers.data (), validity.data (), n), expected);
+
+	jlu::kernels::MinMax<int64_t> range = jlu::kernels::minMax (integers.data (), validity.data (), n);
+	EXPECT_EQ (range.count, count);
+	EXPECT_EQ (range.max, 1000 * 7);	// 1002 is null
+	EXPECT_EQ (range.min, -1001);
+
+	std::vector<uint8_t> none (validity.size (), 0);
+	range = jlu::kernels::minMax (integers.data (), none.data (), n);
+	EXPECT_EQ (range.count, 0u);
+	EXPECT_EQ (range.min, 0);
+}
+
+TEST_F (KernelsTest, Compare_bitmap_filters_an_aggregate) {
+	const size_t n = reals.size ();
+	std::vector<uint8_t> bitmap ((n + 7) / 8);
+	size_t matches = jlu::kernels::compare (reals.data (), nullptr, n, CompareOp::Lt, 0.0, bitmap.data ());
+	EXPECT_EQ (matches, 400u);	 // i * 0.25 < 100
+	EXPECT_DOUBLE_EQ (jlu::kernels::sum (reals.data (), bitmap.data (), n), -20050.0);
+
+	jlu::kernels::bitmapAnd (bitmap.data (), validity.data (), bitmap.data (), n);
+	EXPECT_EQ (jlu::kernels::countValid (bitmap.data (), n), 266u);
+
+	std::vector<double> withNan = {1.0, std::nan (""), 3.0};
+	jlu::kernels::MinMax<double> range = jlu::kernels::minMax (withNan.data (), nullptr, withNan.size ());
+	EXPECT_DOUBLE_EQ (range.min, 1.0);
+	EXPECT_DOUBLE_EQ (range.max, 3.0);
+	EXPECT_EQ (jlu::kernels::compare (withNan.data (), nullptr, 3, CompareOp::Ne, 1.0, bitmap.data ()), 2u);
+}
+
+TEST_F (KernelsTest, Nan_values_are_skipped_by_every_aggregate) {
+	std::vector<double> nans (21, std::nan (""));
+	std::vector<double> mixed (nans);
+	mixed[3] = -2.0;
+	mixed[12] = 5.0;
+	mixed[20] = 7.0;
+	std::vector<uint8_t> mixedValidity = {0xff, 0xff, 0x0e};	// 7.0 is null
+	for (Isa isa : {Isa::Scalar, Isa::Sse42, Isa::Avx2}) {
+		if (jlu::kernels::forceIsa (isa) != isa) {
+			continue;
+		}
+		jlu::kernels::MinMax<double> range = jlu::kernels::minMax (nans.data (), nullptr, nans.size ());
+		EXPECT_EQ (range.count, 0u);
+		EXPECT_EQ (range.min, 0.0);
+		EXPECT_EQ (range.max, 0.0);
+		range = jlu::kernels::minMax (mixed.data (), mixedValidity.data (), mixed.size ());
+		EXPECT_EQ (range.count, 2u);
+		EXPECT_EQ (range.min, -2.0);
+		EXPECT_EQ (range.max, 5.0);
+
+		EXPECT_EQ (jlu::kernels::sum (nans.data (), nullptr, nans.size ()), 0.0);
+		EXPECT_EQ (jlu::kernels::moments (nans.data (), nullptr, nans.size ()).count, 0u);
+		EXPECT_EQ (jlu::kernels::sum (mixed.data (), mixedValidity.data (), mixed.size ()), 3.0);
+		EXPECT_EQ (jlu::kernels::sum (mixed.data (), nullptr, mixed.size ()), 10.0);
+		jlu::kernels::Moments moments = jlu::kernels::moments (mixed.data (), mixedValidity.data (), mixed.size ());
+		EXPECT_EQ (moments.count, range.count);
+		EXPECT_DOUBLE_EQ (moments.mean, 1.5);
+		EXPECT_DOUBLE_EQ (moments.variance, 12.25);
+		EXPECT_DOUBLE_EQ (moments.sampleVariance, 24.5);
+		moments = jlu::kernels::moments (mixed.data (), nullptr, mixed.size ());
+		EXPECT_EQ (moments.count, 3u);
+		EXPECT_DOUBLE_EQ (moments.mean, 10.0 / 3);
+	}
+}
+
+TEST_F (KernelsTest, Kernels_run_on_arrow_batches) {
+	jlu::MySQLite db;
+	db.open (":memory:");
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, value REAL)");
+	db.exec (
+		"WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 5000) "
+		"INSERT INTO data_1 SELECT i, CASE WHEN i % 10 = 0 THEN NULL ELSE i END FROM n;");
+	std::vector<jlu::ArrowBatch> batches;
+	ASSERT_TRUE (db.queryBatches ("SELECT id, value FROM data_1", 2048, batches));
+
+	int64_t idSum = 0;
+	double valueSum = 0.0;
+	size_t valueCount = 0;
+	for (const jlu::ArrowBatch& batch : batches) {
+		const ArrowArray* id = batch.array.children[0];
+		const ArrowArray* value = batch.array.children[1];
+		idSum += jlu::kernels::sum (static_cast<const int64_t*> (id->buffers[1]),
+									static_cast<const uint8_t*> (id->buffers[0]), id->length);
+		const uint8_t* valid = static_cast<const uint8_t*> (value->buffers[0]);
+		valueSum += jlu::kernels::sum (static_cast<const double*> (value->buffers[1]), valid, value->length);
+		valueCount += jlu::kernels::countValid (valid, value->length);
+	}
+	EXPECT_EQ (idSum, 12502500);
+	EXPECT_DOUBLE_EQ (valueSum, 12502500.0 - 1252500.0);
+	EXPECT_EQ (valueCount, 4500u);
+}
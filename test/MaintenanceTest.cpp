@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <thread>
+#include "../src/MySQLite/include/maintenance.h"
+
+static const std::string maintFileName ("maintenance.db");
+
+class MaintenanceTest : public ::testing::Test {
+   public:
+	void SetUp () {
+		for (std::string suffix : {"", "-wal", "-shm", "-journal"}) {
+			std::filesystem::remove (maintFileName + suffix);
+		}
+	}
+};
+
+static void fillAndDelete (jlu::MySQLite& db) {
+	db.exec (
+		"CREATE TABLE IF NOT EXISTS data_1 (id INTEGER PRIMARY KEY ASC NOT NULL, "
+		"resource TEXT NOT NULL, value REAL NOT NULL)");
+	db.exec (
+		"WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 5000) "
+		"INSERT INTO data_1 (resource, value) SELECT printf('AI%0500d', i), i * 0.3 FROM n;");
+	db.exec ("DELETE FROM data_1;");
+}
+
+TEST_F (MaintenanceTest, Enable_incremental_vacuum_only_on_new_files) {
+	jlu::MySQLite db (maintFileName);
+	EXPECT_TRUE (jlu::Maintenance::enableIncrementalVacuum (db));
+	EXPECT_TRUE (db.close ());
+
+	std::filesystem::remove (maintFileName);
+	EXPECT_TRUE (db.open (maintFileName));
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY)");
+	EXPECT_FALSE (jlu::Maintenance::enableIncrementalVacuum (db));
+	EXPECT_TRUE (db.close ());
+}
+
+TEST_F (MaintenanceTest, Vacuum_slices_reclaim_free_pages) {
+	jlu::MySQLite db (maintFileName);
+	EXPECT_TRUE (jlu::Maintenance::enableIncrementalVacuum (db));
+	fillAndDelete (db);
+
+	jlu::MaintenanceOptions options;
+	options.sliceInterval = std::chrono::milliseconds (5);
+	options.idleDelay = std::chrono::milliseconds (20);
+	options.pagesPerSlice = 100;
+	options.minFreePages = 1;
+	jlu::Maintenance maint (db, options);
+	EXPECT_TRUE (maint.start ());
+
+	for (int i = 0; i < 500 && (maint.getStats ().vacuumSlices == 0 || maint.getStats ().freePages > 0);
+		 i++) {
+		std::this_thread::sleep_for (std::chrono::milliseconds (10));
+	}
+	EXPECT_TRUE (maint.stop ());
+
+	jlu::MaintenanceStats stats = maint.getStats ();
+	EXPECT_GT (stats.vacuumSlices, 1u);
+	EXPECT_GT (stats.pagesReclaimed, 100u);
+	EXPECT_EQ (stats.freePages, 0);
+
+	std::vector<jlu::sqlRow> result;
+	db.exec ("PRAGMA freelist_count;", result);
+	EXPECT_EQ (std::get<int> (result[0]["freelist_count"]), 0);
+	EXPECT_TRUE (db.close ());
+}
+
+TEST_F (MaintenanceTest, Optimize_on_demand) {
+	jlu::MySQLite db (maintFileName);
+	fillAndDelete (db);
+	jlu::Maintenance maint (db);
+	EXPECT_FALSE (maint.optimize ());
+	EXPECT_TRUE (maint.start ());
+	EXPECT_TRUE (maint.optimize ());
+	EXPECT_FALSE (maint.vacuumSlice ());
+	EXPECT_EQ (maint.getStats ().optimizeRuns, 1u);
+	EXPECT_TRUE (maint.stop ());
+	EXPECT_TRUE (db.close ());
+}
+
+TEST_F (MaintenanceTest, Foreground_writes_wait_for_slices) {
+	jlu::MySQLite db (maintFileName);
+	EXPECT_TRUE (jlu::Maintenance::enableIncrementalVacuum (db));
+	fillAndDelete (db);
+
+	jlu::MaintenanceOptions options;
+	options.sliceInterval = std::chrono::milliseconds (1);
+	options.idleDelay = std::chrono::milliseconds (1);
+	options.pagesPerSlice = 4;
+	options.minFreePages = 1;
+	jlu::Maintenance maint (db, options);
+	EXPECT_TRUE (maint.start ());
+
+	std::vector<jlu::sqlRow> result;
+	db.exec ("PRAGMA busy_timeout;", result);
+	EXPECT_EQ (std::get<int> (result[0]["timeout"]), options.foregroundBusyTimeoutMs);
+	for (int i = 0; i < 300; i++) {
+		EXPECT_NO_THROW (db.exec ("INSERT INTO data_1 (resource, value) VALUES ('AI01', 1.5);"));
+		std::this_thread::sleep_for (std::chrono::milliseconds (2));
+	}
+	EXPECT_TRUE (maint.stop ());
+	EXPECT_GT (maint.getStats ().vacuumSlices, 0u);
+
+	db.exec ("PRAGMA busy_timeout;", result);
+	EXPECT_EQ (std::get<int> (result[0]["timeout"]), 0);
+	db.exec ("SELECT count(*) AS n FROM data_1;", result);
+	EXPECT_EQ (std::get<int> (result[0]["n"]), 300);
+	EXPECT_TRUE (db.close ());
+}
+
+TEST_F (MaintenanceTest, A_locked_database_is_a_busy_skip) {
+	jlu::MySQLite db (maintFileName);
+	EXPECT_TRUE (jlu::Maintenance::enableIncrementalVacuum (db));
+	fillAndDelete (db);
+
+	jlu::MaintenanceOptions options;
+	options.sliceInterval = std::chrono::milliseconds (1);
+	options.idleDelay = std::chrono::milliseconds (1);
+	jlu::Maintenance maint (db, options);
+	EXPECT_TRUE (maint.start ());
+
+	db.exec ("BEGIN EXCLUSIVE;");
+	for (int i = 0; i < 500 && maint.getStats ().busySkips < 3; i++) {
+		std::this_thread::sleep_for (std::chrono::milliseconds (2));
+	}
+	db.exec ("COMMIT;");
+	EXPECT_TRUE (maint.stop ());
+	EXPECT_GE (maint.getStats ().busySkips, 3u);
+	EXPECT_TRUE (db.close ());
+}
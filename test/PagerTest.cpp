@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include "../src/MySQLite/include/pager.h"
+
+class PagerTest : public ::testing::Test {
+   public:
+	void SetUp () {
+		db.open (":memory:");
+		db.exec (
+			"CREATE TABLE data_1 (id INTEGER PRIMARY KEY ASC NOT NULL, resource TEXT NOT NULL, "
+			"value REAL NOT NULL)");
+		db.exec (
+			"WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 1000) "
+			"INSERT INTO data_1 (resource, value) SELECT 'AI0' || (i % 7), i * 0.3 FROM n;");
+	}
+	jlu::MySQLite db;
+};
+
+TEST_F (PagerTest, Walk_all_pages_by_primary_key) {
+	jlu::Pager pager (db, "SELECT id, resource, value FROM data_1;", {"id"}, 64);
+	jlu::Page page;
+	std::string token;
+	int expected = 1;
+	int pages = 0;
+	do {
+		EXPECT_TRUE (pager.fetch (token, page));
+		ASSERT_EQ (page.columns.size (), 3u);
+		EXPECT_EQ (page.columns[0], "id");
+		for (const std::vector<jlu::sqlValue>& row : page.rows) {
+			EXPECT_EQ (std::get<int> (row[0]), expected++);
+		}
+		token = page.nextToken;
+		pages++;
+	} while (!token.empty ());
+	EXPECT_EQ (expected, 1001);
+	EXPECT_EQ (pages, 16);
+	EXPECT_EQ (page.rows.size (), 1000u % 64);
+}
+
+TEST_F (PagerTest, Composite_key_descending) {
+	jlu::Pager pager (db, "SELECT resource, id FROM data_1 WHERE value > 150", {"resource", "id"},
+					  100, true);
+	std::vector<jlu::sqlRow> expected;
+	db.exec ("SELECT resource, id FROM data_1 WHERE value > 150 ORDER BY resource DESC, id DESC",
+			 expected);
+
+	jlu::Page page;
+	std::string token;
+	size_t i = 0;
+	do {
+		pager.fetch (token, page);
+		for (const std::vector<jlu::sqlValue>& row : page.rows) {
+			ASSERT_LT (i, expected.size ());
+			EXPECT_EQ (std::get<std::string> (row[0]), std::get<std::string> (expected[i]["resource"]));
+			EXPECT_EQ (std::get<int> (row[1]), std::get<int> (expected[i]["id"]));
+			i++;
+		}
+		token = page.nextToken;
+	} while (!token.empty ());
+	EXPECT_EQ (i, expected.size ());
+}
+
+TEST_F (PagerTest, Seek_query_uses_the_primary_key) {
+	jlu::Pager pager (db, "SELECT * FROM data_1", {"id"}, 10);
+	std::vector<jlu::sqlRow> plan;
+	db.exec ("EXPLAIN QUERY PLAN " + pager.getSeekQuery (), plan);
+	ASSERT_FALSE (plan.empty ());
+	EXPECT_NE (std::get<std::string> (plan[0]["detail"]).find ("rowid>?"), std::string::npos);
+}
+
+TEST_F (PagerTest, Throw_exception_on_bad_key_or_token) {
+	EXPECT_THROW (jlu::Pager (db, "SELECT resource FROM data_1", {"id"}, 10), std::runtime_error);
+	jlu::Pager pager (db, "SELECT * FROM data_1", {"id"}, 10);
+	jlu::Page page;
+	EXPECT_THROW (pager.fetch ("zz", page), std::runtime_error);
+	EXPECT_THROW (pager.fetch ("69", page), std::runtime_error);
+}
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstdio>
+#include "../src/MySQLite/include/parallelscan.h"
+
+class ParallelScanTest : public ::testing::Test {
+   public:
+	void SetUp () {
+		std::remove ("scan.db");
+		std::remove ("scan.db-wal");
+		std::remove ("scan.db-shm");
+		db.open ("scan.db");
+		db.exec ("PRAGMA journal_mode=WAL;");
+		db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY ASC NOT NULL, resource TEXT, value INTEGER)");
+		db.exec (
+			"WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 100000) "
+			"INSERT INTO data_1 (id, resource, value) SELECT i * 3, 'AI' || (i % 10), i FROM n;");
+	}
+	void TearDown () {
+		db.close ();
+		std::remove ("scan.db");
+		std::remove ("scan.db-wal");
+		std::remove ("scan.db-shm");
+	}
+	jlu::MySQLite db;
+};
+
+TEST_F (ParallelScanTest, Partial_aggregates_are_merged) {
+	jlu::ScanOptions options;
+	options.threads = 4;
+	options.columns = "value";
+	jlu::ParallelScan scan (db, "data_1", options);
+	EXPECT_EQ (scan.workers (), 4u);
+
+	int64_t total = scan.aggregate (
+		int64_t (0), [] (int64_t& sum, sqlite3_stmt* stmt) { sum += sqlite3_column_int64 (stmt, 0); },
+		[] (int64_t& sum, const int64_t& partial) { sum += partial; });
+	EXPECT_EQ (total, 5000050000LL);
+	jlu::ScanStats stats = scan.getStats ();
+	EXPECT_EQ (stats.rows, 100000u);
+	EXPECT_EQ (stats.chunks, 16u);
+	EXPECT_EQ (stats.threads, 4u);
+}
+
+TEST_F (ParallelScanTest, Predicate_and_batches) {
+	jlu::ScanOptions options;
+	options.threads = 3;
+	options.columns = "id, value";
+	options.predicate = "resource = 'AI7'";
+	options.batchRows = 1000;
+	jlu::ParallelScan scan (db, "data_1", options);
+
+	std::atomic<int64_t> rows (0);
+	std::atomic<int64_t> sum (0);
+	jlu::ScanStats stats = scan.runBatches ([&] (size_t, jlu::ArrowBatch& batch) {
+		EXPECT_LE (batch.numRows (), 1000);
+		const int64_t* values = static_cast<const int64_t*> (batch.array.children[1]->buffers[1]);
+		for (int64_t i = 0; i < batch.numRows (); i++) {
+			sum += values[i];
+		}
+		rows += batch.numRows ();
+	});
+	EXPECT_EQ (rows, 10000);
+	EXPECT_EQ (stats.rows, 10000u);
+	EXPECT_EQ (sum, 500020000);	// 7 + 17 + ... + 99997
+}
+
+TEST_F (ParallelScanTest, Workers_share_one_snapshot) {
+	jlu::ScanOptions options;
+	options.threads = 2;
+	options.columns = "value";
+	jlu::ParallelScan scan (db, "data_1", options);
+
+	std::atomic<bool> updated (false);
+	int64_t total = scan.aggregate (
+		int64_t (0),
+		[&] (int64_t& sum, sqlite3_stmt* stmt) {
+			if (!updated.exchange (true)) {
+				db.exec ("UPDATE data_1 SET value = 0;");
+			}
+			sum += sqlite3_column_int64 (stmt, 0);
+		},
+		[] (int64_t& sum, const int64_t& partial) { sum += partial; });
+	EXPECT_TRUE (updated);
+	EXPECT_EQ (total, 5000050000LL);
+
+	total = scan.aggregate (
+		int64_t (0), [] (int64_t& sum, sqlite3_stmt* stmt) { sum += sqlite3_column_int64 (stmt, 0); },
+		[] (int64_t& sum, const int64_t& partial) { sum += partial; });
+	EXPECT_EQ (total, 0);
+}
+
+TEST_F (ParallelScanTest, Errors) {
+	jlu::ScanOptions options;
+	options.threads = 2;
+	jlu::ParallelScan scan (db, "data_1", options);
+	EXPECT_THROW (scan.run ([] (size_t, sqlite3_stmt*) { throw std::runtime_error ("stop"); }),
+				  std::runtime_error);
+	EXPECT_EQ (scan.run ([] (size_t, sqlite3_stmt*) {}).rows, 100000u);
+
+	jlu::MySQLite memory;
+	memory.open (":memory:");
+	memory.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY)");
+	EXPECT_THROW (jlu::ParallelScan (memory, "data_1"), std::runtime_error);
+	options.predicate = "no_such_column = 1";
+	EXPECT_THROW (jlu::ParallelScan (db, "data_1", options), std::runtime_error);
+}
+
+TEST_F (ParallelScanTest, Keys_over_the_whole_int64_range) {
+	db.exec ("DELETE FROM data_1;");
+	db.exec (
+		"INSERT INTO data_1 (id, resource, value) VALUES (-9223372036854775808, 'AI1', 1), (0, 'AI1', 2), "
+		"(6148914691236517204, 'AI1', 3), (9223372036854775807, 'AI1', 4);");
+
+	for (size_t threads : {1, 2, 3, 4}) {
+		for (size_t chunksPerThread : {1, 2, 7}) {
+			jlu::ScanOptions options;
+			options.threads = threads;
+			options.chunksPerThread = chunksPerThread;
+			options.columns = "value";
+			jlu::ParallelScan scan (db, "data_1", options);
+			int64_t total = scan.aggregate (
+				int64_t (0), [] (int64_t& sum, sqlite3_stmt* stmt) { sum += sqlite3_column_int64 (stmt, 0); },
+				[] (int64_t& sum, const int64_t& partial) { sum += partial; });
+			EXPECT_EQ (total, 10) << threads << " threads, " << chunksPerThread << " chunks per thread";
+			EXPECT_EQ (scan.getStats ().rows, 4u);
+		}
+	}
+}
@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <thread>
+#include "../src/MySQLite/include/pipelinedfetch.h"
+
+static const std::string fetchFileName ("fetch.db");
+
+class PipelinedFetchTest : public ::testing::Test {
+   public:
+	void SetUp () {
+		std::filesystem::remove (fetchFileName);
+		jlu::MySQLite db (fetchFileName);
+		db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, resource TEXT, value REAL)");
+		db.exec ("BEGIN;");
+		for (int i = 1; i <= 10000; i++) {
+			db.exec ("INSERT INTO data_1 (resource, value) VALUES ('AI" + std::to_string (i % 10) + "', " +
+					 std::to_string (i) + ")");
+		}
+		db.exec ("COMMIT;");
+	}
+};
+
+TEST_F (PipelinedFetchTest, Batches_arrive_in_order_in_recycled_buffers) {
+	jlu::MySQLite db (fetchFileName);
+	jlu::FetchOptions options;
+	options.batchRows = 128;
+	jlu::PipelinedFetch fetch (db, options);
+
+	int64_t expected = 1;
+	double total = 0.0;
+	std::set<const jlu::Rows*> buffers;
+	jlu::FetchStats stats = fetch.run ("SELECT id, resource, value FROM data_1 ORDER BY id", [&] (const jlu::Rows& batch) {
+		buffers.insert (&batch);
+		EXPECT_LE (batch.size (), 128u);
+		for (jlu::Rows::Row row : batch) {
+			EXPECT_EQ (row["id"].asInt64 (), expected++);
+			total += row[2].asDouble ();
+		}
+	});
+	EXPECT_EQ (stats.rows, 10000u);
+	EXPECT_EQ (stats.batches, 79u);
+	EXPECT_DOUBLE_EQ (total, 10000.0 * 10001.0 / 2.0);
+	EXPECT_LE (buffers.size (), 2u);
+	EXPECT_EQ (fetch.getStats ().rows, 10000u);
+
+	stats = fetch.run ("SELECT id FROM data_1 WHERE id < 0", [] (const jlu::Rows&) { FAIL (); });
+	EXPECT_EQ (stats.rows, 0u);
+	EXPECT_EQ (stats.batches, 0u);
+}
+
+TEST_F (PipelinedFetchTest, Slow_consumer_holds_back_the_producer) {
+	jlu::MySQLite db (fetchFileName);
+	jlu::FetchOptions options;
+	options.batchRows = 1000;
+	options.buffers = 3;
+	options.interning = jlu::Interning::PerColumn;
+	jlu::PipelinedFetch fetch (db, options);
+
+	std::set<uint32_t> codes;
+	jlu::FetchStats stats = fetch.run ("SELECT resource FROM data_1", [&codes] (const jlu::Rows& batch) {
+		for (jlu::Rows::Row row : batch) {
+			codes.insert (row[0].code ());
+		}
+		std::this_thread::sleep_for (std::chrono::milliseconds (20));
+	});
+	EXPECT_EQ (stats.batches, 10u);
+	EXPECT_EQ (codes.size (), 10u);
+	EXPECT_GE (stats.consumeSeconds, 0.19);
+	// With 3 buffers the producer is stopped for most of the 10 batches.
+	EXPECT_GE (stats.producerWaitSeconds, 0.05);
+}
+
+TEST_F (PipelinedFetchTest, Interned_codes_hold_across_batches) {
+	jlu::MySQLite db (fetchFileName);
+	jlu::FetchOptions options;
+	options.batchRows = 100;
+	options.interning = jlu::Interning::PerResult;
+	jlu::PipelinedFetch fetch (db, options);
+
+	const jlu::StringDictionary* dictionary = nullptr;
+	std::map<uint32_t, std::string> texts;
+	size_t mismatches = 0;
+	fetch.run ("SELECT resource FROM data_1", [&] (const jlu::Rows& batch) {
+		if (dictionary == nullptr) {
+			dictionary = batch.dictionary (0);
+		}
+		mismatches += (batch.dictionary (0) != dictionary);
+		for (jlu::Rows::Row row : batch) {
+			auto known = texts.emplace (row[0].code (), std::string (row[0].asText ()));
+			mismatches += (known.first->second != row[0].asText ());
+		}
+	});
+	EXPECT_EQ (mismatches, 0u);
+	EXPECT_EQ (texts.size (), 10u);
+	ASSERT_NE (dictionary, nullptr);
+}
+
+TEST_F (PipelinedFetchTest, Errors_stop_the_producer) {
+	jlu::MySQLite db (fetchFileName);
+	jlu::PipelinedFetch fetch (db);
+	EXPECT_THROW (fetch.run ("SELECT * FROM data_2", [] (const jlu::Rows&) {}), std::runtime_error);
+
+	int calls = 0;
+	EXPECT_THROW (fetch.run ("SELECT * FROM data_1",
+							 [&calls] (const jlu::Rows&) {
+								 calls++;
+								 throw std::logic_error ("stop");
+							 }),
+				  std::logic_error);
+	EXPECT_EQ (calls, 1);
+
+	// The statement is finalized: the connection can write and close.
+	EXPECT_TRUE (db.exec ("DELETE FROM data_1 WHERE id > 10"));
+	EXPECT_TRUE (db.close ());
+}
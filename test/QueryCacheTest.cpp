@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include "../src/MySQLite/include/querycache.h"
+#include "../src/MySQLite/include/transaction.h"
+
+class QueryCacheTest : public ::testing::Test {
+   public:
+	void SetUp () {
+		std::remove ("cache.db");
+		db.open ("cache.db");
+		db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY ASC NOT NULL, resource TEXT, value REAL)");
+		db.exec ("CREATE TABLE data_2 (id INTEGER PRIMARY KEY ASC NOT NULL, name TEXT)");
+		db.exec ("INSERT INTO data_1 (resource, value) VALUES ('AI01', 1.5), ('AI02', 2.5), ('AI03', 3.5);");
+		db.exec ("INSERT INTO data_2 (name) VALUES ('pump');");
+	}
+	void TearDown () {
+		db.close ();
+		std::remove ("cache.db");
+	}
+	jlu::MySQLite db;
+};
+
+TEST_F (QueryCacheTest, Repeated_queries_hit_the_cache) {
+	jlu::QueryCache cache (db);
+	jlu::CachedResult first = cache.query ("SELECT * FROM data_1 WHERE value > ?1", {2.0});
+	ASSERT_EQ (first->size (), 2u);
+	jlu::CachedResult second = cache.query ("SELECT * FROM data_1 WHERE value > ?1", {2.0});
+	EXPECT_EQ (first.get (), second.get ());
+	jlu::CachedResult other = cache.query ("SELECT * FROM data_1 WHERE value > ?1", {3.0});
+	EXPECT_EQ (other->size (), 1u);
+
+	std::vector<jlu::sqlRow> rows;
+	db.exec ("SELECT count(*) AS n FROM data_2", rows);	// other reads do not invalidate
+	cache.exec ("SELECT count(*) AS n FROM data_2", rows);
+	cache.exec ("SELECT count(*) AS n FROM data_2", rows);
+	EXPECT_EQ (std::get<int> (rows[0]["n"]), 1);
+
+	jlu::QueryCacheStats stats = cache.getStats ();
+	EXPECT_EQ (stats.hits, 2u);
+	EXPECT_EQ (stats.misses, 3u);
+	EXPECT_EQ (stats.entries, 3u);
+	EXPECT_GT (stats.bytes, 0u);
+	EXPECT_DOUBLE_EQ (stats.hitRatio (), 0.4);
+}
+
+TEST_F (QueryCacheTest, Writes_invalidate_the_tables_they_change) {
+	jlu::QueryCache cache (db);
+	cache.query ("SELECT * FROM data_1");
+	cache.query ("SELECT count(*) FROM data_2");
+	cache.query ("SELECT d.resource FROM data_1 d JOIN data_2 n ON n.id = d.id");
+
+	db.exec ("UPDATE data_2 SET name = 'valve';");
+	jlu::QueryCacheStats stats = cache.getStats ();
+	EXPECT_EQ (stats.invalidations, 2u);
+	EXPECT_EQ (stats.entries, 1u);
+
+	cache.query ("SELECT * FROM data_1");
+	EXPECT_EQ (cache.getStats ().hits, 1u);
+
+	db.exec ("BEGIN;");
+	db.exec ("DELETE FROM data_1 WHERE id = 1;");
+	EXPECT_EQ (cache.query ("SELECT * FROM data_1")->size (), 2u);
+	db.exec ("ROLLBACK;");
+	EXPECT_EQ (cache.query ("SELECT * FROM data_1")->size (), 3u);
+}
+
+TEST_F (QueryCacheTest, Other_connections_and_schema_changes_are_caught) {
+	jlu::QueryCache cache (db);
+	EXPECT_EQ (cache.query ("SELECT * FROM data_2")->size (), 1u);
+
+	jlu::MySQLite other;
+	other.open ("cache.db");
+	other.exec ("INSERT INTO data_2 (name) VALUES ('valve');");
+	other.close ();
+	EXPECT_EQ (cache.query ("SELECT * FROM data_2")->size (), 2u);
+
+	cache.query ("SELECT * FROM data_1");
+	db.exec ("DELETE FROM data_1;");	// truncate optimization: no update hook
+	EXPECT_EQ (cache.query ("SELECT * FROM data_1")->size (), 0u);
+
+	cache.query ("SELECT * FROM data_2");
+	db.exec ("ALTER TABLE data_2 ADD COLUMN kind TEXT;");
+	EXPECT_EQ (cache.query ("SELECT * FROM data_2")->at (0).size (), 3u);
+}
+
+TEST_F (QueryCacheTest, Schema_change_in_a_transaction_with_row_changes_is_caught) {
+	jlu::QueryCache cache (db);
+	EXPECT_EQ (cache.query ("SELECT * FROM data_1")->size (), 3u);
+
+	db.exec ("BEGIN;");
+	db.exec ("INSERT INTO data_2 (name) VALUES ('valve');");
+	db.exec ("DROP TABLE data_1;");
+	db.exec ("CREATE TABLE data_1 (x);");
+	db.exec ("COMMIT;");
+	EXPECT_EQ (cache.query ("SELECT * FROM data_1")->size (), 0u);
+}
+
+TEST_F (QueryCacheTest, Volatile_statements_and_memory_budget) {
+	jlu::QueryCacheOptions options;
+	options.maxBytes = 4096;
+	jlu::QueryCache cache (db, options);
+
+	cache.query ("SELECT random() AS r");
+	cache.query ("SELECT datetime('now') AS t");
+	EXPECT_EQ (cache.getStats ().uncacheable, 2u);
+	EXPECT_EQ (cache.getStats ().entries, 0u);
+
+	for (int i = 0; i < 50; i++) {
+		cache.query ("SELECT * FROM data_1 WHERE id = ?1", {i});
+	}
+	jlu::QueryCacheStats stats = cache.getStats ();
+	EXPECT_LE (stats.bytes, 4096u);
+	EXPECT_GT (stats.evictions, 0u);
+	EXPECT_EQ (stats.entries + stats.evictions, 50u);
+	EXPECT_THROW (cache.query ("SELECT * FROM no_table"), std::runtime_error);
+}
+
+TEST_F (QueryCacheTest, Savepoint_rollback_leaves_no_stale_result) {
+	jlu::QueryCache cache (db);
+	std::vector<jlu::sqlRow> rows;
+	{
+		jlu::Transaction transaction (db);
+		{
+			jlu::Savepoint savepoint (db);
+			db.exec ("UPDATE data_1 SET value = 99 WHERE id = 1;");
+			cache.exec ("SELECT value FROM data_1 WHERE id = 1", rows);
+			EXPECT_DOUBLE_EQ (std::get<double> (rows[0]["value"]), 99.0);
+		}
+		transaction.commit ();
+	}
+	cache.exec ("SELECT value FROM data_1 WHERE id = 1", rows);
+	EXPECT_DOUBLE_EQ (std::get<double> (rows[0]["value"]), 1.5);
+	EXPECT_EQ (cache.getStats ().hits, 0u);
+}
+
+TEST_F (QueryCacheTest, Transactions_and_pragmas_run_every_time) {
+	jlu::QueryCache cache (db);
+	std::vector<jlu::sqlRow> rows;
+	for (int i = 0; i < 2; i++) {
+		cache.exec ("BEGIN", rows);
+		EXPECT_EQ (sqlite3_get_autocommit (db.getHandle ()), 0);
+		cache.exec ("COMMIT", rows);
+		EXPECT_NE (sqlite3_get_autocommit (db.getHandle ()), 0);
+	}
+
+	cache.exec ("PRAGMA user_version", rows);
+	db.exec ("PRAGMA user_version = 7;");
+	cache.exec ("PRAGMA user_version", rows);
+	EXPECT_EQ (std::get<int> (rows[0]["user_version"]), 7);
+	EXPECT_EQ (cache.getStats ().entries, 0u);
+	EXPECT_EQ (cache.getStats ().hits, 0u);
+
+	EXPECT_THROW (cache.exec ("SELECT 1; DELETE FROM data_1", rows), std::runtime_error);
+	cache.exec ("SELECT count(*) AS n FROM data_1; -- rows", rows);
+	EXPECT_EQ (std::get<int> (rows[0]["n"]), 3);
+}
+
+TEST_F (QueryCacheTest, Misses_do_not_expire_other_statements) {
+	sqlite3_stmt* stmt = nullptr;
+	ASSERT_EQ (sqlite3_prepare_v2 (db.getHandle (), "SELECT name FROM data_2", -1, &stmt, nullptr), SQLITE_OK);
+	{
+		jlu::QueryCache cache (db);
+		EXPECT_EQ (sqlite3_step (stmt), SQLITE_ROW);
+		sqlite3_reset (stmt);
+		for (int i = 0; i < 5; i++) {
+			cache.query ("SELECT * FROM data_1 WHERE id = ?1", {i});
+			EXPECT_EQ (sqlite3_step (stmt), SQLITE_ROW);
+			sqlite3_reset (stmt);
+		}
+		EXPECT_EQ (cache.getStats ().misses, 5u);
+	}
+	// Only the authorizer set by the constructor expired it.
+	EXPECT_EQ (sqlite3_stmt_status (stmt, SQLITE_STMTSTATUS_REPREPARE, 0), 1);
+	sqlite3_finalize (stmt);
+}
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include "../src/MySQLite/include/mysqlite.h"
+
+static const std::string rowsFileName ("rows.db");
+
+class RowsTest : public ::testing::Test {
+   public:
+	void SetUp () { std::filesystem::remove (rowsFileName); }
+};
+
+TEST_F (RowsTest, Column_index_is_a_perfect_hash) {
+	std::vector<std::string> names;
+	for (int i = 0; i < 200; i++) {
+		names.push_back ("column_" + std::to_string (i));
+	}
+	names.push_back ("column_7");
+	jlu::ColumnIndex index (names);
+	EXPECT_EQ (index.size (), 201u);
+	for (int i = 0; i < 200; i++) {
+		EXPECT_EQ (index.find ("column_" + std::to_string (i)), i);
+	}
+	EXPECT_EQ (index.find ("column_200"), -1);
+	EXPECT_EQ (index.find (""), -1);
+	EXPECT_EQ (jlu::ColumnIndex ().find ("id"), -1);
+}
+
+TEST_F (RowsTest, Query_into_flat_rows) {
+	jlu::MySQLite db (rowsFileName);
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, resource TEXT, value REAL)");
+	db.exec ("BEGIN;");
+	for (int i = 1; i <= 100; i++) {
+		db.exec ("INSERT INTO data_1 (resource, value) VALUES ('AI" + std::to_string (i % 4) + "', " +
+				 std::to_string (i) + ".5)");
+	}
+	db.exec ("COMMIT;");
+
+	jlu::Rows rows;
+	EXPECT_TRUE (db.query ("SELECT id, resource, value FROM data_1 ORDER BY id", rows));
+	ASSERT_EQ (rows.size (), 100u);
+	EXPECT_EQ (rows.columnCount (), 3u);
+	EXPECT_EQ (rows.columns ().name (1), "resource");
+	EXPECT_EQ (rows[9][0].asInt64 (), 10);
+	EXPECT_EQ (rows[9]["resource"].asText (), "AI2");
+	EXPECT_DOUBLE_EQ (rows[9]["value"].asDouble (), 10.5);
+	EXPECT_THROW (rows[9]["missing"], std::runtime_error);
+
+	int64_t total = 0;
+	size_t cells = 0;
+	for (jlu::Rows::Row row : rows) {
+		total += row["id"].asInt64 ();
+		for (const jlu::Value& cell : row) {
+			cells += cell.isNull () ? 0 : 1;
+		}
+	}
+	EXPECT_EQ (total, 5050);
+	EXPECT_EQ (cells, 300u);
+
+	std::shared_ptr<const jlu::ColumnIndex> columns = rows.sharedColumns ();
+	EXPECT_TRUE (db.query ("SELECT count(*) AS n FROM data_1", rows));
+	ASSERT_EQ (rows.size (), 1u);
+	EXPECT_EQ (rows[0]["n"].asInt64 (), 100);
+	EXPECT_EQ (columns->find ("value"), 2);
+	EXPECT_THROW (db.query ("SELECT * FROM data_2", rows), std::runtime_error);
+}
+
+TEST_F (RowsTest, Interned_texts) {
+	jlu::MySQLite db (rowsFileName);
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, resource TEXT, unit TEXT)");
+	db.exec ("BEGIN;");
+	for (int i = 0; i < 1000; i++) {
+		db.exec ("INSERT INTO data_1 (resource, unit) VALUES ('resource number " + std::to_string (i % 3) + "', " +
+				 ((i % 2 == 0) ? "'resource number 0'" : "NULL") + ")");
+	}
+	db.exec ("COMMIT;");
+
+	jlu::Rows rows;
+	rows.setInterning (jlu::Interning::PerColumn);
+	db.query ("SELECT resource, unit, id FROM data_1 ORDER BY id", rows);
+	ASSERT_EQ (rows.size (), 1000u);
+	ASSERT_NE (rows.dictionary (0), nullptr);
+	EXPECT_EQ (rows.dictionary (0)->size (), 3u);
+	EXPECT_EQ (rows.dictionary (1)->size (), 1u);
+	EXPECT_NE (rows.dictionary (0), rows.dictionary (1));
+
+	std::vector<int> groups (rows.dictionary (0)->size (), 0);
+	for (jlu::Rows::Row row : rows) {
+		ASSERT_TRUE (row[0].isInterned ());
+		groups[row[0].code ()]++;
+	}
+	EXPECT_EQ (groups, (std::vector<int>{334, 333, 333}));
+	EXPECT_EQ (rows[4]["resource"].asText (), "resource number 1");
+	EXPECT_EQ (rows[4]["resource"], jlu::Value::text ("resource number 1"));
+	EXPECT_EQ (rows[1][0], rows[4][0]);
+	EXPECT_TRUE (rows[1]["unit"].isNull ());
+	EXPECT_EQ (rows[1]["id"].code (), jlu::Value::noCode);
+
+	// One dictionary for the result: equal texts of different columns share a code.
+	rows.setInterning (jlu::Interning::PerResult, 2);
+	db.query ("SELECT resource, unit FROM data_1 ORDER BY id", rows);
+	EXPECT_EQ (rows.dictionary (0), rows.dictionary (1));
+	EXPECT_EQ (rows.dictionary (0)->size (), 2u);
+	EXPECT_EQ (rows[0][0].code (), rows[0][1].code ());
+	// The dictionary is full: the third text is stored as a plain value.
+	EXPECT_FALSE (rows[2][0].isInterned ());
+	EXPECT_EQ (rows[2][0].asText (), "resource number 2");
+
+	rows.setInterning (jlu::Interning::Off);
+	db.query ("SELECT resource FROM data_1", rows);
+	EXPECT_EQ (rows.dictionary (0), nullptr);
+	EXPECT_FALSE (rows[0][0].isInterned ());
+}
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include "../src/MySQLite/include/snapshot.h"
+
+static int64_t sumValues (sqlite3* conn) {
+	sqlite3_stmt* stmt = nullptr;
+	sqlite3_prepare_v2 (conn, "SELECT sum(value) FROM data_1", -1, &stmt, nullptr);
+	int64_t sum = (sqlite3_step (stmt) == SQLITE_ROW) ? sqlite3_column_int64 (stmt, 0) : -1;
+	sqlite3_finalize (stmt);
+	return sum;
+}
+
+class SnapshotTest : public ::testing::Test {
+   public:
+	void SetUp () {
+		removeFiles ();
+		db.open ("snapshot.db");
+		db.exec ("PRAGMA journal_mode=WAL;");
+		db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY ASC NOT NULL, value INTEGER)");
+		db.exec (
+			"WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 1000) "
+			"INSERT INTO data_1 SELECT i, i FROM n;");
+	}
+	void TearDown () {
+		db.close ();
+		removeFiles ();
+	}
+	void removeFiles () {
+		std::remove ("snapshot.db");
+		std::remove ("snapshot.db-wal");
+		std::remove ("snapshot.db-shm");
+	}
+	jlu::MySQLite db;
+};
+
+TEST_F (SnapshotTest, Readers_share_one_snapshot) {
+	jlu::ReaderPool pool (db, 3);
+	pool.begin ();
+	EXPECT_TRUE (pool.inRead ());
+	EXPECT_TRUE (pool.getSnapshot ().isValid ());
+
+	db.exec ("UPDATE data_1 SET value = 0 WHERE id > 500;");
+	for (size_t i = 0; i < pool.size (); i++) {
+		EXPECT_EQ (sumValues (pool.reader (i)), 500500);
+	}
+	EXPECT_THROW (pool.begin (), std::runtime_error);
+	pool.end ();
+
+	pool.begin ();
+	EXPECT_EQ (sumValues (pool.reader (2)), 125250);
+	pool.end ();
+}
+
+TEST_F (SnapshotTest, Snapshot_of_the_main_connection) {
+	jlu::ReaderPool pool (db, 2);
+	sqlite3* handle = db.getHandle ();
+	db.exec ("BEGIN;");
+	EXPECT_EQ (sumValues (handle), 500500);
+	jlu::Snapshot before = jlu::Snapshot::capture (handle);
+	db.exec ("COMMIT;");
+
+	db.exec ("PRAGMA wal_autocheckpoint = 0;");
+	db.exec ("DELETE FROM data_1 WHERE id > 10;");
+	pool.begin (before);
+	EXPECT_EQ (sumValues (pool.reader (0)), 500500);
+	EXPECT_EQ (sumValues (pool.reader (1)), 500500);
+	pool.end ();
+
+	pool.begin ();
+	EXPECT_EQ (sumValues (pool.reader (1)), 55);
+	EXPECT_LT (before.compare (pool.getSnapshot ()), 0);
+	EXPECT_EQ (pool.getSnapshot ().compare (pool.getSnapshot ()), 0);
+	pool.end ();
+}
+
+TEST_F (SnapshotTest, Rollback_journal_falls_back_to_holding_writers) {
+	db.close ();
+	removeFiles ();
+	db.open ("snapshot.db");
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY ASC NOT NULL, value INTEGER)");
+	db.exec ("INSERT INTO data_1 VALUES (1, 10), (2, 20);");
+
+	jlu::ReaderPool pool (db, 2, 10);
+	pool.begin ();
+	EXPECT_FALSE (pool.getSnapshot ().isValid ());
+	EXPECT_EQ (sumValues (pool.reader (0)), 30);
+	EXPECT_EQ (sumValues (pool.reader (1)), 30);
+	pool.end ();
+	EXPECT_TRUE (db.exec ("INSERT INTO data_1 VALUES (3, 30);"));
+}
+
+TEST_F (SnapshotTest, Errors) {
+	jlu::Snapshot empty;
+	EXPECT_FALSE (empty.isValid ());
+	EXPECT_THROW (empty.open (db.getHandle ()), std::runtime_error);
+	// Autocommit connection: no read transaction to capture.
+	EXPECT_THROW (jlu::Snapshot::capture (db.getHandle ()), std::runtime_error);
+
+	jlu::MySQLite memory;
+	memory.open (":memory:");
+	EXPECT_THROW (jlu::ReaderPool (memory, 2), std::runtime_error);
+}
@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+#include "../src/MySQLite/include/transaction.h"
+
+static const std::string transactionFileName ("transaction.db");
+
+class TransactionTest : public ::testing::Test {
+   public:
+	void SetUp () { std::filesystem::remove (transactionFileName); }
+};
+
+static int countRows (jlu::MySQLite& db) {
+	std::vector<jlu::sqlRow> result;
+	db.exec ("SELECT count(*) AS n FROM data_1", result);
+	return std::get<int> (result[0]["n"]);
+}
+
+TEST_F (TransactionTest, Commit_and_rollback_on_unwind) {
+	jlu::MySQLite db (transactionFileName);
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, value REAL)");
+
+	{
+		jlu::Transaction transaction (db, jlu::TransactionMode::Immediate);
+		db.exec ("INSERT INTO data_1 (value) VALUES (1.5)");
+		EXPECT_THROW (jlu::Transaction (db, jlu::TransactionMode::Deferred), std::runtime_error);
+		std::this_thread::sleep_for (std::chrono::milliseconds (10));
+		transaction.commit ();
+		EXPECT_FALSE (transaction.isActive ());
+		EXPECT_GE (transaction.writeLockSeconds (), 0.01);
+		EXPECT_THROW (transaction.commit (), std::runtime_error);
+	}
+	EXPECT_EQ (countRows (db), 1);
+
+	try {
+		jlu::Transaction transaction (db);
+		db.exec ("INSERT INTO data_1 (value) VALUES (2.5)");
+		throw std::runtime_error ("failure");
+	} catch (std::runtime_error&) {}
+	EXPECT_EQ (countRows (db), 1);
+	EXPECT_NE (sqlite3_get_autocommit (db.getHandle ()), 0);
+
+	{
+		// Only reads: a DEFERRED transaction never takes the write lock.
+		jlu::Transaction transaction (db);
+		countRows (db);
+		transaction.commit ();
+		EXPECT_EQ (transaction.writeLockSeconds (), 0.0);
+	}
+
+	jlu::TransactionStats stats = db.getTransactionStats ();
+	EXPECT_EQ (stats.commits, 2u);
+	EXPECT_EQ (stats.rollbacks, 1u);
+	EXPECT_GE (stats.writeLockSeconds, 0.01);
+	// The rolled back DEFERRED transaction wrote, so it held the lock too.
+	EXPECT_GE (stats.maxWriteLockSeconds, 0.01);
+	EXPECT_GT (stats.writeLockSeconds, stats.maxWriteLockSeconds);
+}
+
+TEST_F (TransactionTest, Immediate_fails_while_another_connection_writes) {
+	jlu::MySQLite db (transactionFileName);
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, value REAL)");
+	jlu::MySQLite other (transactionFileName);
+
+	jlu::Transaction writer (db, jlu::TransactionMode::Immediate);
+	EXPECT_THROW (jlu::Transaction (other, jlu::TransactionMode::Immediate), std::runtime_error);
+	EXPECT_NE (sqlite3_get_autocommit (other.getHandle ()), 0);
+	writer.rollback ();
+	jlu::Transaction (other, jlu::TransactionMode::Exclusive).commit ();
+}
+
+TEST_F (TransactionTest, Nested_savepoints) {
+	jlu::MySQLite db (transactionFileName);
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, value REAL)");
+
+	jlu::Transaction transaction (db);
+	db.exec ("INSERT INTO data_1 (value) VALUES (1.5)");
+	{
+		jlu::Savepoint outer (db);
+		db.exec ("INSERT INTO data_1 (value) VALUES (2.5)");
+		{
+			jlu::Savepoint inner (db);
+			EXPECT_NE (inner.getName (), outer.getName ());
+			db.exec ("INSERT INTO data_1 (value) VALUES (3.5)");
+			EXPECT_EQ (countRows (db), 3);
+		}
+		EXPECT_EQ (countRows (db), 2);
+		outer.release ();
+		EXPECT_THROW (outer.rollback (), std::runtime_error);
+	}
+	transaction.commit ();
+	EXPECT_EQ (countRows (db), 2);
+
+	// A savepoint outside a transaction begins one; its release commits.
+	{
+		jlu::Savepoint savepoint (db);
+		db.exec ("INSERT INTO data_1 (value) VALUES (4.5)");
+		EXPECT_EQ (sqlite3_get_autocommit (db.getHandle ()), 0);
+		savepoint.release ();
+	}
+	EXPECT_NE (sqlite3_get_autocommit (db.getHandle ()), 0);
+	EXPECT_EQ (countRows (db), 3);
+}
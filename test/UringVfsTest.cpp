@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include "../src/MySQLite/include/mysqlite.h"
+#include "../src/MySQLite/include/uringvfs.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+static const std::string uringFileName ("uring.db");
+
+class UringVfsTest : public ::testing::Test {
+   public:
+	void SetUp () {
+		for (std::string suffix : {"", "-wal", "-shm", "-journal"}) {
+			std::filesystem::remove (uringFileName + suffix);
+		}
+		jlu::uringvfs::registerVfs ();
+	}
+};
+
+static void insertRows (jlu::MySQLite& db, int first, int count) {
+	db.exec ("BEGIN;");
+	for (int i = first; i < first + count; i++) {
+		db.exec ("INSERT INTO data_1 VALUES (" + std::to_string (i) + ", randomblob(300), " + std::to_string (i) +
+				 ".5);");
+	}
+	db.exec ("COMMIT;");
+}
+
+static std::string count (jlu::MySQLite& db) {
+	std::vector<jlu::sqlRow> rows;
+	db.exec ("SELECT count(*) AS n, sum(value) AS total FROM data_1;", rows);
+	return std::to_string (std::get<int> (rows[0]["n"])) + "/" + std::to_string (std::get<double> (rows[0]["total"]));
+}
+
+TEST_F (UringVfsTest, Register_and_fall_back) {
+	EXPECT_EQ (jlu::uringvfs::registerVfs (), jlu::uringvfs::isAvailable ());
+	EXPECT_NE (sqlite3_vfs_find (jlu::uringvfs::name), nullptr);
+
+	jlu::MySQLite db;
+	EXPECT_THROW (db.open (uringFileName, "no-such-vfs"), std::runtime_error);
+	EXPECT_TRUE (db.open (uringFileName, jlu::uringvfs::name));
+	EXPECT_TRUE (db.close ());
+}
+
+TEST_F (UringVfsTest, Rollback_journal_writes_reach_the_file) {
+	jlu::MySQLite db;
+	db.open (uringFileName, jlu::uringvfs::name);
+	db.exec ("PRAGMA synchronous=FULL;");
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, payload BLOB, value REAL)");
+	for (int t = 0; t < 20; t++) {
+		insertRows (db, t * 50, 50);
+	}
+	db.exec ("UPDATE data_1 SET value = value + 1 WHERE id % 3 = 0;");
+	std::string expected = count (db);
+
+	jlu::MySQLite plain (uringFileName);
+	EXPECT_EQ (count (plain), expected);
+	db.close ();
+	EXPECT_EQ (count (plain), expected);
+	std::vector<jlu::sqlRow> check;
+	plain.exec ("PRAGMA integrity_check;", check);
+	EXPECT_EQ (std::get<std::string> (check[0]["integrity_check"]), "ok");
+
+	if (jlu::uringvfs::isAvailable ()) {
+		jlu::uringvfs::Stats stats = jlu::uringvfs::getStats ();
+		EXPECT_GT (stats.submissions, 0u);
+		EXPECT_GT (stats.coalescedWrites + stats.writes, 0u);
+	}
+}
+
+TEST_F (UringVfsTest, Wal_commits_are_visible_to_other_connections) {
+	jlu::MySQLite db;
+	db.open (uringFileName, jlu::uringvfs::name);
+	db.exec ("PRAGMA journal_mode=WAL;");
+	db.exec ("PRAGMA synchronous=NORMAL;");
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, payload BLOB, value REAL)");
+
+	// No sync at commit: the frames must be written before the WAL index shows them.
+	jlu::MySQLite reader (uringFileName);
+	uint64_t syncs = jlu::uringvfs::getStats ().syncs;
+	for (int t = 0; t < 10; t++) {
+		insertRows (db, t * 100, 100);
+		EXPECT_EQ (count (reader), count (db));
+	}
+	EXPECT_EQ (jlu::uringvfs::getStats ().syncs, syncs);
+
+	db.exec ("PRAGMA synchronous=FULL;");
+	insertRows (db, 1000, 100);
+	insertRows (db, 1100, 100);
+	EXPECT_EQ (count (reader), count (db));
+	db.exec ("PRAGMA wal_checkpoint(TRUNCATE);");
+	db.close ();
+
+	std::vector<jlu::sqlRow> check;
+	reader.exec ("PRAGMA integrity_check;", check);
+	EXPECT_EQ (std::get<std::string> (check[0]["integrity_check"]), "ok");
+	EXPECT_EQ (count (reader), "1200/" + std::to_string (1200 * 1199 / 2 + 1200 * 0.5));
+}
+
+#ifdef __linux__
+// True if another process sees a read lock on the shared range of the database file, the
+// lock that a connection of the unix VFS holds inside a read transaction.
+static bool sharedLockVisible (const std::string& fileName) {
+	pid_t child = fork ();
+	if (child == 0) {
+		int fd = open (fileName.c_str (), O_RDWR);
+		struct flock lock;
+		lock.l_type = F_WRLCK;
+		lock.l_whence = SEEK_SET;
+		lock.l_start = 0x40000000 + 2;
+		lock.l_len = 510;
+		lock.l_pid = 0;
+		_exit ((fd >= 0 && fcntl (fd, F_GETLK, &lock) == 0 && lock.l_type == F_RDLCK) ? 0 : 1);
+	}
+	int status = 0;
+	waitpid (child, &status, 0);
+	return WIFEXITED (status) && WEXITSTATUS (status) == 0;
+}
+
+TEST_F (UringVfsTest, Closing_keeps_the_locks_of_other_connections) {
+	{
+		jlu::MySQLite writer (uringFileName);
+		writer.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, payload BLOB, value REAL)");
+		insertRows (writer, 0, 10);
+	}
+
+	jlu::MySQLite plain;
+	plain.open (uringFileName, jlu::uringvfs::name);
+	plain.exec ("BEGIN;");
+	EXPECT_EQ (count (plain), "10/50.000000");
+	ASSERT_TRUE (sharedLockVisible (uringFileName));
+
+	for (int i = 0; i < 2; i++) {
+		jlu::MySQLite db;
+		db.open (uringFileName, jlu::uringvfs::name);
+		EXPECT_EQ (count (db), "10/50.000000");
+		db.close ();
+		EXPECT_TRUE (sharedLockVisible (uringFileName));
+	}
+	plain.exec ("COMMIT;");
+	EXPECT_FALSE (sharedLockVisible (uringFileName));
+}
+
+static size_t openDescriptors () {
+	size_t count = 0;
+	for (const auto& entry : std::filesystem::directory_iterator ("/proc/self/fd")) {
+		(void)entry;
+		count++;
+	}
+	return count;
+}
+
+TEST_F (UringVfsTest, Closed_files_release_their_descriptors) {
+	size_t before = openDescriptors ();
+	for (int i = 0; i < 50; i++) {
+		jlu::MySQLite db;
+		db.open (uringFileName, jlu::uringvfs::name);
+		db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, payload BLOB, value REAL)");
+		insertRows (db, 0, 5);
+		db.close ();
+		std::filesystem::remove (uringFileName);
+	}
+	EXPECT_LE (openDescriptors (), before + 2);
+}
+#endif
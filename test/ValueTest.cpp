@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include "../src/MySQLite/include/mysqlite.h"
+
+static const std::string valueFileName ("value.db");
+
+class ValueTest : public ::testing::Test {
+   public:
+	void SetUp () { std::filesystem::remove (valueFileName); }
+};
+
+TEST_F (ValueTest, Types_and_inline_storage) {
+	EXPECT_EQ (sizeof (jlu::Value), 16u);
+	jlu::Value null;
+	EXPECT_TRUE (null.isNull ());
+	EXPECT_EQ (null.toString (), "null");
+
+	// Reals are printed as sqlite3 casts them to text.
+	EXPECT_EQ (jlu::Value (1.5).toString (), "1.5");
+	EXPECT_EQ (jlu::Value (2.0).toString (), "2.0");
+	jlu::MySQLite db (valueFileName);
+	std::vector<jlu::sqlRow> result;
+	db.exec ("SELECT CAST (-0.1 AS TEXT) AS a, CAST (1e20 AS TEXT) AS b, CAST (3.14159265358979 AS TEXT) AS c",
+			 result);
+	EXPECT_EQ (jlu::Value (-0.1).toString (), std::get<std::string> (result[0]["a"]));
+	EXPECT_EQ (jlu::Value (1e20).toString (), std::get<std::string> (result[0]["b"]));
+	EXPECT_EQ (jlu::Value (3.14159265358979).toString (), std::get<std::string> (result[0]["c"]));
+
+	jlu::Value big (int64_t (1) << 40);
+	EXPECT_EQ (big.type (), jlu::Value::Type::Integer);
+	EXPECT_EQ (big.asInt64 (), int64_t (1) << 40);
+	EXPECT_DOUBLE_EQ (jlu::Value (2.5).asDouble (), 2.5);
+	EXPECT_EQ (jlu::Value (2.5).asInt64 (), 2);
+
+	jlu::Value shortText = jlu::Value::text ("AI01");
+	EXPECT_TRUE (shortText.isInline ());
+	EXPECT_EQ (shortText.asText (), "AI01");
+	jlu::Value longText = jlu::Value::text ("a text longer than fourteen bytes");
+	EXPECT_FALSE (longText.isInline ());
+	EXPECT_EQ (longText.size (), 33u);
+
+	jlu::Value copy (longText);
+	EXPECT_EQ (copy, longText);
+	EXPECT_NE (copy.data (), longText.data ());
+	jlu::Value moved (std::move (copy));
+	EXPECT_EQ (moved.asText (), "a text longer than fourteen bytes");
+	EXPECT_TRUE (copy.isNull ());
+	moved = shortText;
+	EXPECT_EQ (moved, shortText);
+	moved = jlu::Value::blob ("\x01\x02", 2);
+	EXPECT_EQ (moved.type (), jlu::Value::Type::Blob);
+	EXPECT_NE (moved, jlu::Value::text ("\x01\x02"));
+	EXPECT_NE (jlu::Value (1), jlu::Value (1.0));
+}
+
+TEST_F (ValueTest, Query_into_value_rows) {
+	jlu::MySQLite db (valueFileName);
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, resource TEXT, value REAL, data BLOB)");
+	db.exec ("INSERT INTO data_1 VALUES (5000000000, 'AI01', 2.5, x'0102'), "
+			 "(2, 'a text longer than fourteen bytes', NULL, NULL)");
+
+	std::vector<jlu::valueRow> rows;
+	std::vector<std::string> columns;
+	EXPECT_TRUE (db.query ("SELECT id, resource, value, data FROM data_1 ORDER BY id DESC", rows, &columns));
+	EXPECT_EQ (columns, (std::vector<std::string>{"id", "resource", "value", "data"}));
+	ASSERT_EQ (rows.size (), 2u);
+	EXPECT_EQ (rows[0][0].asInt64 (), 5000000000);
+	EXPECT_EQ (rows[0][1].asText (), "AI01");
+	EXPECT_DOUBLE_EQ (rows[0][2].asDouble (), 2.5);
+	EXPECT_EQ (rows[0][3], jlu::Value::blob ("\x01\x02", 2));
+	EXPECT_EQ (rows[1][1].asText (), "a text longer than fourteen bytes");
+	EXPECT_TRUE (rows[1][2].isNull ());
+	EXPECT_TRUE (rows[1][3].isNull ());
+
+	EXPECT_THROW (db.query ("SELECT * FROM data_2", rows), std::runtime_error);
+}
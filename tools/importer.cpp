@@ -0,0 +1,72 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "importer.h"
+#include "mysqlite.h"
+
+static void usage () {
+	std::cerr << "Usage: importer [options] <database> <table> <file>\n"
+			  << "  --jsonl          The file is JSON Lines (default CSV)\n"
+			  << "  --delimiter <c>  CSV field delimiter (default ',')\n"
+			  << "  --no-header      The CSV file has no header line\n"
+			  << "  --threads <n>    Parser threads (default: all cores)\n"
+			  << "  --batch <n>      Rows per batch (default 4096)\n"
+			  << "  --txn <n>        Rows per transaction (default 200000)" << std::endl;
+}
+
+int main (int argc, char** argv) {
+	jlu::ImportOptions options;
+	std::string positional[3];
+	int count = 0;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg (argv[i]);
+		bool hasValue = (i + 1 < argc);
+		if (arg == "--jsonl") {
+			options.format = jlu::ImportFormat::JsonLines;
+		} else if (arg == "--no-header") {
+			options.header = false;
+		} else if (arg == "--delimiter" && hasValue) {
+			std::string value (argv[++i]);
+			options.delimiter = (value == "\\t") ? '\t' : value[0];
+		} else if (arg == "--threads" && hasValue) {
+			options.threads = static_cast<unsigned int> (std::stoul (argv[++i]));
+		} else if (arg == "--batch" && hasValue) {
+			options.batchRows = std::stoul (argv[++i]);
+		} else if (arg == "--txn" && hasValue) {
+			options.rowsPerTransaction = std::stoul (argv[++i]);
+		} else if (arg.rfind ("--", 0) != 0 && count < 3) {
+			positional[count++] = arg;
+		} else {
+			usage ();
+			return EXIT_FAILURE;
+		}
+	}
+	if (count != 3) {
+		usage ();
+		return EXIT_FAILURE;
+	}
+
+	try {
+		jlu::MySQLite db (positional[0]);
+		db.exec ("PRAGMA journal_mode=WAL;");
+		db.exec ("PRAGMA synchronous=NORMAL;");
+		jlu::Importer importer (db, options);
+		jlu::ImportStats stats = importer.importFile (positional[2], positional[1]);
+
+		std::cout << "rows:          " << stats.rows << "\n"
+				  << "bytes:         " << stats.bytes << "\n"
+				  << "transactions:  " << stats.transactions << "\n"
+				  << "total:         " << stats.totalSeconds << " s\n"
+				  << "parse stage:   " << stats.parseSeconds << " s, " << stats.parseRowsPerSecond ()
+				  << " rows/s, " << stats.parseBytesPerSecond () / (1024 * 1024) << " MB/s\n"
+				  << "insert stage:  " << stats.insertSeconds << " s, "
+				  << stats.insertRowsPerSecond () << " rows/s, "
+				  << stats.insertBytesPerSecond () / (1024 * 1024) << " MB/s" << std::endl;
+	} catch (const std::exception& exc) {
+		std::cerr << exc.what () << std::endl;
+		return EXIT_FAILURE;
+	}
+	return 0;
+}
@@ -0,0 +1,128 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "kernels.h"
+#include "mysqlite.h"
+
+// Fetch a generated table as Arrow batches, then time every kernel with every instruction
+// set the CPU supports.
+
+static void usage () {
+	std::cerr << "Usage: kernelbench [options]\n"
+			  << "  --rows <n>    Rows of the generated table (default 4000000)\n"
+			  << "  --batch <n>   Rows per Arrow batch (default 65536)\n"
+			  << "  --repeat <n>  Runs of every kernel (default 10)" << std::endl;
+}
+
+template <typename F>
+static double timeIt (int repeat, F kernel) {
+	auto start = std::chrono::steady_clock::now ();
+	for (int r = 0; r < repeat; r++) {
+		kernel ();
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now () - start;
+	return elapsed.count () / repeat;
+}
+
+int main (int argc, char** argv) {
+	size_t rows = 4000000;
+	size_t batchRows = 65536;
+	int repeat = 10;
+	for (int i = 1; i < argc; i++) {
+		std::string arg (argv[i]);
+		bool hasValue = (i + 1 < argc);
+		if (arg == "--rows" && hasValue) {
+			rows = std::strtoull (argv[++i], nullptr, 10);
+		} else if (arg == "--batch" && hasValue) {
+			batchRows = std::strtoull (argv[++i], nullptr, 10);
+		} else if (arg == "--repeat" && hasValue) {
+			repeat = std::atoi (argv[++i]);
+		} else {
+			usage ();
+			return 1;
+		}
+	}
+
+	jlu::MySQLite db;
+	db.open (":memory:");
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, value REAL)");
+	db.exec ("WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < " +
+			 std::to_string (rows) +
+			 ") INSERT INTO data_1 SELECT i, CASE WHEN i % 16 = 0 THEN NULL ELSE i * 0.5 END FROM n;");
+
+	auto start = std::chrono::steady_clock::now ();
+	std::vector<jlu::ArrowBatch> batches;
+	if (!db.queryBatches ("SELECT id, value FROM data_1", batchRows, batches)) {
+		std::cerr << "No rows" << std::endl;
+		return 1;
+	}
+	std::chrono::duration<double> fetch = std::chrono::steady_clock::now () - start;
+	std::cout << "fetch: " << rows << " rows in " << batches.size () << " batches, " << fetch.count ()
+			  << " s" << std::endl;
+
+	std::vector<std::vector<uint8_t>> bitmaps;
+	for (const jlu::ArrowBatch& batch : batches) {
+		bitmaps.emplace_back ((batch.array.length + 7) / 8);
+	}
+
+	std::vector<jlu::kernels::Isa> isas = {jlu::kernels::Isa::Scalar};
+	for (jlu::kernels::Isa isa : {jlu::kernels::Isa::Sse42, jlu::kernels::Isa::Avx2}) {
+		if (jlu::kernels::forceIsa (isa) == isa) {
+			isas.push_back (isa);
+		}
+	}
+
+	for (jlu::kernels::Isa isa : isas) {
+		jlu::kernels::forceIsa (isa);
+		volatile double sink = 0.0;
+		double sumInt = timeIt (repeat, [&] {
+			for (const jlu::ArrowBatch& batch : batches) {
+				const ArrowArray* col = batch.array.children[0];
+				sink = sink + jlu::kernels::sum (static_cast<const int64_t*> (col->buffers[1]),
+												 static_cast<const uint8_t*> (col->buffers[0]), col->length);
+			}
+		});
+		double sumReal = timeIt (repeat, [&] {
+			for (const jlu::ArrowBatch& batch : batches) {
+				const ArrowArray* col = batch.array.children[1];
+				sink = sink + jlu::kernels::sum (static_cast<const double*> (col->buffers[1]),
+												 static_cast<const uint8_t*> (col->buffers[0]), col->length);
+			}
+		});
+		double minMax = timeIt (repeat, [&] {
+			for (const jlu::ArrowBatch& batch : batches) {
+				const ArrowArray* col = batch.array.children[1];
+				sink = sink + jlu::kernels::minMax (static_cast<const double*> (col->buffers[1]),
+													static_cast<const uint8_t*> (col->buffers[0]), col->length)
+								  .max;
+			}
+		});
+		double moments = timeIt (repeat, [&] {
+			for (const jlu::ArrowBatch& batch : batches) {
+				const ArrowArray* col = batch.array.children[1];
+				sink = sink + jlu::kernels::moments (static_cast<const double*> (col->buffers[1]),
+													 static_cast<const uint8_t*> (col->buffers[0]), col->length)
+								  .variance;
+			}
+		});
+		double filter = timeIt (repeat, [&] {
+			for (size_t b = 0; b < batches.size (); b++) {
+				const ArrowArray* col = batches[b].array.children[1];
+				sink = sink + jlu::kernels::compare (static_cast<const double*> (col->buffers[1]),
+													 static_cast<const uint8_t*> (col->buffers[0]), col->length,
+													 jlu::kernels::CompareOp::Gt, rows * 0.25, bitmaps[b].data ());
+			}
+		});
+
+		double megaRows = rows / 1e6;
+		std::cout << jlu::kernels::isaName (isa) << ":\tsum int64 " << megaRows / sumInt << " Mrows/s"
+				  << "\tsum double " << megaRows / sumReal << " Mrows/s"
+				  << "\tmin/max " << megaRows / minMax << " Mrows/s"
+				  << "\tmoments " << megaRows / moments << " Mrows/s"
+				  << "\tfilter " << megaRows / filter << " Mrows/s" << std::endl;
+	}
+	return 0;
+}
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "faultvfs.h"
+#include "mysqlite.h"
+#include "uringvfs.h"
+
+// Commit the same transactions through the default VFS and through the io_uring VFS, and
+// compare the commit latency and the throughput. With a --fault-* option they also run
+// through the "faulty" VFS, which simulates a slower device over the default one.
+
+static void usage () {
+	std::cerr << "Usage: vfsbench [options]\n"
+			  << "  --file <path>       Database file (default vfsbench.db)\n"
+			  << "  --txns <n>          Transactions (default 2000)\n"
+			  << "  --rows <n>          Rows per transaction (default 20)\n"
+			  << "  --payload <bytes>   Blob size of every row (default 512)\n"
+			  << "  --journal <mode>    WAL or DELETE (default WAL)\n"
+			  << "  --sync <mode>       OFF, NORMAL or FULL (default FULL)\n"
+			  << "  --fault-read <us>   Mean latency added to every read\n"
+			  << "  --fault-write <us>  Mean latency added to every write\n"
+			  << "  --fault-sync <us>   Mean latency added to every sync\n"
+			  << "  --fault-dist <d>    constant, uniform or exponential (default constant)\n"
+			  << "  --fault-stall <p>:<us>  Probability and length of a stall of any operation\n"
+			  << "  --fault-bps <bytes> Throughput cap of the simulated device" << std::endl;
+}
+
+static bool parseDistribution (const std::string& text, jlu::faultvfs::Distribution& distribution) {
+	if (text == "constant") {
+		distribution = jlu::faultvfs::Distribution::Constant;
+	} else if (text == "uniform") {
+		distribution = jlu::faultvfs::Distribution::Uniform;
+	} else if (text == "exponential") {
+		distribution = jlu::faultvfs::Distribution::Exponential;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+static void removeFiles (const std::string& file) {
+	for (std::string suffix : {"", "-wal", "-shm", "-journal"}) {
+		std::filesystem::remove (file + suffix);
+	}
+}
+
+static void run (const std::string& label,
+				 const std::string& vfs,
+				 const std::string& file,
+				 int txns,
+				 int rows,
+				 int payload,
+				 const std::string& journal,
+				 const std::string& sync) {
+	removeFiles (file);
+	jlu::MySQLite db;
+	db.open (file, vfs);
+	db.exec ("PRAGMA journal_mode=" + journal + ";");
+	db.exec ("PRAGMA synchronous=" + sync + ";");
+	db.exec ("CREATE TABLE data_1 (id INTEGER PRIMARY KEY, payload BLOB, value REAL)");
+
+	sqlite3_stmt* stmt = nullptr;
+	sqlite3_prepare_v2 (db.getHandle (), "INSERT INTO data_1 (payload, value) VALUES (randomblob(?1), ?2)", -1,
+						&stmt, nullptr);
+	std::vector<double> latencies;
+	latencies.reserve (txns);
+	auto start = std::chrono::steady_clock::now ();
+	for (int t = 0; t < txns; t++) {
+		auto begin = std::chrono::steady_clock::now ();
+		db.exec ("BEGIN;");
+		for (int r = 0; r < rows; r++) {
+			sqlite3_bind_int (stmt, 1, payload);
+			sqlite3_bind_double (stmt, 2, t * 0.5 + r);
+			sqlite3_step (stmt);
+			sqlite3_reset (stmt);
+		}
+		db.exec ("COMMIT;");
+		std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now () - begin;
+		latencies.push_back (elapsed.count ());
+	}
+	std::chrono::duration<double> total = std::chrono::steady_clock::now () - start;
+	sqlite3_finalize (stmt);
+	db.close ();
+	removeFiles (file);
+
+	std::sort (latencies.begin (), latencies.end ());
+	auto percentile = [&latencies] (double p) {
+		return latencies[std::min (latencies.size () - 1, static_cast<size_t> (p * latencies.size ()))];
+	};
+	double megabytes = static_cast<double> (txns) * rows * payload / (1024.0 * 1024.0);
+	printf ("%-8s %10.1f %10.1f %10.1f %10.0f %10.1f\n", label.c_str (), percentile (0.5), percentile (0.99),
+			latencies.back (), txns / total.count (), megabytes / total.count ());
+}
+
+int main (int argc, char** argv) {
+	std::string file ("vfsbench.db");
+	int txns = 2000;
+	int rows = 20;
+	int payload = 512;
+	std::string journal ("WAL");
+	std::string sync ("FULL");
+	jlu::faultvfs::Options faults;
+	bool faulty = false;
+	for (int i = 1; i < argc; i++) {
+		std::string arg (argv[i]);
+		bool hasValue = (i + 1 < argc);
+		if (arg == "--file" && hasValue) {
+			file = argv[++i];
+		} else if (arg == "--txns" && hasValue) {
+			txns = std::max (1, std::atoi (argv[++i]));
+		} else if (arg == "--rows" && hasValue) {
+			rows = std::atoi (argv[++i]);
+		} else if (arg == "--payload" && hasValue) {
+			payload = std::atoi (argv[++i]);
+		} else if (arg == "--journal" && hasValue) {
+			journal = argv[++i];
+		} else if (arg == "--sync" && hasValue) {
+			sync = argv[++i];
+		} else if (arg == "--fault-read" && hasValue) {
+			faults.read.mean = std::chrono::microseconds (std::atoll (argv[++i]));
+			faulty = true;
+		} else if (arg == "--fault-write" && hasValue) {
+			faults.write.mean = std::chrono::microseconds (std::atoll (argv[++i]));
+			faulty = true;
+		} else if (arg == "--fault-sync" && hasValue) {
+			faults.sync.mean = std::chrono::microseconds (std::atoll (argv[++i]));
+			faulty = true;
+		} else if (arg == "--fault-dist" && hasValue && parseDistribution (argv[i + 1], faults.read.distribution)) {
+			faults.write.distribution = faults.sync.distribution = faults.read.distribution;
+			i++;
+		} else if (arg == "--fault-stall" && hasValue && std::string (argv[i + 1]).find (':') != std::string::npos) {
+			std::string value (argv[++i]);
+			double probability = std::atof (value.substr (0, value.find (':')).c_str ());
+			std::chrono::microseconds stall (std::atoll (value.substr (value.find (':') + 1).c_str ()));
+			for (jlu::faultvfs::LatencyModel* model : {&faults.read, &faults.write, &faults.sync}) {
+				model->stallProbability = probability;
+				model->stall = stall;
+			}
+			faulty = true;
+		} else if (arg == "--fault-bps" && hasValue) {
+			faults.bytesPerSecond = std::strtoull (argv[++i], nullptr, 10);
+			faulty = true;
+		} else {
+			usage ();
+			return 1;
+		}
+	}
+
+	bool available = jlu::uringvfs::registerVfs ();
+	printf ("io_uring: %s, journal_mode=%s, synchronous=%s, %d txns x %d rows x %d bytes\n",
+			available ? "available" : "not available (uring falls back to the default VFS)", journal.c_str (),
+			sync.c_str (), txns, rows, payload);
+	printf ("%-8s %10s %10s %10s %10s %10s\n", "vfs", "p50 us", "p99 us", "max us", "txn/s", "MB/s");
+	run ("default", "", file, txns, rows, payload, journal, sync);
+	run ("uring", jlu::uringvfs::name, file, txns, rows, payload, journal, sync);
+	if (faulty && jlu::faultvfs::registerVfs ()) {
+		jlu::faultvfs::configure (faults);
+		run ("faulty", jlu::faultvfs::name, file, txns, rows, payload, journal, sync);
+	}
+
+	jlu::uringvfs::Stats stats = jlu::uringvfs::getStats ();
+	printf ("uring: %llu submissions, %llu writes (%llu merged), %llu chained syncs, %llu fallback files\n",
+			static_cast<unsigned long long> (stats.submissions), static_cast<unsigned long long> (stats.writes),
+			static_cast<unsigned long long> (stats.coalescedWrites), static_cast<unsigned long long> (stats.syncs),
+			static_cast<unsigned long long> (stats.fallbackFiles));
+	if (faulty) {
+		jlu::faultvfs::Stats injected = jlu::faultvfs::getStats ();
+		printf ("faulty: %llu reads, %llu writes, %llu syncs, %llu stalls, %.1f ms injected\n",
+				static_cast<unsigned long long> (injected.reads), static_cast<unsigned long long> (injected.writes),
+				static_cast<unsigned long long> (injected.syncs), static_cast<unsigned long long> (injected.stalls),
+				injected.injectedDelay.count () / 1000.0);
+	}
+	return 0;
+}